@@ -0,0 +1,310 @@
+/*
+ * Application level build options.
+ *
+ * Every option can be overridden from the compiler command line (see
+ * CMakeLists.txt), the values below are only the defaults.
+ */
+
+#ifndef APP_CONFIG_H_
+#define APP_CONFIG_H_
+
+//--------------------------------------------------------------------+
+// Startup
+//--------------------------------------------------------------------+
+
+// Fixed wait between mount and the first input report
+#ifndef CFG_APP_START_DELAY_MS
+#define CFG_APP_START_DELAY_MS    2000
+#endif
+
+// Start as soon as the host sets the keyboard LEDs after mount instead of
+// waiting CFG_APP_START_DELAY_MS, or after CFG_APP_FAST_START_TIMEOUT_MS for
+// hosts that never do
+#ifndef CFG_APP_FAST_START
+#define CFG_APP_FAST_START        0
+#endif
+
+#ifndef CFG_APP_FAST_START_TIMEOUT_MS
+#define CFG_APP_FAST_START_TIMEOUT_MS 500
+#endif
+
+//--------------------------------------------------------------------+
+// Status LED
+//--------------------------------------------------------------------+
+
+// Render the status LED patterns (hid_led.h) from a hardware alarm with PWM
+// brightness instead of polling it from the main loop. Boards without the
+// LED on a GPIO (no PICO_DEFAULT_LED_PIN, e.g. Pico W) poll regardless.
+#ifndef CFG_APP_LED_PWM
+#define CFG_APP_LED_PWM           1
+#endif
+
+// Pattern engine resolution
+#ifndef CFG_APP_LED_TICK_MS
+#define CFG_APP_LED_TICK_MS       10
+#endif
+
+//--------------------------------------------------------------------+
+// FreeRTOS
+//--------------------------------------------------------------------+
+
+// Run TinyUSB, the transmit scheduler and the application as FreeRTOS tasks
+// instead of the super-loop. Set by the FREERTOS CMake option together with
+// CFG_TUSB_OS.
+#ifndef CFG_APP_FREERTOS
+#define CFG_APP_FREERTOS          0
+#endif
+
+// Task priorities: the USB task blocks on TinyUSB's event queue and must
+// preempt everything, the transmit task preempts the producers
+#ifndef CFG_APP_RTOS_USBD_PRIO
+#define CFG_APP_RTOS_USBD_PRIO    3
+#endif
+
+#ifndef CFG_APP_RTOS_TX_PRIO
+#define CFG_APP_RTOS_TX_PRIO      2
+#endif
+
+#ifndef CFG_APP_RTOS_APP_PRIO
+#define CFG_APP_RTOS_APP_PRIO     1
+#endif
+
+// Stack depths in words
+#ifndef CFG_APP_RTOS_USBD_STACK
+#define CFG_APP_RTOS_USBD_STACK   1024
+#endif
+
+#ifndef CFG_APP_RTOS_TX_STACK
+#define CFG_APP_RTOS_TX_STACK     256
+#endif
+
+#ifndef CFG_APP_RTOS_APP_STACK
+#define CFG_APP_RTOS_APP_STACK    512
+#endif
+
+//--------------------------------------------------------------------+
+// Keyboard lanes
+//--------------------------------------------------------------------+
+
+// Extra keyboard interfaces for parallel typing (hid_lanes.h), 0 to 4.
+// Each takes an interface and an IN endpoint, and changes the USB PID.
+#ifndef CFG_APP_KEYBOARD_LANES
+#define CFG_APP_KEYBOARD_LANES    0
+#endif
+
+//--------------------------------------------------------------------+
+// Input replay
+//--------------------------------------------------------------------+
+
+// Replay a recorded timeline (see hid_timeline.h) instead of the typing demo.
+// The timeline is linked in as `replay_timeline` / `replay_timeline_len`.
+#ifndef CFG_APP_REPLAY
+#define CFG_APP_REPLAY            0
+#endif
+
+// Check the timeline against the per-block SHA-256 digests generated with
+// it (`replay_timeline_digests`), see hid_timeline.h. Uses the RP2350 SHA
+// accelerator, software elsewhere.
+#ifndef CFG_APP_REPLAY_VERIFY
+#define CFG_APP_REPLAY_VERIFY     1
+#endif
+
+// Bytes hashed per main loop iteration, bounds the time verification takes
+// from the loop
+#ifndef CFG_APP_VERIFY_SLICE
+#define CFG_APP_VERIFY_SLICE      512
+#endif
+
+//--------------------------------------------------------------------+
+// DuckyScript
+//--------------------------------------------------------------------+
+
+// Run a DuckyScript payload (hid_ducky.h) instead of the typing demo. The
+// script is linked in as `ducky_script` / `ducky_script_len` and compiled
+// once at boot.
+#ifndef CFG_APP_DUCKY
+#define CFG_APP_DUCKY             0
+#endif
+
+//--------------------------------------------------------------------+
+// Incremental typing
+//--------------------------------------------------------------------+
+
+// Type the demo text as an edit of what was typed on the previous mount
+// (hid_edit.h): cursor moves, deletions and insertions instead of the whole
+// text. Assumes nobody edits the field in between.
+#ifndef CFG_APP_EDIT
+#define CFG_APP_EDIT              0
+#endif
+
+//--------------------------------------------------------------------+
+// Resumable execution
+//--------------------------------------------------------------------+
+
+// Mirror the execution checkpoint (hid_checkpoint.h) into watchdog scratch
+// registers so a payload resumes after a watchdog reboot, not only after a
+// bus reset.
+#ifndef CFG_APP_CHECKPOINT_RETAIN
+#define CFG_APP_CHECKPOINT_RETAIN 1
+#endif
+
+// Watchdog timeout, 0 to leave the watchdog disabled
+#ifndef CFG_APP_WATCHDOG_MS
+#define CFG_APP_WATCHDOG_MS       0
+#endif
+
+//--------------------------------------------------------------------+
+// Transmit scheduler
+//--------------------------------------------------------------------+
+
+// A class passed over this many times in a row is sent next (hid_tx.h)
+#ifndef CFG_APP_TX_MAX_SKIPS
+#define CFG_APP_TX_MAX_SKIPS      4
+#endif
+
+// Token bucket rate limits in reports per second (0 = unlimited) and burst
+// size in reports. A typed character is two reports. Adjustable at runtime
+// with hid_tx_set_rate().
+#ifndef CFG_APP_TX_RATE_KEYBOARD
+#define CFG_APP_TX_RATE_KEYBOARD  0
+#endif
+
+#ifndef CFG_APP_TX_BURST_KEYBOARD
+#define CFG_APP_TX_BURST_KEYBOARD 8
+#endif
+
+#ifndef CFG_APP_TX_RATE_MOUSE
+#define CFG_APP_TX_RATE_MOUSE     0
+#endif
+
+#ifndef CFG_APP_TX_BURST_MOUSE
+#define CFG_APP_TX_BURST_MOUSE    4
+#endif
+
+// Submit reports right after the SOF of the frame the host polls in,
+// instead of whenever the main loop gets to them
+#ifndef CFG_APP_TX_SOF_SYNC
+#define CFG_APP_TX_SOF_SYNC       0
+#endif
+
+//--------------------------------------------------------------------+
+// Hot path
+//--------------------------------------------------------------------+
+
+// Run the report path (send helpers, hid_tx, replay, completion and SOF
+// callbacks) from SRAM instead of XIP flash, see HID_HOT_FUNC in hid_tx.h
+#ifndef CFG_APP_RAM_HOT_PATH
+#define CFG_APP_RAM_HOT_PATH      0
+#endif
+
+// Invalidate the XIP cache before every main loop iteration and log the
+// worst and mean iteration time each second. Benchmarking only.
+#ifndef CFG_APP_LOOP_BENCH
+#define CFG_APP_LOOP_BENCH        0
+#endif
+
+//--------------------------------------------------------------------+
+// Logging
+//--------------------------------------------------------------------+
+
+// Deferred-formatting binary log (hid_log.h), drained over the telemetry
+// feature report and decoded by tools/hid_log_decode.py
+#ifndef CFG_APP_LOG
+#define CFG_APP_LOG               1
+#endif
+
+//--------------------------------------------------------------------+
+// Buffer sizes
+//--------------------------------------------------------------------+
+
+// Engine buffers are carved out of one static arena (hid_arena.h) at init.
+// CFG_APP_ARENA_SIZE defaults to the sum of the buffer sizes in this section, so
+// growing one buffer only needs shrinking another to keep RAM constant.
+
+// Transmit queue depth per report class, in reports
+#ifndef CFG_APP_TX_DEPTH_KEYBOARD
+#define CFG_APP_TX_DEPTH_KEYBOARD 16
+#endif
+
+#ifndef CFG_APP_TX_DEPTH_MOUSE
+#define CFG_APP_TX_DEPTH_MOUSE    8
+#endif
+
+#ifndef CFG_APP_TX_DEPTH_CONSUMER
+#define CFG_APP_TX_DEPTH_CONSUMER 4
+#endif
+
+#ifndef CFG_APP_TX_DEPTH_GAMEPAD
+#define CFG_APP_TX_DEPTH_GAMEPAD  4
+#endif
+
+// Bytes per queued report, checked against hid_tx_entry_t in hid_tx.c
+#define APP_TX_ENTRY_SIZE         32
+
+#define APP_ARENA_TX_QUEUES       (APP_TX_ENTRY_SIZE * (CFG_APP_TX_DEPTH_KEYBOARD + \
+                                   CFG_APP_TX_DEPTH_MOUSE + CFG_APP_TX_DEPTH_CONSUMER + \
+                                   CFG_APP_TX_DEPTH_GAMEPAD))
+
+// Log ring size in 32-bit words, a power of two
+#ifndef CFG_APP_LOG_RING_WORDS
+#define CFG_APP_LOG_RING_WORDS    256
+#endif
+
+#if CFG_APP_LOG
+#define APP_ARENA_LOG             (4 * CFG_APP_LOG_RING_WORDS)
+#else
+#define APP_ARENA_LOG             0
+#endif
+
+// Reports scheduled at host time (clock_sync.h) until they are due
+#ifndef CFG_APP_CLOCK_SYNC_DEPTH
+#define CFG_APP_CLOCK_SYNC_DEPTH  8
+#endif
+
+// Bytes per scheduled report, checked in clock_sync.c
+#define APP_CLOCK_SYNC_ENTRY_SIZE 24
+
+#define APP_ARENA_CLOCK_SYNC      (APP_CLOCK_SYNC_ENTRY_SIZE * CFG_APP_CLOCK_SYNC_DEPTH)
+
+// Compiled DuckyScript, in bytes. A typed character takes two.
+#ifndef CFG_APP_DUCKY_CODE_SIZE
+#define CFG_APP_DUCKY_CODE_SIZE   2048
+#endif
+
+#if CFG_APP_DUCKY
+#define APP_ARENA_DUCKY           CFG_APP_DUCKY_CODE_SIZE
+#else
+#define APP_ARENA_DUCKY           0
+#endif
+
+// Longest text hid_edit remembers, in bytes including the terminator
+#ifndef CFG_APP_EDIT_MAX_TEXT
+#define CFG_APP_EDIT_MAX_TEXT     256
+#endif
+
+// Character edits the diff resolves, larger changes are retyped as one block.
+// The diff takes 2 * (CFG_APP_EDIT_MAX_D + 1)^2 bytes.
+#ifndef CFG_APP_EDIT_MAX_D
+#define CFG_APP_EDIT_MAX_D        32
+#endif
+
+#if CFG_APP_EDIT
+#define APP_ARENA_EDIT            (CFG_APP_EDIT_MAX_TEXT + 2 * \
+                                   (CFG_APP_EDIT_MAX_D + 1) * \
+                                   (CFG_APP_EDIT_MAX_D + 1))
+#else
+#define APP_ARENA_EDIT            0
+#endif
+
+// Headroom for buffers not listed here
+#ifndef CFG_APP_ARENA_SPARE
+#define CFG_APP_ARENA_SPARE       64
+#endif
+
+#ifndef CFG_APP_ARENA_SIZE
+#define CFG_APP_ARENA_SIZE        (APP_ARENA_TX_QUEUES + APP_ARENA_LOG + \
+                                   APP_ARENA_CLOCK_SYNC + APP_ARENA_DUCKY + \
+                                   APP_ARENA_EDIT + CFG_APP_ARENA_SPARE)
+#endif
+
+#endif /* APP_CONFIG_H_ */
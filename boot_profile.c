@@ -0,0 +1,83 @@
+/*
+ * Boot-phase timestamps.
+ */
+
+#include "pico/platform.h"
+#include "pico/time.h"
+
+#include "boot_profile.h"
+#include "hid_log.h"
+
+#define BOOT_PROFILE_MAGIC 0x42505246u // "BPRF"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t times_us[BOOT_PHASE_COUNT];
+} boot_record_t;
+
+// Not cleared by the runtime, so it survives a reboot without power loss
+static boot_record_t __uninitialized_ram(records)[2];
+
+enum {
+  RECORD_CURRENT,
+  RECORD_PREVIOUS,
+};
+
+static bool reported;
+
+void boot_profile_start(void) {
+  // 0 means not reached, as in boot_profile_mark()
+  uint32_t now = time_us_32();
+  if (now == 0)
+    now = 1;
+
+  // After power up the RAM is random and the magic does not match
+  if (records[RECORD_CURRENT].magic == BOOT_PROFILE_MAGIC)
+    records[RECORD_PREVIOUS] = records[RECORD_CURRENT];
+  else
+    records[RECORD_PREVIOUS].magic = 0;
+
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    records[RECORD_CURRENT].times_us[i] = 0;
+  records[RECORD_CURRENT].times_us[BOOT_PHASE_MAIN] = now;
+  records[RECORD_CURRENT].magic = BOOT_PROFILE_MAGIC;
+  reported = false;
+}
+
+void boot_profile_mark(boot_phase_t phase) {
+  if (phase >= BOOT_PHASE_COUNT || records[RECORD_CURRENT].times_us[phase])
+    return;
+  // 0 means not reached, a phase ending right at reset is 1 µs off
+  uint32_t const now = time_us_32();
+  records[RECORD_CURRENT].times_us[phase] = now ? now : 1;
+}
+
+bool boot_profile_get(bool previous, uint32_t times_us[BOOT_PHASE_COUNT]) {
+  boot_record_t const *r = &records[previous ? RECORD_PREVIOUS : RECORD_CURRENT];
+  if (r->magic != BOOT_PROFILE_MAGIC)
+    return false;
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    times_us[i] = r->times_us[i];
+  return true;
+}
+
+void boot_profile_report(void) {
+  if (reported)
+    return;
+  reported = true;
+
+  uint32_t t[BOOT_PHASE_COUNT];
+  if (boot_profile_get(false, t)) {
+    HID_LOG("boot: main %u board %u app %u tud %u after_tusb %u mount %u us",
+            t[BOOT_PHASE_MAIN], t[BOOT_PHASE_BOARD_INIT],
+            t[BOOT_PHASE_APP_INIT], t[BOOT_PHASE_TUD_INIT],
+            t[BOOT_PHASE_INIT_AFTER_TUSB], t[BOOT_PHASE_MOUNT]);
+  }
+  if (boot_profile_get(true, t)) {
+    HID_LOG("boot: previous main %u board %u app %u tud %u after_tusb %u "
+            "mount %u us",
+            t[BOOT_PHASE_MAIN], t[BOOT_PHASE_BOARD_INIT],
+            t[BOOT_PHASE_APP_INIT], t[BOOT_PHASE_TUD_INIT],
+            t[BOOT_PHASE_INIT_AFTER_TUSB], t[BOOT_PHASE_MOUNT]);
+  }
+}
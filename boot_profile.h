@@ -0,0 +1,51 @@
+/*
+ * Boot-phase timestamps.
+ *
+ * The µs timer starts counting at reset, so time_us_32() at the end of each
+ * phase is the time since reset. The record lives in uninitialized RAM: after
+ * a watchdog or software reboot the previous boot's record is still there and
+ * is reported next to the current one. Both are emitted with HID_LOG() at the
+ * first mount and read over the telemetry feature report.
+ */
+
+#ifndef BOOT_PROFILE_H_
+#define BOOT_PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  BOOT_PHASE_MAIN,            // runtime init done, main() entered
+  BOOT_PHASE_BOARD_INIT,
+  BOOT_PHASE_APP_INIT,        // arena and module init
+  BOOT_PHASE_TUD_INIT,
+  BOOT_PHASE_INIT_AFTER_TUSB,
+  BOOT_PHASE_MOUNT,           // SET_CONFIGURATION from the host
+  BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Retires the previous boot's record and marks BOOT_PHASE_MAIN.
+ *        Call first thing in main().
+ */
+void boot_profile_start(void);
+
+/**
+ * @brief Records the end of a phase, only the first time in a boot.
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/**
+ * @brief Copies the phase end times of this boot, or of the one before the
+ *        last reboot. 0 marks a phase that was not reached.
+ *
+ * @return false if there is no such record.
+ */
+bool boot_profile_get(bool previous, uint32_t times_us[BOOT_PHASE_COUNT]);
+
+/**
+ * @brief Logs both records, once the log can be drained.
+ */
+void boot_profile_report(void);
+
+#endif /* BOOT_PROFILE_H_ */
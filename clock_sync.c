@@ -0,0 +1,342 @@
+/*
+ * Host/device clock synchronization over a vendor feature report.
+ */
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "clock_sync.h"
+#include "hid_arena.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
+
+#if CFG_APP_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+
+// SET_REPORT runs in the USB task, clock_sync_task() in the application task
+#define SYNC_LOCK()   taskENTER_CRITICAL()
+#define SYNC_UNLOCK() taskEXIT_CRITICAL()
+#else
+#define SYNC_LOCK()   ((void)0)
+#define SYNC_UNLOCK() ((void)0)
+#endif
+
+// Drift is only estimated over at least this much device time
+#define DRIFT_MIN_BASELINE_US  1000000u
+// and the baseline restarts after this much, to follow temperature changes
+#define DRIFT_MAX_BASELINE_US  30000000u
+// Crystal tolerance plus margin, anything beyond is a bad sample
+#define DRIFT_MAX_PPB          500000
+
+// A sample whose round trip exceeds twice the best plus this was queued
+#define DELAY_SLACK_US         200u
+
+// Host controlled values are bounded before any arithmetic on them: offsets
+// beyond ~146000 years are bad samples, the model is not extrapolated beyond
+// ~203 days, where drift_ppb * dt would overflow
+#define OFFSET_MAX_US          (INT64_C(1) << 62)
+#define EXTRAPOLATE_MAX_US     (INT64_C(1) << 44)
+
+// Scheduled reports further ahead would hold a slot for too long
+#define SCHEDULE_MAX_AHEAD_US  (30ull * 60 * 1000000)
+
+typedef struct {
+  uint64_t host_us;
+  uint8_t report_id;
+  uint8_t len;
+  uint8_t data[HID_TX_MAX_REPORT];
+} clock_sync_pending_t;
+
+_Static_assert(sizeof(clock_sync_pending_t) <= APP_CLOCK_SYNC_ENTRY_SIZE,
+               "APP_CLOCK_SYNC_ENTRY_SIZE too small for clock_sync_pending_t");
+
+typedef struct {
+  // Round trip in progress
+  uint8_t seq;
+  uint64_t t1;
+  uint64_t t2;
+  uint64_t t3;
+  bool have_t3;
+
+  // Model: offset (device - host) at t0, changing by drift_ppb
+  bool valid;
+  uint64_t t0;
+  int64_t offset0;
+  int32_t drift_ppb;
+
+  // Drift baseline
+  uint64_t base_local;
+  int64_t base_offset;
+
+  uint32_t min_delay_us;
+  uint32_t accepted;
+  uint32_t rejected;
+} clock_sync_t;
+
+static clock_sync_t clk;
+
+// Scheduled reports, earliest first
+static clock_sync_pending_t *pending;
+static uint8_t pending_count;
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+static uint64_t get_u64(uint8_t const *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+  for (int i = 0; i < 8; i++, v >>= 8)
+    p[i] = (uint8_t)v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++, v >>= 8)
+    p[i] = (uint8_t)v;
+}
+
+// Offset (device - host) predicted at device time local
+static int64_t offset_at(uint64_t local) {
+  int64_t dt = (int64_t)(local - clk.t0);
+  if (dt > EXTRAPOLATE_MAX_US)
+    dt = EXTRAPOLATE_MAX_US;
+  if (dt < -EXTRAPOLATE_MAX_US)
+    dt = -EXTRAPOLATE_MAX_US;
+  return clk.offset0 + (int64_t)clk.drift_ppb * dt / 1000000000;
+}
+
+//--------------------------------------------------------------------+
+// Model
+//--------------------------------------------------------------------+
+
+static void add_sample(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+  // Both deltas are taken on a single clock, so the delay is offset free.
+  // Unsigned, a negative delay wraps to a huge one.
+  uint64_t const delay = (t4 - t1) - (t3 - t2);
+  if (delay > UINT32_MAX) {
+    clk.rejected++;
+    return;
+  }
+
+  // Let the best delay age so a route change does not lock us out forever
+  if (clk.accepted == 0 || (uint32_t)delay < clk.min_delay_us)
+    clk.min_delay_us = (uint32_t)delay;
+  else if (clk.min_delay_us < UINT32_MAX / 2)
+    clk.min_delay_us += clk.min_delay_us / 64 + 1;
+
+  if (delay > 2 * (uint64_t)clk.min_delay_us + DELAY_SLACK_US) {
+    clk.rejected++;
+    return;
+  }
+
+  // ((t2 - t1) + (t3 - t4)) / 2, without the sum that can overflow
+  int64_t const offset = (int64_t)((t2 - t1) - delay / 2);
+  if (offset > OFFSET_MAX_US || offset < -OFFSET_MAX_US) {
+    clk.rejected++;
+    return;
+  }
+  uint64_t const local = t2 + (t3 - t2) / 2;
+  clk.accepted++;
+
+  if (!clk.valid) {
+    clk.valid = true;
+    clk.drift_ppb = 0;
+    clk.base_local = local;
+    clk.base_offset = offset;
+  } else {
+    uint64_t const baseline = local - clk.base_local;
+    if (baseline > 2 * DRIFT_MAX_BASELINE_US) {
+      // No samples for too long, the baseline is stale
+      clk.base_local = local;
+      clk.base_offset = offset;
+    } else if (baseline >= DRIFT_MIN_BASELINE_US) {
+      // Clamped before scaling, so the product stays in range
+      int64_t const diff = offset - clk.base_offset;
+      int64_t const max_diff =
+          (int64_t)baseline / (1000000000 / DRIFT_MAX_PPB);
+      int64_t drift;
+      if (diff > max_diff)
+        drift = DRIFT_MAX_PPB;
+      else if (diff < -max_diff)
+        drift = -DRIFT_MAX_PPB;
+      else
+        drift = diff * 1000000000 / (int64_t)baseline;
+      clk.drift_ppb = (int32_t)((3 * (int64_t)clk.drift_ppb + drift) / 4);
+
+      if (baseline >= DRIFT_MAX_BASELINE_US) {
+        clk.base_local = local;
+        clk.base_offset = offset;
+      }
+    }
+  }
+
+  clk.t0 = local;
+  clk.offset0 = offset;
+}
+
+//--------------------------------------------------------------------+
+// Feature report
+//--------------------------------------------------------------------+
+
+bool clock_sync_init(void) {
+  memset(&clk, 0, sizeof(clk));
+  pending = hid_arena_alloc(CFG_APP_CLOCK_SYNC_DEPTH *
+                            sizeof(clock_sync_pending_t));
+  pending_count = 0;
+  return pending != NULL;
+}
+
+void clock_sync_set_report(uint8_t const *buffer, uint16_t bufsize) {
+  uint64_t const now = time_us_64();
+
+  if (bufsize < 1)
+    return;
+
+  switch (buffer[0]) {
+  case CLOCK_SYNC_OP_PING:
+    // op, seq, t1, prev_seq, prev_t4
+    if (bufsize < 19)
+      return;
+    SYNC_LOCK();
+    if (clk.have_t3 && buffer[10] == clk.seq)
+      add_sample(clk.t1, clk.t2, clk.t3, get_u64(&buffer[11]));
+
+    clk.seq = buffer[1];
+    clk.t1 = get_u64(&buffer[2]);
+    clk.t2 = now;
+    clk.have_t3 = false;
+    SYNC_UNLOCK();
+    break;
+
+  case CLOCK_SYNC_OP_SCHEDULE: {
+    // op, host_us, report_id, payload
+    if (bufsize < 10)
+      return;
+    uint8_t const report_id = buffer[9];
+    uint8_t const len = hid_timeline_report_len(report_id);
+    if (len == 0 || bufsize < 10 + len)
+      return;
+    clock_sync_send_at(report_id, &buffer[10], len, get_u64(&buffer[1]));
+  } break;
+
+  default:
+    break;
+  }
+}
+
+uint16_t clock_sync_get_report(uint8_t *buffer, uint16_t reqlen) {
+  // seq, valid, t2, t3, offset, drift_ppb
+  if (reqlen < 30)
+    return 0;
+
+  SYNC_LOCK();
+  clk.t3 = time_us_64();
+  clk.have_t3 = true;
+
+  buffer[0] = clk.seq;
+  buffer[1] = clk.valid;
+  put_u64(&buffer[2], clk.t2);
+  put_u64(&buffer[10], clk.t3);
+  put_u64(&buffer[18], (uint64_t)(clk.valid ? offset_at(clk.t3) : 0));
+  put_u32(&buffer[26], (uint32_t)clk.drift_ppb);
+  SYNC_UNLOCK();
+  return 30;
+}
+
+//--------------------------------------------------------------------+
+// Scheduling
+//--------------------------------------------------------------------+
+
+bool clock_sync_valid(void) { return clk.valid; }
+
+uint64_t clock_sync_host_to_local(uint64_t host_us) {
+  // Evaluate the drift at the estimated local time, one iteration is plenty
+  uint64_t const guess = host_us + (uint64_t)clk.offset0;
+  return host_us + (uint64_t)offset_at(guess);
+}
+
+uint64_t clock_sync_local_to_host(uint64_t local_us) {
+  return local_us - (uint64_t)offset_at(local_us);
+}
+
+// Inserts behind every entry due no later, so equal times keep their order
+static bool insert_pending(clock_sync_pending_t const *entry) {
+  if (pending == NULL || pending_count >= CFG_APP_CLOCK_SYNC_DEPTH)
+    return false;
+
+  uint8_t at = pending_count;
+  while (at > 0 && pending[at - 1].host_us > entry->host_us) {
+    pending[at] = pending[at - 1];
+    at--;
+  }
+  pending[at] = *entry;
+  pending_count++;
+  return true;
+}
+
+bool clock_sync_send_at(uint8_t report_id, void const *report, uint8_t len,
+                        uint64_t host_us) {
+  if (hid_tx_class_of(report_id) == HID_TX_CLASS_COUNT ||
+      len > HID_TX_MAX_REPORT)
+    return false;
+
+  clock_sync_pending_t entry = {
+      .host_us = host_us, .report_id = report_id, .len = len};
+  memcpy(entry.data, report, len);
+
+  SYNC_LOCK();
+  bool ok = false;
+  if (clk.valid) {
+    uint64_t const local = clock_sync_host_to_local(host_us);
+    uint64_t const now = time_us_64();
+    if (local <= now || local - now <= SCHEDULE_MAX_AHEAD_US)
+      ok = insert_pending(&entry);
+  }
+  SYNC_UNLOCK();
+  return ok;
+}
+
+static bool same_entry(clock_sync_pending_t const *a,
+                       clock_sync_pending_t const *b) {
+  return a->host_us == b->host_us && a->report_id == b->report_id &&
+         a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+void clock_sync_task(void) {
+  while (1) {
+    // Due is decided on the current model, which may have moved since the
+    // report was scheduled
+    SYNC_LOCK();
+    if (pending_count == 0 ||
+        clock_sync_local_to_host(time_us_64()) < pending[0].host_us) {
+      SYNC_UNLOCK();
+      return;
+    }
+    clock_sync_pending_t const entry = pending[0];
+    SYNC_UNLOCK();
+
+    // hid_tx takes its own lock, so the report is sent outside ours. With
+    // its class queue full it stays scheduled for the next call.
+    if (!hid_tx_send(hid_tx_class_of(entry.report_id), entry.data, entry.len,
+                     0))
+      return;
+
+    // Reports scheduled meanwhile may have gone in front of it
+    SYNC_LOCK();
+    for (uint8_t i = 0; i < pending_count; i++) {
+      if (same_entry(&pending[i], &entry)) {
+        pending_count--;
+        memmove(&pending[i], &pending[i + 1],
+                (pending_count - i) * sizeof(pending[0]));
+        break;
+      }
+    }
+    SYNC_UNLOCK();
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * Host/device clock synchronization over the REPORT_ID_CLOCK_SYNC feature
+ * report, and scheduling of reports at absolute host time.
+ *
+ * Exchange (host timestamps are the host's µs clock, device timestamps are
+ * time_us_64(), all little endian):
+ *
+ *   SET_REPORT  op=PING     : seq, t1, prev_seq, prev_t4
+ *   GET_REPORT              : seq, valid, t2, t3, offset, drift_ppb
+ *
+ * t1 is when the host sent the SET, t2 when the device received it, t3 when
+ * the device answered the GET and t4 when the host got the answer. The host
+ * returns t4 with the next PING, so the device can evaluate every round trip
+ * itself: offset = ((t2 - t1) + (t3 - t4)) / 2, delay = (t4 - t1) - (t3 - t2).
+ * Samples with a delay well above the best seen are dropped as queued, the
+ * rest update an offset + drift model.
+ *
+ *   SET_REPORT  op=SCHEDULE : host_us, report_id, payload
+ *
+ * queues an input report to go out when the host clock reads host_us.
+ * Scheduled reports wait in a list of their own, ordered by time, and
+ * clock_sync_task() hands each to the transmit scheduler once the host clock
+ * reaches it. So they neither hold back reports queued after them in their
+ * class nor go out of order, and a due time follows model updates made while
+ * it waits. tools/clock_sync_host.py implements the host side.
+ */
+
+#ifndef CLOCK_SYNC_H_
+#define CLOCK_SYNC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+  CLOCK_SYNC_OP_PING = 1,
+  CLOCK_SYNC_OP_SCHEDULE,
+};
+
+/**
+ * @brief Allocates the scheduled report list from the arena.
+ *
+ * @return false if the arena is too small.
+ */
+bool clock_sync_init(void);
+
+/**
+ * @brief Moves scheduled reports that are due to the transmit scheduler.
+ *        Call from the main loop; the report goes out with the first poll
+ *        after the call that finds it due.
+ */
+void clock_sync_task(void);
+
+/**
+ * @brief Handles a SET_REPORT of the sync feature report (ID stripped).
+ */
+void clock_sync_set_report(uint8_t const *buffer, uint16_t bufsize);
+
+/**
+ * @brief Fills a GET_REPORT of the sync feature report (ID excluded).
+ *
+ * @return number of bytes written, 0 to STALL.
+ */
+uint16_t clock_sync_get_report(uint8_t *buffer, uint16_t reqlen);
+
+/**
+ * @brief Returns true once at least one round trip has been accepted.
+ */
+bool clock_sync_valid(void);
+
+/**
+ * @brief Converts between host time and time_us_64() using the current
+ *        offset and drift estimate.
+ */
+uint64_t clock_sync_host_to_local(uint64_t host_us);
+uint64_t clock_sync_local_to_host(uint64_t local_us);
+
+/**
+ * @brief Schedules an input report to be sent when the host clock reads
+ *        host_us.
+ *
+ * @return false if not synchronized, the time is not within the next half
+ *         hour, or CFG_APP_CLOCK_SYNC_DEPTH reports are already scheduled.
+ */
+bool clock_sync_send_at(uint8_t report_id, void const *report, uint8_t len,
+                        uint64_t host_us);
+
+#endif /* CLOCK_SYNC_H_ */
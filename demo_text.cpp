@@ -0,0 +1,14 @@
+/*
+ * The demo text, rendered into keyboard reports at compile time.
+ */
+
+#include "hid_text.hpp"
+
+#define DEMO_TEXT "Hello World!"
+
+static constexpr auto reports = HID_TEXT(DEMO_TEXT);
+
+extern "C" {
+char const demo_text[] = DEMO_TEXT;
+hid_text_t const demo_text_reports = {reports.data(), reports.size()};
+}
@@ -0,0 +1,52 @@
+/*
+ * Static arena for HID engine buffers.
+ */
+
+#include "tusb.h"
+
+#include "hid_arena.h"
+
+// HID_ARENA_ALIGN must cover what the USB stack expects of transfer memory
+typedef struct {
+  uint8_t probe CFG_TUSB_MEM_ALIGN;
+} hid_arena_align_probe_t;
+_Static_assert(_Alignof(hid_arena_align_probe_t) <= HID_ARENA_ALIGN,
+               "HID_ARENA_ALIGN is smaller than CFG_TUSB_MEM_ALIGN");
+
+CFG_TUSB_MEM_SECTION static uint8_t
+    arena[HID_ARENA_ALIGN_UP(CFG_APP_ARENA_SIZE)] CFG_TUSB_MEM_ALIGN;
+
+static size_t arena_used;
+static size_t arena_high_water;
+static uint32_t arena_failures;
+
+void hid_arena_init(void) {
+  arena_used = 0;
+  arena_failures = 0;
+}
+
+void *hid_arena_alloc(size_t size) {
+  // Checked before rounding up, which wraps for sizes near SIZE_MAX
+  if (size == 0 || size > sizeof(arena) - arena_used) {
+    arena_failures++;
+    return NULL;
+  }
+  // Cannot exceed the arena either: arena_used and its size are aligned
+  size_t const aligned = HID_ARENA_ALIGN_UP(size);
+
+  uint8_t *p = &arena[arena_used];
+  arena_used += aligned;
+  if (arena_used > arena_high_water)
+    arena_high_water = arena_used;
+
+  memset(p, 0, aligned);
+  return p;
+}
+
+size_t hid_arena_size(void) { return sizeof(arena); }
+
+size_t hid_arena_used(void) { return arena_used; }
+
+size_t hid_arena_high_water(void) { return arena_high_water; }
+
+uint32_t hid_arena_failures(void) { return arena_failures; }
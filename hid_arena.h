@@ -0,0 +1,41 @@
+/*
+ * Static arena for HID engine buffers.
+ *
+ * Modules take their buffers from one statically sized, DMA-safe block at
+ * init instead of declaring their own statics. The arena is sized in
+ * app_config.h from the per-module buffer sizes, so a build can trade one
+ * buffer against another in a single place. There is no free: allocations
+ * live until the next hid_arena_init().
+ */
+
+#ifndef HID_ARENA_H_
+#define HID_ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Every allocation starts on this boundary, matching CFG_TUSB_MEM_ALIGN
+#define HID_ARENA_ALIGN         4
+#define HID_ARENA_ALIGN_UP(n)   (((n) + HID_ARENA_ALIGN - 1) & ~(size_t)(HID_ARENA_ALIGN - 1))
+
+/**
+ * @brief Empties the arena. Only call before any module init.
+ */
+void hid_arena_init(void);
+
+/**
+ * @brief Returns a zeroed, aligned region of size bytes.
+ *
+ * @return NULL if the arena is exhausted; the failure is counted.
+ */
+void *hid_arena_alloc(size_t size);
+
+size_t hid_arena_size(void);
+size_t hid_arena_used(void);
+size_t hid_arena_high_water(void);
+uint32_t hid_arena_failures(void);
+
+#endif /* HID_ARENA_H_ */
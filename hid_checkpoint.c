@@ -0,0 +1,75 @@
+/*
+ * Execution checkpoints for resuming a payload after bus reset, unmount or
+ * watchdog reboot.
+ */
+
+#include "app_config.h"
+#include "hid_checkpoint.h"
+
+#if CFG_APP_CHECKPOINT_RETAIN
+#include "hardware/watchdog.h"
+
+// scratch[4..7] are used by the bootrom for watchdog_reboot()
+enum {
+  SCRATCH_MAGIC,
+  SCRATCH_STATE,
+  SCRATCH_POSITION,
+};
+
+#define CHECKPOINT_MAGIC 0x48434b50u // "HCKP"
+#endif
+
+static hid_checkpoint_t committed;
+static bool committed_valid;
+
+#if CFG_APP_CHECKPOINT_RETAIN
+static void retain(void) {
+  // Invalidate first so a reboot halfway through never sees a torn record
+  watchdog_hw->scratch[SCRATCH_MAGIC] = 0;
+  if (!committed_valid)
+    return;
+  watchdog_hw->scratch[SCRATCH_STATE] = committed.state;
+  watchdog_hw->scratch[SCRATCH_POSITION] = committed.position;
+  watchdog_hw->scratch[SCRATCH_MAGIC] =
+      CHECKPOINT_MAGIC ^ committed.state ^ committed.position;
+}
+#endif
+
+void hid_checkpoint_init(void) {
+  committed_valid = false;
+
+#if CFG_APP_CHECKPOINT_RETAIN
+  uint32_t const state = watchdog_hw->scratch[SCRATCH_STATE];
+  uint32_t const position = watchdog_hw->scratch[SCRATCH_POSITION];
+  if (state <= UINT8_MAX &&
+      watchdog_hw->scratch[SCRATCH_MAGIC] == (CHECKPOINT_MAGIC ^ state ^ position)) {
+    committed.state = (uint8_t)state;
+    committed.position = position;
+    committed_valid = true;
+  }
+#endif
+}
+
+void hid_checkpoint_commit(uint8_t state, uint32_t position) {
+  committed.state = state;
+  committed.position = position;
+  committed_valid = true;
+
+#if CFG_APP_CHECKPOINT_RETAIN
+  retain();
+#endif
+}
+
+bool hid_checkpoint_get(hid_checkpoint_t *checkpoint) {
+  if (committed_valid)
+    *checkpoint = committed;
+  return committed_valid;
+}
+
+void hid_checkpoint_clear(void) {
+  committed_valid = false;
+
+#if CFG_APP_CHECKPOINT_RETAIN
+  retain();
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * Execution checkpoints for resuming a payload after bus reset, unmount or
+ * watchdog reboot.
+ *
+ * A checkpoint is only committed once the host has acknowledged the report
+ * that produced it (tud_hid_report_complete_cb), so resuming from it never
+ * repeats a key press the host already saw and never skips one it did not.
+ *
+ * With CFG_APP_CHECKPOINT_RETAIN the committed checkpoint is mirrored into
+ * watchdog scratch registers, which survive a watchdog reboot but are cleared
+ * on power-on.
+ *
+ * Only the demo text is checkpointed. Its last report clears the checkpoint,
+ * so a mount or reboot after it finished types it again. Timeline replay,
+ * DuckyScript, the keyboard lanes and hid_edit are not checkpointed: a new
+ * mount runs them from the start.
+ */
+
+#ifndef HID_CHECKPOINT_H_
+#define HID_CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint8_t state;     // engine state to resume in
+  uint32_t position; // position within the payload (e.g. text index)
+} hid_checkpoint_t;
+
+/**
+ * @brief Loads a retained checkpoint, if any. Call once at boot.
+ */
+void hid_checkpoint_init(void);
+
+/**
+ * @brief Commits the checkpoint reached by a report the host acknowledged.
+ *        Call from tud_hid_report_complete_cb; reports still queued or lost
+ *        with the bus never get here.
+ */
+void hid_checkpoint_commit(uint8_t state, uint32_t position);
+
+/**
+ * @brief Returns the last committed checkpoint.
+ *
+ * @return false if there is none.
+ */
+bool hid_checkpoint_get(hid_checkpoint_t *checkpoint);
+
+/**
+ * @brief Drops the committed checkpoint, the next run starts from scratch.
+ */
+void hid_checkpoint_clear(void);
+
+#endif /* HID_CHECKPOINT_H_ */
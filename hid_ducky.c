@@ -0,0 +1,536 @@
+/*
+ * DuckyScript interpreter.
+ */
+
+#include <string.h>
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "hid_arena.h"
+#include "hid_ducky.h"
+#include "hid_keymap.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+
+enum {
+  OP_END,
+  OP_KEY,
+  OP_TEXT,
+  OP_DELAY,
+  OP_DEFAULT,
+  OP_REPEAT,
+};
+
+// Set on the last instruction of each command, the default delay follows
+// only those
+#define OP_LAST 0x80
+
+#define NO_PC ((size_t)-1)
+
+static uint16_t read_u16(uint8_t const *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(uint8_t const *p) {
+  return read_u16(p) | ((uint32_t)read_u16(p + 2) << 16);
+}
+
+//--------------------------------------------------------------------+
+// Compiler
+//--------------------------------------------------------------------+
+
+typedef struct {
+  char const *name;
+  uint8_t modifier;
+  uint8_t key;
+} key_name_t;
+
+static key_name_t const key_names[] = {
+    {"CTRL", KEYBOARD_MODIFIER_LEFTCTRL, 0},
+    {"CONTROL", KEYBOARD_MODIFIER_LEFTCTRL, 0},
+    {"SHIFT", KEYBOARD_MODIFIER_LEFTSHIFT, 0},
+    {"ALT", KEYBOARD_MODIFIER_LEFTALT, 0},
+    {"GUI", KEYBOARD_MODIFIER_LEFTGUI, 0},
+    {"WINDOWS", KEYBOARD_MODIFIER_LEFTGUI, 0},
+    {"COMMAND", KEYBOARD_MODIFIER_LEFTGUI, 0},
+    {"ENTER", 0, HID_KEY_ENTER},
+    {"ESC", 0, HID_KEY_ESCAPE},
+    {"ESCAPE", 0, HID_KEY_ESCAPE},
+    {"TAB", 0, HID_KEY_TAB},
+    {"SPACE", 0, HID_KEY_SPACE},
+    {"BACKSPACE", 0, HID_KEY_BACKSPACE},
+    {"DELETE", 0, HID_KEY_DELETE},
+    {"DEL", 0, HID_KEY_DELETE},
+    {"INSERT", 0, HID_KEY_INSERT},
+    {"HOME", 0, HID_KEY_HOME},
+    {"END", 0, HID_KEY_END},
+    {"PAGEUP", 0, HID_KEY_PAGE_UP},
+    {"PAGEDOWN", 0, HID_KEY_PAGE_DOWN},
+    {"UP", 0, HID_KEY_ARROW_UP},
+    {"UPARROW", 0, HID_KEY_ARROW_UP},
+    {"DOWN", 0, HID_KEY_ARROW_DOWN},
+    {"DOWNARROW", 0, HID_KEY_ARROW_DOWN},
+    {"LEFT", 0, HID_KEY_ARROW_LEFT},
+    {"LEFTARROW", 0, HID_KEY_ARROW_LEFT},
+    {"RIGHT", 0, HID_KEY_ARROW_RIGHT},
+    {"RIGHTARROW", 0, HID_KEY_ARROW_RIGHT},
+    {"CAPSLOCK", 0, HID_KEY_CAPS_LOCK},
+    {"NUMLOCK", 0, HID_KEY_NUM_LOCK},
+    {"SCROLLLOCK", 0, HID_KEY_SCROLL_LOCK},
+    {"PRINTSCREEN", 0, HID_KEY_PRINT_SCREEN},
+    {"PAUSE", 0, HID_KEY_PAUSE},
+    {"BREAK", 0, HID_KEY_PAUSE},
+    {"MENU", 0, HID_KEY_APPLICATION},
+    {"APP", 0, HID_KEY_APPLICATION},
+    {"F1", 0, HID_KEY_F1},
+    {"F2", 0, HID_KEY_F2},
+    {"F3", 0, HID_KEY_F3},
+    {"F4", 0, HID_KEY_F4},
+    {"F5", 0, HID_KEY_F5},
+    {"F6", 0, HID_KEY_F6},
+    {"F7", 0, HID_KEY_F7},
+    {"F8", 0, HID_KEY_F8},
+    {"F9", 0, HID_KEY_F9},
+    {"F10", 0, HID_KEY_F10},
+    {"F11", 0, HID_KEY_F11},
+    {"F12", 0, HID_KEY_F12},
+};
+
+typedef struct {
+  uint8_t *code;
+  size_t size;
+  size_t len;
+  size_t last_op; // where the latest instruction starts
+  uint32_t ops;
+  bool overflow;
+} emitter_t;
+
+static void emit(emitter_t *e, uint8_t b) {
+  if (e->len < e->size)
+    e->code[e->len++] = b;
+  else
+    e->overflow = true;
+}
+
+static void emit_op(emitter_t *e, uint8_t op) {
+  e->last_op = e->len;
+  emit(e, op);
+  e->ops++;
+}
+
+static void emit_u16(emitter_t *e, uint16_t v) {
+  emit(e, (uint8_t)v);
+  emit(e, (uint8_t)(v >> 8));
+}
+
+static void emit_u32(emitter_t *e, uint32_t v) {
+  emit_u16(e, (uint16_t)v);
+  emit_u16(e, (uint16_t)(v >> 16));
+}
+
+static bool word_is(char const *word, size_t n, char const *name) {
+  return strlen(name) == n && memcmp(word, name, n) == 0;
+}
+
+static bool parse_number(char const *s, size_t n, uint32_t max,
+                         uint32_t *value) {
+  uint32_t v = 0;
+  if (n == 0)
+    return false;
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9')
+      return false;
+    uint32_t const digit = (uint32_t)(s[i] - '0');
+    if (v > (max - digit) / 10)
+      return false;
+    v = v * 10 + digit;
+  }
+  *value = v;
+  return true;
+}
+
+static void emit_text(emitter_t *e, char const *s, size_t n) {
+  while (n) {
+    // Up to 255 characters per instruction, the count goes in front
+    size_t const count_at = e->len;
+    size_t const last_op = e->last_op;
+    uint8_t count = 0;
+    emit_op(e, OP_TEXT);
+    emit(e, 0);
+    while (n && count < UINT8_MAX) {
+      uint8_t modifier, key;
+      if (hid_keymap_ascii(*s, &modifier, &key)) {
+        emit(e, modifier);
+        emit(e, key);
+        count++;
+      }
+      s++;
+      n--;
+    }
+    if (count == 0) {
+      e->len = count_at;
+      e->last_op = last_op;
+      e->ops--;
+    } else if (!e->overflow) {
+      e->code[count_at + 1] = count;
+    }
+  }
+}
+
+// Modifiers plus at most one key, separated by spaces or dashes
+static bool emit_combo(emitter_t *e, char const *s, size_t n) {
+  uint8_t modifier = 0;
+  uint8_t key = 0;
+
+  while (n) {
+    size_t w = 0;
+    while (w < n && s[w] != ' ' && s[w] != '-')
+      w++;
+    // A lone dash is the minus key
+    if (w == 0 && s[0] == '-' && (n == 1 || s[1] == ' '))
+      w = 1;
+
+    if (w) {
+      uint8_t m = 0, k = 0;
+      bool found = false;
+      for (size_t i = 0; i < TU_ARRAY_SIZE(key_names); i++) {
+        if (word_is(s, w, key_names[i].name)) {
+          m = key_names[i].modifier;
+          k = key_names[i].key;
+          found = true;
+          break;
+        }
+      }
+      if (!found && w == 1) {
+        // Letters are sent unshifted, as on the original
+        char c = s[0];
+        if (c >= 'A' && c <= 'Z')
+          c = (char)(c - 'A' + 'a');
+        found = hid_keymap_ascii(c, &m, &k);
+      }
+      if (!found || (k && key))
+        return false;
+      modifier |= m;
+      if (k)
+        key = k;
+    }
+
+    s += w;
+    n -= w;
+    if (n && (s[0] == ' ' || s[0] == '-')) {
+      s++;
+      n--;
+    }
+  }
+
+  if (!modifier && !key)
+    return false;
+  emit_op(e, OP_KEY);
+  emit(e, modifier);
+  emit(e, key);
+  return true;
+}
+
+bool hid_ducky_compile(char const *src, size_t len, uint8_t *code,
+                       size_t size, size_t *code_len, uint32_t *error_line) {
+  emitter_t e = {.code = code, .size = size};
+  size_t last = NO_PC;        // start of the previous command, for REPEAT
+  size_t last_repeat = NO_PC; // the REPEAT emitted for it, if any
+  uint32_t line_no = 0;
+  size_t pos = 0;
+
+  while (pos < len) {
+    size_t end = pos;
+    while (end < len && src[end] != '\n')
+      end++;
+    char const *line = &src[pos];
+    size_t n = end - pos;
+    pos = end + 1;
+    line_no++;
+
+    if (n && line[n - 1] == '\r')
+      n--;
+    while (n && (line[0] == ' ' || line[0] == '\t')) {
+      line++;
+      n--;
+    }
+    if (n == 0)
+      continue;
+
+    size_t w = 0;
+    while (w < n && line[w] != ' ')
+      w++;
+    // Argument is the rest of the line after one space, verbatim
+    char const *arg = w < n ? &line[w + 1] : &line[n];
+    size_t const arg_n = w < n ? n - w - 1 : 0;
+
+    size_t const start = e.len;
+    uint32_t const ops = e.ops;
+    uint32_t value = 0;
+    bool ok = true;
+
+    if (word_is(line, w, "REM")) {
+      continue;
+    } else if (word_is(line, w, "STRING")) {
+      emit_text(&e, arg, arg_n);
+    } else if (word_is(line, w, "STRINGLN")) {
+      emit_text(&e, arg, arg_n);
+      emit_op(&e, OP_KEY);
+      emit(&e, 0);
+      emit(&e, HID_KEY_ENTER);
+    } else if (word_is(line, w, "DELAY")) {
+      ok = parse_number(arg, arg_n, UINT32_MAX, &value);
+      emit_op(&e, OP_DELAY);
+      emit_u32(&e, value);
+    } else if (word_is(line, w, "DEFAULT_DELAY") ||
+               word_is(line, w, "DEFAULTDELAY")) {
+      ok = parse_number(arg, arg_n, UINT32_MAX, &value);
+      emit_op(&e, OP_DEFAULT);
+      emit_u32(&e, value);
+    } else if (word_is(line, w, "REPEAT") || word_is(line, w, "REPLAY")) {
+      ok = parse_number(arg, arg_n, UINT16_MAX, &value) && last != NO_PC &&
+           last <= UINT16_MAX;
+      if (ok && value && last_repeat != NO_PC) {
+        // REPEAT of REPEAT repeats the same command, more times
+        uint32_t const total = read_u16(&e.code[last_repeat + 3]) + value;
+        ok = total <= UINT16_MAX;
+        if (ok) {
+          e.code[last_repeat + 3] = (uint8_t)total;
+          e.code[last_repeat + 4] = (uint8_t)(total >> 8);
+        }
+      } else if (ok && value) {
+        last_repeat = e.len;
+        emit_op(&e, OP_REPEAT);
+        emit_u16(&e, (uint16_t)last);
+        emit_u16(&e, (uint16_t)value);
+      }
+      if (ok && !e.overflow)
+        continue;
+    } else {
+      ok = emit_combo(&e, line, n);
+    }
+
+    if (!ok || e.overflow) {
+      *error_line = line_no;
+      return false;
+    }
+    // REPEAT runs every instruction of the command again
+    last = e.ops != ops ? start : NO_PC;
+    last_repeat = NO_PC;
+    if (e.ops != ops)
+      e.code[e.last_op] |= OP_LAST;
+  }
+
+  emit_op(&e, OP_END);
+  if (e.overflow) {
+    *error_line = line_no;
+    return false;
+  }
+  *code_len = e.len;
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Interpreter
+//--------------------------------------------------------------------+
+
+static struct {
+  uint8_t *code; // arena buffer, NULL until the first load
+  bool loaded;
+  bool active;
+
+  size_t pc;
+  uint16_t step;   // progress inside KEY / TEXT
+  uint8_t held;    // key of the last TEXT press, 0 once released
+  size_t repeat_pc; // REPEAT being run, NO_PC if none
+  uint16_t repeat_left;
+
+  uint32_t default_delay_ms;
+  uint32_t delay_ms;
+  bool delay_armed;
+  uint32_t delay_from_ms;
+
+  // The keyboard queue was full, hid_tx's estimate of when it has room
+  uint32_t full_until_us;
+  bool full;
+
+  uint32_t start_ms;
+  hid_ducky_stats_t stats;
+} ducky;
+
+static bool send(uint8_t modifier, uint8_t key) {
+  hid_keyboard_report_t report = {.modifier = modifier};
+  report.keycode[0] = key;
+  hid_tx_status_t status;
+  if (!hid_tx_send_ex(HID_TX_KEYBOARD, &report, sizeof(report), 0, 0,
+                      &status)) {
+    ducky.full = true;
+    ducky.full_until_us = time_us_32() + status.eta_us;
+    return false;
+  }
+  ducky.stats.reports++;
+  return true;
+}
+
+// No use trying again before the queue has room
+static bool queue_full(void) {
+  if (ducky.full && (int32_t)(time_us_32() - ducky.full_until_us) < 0)
+    return true;
+  ducky.full = false;
+  return false;
+}
+
+static void advance(size_t next) {
+  // Between commands, not between the TEXT and ENTER of a STRINGLN or the
+  // pieces of a long STRING
+  ducky.delay_ms =
+      ducky.code[ducky.pc] & OP_LAST ? ducky.default_delay_ms : 0;
+  ducky.pc = next;
+  ducky.step = 0;
+}
+
+static bool delaying(uint32_t now_ms) {
+  if (!ducky.delay_ms)
+    return false;
+  if (!ducky.delay_armed) {
+    // Counts from when the host has the last report, in flight included
+    if (!hid_tx_idle(HID_TX_KEYBOARD))
+      return true;
+    ducky.delay_armed = true;
+    ducky.delay_from_ms = now_ms;
+  }
+  if (now_ms - ducky.delay_from_ms < ducky.delay_ms)
+    return true;
+  ducky.delay_ms = 0;
+  ducky.delay_armed = false;
+  return false;
+}
+
+bool hid_ducky_load(char const *src, size_t len) {
+  if (!ducky.code) {
+    ducky.code = hid_arena_alloc(CFG_APP_DUCKY_CODE_SIZE);
+    if (!ducky.code)
+      return false;
+  }
+
+  memset(&ducky.stats, 0, sizeof(ducky.stats));
+  ducky.stats.script_len = len;
+
+  size_t code_len = 0;
+  uint32_t const start_us = time_us_32();
+  ducky.loaded = hid_ducky_compile(src, len, ducky.code,
+                                   CFG_APP_DUCKY_CODE_SIZE, &code_len,
+                                   &ducky.stats.error_line);
+  ducky.stats.compile_us = time_us_32() - start_us;
+  ducky.stats.code_len = code_len;
+
+  if (!ducky.loaded) {
+    HID_LOG("ducky: error in line %u", ducky.stats.error_line);
+    return false;
+  }
+  HID_LOG("ducky: %u bytes of script to %u bytes of code in %u us",
+          ducky.stats.script_len, ducky.stats.code_len,
+          ducky.stats.compile_us);
+  return true;
+}
+
+bool hid_ducky_start(uint32_t now_ms) {
+  if (!ducky.loaded)
+    return false;
+
+  ducky.active = true;
+  ducky.pc = 0;
+  ducky.step = 0;
+  ducky.held = 0;
+  ducky.repeat_pc = NO_PC;
+  ducky.default_delay_ms = 0;
+  ducky.delay_ms = 0;
+  ducky.delay_armed = false;
+  ducky.full = false;
+  ducky.start_ms = now_ms;
+  ducky.stats.reports = 0;
+  return true;
+}
+
+bool hid_ducky_task(uint32_t now_ms) {
+  while (ducky.active) {
+    if (delaying(now_ms) || queue_full())
+      return true;
+
+    uint8_t const *ins = &ducky.code[ducky.pc];
+    switch (ins[0] & ~OP_LAST) {
+    case OP_KEY:
+      if (ducky.step == 0) {
+        if (!send(ins[1], ins[2]))
+          return true;
+        ducky.step = 1;
+      }
+      if (!send(0, 0))
+        return true;
+      advance(ducky.pc + 3);
+      break;
+
+    case OP_TEXT: {
+      uint8_t const count = ins[1];
+      while (ducky.step < count) {
+        uint8_t const *c = &ins[2 + 2 * ducky.step];
+        // The host only sees a key go down again after it went up
+        if (ducky.held == c[1]) {
+          if (!send(0, 0))
+            return true;
+          ducky.held = 0;
+        }
+        if (!send(c[0], c[1]))
+          return true;
+        ducky.held = c[1];
+        ducky.step++;
+      }
+      if (!send(0, 0))
+        return true;
+      ducky.held = 0;
+      advance(ducky.pc + 2 + 2 * (size_t)count);
+    } break;
+
+    case OP_DELAY:
+      advance(ducky.pc + 5);
+      ducky.delay_ms = read_u32(&ins[1]);
+      break;
+
+    case OP_DEFAULT:
+      ducky.default_delay_ms = read_u32(&ins[1]);
+      advance(ducky.pc + 5);
+      ducky.delay_ms = 0;
+      break;
+
+    case OP_REPEAT:
+      // Runs the instructions from target up to here again
+      if (ducky.repeat_pc != ducky.pc) {
+        ducky.repeat_pc = ducky.pc;
+        ducky.repeat_left = read_u16(&ins[3]);
+      }
+      if (ducky.repeat_left) {
+        ducky.repeat_left--;
+        ducky.pc = read_u16(&ins[1]);
+        ducky.step = 0;
+      } else {
+        ducky.repeat_pc = NO_PC;
+        ducky.pc += 5;
+      }
+      break;
+
+    case OP_END:
+    default:
+      ducky.active = false;
+      ducky.stats.run_ms = now_ms - ducky.start_ms;
+      HID_LOG("ducky: done, %u reports in %u ms", ducky.stats.reports,
+              ducky.stats.run_ms);
+      break;
+    }
+  }
+  return false;
+}
+
+void hid_ducky_stop(void) { ducky.active = false; }
+
+void hid_ducky_get_stats(hid_ducky_stats_t *stats) { *stats = ducky.stats; }
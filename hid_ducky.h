@@ -0,0 +1,98 @@
+/*
+ * DuckyScript interpreter.
+ *
+ * A script is compiled once at load into a compact bytecode, so running it
+ * from hid_task is a dispatch loop over pre-mapped keys with no text
+ * handling. Supported commands:
+ *
+ *   REM ...                 comment
+ *   STRING text             type text (US layout, unmappable characters
+ *   STRINGLN text           are skipped), STRINGLN adds ENTER
+ *   DELAY ms                wait
+ *   DEFAULT_DELAY ms        wait after every following command
+ *   (DEFAULTDELAY)
+ *   REPEAT n                run the previous command n more times, every
+ *   (REPLAY)                instruction of it (a long STRING or STRINGLN
+ *                           is several); REPEAT of REPEAT adds up
+ *   GUI r, CTRL ALT DELETE  press a key combination and release it: any
+ *   CTRL-SHIFT ESC, ENTER   modifiers (CTRL SHIFT ALT GUI and aliases) plus
+ *                           at most one key name or character
+ *
+ * Bytecode, multi-byte operands little endian:
+ *
+ *   END
+ *   KEY     modifier key        press, then release
+ *   TEXT    n (modifier key)*n  typed in order, released between repeats
+ *                               of a key and at the end
+ *   DELAY   ms:u32
+ *   DEFAULT ms:u32              sets the default delay
+ *   REPEAT  target:u16 n:u16    runs the instructions from target up to
+ *                               the REPEAT n more times
+ *
+ * The last instruction of each command has OP_LAST (0x80) set in its
+ * opcode, the default delay only follows those.
+ *
+ * Delays count from the moment the host has fetched every report queued
+ * before them, the one in flight on the endpoint included, not from when
+ * they were queued.
+ */
+
+#ifndef HID_DUCKY_H_
+#define HID_DUCKY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+typedef struct {
+  uint32_t script_len;
+  uint32_t code_len;
+  uint32_t compile_us;
+  uint32_t error_line; // 1-based, 0 if the script compiled
+  uint32_t reports;
+  uint32_t run_ms;
+} hid_ducky_stats_t;
+
+/**
+ * @brief Compiles a script into code.
+ *
+ * @param error_line Set to the 1-based line that failed (unknown command,
+ *                   bad number, code buffer full), untouched on success.
+ * @return false on error; *code_len is the size of the code on success.
+ */
+bool hid_ducky_compile(char const *src, size_t len, uint8_t *code,
+                       size_t size, size_t *code_len, uint32_t *error_line);
+
+/**
+ * @brief Takes the code buffer from the arena on first use and compiles the
+ *        script into it. The script text is not needed afterwards.
+ *
+ * @return false if the arena is exhausted or the script does not compile.
+ */
+bool hid_ducky_load(char const *src, size_t len);
+
+/**
+ * @brief Runs the loaded script from the start.
+ *
+ * @return false if no script is loaded.
+ */
+bool hid_ducky_start(uint32_t now_ms);
+
+/**
+ * @brief Queues the reports of as many instructions as the keyboard queue
+ *        takes. Call from hid_task.
+ *
+ * @return true while the script is running.
+ */
+bool hid_ducky_task(uint32_t now_ms);
+
+/**
+ * @brief Abandons the script, e.g. on unmount.
+ */
+void hid_ducky_stop(void);
+
+void hid_ducky_get_stats(hid_ducky_stats_t *stats);
+
+#endif /* HID_DUCKY_H_ */
@@ -0,0 +1,365 @@
+/*
+ * Incremental text update.
+ */
+
+#include <string.h>
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "hid_arena.h"
+#include "hid_edit.h"
+#include "hid_keymap.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+
+#if CFG_APP_EDIT
+
+_Static_assert(CFG_APP_EDIT_MAX_TEXT <= INT16_MAX,
+               "diff positions are 16 bit");
+
+// One hunk replaces old[old_pos, old_pos + del) by new[new_pos, new_pos + ins)
+typedef struct {
+  uint16_t old_pos;
+  uint16_t del;
+  uint16_t new_pos;
+  uint16_t ins;
+} hunk_t;
+
+enum {
+  OP_KEY,  // press and release key, count times
+  OP_TYPE, // type count characters of the text from pos
+};
+
+typedef struct {
+  uint8_t kind;
+  uint8_t modifier;
+  uint8_t key;
+  uint16_t count;
+  uint16_t pos;
+} edit_op_t;
+
+// Left to right: Home, then per hunk Right, Delete, type; then End
+#define MAX_OPS (3 * CFG_APP_EDIT_MAX_D + 4)
+
+// Home, Shift+End, Delete empty a field whose text is unknown
+#define CLEAR_KEYS 3
+
+static struct {
+  char *text;      // remembered text, the target while updating
+  uint16_t len;
+  bool known;      // the field holds text
+
+  int16_t *trace;  // Myers V per d, row d at d * d
+  hunk_t hunks[CFG_APP_EDIT_MAX_D + 1];
+  uint16_t hunk_count;
+
+  edit_op_t ops[MAX_OPS];
+  uint16_t op_count;
+  uint16_t op;     // running op, op_count when idle
+  uint16_t done;   // of the running op
+  uint8_t held;    // key of the last OP_TYPE press, 0 once released
+  bool active;
+
+  hid_edit_stats_t stats;
+} edit;
+
+//--------------------------------------------------------------------+
+// Diff
+//--------------------------------------------------------------------+
+
+#define V(d, k) edit.trace[(d) * (d) + (k) + (d)]
+
+static void add_edit(uint16_t old_pos, uint16_t new_pos, bool del) {
+  // Edits come last to first, a new one extends the hunk in front of it
+  // when no unchanged text lies between them
+  hunk_t *h = edit.hunk_count ? &edit.hunks[edit.hunk_count - 1] : NULL;
+  if (!h || h->old_pos != old_pos + del || h->new_pos != new_pos + !del) {
+    h = &edit.hunks[edit.hunk_count++];
+    *h = (hunk_t){.old_pos = (uint16_t)(old_pos + del),
+                  .new_pos = (uint16_t)(new_pos + !del)};
+  }
+  if (del) {
+    h->old_pos--;
+    h->del++;
+  } else {
+    h->new_pos--;
+    h->ins++;
+  }
+}
+
+// Shortest edit script of a -> b as hunks, false if it takes more than
+// CFG_APP_EDIT_MAX_D edits
+static bool myers(char const *a, int n, char const *b, int m) {
+  int found = -1;
+  for (int d = 0; d <= CFG_APP_EDIT_MAX_D && found < 0; d++) {
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (d == 0)
+        x = 0;
+      else if (k == -d || (k != d && V(d - 1, k - 1) < V(d - 1, k + 1)))
+        x = V(d - 1, k + 1); // insertion
+      else
+        x = V(d - 1, k - 1) + 1; // deletion
+      int y = x - k;
+      while (x < n && y < m && a[x] == b[y]) {
+        x++;
+        y++;
+      }
+      V(d, k) = (int16_t)x;
+      if (x >= n && y >= m) {
+        found = d;
+        break;
+      }
+    }
+  }
+  if (found < 0)
+    return false;
+
+  edit.hunk_count = 0;
+  int x = n, y = m;
+  for (int d = found; d > 0; d--) {
+    int const k = x - y;
+    bool const ins = k == -d || (k != d && V(d - 1, k - 1) < V(d - 1, k + 1));
+    int const prev_k = ins ? k + 1 : k - 1;
+    int const prev_x = V(d - 1, prev_k);
+    int const prev_y = prev_x - prev_k;
+    add_edit((uint16_t)prev_x, (uint16_t)prev_y, !ins);
+    x = prev_x;
+    y = prev_y;
+  }
+
+  // Collected last to first
+  for (uint16_t i = 0; i < edit.hunk_count / 2; i++) {
+    hunk_t const t = edit.hunks[i];
+    edit.hunks[i] = edit.hunks[edit.hunk_count - 1 - i];
+    edit.hunks[edit.hunk_count - 1 - i] = t;
+  }
+  return true;
+}
+
+static void diff(char const *old, uint16_t old_len, char const *target,
+                 uint16_t new_len) {
+  uint16_t prefix = 0;
+  while (prefix < old_len && prefix < new_len && old[prefix] == target[prefix])
+    prefix++;
+  uint16_t suffix = 0;
+  while (suffix < old_len - prefix && suffix < new_len - prefix &&
+         old[old_len - 1 - suffix] == target[new_len - 1 - suffix])
+    suffix++;
+
+  int const n = old_len - prefix - suffix;
+  int const m = new_len - prefix - suffix;
+  if (myers(&old[prefix], n, &target[prefix], m)) {
+    for (uint16_t i = 0; i < edit.hunk_count; i++) {
+      edit.hunks[i].old_pos += prefix;
+      edit.hunks[i].new_pos += prefix;
+    }
+  } else {
+    // Too different, replace the middle as a whole
+    edit.hunks[0] = (hunk_t){.old_pos = prefix,
+                             .del = (uint16_t)n,
+                             .new_pos = prefix,
+                             .ins = (uint16_t)m};
+    edit.hunk_count = 1;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Plan
+//--------------------------------------------------------------------+
+
+static void add_op(uint8_t kind, uint8_t modifier, uint8_t key,
+                   uint16_t count, uint16_t pos) {
+  if (count == 0)
+    return;
+  edit.ops[edit.op_count++] = (edit_op_t){
+      .kind = kind, .modifier = modifier, .key = key, .count = count,
+      .pos = pos};
+}
+
+static uint32_t plan_keys(void) {
+  uint32_t keys = 0;
+  for (uint16_t i = 0; i < edit.op_count; i++)
+    keys += edit.ops[i].count;
+  return keys;
+}
+
+static void plan_left_to_right(uint16_t old_len) {
+  edit.op_count = 0;
+  add_op(OP_KEY, 0, HID_KEY_HOME, 1, 0);
+  uint16_t cursor = 0; // in old text
+  for (uint16_t i = 0; i < edit.hunk_count; i++) {
+    hunk_t const *h = &edit.hunks[i];
+    add_op(OP_KEY, 0, HID_KEY_ARROW_RIGHT, h->old_pos - cursor, 0);
+    add_op(OP_KEY, 0, HID_KEY_DELETE, h->del, 0);
+    add_op(OP_TYPE, 0, 0, h->ins, h->new_pos);
+    cursor = h->old_pos + h->del;
+  }
+  if (cursor < old_len)
+    add_op(OP_KEY, 0, HID_KEY_END, 1, 0);
+}
+
+static void plan_right_to_left(uint16_t old_len) {
+  edit.op_count = 0;
+  // Distance from the cursor to the end of the next hunk to the left,
+  // counting what was just inserted
+  uint16_t cursor = old_len;
+  uint16_t inserted = 0;
+  for (uint16_t i = edit.hunk_count; i-- > 0;) {
+    hunk_t const *h = &edit.hunks[i];
+    add_op(OP_KEY, 0, HID_KEY_ARROW_LEFT,
+           (uint16_t)(inserted + cursor - (h->old_pos + h->del)), 0);
+    add_op(OP_KEY, 0, HID_KEY_BACKSPACE, h->del, 0);
+    add_op(OP_TYPE, 0, 0, h->ins, h->new_pos);
+    cursor = h->old_pos;
+    inserted = h->ins;
+  }
+  // The cursor stays behind the leftmost insertion
+  if (edit.hunk_count > 1 ||
+      (edit.hunk_count == 1 && cursor + edit.hunks[0].del < old_len))
+    add_op(OP_KEY, 0, HID_KEY_END, 1, 0);
+}
+
+// Whatever the field holds: select it all, delete it, type the target
+static void plan_clear(uint16_t new_len) {
+  edit.hunks[0] = (hunk_t){.ins = new_len};
+  edit.hunk_count = 1;
+  edit.op_count = 0;
+  add_op(OP_KEY, 0, HID_KEY_HOME, 1, 0);
+  add_op(OP_KEY, KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_END, 1, 0);
+  add_op(OP_KEY, 0, HID_KEY_DELETE, 1, 0);
+  add_op(OP_TYPE, 0, 0, new_len, 0);
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+bool hid_edit_init(void) {
+  edit.text = hid_arena_alloc(CFG_APP_EDIT_MAX_TEXT);
+  edit.trace = hid_arena_alloc(sizeof(int16_t) * (CFG_APP_EDIT_MAX_D + 1) *
+                               (CFG_APP_EDIT_MAX_D + 1));
+  hid_edit_reset();
+  return edit.text && edit.trace;
+}
+
+bool hid_edit_type(char const *target) {
+  if (edit.active || !edit.text || !edit.trace)
+    return false;
+  size_t const new_len = strlen(target);
+  if (new_len >= CFG_APP_EDIT_MAX_TEXT)
+    return false;
+
+  uint32_t const start_us = time_us_32();
+  uint32_t full_keys;
+  if (edit.known) {
+    diff(edit.text, edit.len, target, (uint16_t)new_len);
+
+    // Both ways, keep the cheaper
+    plan_right_to_left(edit.len);
+    uint32_t const rl_keys = plan_keys();
+    plan_left_to_right(edit.len);
+    if (plan_keys() > rl_keys)
+      plan_right_to_left(edit.len);
+    full_keys = (uint32_t)(edit.len + new_len);
+  } else {
+    plan_clear((uint16_t)new_len);
+    full_keys = (uint32_t)(CLEAR_KEYS + new_len);
+  }
+
+  memset(&edit.stats, 0, sizeof(edit.stats));
+  edit.stats.hunks = edit.hunk_count;
+  edit.stats.keys = plan_keys();
+  edit.stats.full_keys = full_keys;
+  edit.stats.diff_us = time_us_32() - start_us;
+
+  // The ops type from the new text
+  memcpy(edit.text, target, new_len);
+  edit.len = (uint16_t)new_len;
+  edit.known = false; // until the update finished
+
+  edit.op = 0;
+  edit.done = 0;
+  edit.held = 0;
+  edit.active = true;
+  return true;
+}
+
+static bool send(uint8_t modifier, uint8_t key) {
+  hid_keyboard_report_t report = {.modifier = modifier};
+  report.keycode[0] = key;
+  if (!hid_tx_send(HID_TX_KEYBOARD, &report, sizeof(report), 0))
+    return false;
+  edit.stats.reports++;
+  return true;
+}
+
+bool hid_edit_task(void) {
+  while (edit.active) {
+    if (edit.op == edit.op_count) {
+      edit.active = false;
+      edit.known = true;
+      HID_LOG("edit: %u hunks, %u keys instead of %u, %u reports, diff %u us",
+              edit.stats.hunks, edit.stats.keys, edit.stats.full_keys,
+              edit.stats.reports, edit.stats.diff_us);
+      break;
+    }
+
+    edit_op_t const *op = &edit.ops[edit.op];
+    if (op->kind == OP_KEY) {
+      // Press and release per stroke, done counts the reports
+      while (edit.done < 2 * op->count) {
+        bool const release = edit.done & 1;
+        if (!send(release ? 0 : op->modifier, release ? 0 : op->key))
+          return true;
+        edit.done++;
+      }
+    } else {
+      while (edit.done < op->count) {
+        uint8_t modifier, key;
+        if (!hid_keymap_ascii(edit.text[op->pos + edit.done], &modifier,
+                              &key)) {
+          edit.done++;
+          continue;
+        }
+        // The host only sees a key go down again after it went up
+        if (edit.held == key) {
+          if (!send(0, 0))
+            return true;
+          edit.held = 0;
+        }
+        if (!send(modifier, key))
+          return true;
+        edit.held = key;
+        edit.done++;
+      }
+      if (edit.held) {
+        if (!send(0, 0))
+          return true;
+        edit.held = 0;
+      }
+    }
+    edit.op++;
+    edit.done = 0;
+  }
+  return false;
+}
+
+void hid_edit_abort(void) {
+  if (!edit.active)
+    return;
+  // Some of the update may have reached the field
+  edit.active = false;
+  edit.known = false;
+}
+
+void hid_edit_reset(void) {
+  edit.active = false;
+  edit.known = true;
+  edit.len = 0;
+}
+
+void hid_edit_get_stats(hid_edit_stats_t *stats) { *stats = edit.stats; }
+
+#endif
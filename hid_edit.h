@@ -0,0 +1,72 @@
+/*
+ * Incremental text update.
+ *
+ * Remembers the text last typed into a field and, for a new target, types
+ * only the difference: cursor moves, deletions and insertions. The diff
+ * (Myers) resolves up to CFG_APP_EDIT_MAX_D single character edits in
+ * (CFG_APP_EDIT_MAX_D + 1)^2 words of arena memory; beyond that the
+ * changed middle part, after common prefix and suffix, is replaced as one
+ * block.
+ *
+ * The changes are applied either left to right from Home (Right over
+ * unchanged text, Delete, type) or right to left from the cursor at the end
+ * (Left over unchanged and just inserted text, Backspace, type), whichever
+ * takes fewer keys. The cursor is put back at the end afterwards.
+ *
+ * Assumes a single line field that holds exactly the remembered text with
+ * the cursor at the end, i.e. nobody else edited it. An update that does not
+ * finish leaves the field unknown; the next update then selects all of it
+ * (Home, Shift+End), deletes it and types the target in full.
+ */
+
+#ifndef HID_EDIT_H_
+#define HID_EDIT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+typedef struct {
+  uint32_t hunks;
+  uint32_t keys;        // key strokes of the edit
+  uint32_t full_keys;   // to clear the old text and type the new one,
+                        // Backspace per character or, unknown, selected
+  uint32_t reports;
+  uint32_t diff_us;
+} hid_edit_stats_t;
+
+/**
+ * @brief Takes the buffers from the arena.
+ */
+bool hid_edit_init(void);
+
+/**
+ * @brief Starts turning the field into target. The text is copied.
+ *
+ * @return false while an update runs or if target is longer than
+ *         CFG_APP_EDIT_MAX_TEXT - 1.
+ */
+bool hid_edit_type(char const *target);
+
+/**
+ * @brief Queues the next key reports. Call from hid_task.
+ *
+ * @return true while the update runs.
+ */
+bool hid_edit_task(void);
+
+/**
+ * @brief Abandons the update, e.g. on unmount. The field content is then
+ *        unknown.
+ */
+void hid_edit_abort(void);
+
+/**
+ * @brief Forgets the remembered text, the next target is typed in full.
+ */
+void hid_edit_reset(void);
+
+void hid_edit_get_stats(hid_edit_stats_t *stats);
+
+#endif /* HID_EDIT_H_ */
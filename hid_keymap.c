@@ -0,0 +1,20 @@
+/*
+ * ASCII to US keyboard usage mapping.
+ */
+
+#include "tusb.h"
+
+#include "hid_keymap.h"
+
+// { shift, keycode } per character, from TinyUSB
+static uint8_t const ascii_map[128][2] = {HID_ASCII_TO_KEYCODE};
+
+bool hid_keymap_ascii(char c, uint8_t *modifier, uint8_t *keycode) {
+  uint8_t const i = (uint8_t)c;
+  if (i >= 128 || ascii_map[i][1] == 0)
+    return false;
+
+  *modifier = ascii_map[i][0] ? KEYBOARD_MODIFIER_LEFTSHIFT : 0;
+  *keycode = ascii_map[i][1];
+  return true;
+}
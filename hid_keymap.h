@@ -0,0 +1,19 @@
+/*
+ * ASCII to US keyboard usage mapping.
+ */
+
+#ifndef HID_KEYMAP_H_
+#define HID_KEYMAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Maps a character to the key and modifier that type it on a US
+ *        layout host.
+ *
+ * @return false if the character cannot be typed.
+ */
+bool hid_keymap_ascii(char c, uint8_t *modifier, uint8_t *keycode);
+
+#endif /* HID_KEYMAP_H_ */
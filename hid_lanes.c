@@ -0,0 +1,177 @@
+/*
+ * Parallel typing over several keyboard interfaces.
+ */
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "hid_keymap.h"
+#include "hid_lanes.h"
+#include "hid_log.h"
+
+#if CFG_APP_KEYBOARD_LANES
+
+typedef struct {
+  uint8_t modifier;
+  uint8_t count;
+  uint8_t keys[6];
+} lane_report_t;
+
+static struct {
+  char const *text; // NULL when idle
+  uint32_t pos;
+
+  lane_report_t next[CFG_APP_KEYBOARD_LANES]; // the wave being submitted
+  lane_report_t held[CFG_APP_KEYBOARD_LANES]; // last report the host has
+  uint8_t pending;   // lanes of the wave not submitted yet
+  uint8_t in_flight; // lanes submitted, not fetched by the host yet
+  uint8_t fetched;   // lanes of the wave the host has fetched
+
+  uint32_t start_us;
+  hid_lanes_stats_t stats;
+  hid_lanes_stats_t last;
+} lanes;
+
+static bool has_key(lane_report_t const *r, uint8_t key) {
+  for (uint8_t i = 0; i < r->count; i++) {
+    if (r->keys[i] == key)
+      return true;
+  }
+  return false;
+}
+
+// Fills next[] from the text, returns false once the text is done and no
+// key is held anymore
+static bool build_wave(void) {
+  memset(lanes.next, 0, sizeof(lanes.next));
+
+  // The wave takes the modifier of its first character. The host merges
+  // modifiers across keyboards, so while a lane still holds keys under
+  // another modifier the wave only releases.
+  uint8_t wave_modifier = 0, first_key;
+  bool release = false;
+  while (lanes.text[lanes.pos] &&
+         !hid_keymap_ascii(lanes.text[lanes.pos], &wave_modifier, &first_key))
+    lanes.pos++;
+  for (uint8_t i = 0; i < CFG_APP_KEYBOARD_LANES; i++)
+    release |= lanes.held[i].count && lanes.held[i].modifier != wave_modifier;
+
+  uint8_t lane = 0;
+  while (!release && lanes.text[lanes.pos] && lane < CFG_APP_KEYBOARD_LANES) {
+    uint8_t modifier, key;
+    if (!hid_keymap_ascii(lanes.text[lanes.pos], &modifier, &key)) {
+      lanes.pos++;
+      continue;
+    }
+    if (modifier != wave_modifier)
+      break;
+
+    // Anything that would break order or not be seen moves to the next lane
+    lane_report_t *r = &lanes.next[lane];
+    if (r->count == sizeof(r->keys) || has_key(r, key) ||
+        has_key(&lanes.held[lane], key)) {
+      lane++;
+      continue;
+    }
+
+    r->modifier = modifier;
+    r->keys[r->count++] = key;
+    lanes.pos++;
+    lanes.stats.chars++;
+  }
+
+  // A wave without keys still releases whatever is held, lanes with nothing
+  // to press or release sit it out
+  lanes.pending = 0;
+  for (uint8_t i = 0; i < CFG_APP_KEYBOARD_LANES; i++) {
+    if (lanes.next[i].count != 0 || lanes.held[i].count != 0)
+      lanes.pending |= 1u << i;
+  }
+  return lanes.pending != 0;
+}
+
+static void finish(void) {
+  lanes.stats.elapsed_us = time_us_32() - lanes.start_us;
+  lanes.last = lanes.stats;
+  lanes.text = NULL;
+  HID_LOG("lanes: %u chars in %u waves, %u reports, %u us", lanes.last.chars,
+          lanes.last.waves, lanes.last.reports, lanes.last.elapsed_us);
+}
+
+bool hid_lanes_type(char const *text) {
+  if (lanes.text)
+    return false;
+
+  memset(&lanes.stats, 0, sizeof(lanes.stats));
+  memset(lanes.held, 0, sizeof(lanes.held));
+  lanes.text = text;
+  lanes.pos = 0;
+  lanes.pending = 0;
+  lanes.in_flight = 0;
+  lanes.start_us = time_us_32();
+
+  hid_lanes_task();
+  return true;
+}
+
+bool hid_lanes_busy(void) { return lanes.text != NULL; }
+
+void hid_lanes_task(void) {
+  if (!lanes.text)
+    return;
+
+  // The next wave once the host has fetched every lane of this one
+  if (!lanes.pending && !lanes.in_flight) {
+    if (!build_wave()) {
+      finish();
+      return;
+    }
+    lanes.fetched = 0;
+    lanes.stats.waves++;
+  }
+
+  // Every lane of the wave at once, so they go out in the same frame. A
+  // lane that cannot take its report yet holds back the ones after it.
+  for (uint8_t lane = 0; lane < CFG_APP_KEYBOARD_LANES; lane++) {
+    uint8_t const bit = 1u << lane;
+    if (!(lanes.pending & bit))
+      continue;
+
+    uint8_t const instance = HID_LANES_INSTANCE(lane);
+    lane_report_t const *r = &lanes.next[lane];
+    uint8_t keycode[6] = {0};
+    memcpy(keycode, r->keys, r->count);
+    if (!tud_hid_n_ready(instance) ||
+        !tud_hid_n_keyboard_report(instance, 0, r->modifier, keycode))
+      return;
+
+    lanes.pending &= (uint8_t)~bit;
+    lanes.in_flight |= bit;
+    lanes.held[lane] = *r;
+    lanes.stats.reports++;
+  }
+}
+
+void hid_lanes_complete(uint8_t lane) {
+  uint8_t const bit = 1u << lane;
+  if (!lanes.text || !(lanes.in_flight & bit))
+    return;
+
+  // A lower lane fetched after a higher one: the host broke the order
+  if (lanes.fetched & (uint8_t)~((bit << 1) - 1))
+    lanes.stats.reordered++;
+  lanes.fetched |= bit;
+  lanes.in_flight &= (uint8_t)~bit;
+  // The next wave waits for hid_lanes_task(): submitted from here, mid
+  // frame, a lane the host polls later in this frame would go out first
+}
+
+void hid_lanes_flush(void) {
+  lanes.text = NULL;
+  lanes.pending = 0;
+  lanes.in_flight = 0;
+}
+
+void hid_lanes_get_stats(hid_lanes_stats_t *stats) { *stats = lanes.last; }
+
+#endif
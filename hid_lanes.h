@@ -0,0 +1,80 @@
+/*
+ * Parallel typing over several keyboard interfaces.
+ *
+ * With CFG_APP_KEYBOARD_LANES = N the device enumerates N extra keyboards
+ * (HID instances 1..N, each with its own IN endpoint) next to the composite
+ * interface. Text is typed in waves: each wave gives lane 0 up to six
+ * distinct keys of the next characters, then lane 1 the following ones, and
+ * so on, and submits every lane at once, so up to 6 * N characters go down
+ * per poll interval instead of six.
+ *
+ * Order rests on two host behaviours: keys that go down in one report are
+ * processed in array order, and the host fetches the lanes of a wave, which
+ * share bInterval and are all waiting, in the same frame in endpoint order.
+ * A host that fetches a higher lane first types out of order; the device
+ * sees it in its completions and counts it in stats.reordered. The next
+ * wave only starts once the host has fetched the whole wave, from the main
+ * loop rather than the completion callback, so never in the frame of the
+ * last completion.
+ *
+ * Hosts merge the modifiers of all keyboards, so all keys of a wave share
+ * one modifier byte, and a wave that would change the modifier while a lane
+ * still holds keys only releases. A lane never gets a key it is still
+ * holding from the wave before, since the host would not see it go down
+ * again. Lanes that hold keys but get nothing new are released in the same
+ * wave so nothing autorepeats.
+ */
+
+#ifndef HID_LANES_H_
+#define HID_LANES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// HID instance of a lane, instance 0 is the composite interface
+#define HID_LANES_INSTANCE(lane) (1 + (lane))
+
+typedef struct {
+  uint32_t chars;
+  uint32_t waves;
+  uint32_t reports;
+  uint32_t reordered; // waves the host fetched out of lane order
+  uint32_t elapsed_us;
+} hid_lanes_stats_t;
+
+/**
+ * @brief Starts typing text, which must stay valid until hid_lanes_busy()
+ *        returns false. Characters hid_keymap_ascii() cannot map are
+ *        skipped.
+ *
+ * @return false if still typing.
+ */
+bool hid_lanes_type(char const *text);
+
+bool hid_lanes_busy(void);
+
+/**
+ * @brief Submits the lanes of the wave whose endpoint is free, or starts
+ *        the next wave. Call from the main loop.
+ */
+void hid_lanes_task(void);
+
+/**
+ * @brief Report completion on a lane. Once the host has fetched every lane
+ *        of the wave, the next hid_lanes_task() starts the next one.
+ */
+void hid_lanes_complete(uint8_t lane);
+
+/**
+ * @brief Abandons the text, e.g. on unmount.
+ */
+void hid_lanes_flush(void);
+
+/**
+ * @brief Statistics of the last completed text.
+ */
+void hid_lanes_get_stats(hid_lanes_stats_t *stats);
+
+#endif /* HID_LANES_H_ */
@@ -0,0 +1,164 @@
+/*
+ * Status LED engine.
+ */
+
+#include "bsp/board_api.h"
+#include "pico/time.h"
+
+#include "hid_led.h"
+
+// PWM needs the LED on a GPIO, boards without one (e.g. Pico W) fall back to
+// on/off from the main loop
+#if CFG_APP_LED_PWM && defined(PICO_DEFAULT_LED_PIN)
+#define LED_PWM 1
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#else
+#define LED_PWM 0
+#endif
+
+// Pulse and pause of HID_LED_ERROR
+#define ERROR_PULSE_MS 150
+#define ERROR_PAUSE_MS 1000
+
+static volatile uint32_t posted = HID_LED_PATTERN(HID_LED_NOT_MOUNTED, 0);
+
+static struct {
+  uint32_t pattern;
+  uint32_t index;
+  hid_led_step_t step;
+  uint32_t elapsed_ms; // in the current step
+} engine;
+
+//--------------------------------------------------------------------+
+// Patterns
+//--------------------------------------------------------------------+
+
+static bool blink(uint32_t index, uint8_t level, uint16_t ms,
+                  hid_led_step_t *step) {
+  if (index > 1)
+    return false;
+  step->level = index == 0 ? level : 0;
+  step->ms = ms;
+  return true;
+}
+
+bool hid_led_pattern_step(uint32_t pattern, uint32_t index,
+                          hid_led_step_t *step) {
+  uint32_t const arg = HID_LED_PATTERN_ARG(pattern);
+
+  switch (HID_LED_PATTERN_ID(pattern)) {
+  case HID_LED_ON:
+    *step = (hid_led_step_t){.level = 255, .ms = 0};
+    return index == 0;
+
+  case HID_LED_NOT_MOUNTED:
+    return blink(index, 255, 250, step);
+
+  case HID_LED_MOUNTED:
+    return blink(index, 255, 1000, step);
+
+  case HID_LED_SUSPENDED:
+    return blink(index, 32, 2500, step);
+
+  case HID_LED_BUSY:
+    return blink(index, 255, 50, step);
+
+  case HID_LED_ERROR:
+    // Pulses count the error code, the pause separates repetitions
+    if (index < 2 * arg)
+      return blink(index % 2, 255, ERROR_PULSE_MS, step);
+    *step = (hid_led_step_t){.level = 0, .ms = ERROR_PAUSE_MS};
+    return index == 2 * arg;
+
+  case HID_LED_LEVEL:
+    *step = (hid_led_step_t){.level = arg > 255 ? 255 : (uint8_t)arg, .ms = 0};
+    return index == 0;
+
+  case HID_LED_OFF:
+  default:
+    *step = (hid_led_step_t){.level = 0, .ms = 0};
+    return index == 0;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Engine
+//--------------------------------------------------------------------+
+
+void hid_led_post(uint32_t pattern) { posted = pattern; }
+
+static void load_step(uint32_t index) {
+  if (!hid_led_pattern_step(engine.pattern, index, &engine.step)) {
+    index = 0;
+    hid_led_pattern_step(engine.pattern, 0, &engine.step);
+  }
+  engine.index = index;
+  engine.elapsed_ms = 0;
+}
+
+uint8_t hid_led_tick(uint32_t ms) {
+  uint32_t const pattern = posted;
+  if (pattern != engine.pattern) {
+    engine.pattern = pattern;
+    load_step(0);
+    return engine.step.level;
+  }
+
+  engine.elapsed_ms += ms;
+  // Steps shorter than a tick are passed over, not stretched
+  while (engine.step.ms && engine.elapsed_ms >= engine.step.ms) {
+    uint32_t const over = engine.elapsed_ms - engine.step.ms;
+    load_step(engine.index + 1);
+    engine.elapsed_ms = over;
+  }
+  return engine.step.level;
+}
+
+//--------------------------------------------------------------------+
+// Output
+//--------------------------------------------------------------------+
+
+#if LED_PWM
+
+static repeating_timer_t timer;
+
+static bool tick_cb(repeating_timer_t *rt) {
+  (void)rt;
+  uint8_t const level = hid_led_tick(CFG_APP_LED_TICK_MS);
+  // Squared for a roughly linear perceived brightness
+  pwm_set_gpio_level(PICO_DEFAULT_LED_PIN, (uint16_t)(level * level));
+  return true;
+}
+
+bool hid_led_init(void) {
+  gpio_set_function(PICO_DEFAULT_LED_PIN, GPIO_FUNC_PWM);
+  pwm_config config = pwm_get_default_config();
+  pwm_config_set_wrap(&config, 255 * 255);
+  pwm_init(pwm_gpio_to_slice_num(PICO_DEFAULT_LED_PIN), &config, true);
+
+  engine.pattern = ~posted; // picked up on the first tick
+  // Negative: fixed period between callback starts
+  return add_repeating_timer_ms(-CFG_APP_LED_TICK_MS, tick_cb, NULL, &timer);
+}
+
+void hid_led_task(void) {}
+
+#else
+
+bool hid_led_init(void) {
+  engine.pattern = ~posted;
+  return true;
+}
+
+void hid_led_task(void) {
+  static uint32_t start_ms = 0;
+
+  if (board_millis() - start_ms < CFG_APP_LED_TICK_MS)
+    return; // not enough time
+  start_ms += CFG_APP_LED_TICK_MS;
+
+  board_led_write(hid_led_tick(CFG_APP_LED_TICK_MS) != 0);
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Status LED engine.
+ *
+ * The LED shows one pattern at a time, selected by posting a pattern word
+ * (ID plus argument). Posting is a single aligned 32-bit store, so any
+ * context, callbacks and interrupts included, can change the pattern
+ * without locking; the engine picks the new word up on its next tick and
+ * restarts the pattern from its first step.
+ *
+ * With CFG_APP_LED_PWM the engine ticks from a repeating hardware alarm and
+ * drives the LED pin through PWM, so patterns can have brightness levels
+ * and the main loop never touches the LED. Without it, or on boards without
+ * PICO_DEFAULT_LED_PIN (LED not on a GPIO, e.g. Pico W), hid_led_task()
+ * ticks from the main loop and the LED is only on or off.
+ */
+
+#ifndef HID_LED_H_
+#define HID_LED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+typedef enum {
+  HID_LED_OFF,
+  HID_LED_ON,
+  HID_LED_NOT_MOUNTED, // 250 ms blink
+  HID_LED_MOUNTED,     // 1 s blink
+  HID_LED_SUSPENDED,   // dim 2.5 s blink
+  HID_LED_BUSY,        // fast flicker
+  HID_LED_ERROR,       // arg pulses, then a pause
+  HID_LED_LEVEL,       // steady brightness arg (0 - 255), e.g. queue depth
+} hid_led_id_t;
+
+#define HID_LED_PATTERN(id, arg) ((uint32_t)(id) | ((uint32_t)(arg) << 8))
+#define HID_LED_PATTERN_ID(p)    ((hid_led_id_t)((p) & 0xff))
+#define HID_LED_PATTERN_ARG(p)   ((p) >> 8)
+
+// One step of a pattern: brightness for ms milliseconds, 0 ms holds forever
+typedef struct {
+  uint8_t level;
+  uint16_t ms;
+} hid_led_step_t;
+
+/**
+ * @brief Sets up the output and starts ticking with HID_LED_NOT_MOUNTED.
+ *
+ * @return false if no alarm was available.
+ */
+bool hid_led_init(void);
+
+/**
+ * @brief Selects the pattern to show. Safe from any context.
+ */
+void hid_led_post(uint32_t pattern);
+
+/**
+ * @brief Looks up step `index` of a pattern.
+ *
+ * @return false past the last step, the pattern then starts over.
+ */
+bool hid_led_pattern_step(uint32_t pattern, uint32_t index,
+                          hid_led_step_t *step);
+
+/**
+ * @brief Advances the engine by ms milliseconds.
+ *
+ * @return the brightness to show.
+ */
+uint8_t hid_led_tick(uint32_t ms);
+
+/**
+ * @brief Ticks the engine from the main loop, does nothing when the alarm
+ *        drives the LED.
+ */
+void hid_led_task(void);
+
+#endif /* HID_LED_H_ */
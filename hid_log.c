@@ -0,0 +1,111 @@
+/*
+ * Deferred-formatting binary log.
+ */
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "hid_arena.h"
+#include "hid_log.h"
+
+#if CFG_APP_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+#if CFG_APP_LOG
+
+_Static_assert((CFG_APP_LOG_RING_WORDS & (CFG_APP_LOG_RING_WORDS - 1)) == 0,
+               "CFG_APP_LOG_RING_WORDS must be a power of two");
+
+// Start of the format string section, provided by the linker. The drop
+// record's format lives there too, so the section always exists.
+extern char const __start_hid_log_fmt[];
+static char const drop_fmt[] __attribute__((section("hid_log_fmt"), used)) =
+    "log: %u records dropped";
+
+static uint32_t *ring;
+static uint32_t head; // written by the producer only
+static uint32_t tail; // written by the consumer only
+static uint32_t dropped;
+
+bool hid_log_init(void) {
+  ring = hid_arena_alloc(CFG_APP_LOG_RING_WORDS * sizeof(uint32_t));
+  head = tail = dropped = 0;
+  return ring != NULL;
+}
+
+static bool put(char const *fmt, uint32_t nargs, uint32_t const *args) {
+  uint32_t const h = head;
+  uint32_t const free =
+      CFG_APP_LOG_RING_WORDS - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+  if (ring == NULL || free < 2 + nargs)
+    return false;
+
+  uint32_t const mask = CFG_APP_LOG_RING_WORDS - 1;
+  ring[h & mask] = ((uint32_t)(fmt - __start_hid_log_fmt) << 8) | nargs;
+  ring[(h + 1) & mask] = time_us_32();
+  for (uint32_t i = 0; i < nargs; i++)
+    ring[(h + 2 + i) & mask] = args[i];
+
+  // Publish the record only once it is complete
+  __atomic_store_n(&head, h + 2 + nargs, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void write_record(char const *fmt, uint32_t nargs,
+                         uint32_t const *args) {
+  // Report the gap before the first record that fits again
+  if (dropped) {
+    if (!put(drop_fmt, 1, &dropped)) {
+      dropped++;
+      return;
+    }
+    dropped = 0;
+  }
+
+  if (!put(fmt, nargs, args))
+    dropped++;
+}
+
+void hid_log_write(char const *fmt, uint32_t nargs, uint32_t const *args) {
+#if CFG_APP_FREERTOS
+  // The ring has a single producer, every task logs through it
+  taskENTER_CRITICAL();
+  write_record(fmt, nargs, args);
+  taskEXIT_CRITICAL();
+#else
+  write_record(fmt, nargs, args);
+#endif
+}
+
+uint16_t hid_log_read(uint32_t *words, uint16_t max) {
+  uint32_t const t = tail;
+  uint32_t avail = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+  if (avail > max)
+    avail = max;
+
+  for (uint32_t i = 0; i < avail; i++)
+    words[i] = ring[(t + i) & (CFG_APP_LOG_RING_WORDS - 1)];
+
+  __atomic_store_n(&tail, t + avail, __ATOMIC_RELEASE);
+  return (uint16_t)avail;
+}
+
+#else
+
+bool hid_log_init(void) { return true; }
+
+void hid_log_write(char const *fmt, uint32_t nargs, uint32_t const *args) {
+  (void)fmt;
+  (void)nargs;
+  (void)args;
+}
+
+uint16_t hid_log_read(uint32_t *words, uint16_t max) {
+  (void)words;
+  (void)max;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Deferred-formatting binary log.
+ *
+ * A call site stores only the offset of its format string and the raw
+ * arguments into a lock-free ring; no formatting happens on the device.
+ * Format strings live in the `hid_log_fmt` section of the ELF, from which
+ * tools/hid_log_decode.py formats the records on the host.
+ *
+ * Record layout in 32-bit words:
+ *   [format offset << 8 | nargs] [time_us_32()] [arg0] ... [argN-1]
+ *
+ * Arguments are stored as 32-bit integers, so only integer conversions
+ * (%d %u %x %X %c) are supported. The ring is drained over the
+ * REPORT_ID_TELEMETRY feature report. With CFG_APP_LOG disabled HID_LOG()
+ * compiles to nothing and its arguments are not evaluated.
+ */
+
+#ifndef HID_LOG_H_
+#define HID_LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+#define HID_LOG_MAX_ARGS 8
+
+#if CFG_APP_LOG
+
+#define HID_LOG(fmt, ...)                                                      \
+  do {                                                                         \
+    static char const _hid_log_fmt[]                                           \
+        __attribute__((section("hid_log_fmt"), used)) = fmt;                   \
+    uint32_t const _hid_log_args[] = {0, ##__VA_ARGS__};                       \
+    _Static_assert(sizeof(_hid_log_args) / 4 - 1 <= HID_LOG_MAX_ARGS,          \
+                   "too many HID_LOG arguments");                              \
+    hid_log_write(_hid_log_fmt, sizeof(_hid_log_args) / 4 - 1,                 \
+                  &_hid_log_args[1]);                                          \
+  } while (0)
+
+#else
+
+#define HID_LOG(fmt, ...) ((void)0)
+
+#endif
+
+/**
+ * @brief Allocates the ring from the arena.
+ */
+bool hid_log_init(void);
+
+/**
+ * @brief Appends one record, use HID_LOG() instead.
+ */
+void hid_log_write(char const *fmt, uint32_t nargs, uint32_t const *args);
+
+/**
+ * @brief Moves up to max queued words into words.
+ *
+ * @return number of words copied.
+ */
+uint16_t hid_log_read(uint32_t *words, uint16_t max);
+
+#endif /* HID_LOG_H_ */
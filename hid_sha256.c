@@ -0,0 +1,133 @@
+/*
+ * Incremental SHA-256.
+ */
+
+#include <string.h>
+
+#include "hid_sha256.h"
+
+#if HID_SHA256_HW
+
+void hid_sha256_start(hid_sha256_t *ctx) {
+  // Waits for the accelerator if another user holds it
+  pico_sha256_start_blocking(&ctx->hw, SHA256_BIG_ENDIAN, false);
+}
+
+void hid_sha256_update(hid_sha256_t *ctx, void const *data, size_t len) {
+  pico_sha256_update_blocking(&ctx->hw, (uint8_t const *)data, len);
+}
+
+void hid_sha256_finish(hid_sha256_t *ctx, uint8_t digest[HID_SHA256_LEN]) {
+  sha256_result_t result;
+  pico_sha256_finish(&ctx->hw, &result);
+  memcpy(digest, result.bytes, HID_SHA256_LEN);
+}
+
+#else
+
+static uint32_t const k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void compress(uint32_t h[8], uint8_t const block[64]) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+           (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t const s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t const s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+  uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t const t1 = hh + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+                        ((e & f) ^ (~e & g)) + k[i] + w[i];
+    uint32_t const t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+                        ((a & b) ^ (a & c) ^ (b & c));
+    hh = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+  h[5] += f;
+  h[6] += g;
+  h[7] += hh;
+}
+
+void hid_sha256_start(hid_sha256_t *ctx) {
+  static uint32_t const init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                   0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                   0x1f83d9ab, 0x5be0cd19};
+  memcpy(ctx->h, init, sizeof(init));
+  ctx->total = 0;
+}
+
+void hid_sha256_update(hid_sha256_t *ctx, void const *data, size_t len) {
+  uint8_t const *p = data;
+  size_t fill = (size_t)(ctx->total % 64);
+  ctx->total += len;
+
+  if (fill) {
+    size_t const n = len < 64 - fill ? len : 64 - fill;
+    memcpy(&ctx->block[fill], p, n);
+    p += n;
+    len -= n;
+    if (fill + n < 64)
+      return;
+    compress(ctx->h, ctx->block);
+  }
+  for (; len >= 64; p += 64, len -= 64)
+    compress(ctx->h, p);
+  memcpy(ctx->block, p, len);
+}
+
+void hid_sha256_finish(hid_sha256_t *ctx, uint8_t digest[HID_SHA256_LEN]) {
+  uint64_t const bits = ctx->total * 8;
+  size_t fill = (size_t)(ctx->total % 64);
+
+  ctx->block[fill++] = 0x80;
+  if (fill > 56) {
+    memset(&ctx->block[fill], 0, 64 - fill);
+    compress(ctx->h, ctx->block);
+    fill = 0;
+  }
+  memset(&ctx->block[fill], 0, 56 - fill);
+  for (int i = 0; i < 8; i++)
+    ctx->block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+  compress(ctx->h, ctx->block);
+
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i] = (uint8_t)(ctx->h[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(ctx->h[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(ctx->h[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)ctx->h[i];
+  }
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Incremental SHA-256.
+ *
+ * Uses the SHA-256 accelerator through pico_sha256 on RP2350 and a portable
+ * software implementation everywhere else (RP2040, host builds). The
+ * accelerator is a single shared unit: between hid_sha256_start() and
+ * hid_sha256_finish() nobody else can use it, so keep one hash open at a
+ * time.
+ */
+
+#ifndef HID_SHA256_H_
+#define HID_SHA256_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if PICO_RP2350
+#include "pico/sha256.h"
+#define HID_SHA256_HW 1
+#else
+#define HID_SHA256_HW 0
+#endif
+
+#define HID_SHA256_LEN 32
+
+typedef struct {
+#if HID_SHA256_HW
+  pico_sha256_state_t hw;
+#else
+  uint32_t h[8];
+  uint8_t block[64];
+  uint64_t total;
+#endif
+} hid_sha256_t;
+
+void hid_sha256_start(hid_sha256_t *ctx);
+
+void hid_sha256_update(hid_sha256_t *ctx, void const *data, size_t len);
+
+void hid_sha256_finish(hid_sha256_t *ctx, uint8_t digest[HID_SHA256_LEN]);
+
+#endif /* HID_SHA256_H_ */
@@ -0,0 +1,35 @@
+/*
+ * Keyboard report sequences rendered at compile time (see hid_text.hpp).
+ */
+
+#ifndef HID_TEXT_H_
+#define HID_TEXT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same layout as TinyUSB's hid_keyboard_report_t
+typedef struct {
+  uint8_t modifier;
+  uint8_t reserved;
+  uint8_t keycode[6];
+} hid_text_report_t;
+
+typedef struct {
+  hid_text_report_t const *reports;
+  size_t count;
+} hid_text_t;
+
+// The demo text, as a string and pre-rendered (demo_text.cpp)
+extern char const demo_text[];
+extern hid_text_t const demo_text_reports;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HID_TEXT_H_ */
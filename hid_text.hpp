@@ -0,0 +1,125 @@
+/*
+ * Compile-time rendering of text into keyboard reports, C++17.
+ *
+ *   constexpr auto hello = HID_TEXT("Hello World!");
+ *   constexpr auto hello = "Hello World!"_hid;    // GCC/Clang extension
+ *
+ * Both yield a std::array<hid_text_report_t, N> to be sent in order, so
+ * typing becomes a walk over a constant array. Characters are mapped with
+ * TinyUSB's HID_ASCII_TO_KEYCODE table, the same one hid_keymap.c uses.
+ * Each character is one report; a release is only inserted where the next
+ * character uses the same key, and once at the end. Characters without a key
+ * are skipped.
+ */
+
+#ifndef HID_TEXT_HPP_
+#define HID_TEXT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "tusb.h"
+
+#include "hid_text.h"
+
+namespace hid_text {
+
+struct key {
+  uint8_t modifier;
+  uint8_t keycode;
+};
+
+constexpr uint8_t ascii_map[128][2] = {HID_ASCII_TO_KEYCODE};
+
+constexpr key ascii_key(char c) {
+  uint8_t const i = static_cast<uint8_t>(c);
+  if (i >= 128)
+    return {0, 0};
+  return {static_cast<uint8_t>(ascii_map[i][0] ? KEYBOARD_MODIFIER_LEFTSHIFT
+                                               : 0),
+          ascii_map[i][1]};
+}
+
+// Number of reports render() produces for s
+template <std::size_t N> constexpr std::size_t report_count(char const (&s)[N]) {
+  std::size_t count = 0;
+  uint8_t prev = 0;
+  for (std::size_t i = 0; i < N && s[i]; i++) {
+    key const k = ascii_key(s[i]);
+    if (k.keycode == 0)
+      continue;
+    if (k.keycode == prev)
+      count++; // release first
+    count++;
+    prev = k.keycode;
+  }
+  return count ? count + 1 : 0;
+}
+
+template <std::size_t Count, std::size_t N>
+constexpr std::array<hid_text_report_t, Count> render(char const (&s)[N]) {
+  std::array<hid_text_report_t, Count> reports{};
+  std::size_t n = 0;
+  uint8_t prev = 0;
+  for (std::size_t i = 0; i < N && s[i]; i++) {
+    key const k = ascii_key(s[i]);
+    if (k.keycode == 0)
+      continue;
+    if (k.keycode == prev)
+      n++; // stays all zero: release
+    reports[n].modifier = k.modifier;
+    reports[n].keycode[0] = k.keycode;
+    n++;
+    prev = k.keycode;
+  }
+  // The last entry stays all zero: release
+  return reports;
+}
+
+template <char... Cs> struct chars {
+  static constexpr char value[] = {Cs..., 0};
+};
+
+} // namespace hid_text
+
+#define HID_TEXT(str)                                                          \
+  (::hid_text::render<::hid_text::report_count(str)>(str))
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#if defined(__clang__)
+#pragma GCC diagnostic ignored "-Wgnu-string-literal-operator-template"
+#endif
+
+// String literal operator templates are a GNU extension in C++17
+template <typename CharT, CharT... Cs> constexpr auto operator""_hid() {
+  using s = ::hid_text::chars<static_cast<char>(Cs)...>;
+  return ::hid_text::render<::hid_text::report_count(s::value)>(s::value);
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+// Self checks, evaluated wherever the header is included
+namespace hid_text {
+namespace check {
+
+constexpr auto ab = HID_TEXT("ab");
+static_assert(ab.size() == 3, "one report per key plus the final release");
+static_assert(ab[0].keycode[0] == HID_KEY_A && ab[1].keycode[0] == HID_KEY_B,
+              "keys in text order");
+static_assert(ab[2].keycode[0] == 0 && ab[2].modifier == 0, "ends released");
+
+constexpr auto aa = HID_TEXT("aA");
+static_assert(aa.size() == 4 && aa[1].keycode[0] == 0,
+              "a repeated key is released in between");
+static_assert(aa[2].modifier == KEYBOARD_MODIFIER_LEFTSHIFT, "shifted");
+
+static_assert(HID_TEXT("").size() == 0, "empty text, no reports");
+
+} // namespace check
+} // namespace hid_text
+
+#endif /* HID_TEXT_HPP_ */
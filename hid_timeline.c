@@ -0,0 +1,181 @@
+/*
+ * Timestamped HID report timeline and replay engine.
+ */
+
+#include "tusb.h"
+
+#include "pico/time.h"
+
+#include "hid_log.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
+#include "usb_descriptors.h"
+
+//--------------------------------------------------------------------+
+// Decoder
+//--------------------------------------------------------------------+
+
+uint8_t HID_HOT_FUNC(hid_timeline_report_len)(uint8_t report_id) {
+  switch (report_id) {
+  case REPORT_ID_KEYBOARD:
+    return sizeof(hid_keyboard_report_t);
+  case REPORT_ID_MOUSE:
+    return sizeof(hid_mouse_report_t);
+  case REPORT_ID_CONSUMER_CONTROL:
+    return sizeof(uint16_t);
+  case REPORT_ID_GAMEPAD:
+    return sizeof(hid_gamepad_report_t);
+  default:
+    return 0;
+  }
+}
+
+bool HID_HOT_FUNC(hid_timeline_next)(uint8_t const *data, size_t len,
+                                     size_t *pos,
+                                     hid_timeline_record_t *record) {
+  size_t p = *pos;
+  uint32_t delta = 0;
+
+  // LEB128 varint, at most 5 bytes for 32 bits
+  for (uint8_t shift = 0;; shift += 7) {
+    if (p >= len || shift > 28)
+      return false;
+    uint8_t const b = data[p++];
+    // The fifth byte may only carry the top 4 bits
+    if (shift == 28 && (b & 0xf0))
+      return false;
+    delta |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      break;
+  }
+
+  if (p >= len)
+    return false;
+  uint8_t const report_id = data[p++];
+  uint8_t const payload_len = hid_timeline_report_len(report_id);
+  if (payload_len == 0 || len - p < payload_len)
+    return false;
+
+  record->delta_us = delta;
+  record->report_id = report_id;
+  record->len = payload_len;
+  record->payload = &data[p];
+
+  *pos = p + payload_len;
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Verification
+//--------------------------------------------------------------------+
+
+void hid_timeline_verify(hid_timeline_player_t *player,
+                         uint8_t const (*digests)[HID_SHA256_LEN],
+                         size_t block_size) {
+  player->digests = digests;
+  player->block_size = block_size;
+  player->verified = 0;
+  player->hashed = 0;
+}
+
+// Hashes the next slice, staying one block ahead of playback. Returns false
+// once a block does not match.
+static bool verify_step(hid_timeline_player_t *player) {
+  if (player->verified >= player->len ||
+      player->verified > player->pos + player->block_size)
+    return true;
+
+  size_t const block = player->verified;
+  size_t const block_len = TU_MIN(player->block_size, player->len - block);
+  size_t const n = TU_MIN(CFG_APP_VERIFY_SLICE, block_len - player->hashed);
+
+  uint32_t const start_us = time_us_32();
+  if (player->hashed == 0)
+    hid_sha256_start(&player->sha);
+  hid_sha256_update(&player->sha, &player->data[block + player->hashed], n);
+  player->hashed += n;
+
+  if (player->hashed == block_len) {
+    uint8_t digest[HID_SHA256_LEN];
+    hid_sha256_finish(&player->sha, digest);
+    player->hashed = 0;
+    if (memcmp(digest, player->digests[block / player->block_size],
+               HID_SHA256_LEN) != 0) {
+      player->corrupt = true;
+      HID_LOG("timeline: block at %u corrupt", block);
+      return false;
+    }
+    player->verified += block_len;
+  }
+  player->verify_us += time_us_32() - start_us;
+
+  if (player->verified == player->len) {
+    HID_LOG("timeline: verified %u bytes in %u us", player->len,
+            player->verify_us);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Player
+//--------------------------------------------------------------------+
+
+static bool HID_HOT_FUNC(load_next)(hid_timeline_player_t *player) {
+  player->pending = hid_timeline_next(player->data, player->len, &player->pos,
+                                      &player->record);
+  if (player->pending) {
+    // Accumulate on the schedule, not on the send time, so a late report
+    // does not push back every report after it.
+    player->due_us += player->record.delta_us;
+  }
+  return player->pending;
+}
+
+bool hid_timeline_start(hid_timeline_player_t *player, uint8_t const *data,
+                        size_t len, uint64_t now_us) {
+  memset(player, 0, sizeof(*player));
+
+  if (len < HID_TIMELINE_HEADER_LEN || data[0] != 'H' || data[1] != 'T' ||
+      data[2] != 'L' || data[3] != HID_TIMELINE_VERSION)
+    return false;
+
+  player->data = data;
+  player->len = len;
+  player->pos = HID_TIMELINE_HEADER_LEN;
+  player->due_us = now_us;
+  player->active = load_next(player);
+
+  return player->active;
+}
+
+bool HID_HOT_FUNC(hid_timeline_task)(hid_timeline_player_t *player,
+                                     uint64_t now_us) {
+  if (!player->active)
+    return false;
+
+  if (player->digests && !verify_step(player)) {
+    player->active = false;
+    return false;
+  }
+
+  while (player->pending && now_us >= player->due_us) {
+    // Records past the verified blocks wait for the hash to catch up
+    if (player->digests && player->pos > player->verified)
+      return true;
+
+    // Queue full, try again next loop
+    if (!hid_tx_send(hid_tx_class_of(player->record.report_id),
+                     player->record.payload, player->record.len, 0))
+      return true;
+
+    uint64_t const late = now_us - player->due_us;
+    if (late > player->max_late_us)
+      player->max_late_us = late > UINT32_MAX ? UINT32_MAX : (uint32_t)late;
+    player->sent++;
+
+    load_next(player);
+  }
+
+  player->active = player->pending;
+  return player->active;
+}
@@ -0,0 +1,107 @@
+/*
+ * Timestamped HID report timeline and replay engine.
+ *
+ * Binary layout (all multi-byte values little endian):
+ *
+ *   header : 'H' 'T' 'L' version
+ *   record : delta_us (unsigned LEB128 varint)
+ *            report_id (1 byte)
+ *            payload   (hid_timeline_report_len(report_id) bytes)
+ *
+ * delta_us is the time between this record and the previous one (or the start
+ * of playback for the first record). The payload length is implied by the
+ * report ID, so a record carries no explicit length field.
+ *
+ * tools/evdev_to_timeline.py converts a Linux evdev capture into this format.
+ *
+ * Integrity: the generated C sources carry the SHA-256 of every block of the
+ * timeline. With hid_timeline_verify() the player hashes at most one block
+ * ahead of playback, a slice per call, and only sends a record once the
+ * block holding it matched. A corrupt block stops playback before any of
+ * its records reach the host, without hashing the whole image upfront.
+ */
+
+#ifndef HID_TIMELINE_H_
+#define HID_TIMELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hid_sha256.h"
+
+#define HID_TIMELINE_VERSION      1
+#define HID_TIMELINE_HEADER_LEN   4
+
+// Largest payload of any report ID (gamepad)
+#define HID_TIMELINE_MAX_PAYLOAD  11
+
+typedef struct {
+  uint32_t delta_us;
+  uint8_t report_id;
+  uint8_t len;
+  uint8_t const *payload; // points into the timeline buffer
+} hid_timeline_record_t;
+
+typedef struct {
+  uint8_t const *data;
+  size_t len;
+  size_t pos;
+
+  bool active;
+  bool pending;            // record decoded but not yet sent
+  hid_timeline_record_t record;
+  uint64_t due_us;         // absolute time the pending record is due
+
+  // Integrity, digests is NULL when not verifying
+  uint8_t const (*digests)[HID_SHA256_LEN];
+  size_t block_size;
+  size_t verified;         // data before this offset matched its digest
+  size_t hashed;           // bytes of the current block fed to sha
+  hid_sha256_t sha;
+  bool corrupt;
+
+  // Statistics
+  uint32_t sent;
+  uint32_t max_late_us;    // worst lateness of a report vs its due time
+  uint32_t verify_us;      // time spent hashing
+} hid_timeline_player_t;
+
+/**
+ * @brief Returns the payload length for a report ID, 0 if the ID is unknown.
+ */
+uint8_t hid_timeline_report_len(uint8_t report_id);
+
+/**
+ * @brief Decodes the record at *pos and advances *pos past it.
+ *
+ * @return false on end of data, truncated record or unknown report ID.
+ */
+bool hid_timeline_next(uint8_t const *data, size_t len, size_t *pos,
+                       hid_timeline_record_t *record);
+
+/**
+ * @brief Validates the header and arms the player; the first record is due
+ *        delta_us after now_us.
+ */
+bool hid_timeline_start(hid_timeline_player_t *player, uint8_t const *data,
+                        size_t len, uint64_t now_us);
+
+/**
+ * @brief Checks the timeline against one SHA-256 digest per block_size bytes
+ *        while it plays. Call right after hid_timeline_start().
+ */
+void hid_timeline_verify(hid_timeline_player_t *player,
+                         uint8_t const (*digests)[HID_SHA256_LEN],
+                         size_t block_size);
+
+/**
+ * @brief Sends every record that is due at now_us. Call it on every main loop
+ *        iteration, not from the 10 ms hid_task tick, to keep µs precision.
+ *
+ * @return true while the timeline is still playing, false once it ended or
+ *         a block failed verification (player->corrupt).
+ */
+bool hid_timeline_task(hid_timeline_player_t *player, uint64_t now_us);
+
+#endif /* HID_TIMELINE_H_ */
@@ -0,0 +1,631 @@
+/*
+ * Transmit scheduler for the shared HID IN endpoint.
+ */
+
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "hid_arena.h"
+#include "hid_tx.h"
+#include "usb_descriptors.h"
+
+#if CFG_APP_FREERTOS
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+// Producers, the USB task (completion, SOF) and the transmit task all work on
+// the queues. Reports are only ever submitted from the transmit task.
+static SemaphoreHandle_t lock;
+static TaskHandle_t tx_task_handle;
+
+#define TX_LOCK()   xSemaphoreTakeRecursive(lock, portMAX_DELAY)
+#define TX_UNLOCK() xSemaphoreGiveRecursive(lock)
+#define TX_KICK()   xTaskNotifyGive(tx_task_handle)
+#else
+#define TX_LOCK()   ((void)0)
+#define TX_UNLOCK() ((void)0)
+#define TX_KICK()   hid_tx_task()
+#endif
+
+enum {
+  HOLD_NONE,
+  HOLD_FRAME,
+};
+
+typedef struct {
+  uint32_t enqueued_us;
+  uint32_t deadline_us; // absolute
+  uint32_t tag;
+  uint32_t hold_until;  // frame, with HOLD_FRAME
+  uint8_t hold;
+  bool throttled;       // counted in stats.throttled
+  uint8_t len;
+  uint8_t data[HID_TX_MAX_REPORT];
+} hid_tx_entry_t;
+
+_Static_assert(sizeof(hid_tx_entry_t) <= APP_TX_ENTRY_SIZE,
+               "APP_TX_ENTRY_SIZE too small for hid_tx_entry_t");
+
+// Token bucket, levels are in token-µs so refill is exact to the µs
+#define TOKEN 1000000u
+
+typedef struct {
+  uint32_t rate;  // tokens per second, 0 = unlimited
+  uint32_t burst; // bucket depth in tokens
+  uint64_t level;
+  uint64_t last_us; // 64-bit, a class may be idle longer than time_us_32() wraps
+} hid_tx_bucket_t;
+
+typedef struct {
+  hid_tx_entry_t *entries;
+  uint8_t capacity;
+  uint8_t head;
+  uint8_t count;
+  uint8_t skips; // consecutive picks that went to another class
+  uint8_t report_id;
+
+  hid_tx_class_config_t config;
+  hid_tx_bucket_t bucket;
+  hid_tx_stats_t stats;
+} hid_tx_queue_t;
+
+static hid_tx_queue_t queues[HID_TX_CLASS_COUNT];
+
+static uint8_t const class_report_id[HID_TX_CLASS_COUNT] = {
+    [HID_TX_KEYBOARD] = REPORT_ID_KEYBOARD,
+    [HID_TX_MOUSE] = REPORT_ID_MOUSE,
+    [HID_TX_CONSUMER] = REPORT_ID_CONSUMER_CONTROL,
+    [HID_TX_GAMEPAD] = REPORT_ID_GAMEPAD,
+};
+
+static uint8_t const class_depth[HID_TX_CLASS_COUNT] = {
+    [HID_TX_KEYBOARD] = CFG_APP_TX_DEPTH_KEYBOARD,
+    [HID_TX_MOUSE] = CFG_APP_TX_DEPTH_MOUSE,
+    [HID_TX_CONSUMER] = CFG_APP_TX_DEPTH_CONSUMER,
+    [HID_TX_GAMEPAD] = CFG_APP_TX_DEPTH_GAMEPAD,
+};
+
+// Mouse motion must leave within one polling interval, typing is bulk
+static hid_tx_class_config_t const class_defaults[HID_TX_CLASS_COUNT] = {
+    [HID_TX_KEYBOARD] = {.priority = 3, .deadline_us = 50000},
+    [HID_TX_MOUSE] = {.priority = 0, .deadline_us = 5000},
+    [HID_TX_CONSUMER] = {.priority = 2, .deadline_us = 20000},
+    [HID_TX_GAMEPAD] = {.priority = 1, .deadline_us = 5000},
+};
+
+static uint32_t const class_rate[HID_TX_CLASS_COUNT][2] = {
+    [HID_TX_KEYBOARD] = {CFG_APP_TX_RATE_KEYBOARD, CFG_APP_TX_BURST_KEYBOARD},
+    [HID_TX_MOUSE] = {CFG_APP_TX_RATE_MOUSE, CFG_APP_TX_BURST_MOUSE},
+    [HID_TX_CONSUMER] = {0, 0},
+    [HID_TX_GAMEPAD] = {0, 0},
+};
+
+// Class whose report is on the wire, HID_TX_CLASS_COUNT if none
+static hid_tx_class_t in_flight = HID_TX_CLASS_COUNT;
+static uint32_t in_flight_tag;
+static uint32_t in_flight_us;
+
+// Host polling, learned from report completions. A completion right after a
+// submit that followed the previous completion spans exactly one interval.
+#define BACK_TO_BACK_US 500
+
+static uint32_t poll_interval_us = HID_POLL_INTERVAL * 1000;
+static uint32_t last_poll_us;
+static bool poll_seen;
+
+// Extended SOF frame counter
+static uint32_t frame;
+static uint32_t last_sof;
+
+#if CFG_APP_TX_SOF_SYNC
+// Frame within the polling interval in which the host polls, -1 until known
+static int8_t poll_phase = -1;
+static bool sof_window;
+#endif
+
+static void set_rate(hid_tx_bucket_t *b, uint32_t rate, uint32_t burst) {
+  uint64_t const cap = (uint64_t)(burst ? burst : 1) * TOKEN;
+
+  // A new limit starts with a full bucket, a changed one keeps what is left
+  if (b->rate == 0 || b->level > cap)
+    b->level = cap;
+  b->rate = rate;
+  b->burst = burst ? burst : 1;
+  b->last_us = time_us_64();
+}
+
+#if CFG_APP_FREERTOS
+static void tx_task(void *param) {
+  (void)param;
+
+  while (1) {
+    // Completions and new reports notify. Reports that are held, throttled
+    // or waiting for the bus become sendable without an event, so while any
+    // is queued and the endpoint is idle look again every tick.
+    bool idle_with_queued = false;
+    TX_LOCK();
+    for (int i = 0; i < HID_TX_CLASS_COUNT; i++)
+      idle_with_queued |= queues[i].count != 0;
+    idle_with_queued &= in_flight == HID_TX_CLASS_COUNT;
+    TX_UNLOCK();
+
+    ulTaskNotifyTake(pdTRUE, idle_with_queued ? 1 : portMAX_DELAY);
+    hid_tx_task();
+  }
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Queues
+//--------------------------------------------------------------------+
+
+bool hid_tx_init(void) {
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+    hid_tx_queue_t *q = &queues[i];
+    memset(q, 0, sizeof(*q));
+    q->entries = hid_arena_alloc(class_depth[i] * sizeof(hid_tx_entry_t));
+    if (q->entries == NULL)
+      return false;
+    q->capacity = class_depth[i];
+    q->report_id = class_report_id[i];
+    q->config = class_defaults[i];
+    q->stats.min_wire_us = UINT32_MAX;
+    set_rate(&q->bucket, class_rate[i][0], class_rate[i][1]);
+  }
+  in_flight = HID_TX_CLASS_COUNT;
+  poll_interval_us = HID_POLL_INTERVAL * 1000;
+  poll_seen = false;
+
+#if CFG_APP_FREERTOS
+  lock = xSemaphoreCreateRecursiveMutex();
+  if (lock == NULL)
+    return false;
+  if (xTaskCreate(tx_task, "hid_tx", CFG_APP_RTOS_TX_STACK, NULL,
+                  CFG_APP_RTOS_TX_PRIO, &tx_task_handle) != pdPASS)
+    return false;
+#endif
+  return true;
+}
+
+void hid_tx_set_class_config(hid_tx_class_t cls,
+                             hid_tx_class_config_t const *config) {
+  if (cls >= HID_TX_CLASS_COUNT)
+    return;
+
+  TX_LOCK();
+  queues[cls].config = *config;
+  TX_UNLOCK();
+}
+
+void hid_tx_set_rate(hid_tx_class_t cls, uint32_t rate, uint32_t burst) {
+  if (cls >= HID_TX_CLASS_COUNT)
+    return;
+
+  TX_LOCK();
+  set_rate(&queues[cls].bucket, rate, burst);
+  TX_UNLOCK();
+}
+
+hid_tx_class_t hid_tx_class_of(uint8_t report_id) {
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+    if (class_report_id[i] == report_id)
+      return (hid_tx_class_t)i;
+  }
+  return HID_TX_CLASS_COUNT;
+}
+
+// Whether report a of class ca goes before report b of class cb when picked
+// at time now: starved classes first, then reports that can still make
+// their deadline, the earliest deadline first. Under overload (typing that
+// keeps its queue full) the oldest late reports would otherwise always have
+// the earliest deadline and make every other class late as well, so late
+// ones go last and among themselves by priority.
+static bool HID_HOT_FUNC(goes_before)(hid_tx_class_t ca,
+                                      hid_tx_entry_t const *a,
+                                      uint8_t a_skips, hid_tx_class_t cb,
+                                      hid_tx_entry_t const *b,
+                                      uint8_t b_skips, uint32_t now) {
+  bool const a_starved = a_skips >= CFG_APP_TX_MAX_SKIPS;
+  bool const b_starved = b_skips >= CFG_APP_TX_MAX_SKIPS;
+  if (a_starved != b_starved)
+    return a_starved;
+
+  uint8_t const a_priority = queues[ca].config.priority;
+  uint8_t const b_priority = queues[cb].config.priority;
+  bool const a_late = (int32_t)(now - a->deadline_us) > 0;
+  bool const b_late = (int32_t)(now - b->deadline_us) > 0;
+  if (a_late != b_late)
+    return !a_late;
+  if (a_late && a_priority != b_priority)
+    return a_priority < b_priority;
+
+  int32_t const diff = (int32_t)(a->deadline_us - b->deadline_us);
+  return diff < 0 || (diff == 0 && a_priority < b_priority);
+}
+
+// Estimated time until the report at position ahead of the class queue has
+// reached the host, or with room only until it is submitted. Replays the
+// picks over what is queued now, one report per poll from the next one.
+static uint32_t eta_us(hid_tx_class_t cls, uint8_t ahead, bool room,
+                       uint32_t now) {
+  uint32_t const interval = poll_interval_us;
+  // Until the host has fetched a report its phase is a guess
+  uint32_t next_poll = interval / 2;
+  if (poll_seen)
+    next_poll = (interval - (now - last_poll_us) % interval) % interval;
+
+  // The next poll fetches the report in flight, or else the first pick,
+  // which is submitted at once
+  uint32_t submit = 0;
+  uint32_t fetch = next_poll;
+  if (in_flight != HID_TX_CLASS_COUNT) {
+    submit = fetch;
+    fetch += interval;
+  }
+
+  uint8_t pos[HID_TX_CLASS_COUNT] = {0};
+  uint8_t skips[HID_TX_CLASS_COUNT];
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++)
+    skips[i] = queues[i].skips;
+
+  while (1) {
+    hid_tx_class_t best = HID_TX_CLASS_COUNT;
+    hid_tx_entry_t const *best_e = NULL;
+    for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+      hid_tx_queue_t const *q = &queues[i];
+      if (pos[i] >= q->count)
+        continue;
+      hid_tx_entry_t const *e = &q->entries[(q->head + pos[i]) % q->capacity];
+      if (best == HID_TX_CLASS_COUNT ||
+          goes_before((hid_tx_class_t)i, e, skips[i], best, best_e,
+                      skips[best], now + submit)) {
+        best = (hid_tx_class_t)i;
+        best_e = e;
+      }
+    }
+    if (best == HID_TX_CLASS_COUNT || (best == cls && pos[cls] == ahead))
+      break;
+
+    pos[best]++;
+    for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+      if (i != (int)best && pos[i] < queues[i].count && skips[i] < UINT8_MAX)
+        skips[i]++;
+    }
+    skips[best] = 0;
+    submit = fetch;
+    fetch += interval;
+  }
+  uint32_t eta = room ? submit : fetch;
+
+  // A rate limited class also waits for its tokens
+  hid_tx_bucket_t const *b = &queues[cls].bucket;
+  if (b->rate) {
+    uint64_t const need = (uint64_t)(ahead + 1) * TOKEN;
+    if (b->level < need) {
+      uint64_t const wait = (need - b->level) / b->rate;
+      if (wait > eta)
+        eta = wait > UINT32_MAX ? UINT32_MAX : (uint32_t)wait;
+    }
+  }
+  return eta;
+}
+
+static void status_of(hid_tx_class_t cls, bool queued,
+                      hid_tx_status_t *status) {
+  hid_tx_queue_t const *q = &queues[cls];
+  uint32_t const now = time_us_32();
+
+  status->depth = q->count;
+  if (queued) {
+    status->eta_us = eta_us(cls, q->count - 1, false, now);
+  } else if (q->count) {
+    // Room again once the head has been submitted
+    status->eta_us = eta_us(cls, 0, true, now);
+  } else {
+    status->eta_us = 0;
+  }
+}
+
+static bool HID_HOT_FUNC(enqueue)(hid_tx_class_t cls, void const *report,
+                                  uint8_t len, uint32_t tag, uint8_t hold,
+                                  uint32_t hold_until,
+                                  hid_tx_status_t *status) {
+  if (cls >= HID_TX_CLASS_COUNT || len > HID_TX_MAX_REPORT)
+    return false;
+
+  TX_LOCK();
+  hid_tx_queue_t *q = &queues[cls];
+  if (q->count >= q->capacity) {
+    q->stats.dropped++;
+    if (status)
+      status_of(cls, false, status);
+    TX_UNLOCK();
+    return false;
+  }
+
+  hid_tx_entry_t *e = &q->entries[(q->head + q->count) % q->capacity];
+  e->enqueued_us = time_us_32();
+  e->deadline_us = e->enqueued_us + q->config.deadline_us;
+  e->tag = tag;
+  e->hold = hold;
+  e->hold_until = hold_until;
+  e->throttled = false;
+  e->len = len;
+  memcpy(e->data, report, len);
+  q->count++;
+  // Before the kick below may already submit it
+  if (status)
+    status_of(cls, true, status);
+  TX_UNLOCK();
+
+  // Go out right away if the endpoint is idle
+  TX_KICK();
+  return true;
+}
+
+bool HID_HOT_FUNC(hid_tx_send)(hid_tx_class_t cls, void const *report,
+                               uint8_t len, uint32_t tag) {
+  return enqueue(cls, report, len, tag, HOLD_NONE, 0, NULL);
+}
+
+bool HID_HOT_FUNC(hid_tx_send_at_frame)(hid_tx_class_t cls,
+                                        void const *report, uint8_t len,
+                                        uint32_t tag, uint32_t at_frame) {
+  return enqueue(cls, report, len, tag, HOLD_FRAME, at_frame, NULL);
+}
+
+bool hid_tx_send_ex(hid_tx_class_t cls, void const *report, uint8_t len,
+                    uint32_t tag, uint32_t timeout_us,
+                    hid_tx_status_t *status) {
+  if (cls >= HID_TX_CLASS_COUNT || len > HID_TX_MAX_REPORT)
+    return false;
+
+  uint32_t const start_us = time_us_32();
+  while (1) {
+    bool const last_try = time_us_32() - start_us >= timeout_us;
+    TX_LOCK();
+    // A full queue only counts as a drop once the wait is over
+    bool const room = queues[cls].count < queues[cls].capacity;
+    if (room || last_try) {
+      bool const queued = enqueue(cls, report, len, tag, HOLD_NONE, 0, status);
+      TX_UNLOCK();
+      return queued;
+    }
+    if (status)
+      status_of(cls, false, status);
+    TX_UNLOCK();
+
+#if CFG_APP_FREERTOS
+    vTaskDelay(1);
+#else
+    // Nothing else runs while we wait, keep the bus going
+    tud_task();
+    hid_tx_task();
+#endif
+  }
+}
+
+uint32_t hid_tx_poll_interval_us(void) { return poll_interval_us; }
+
+uint32_t hid_tx_frame(void) { return frame; }
+
+uint8_t hid_tx_queued(hid_tx_class_t cls) {
+  return cls < HID_TX_CLASS_COUNT ? queues[cls].count : 0;
+}
+
+bool hid_tx_idle(hid_tx_class_t cls) {
+  if (cls >= HID_TX_CLASS_COUNT)
+    return true;
+
+  TX_LOCK();
+  bool const idle = queues[cls].count == 0 && in_flight != cls;
+  TX_UNLOCK();
+  return idle;
+}
+
+void hid_tx_get_stats(hid_tx_class_t cls, hid_tx_stats_t *stats) {
+  if (cls >= HID_TX_CLASS_COUNT)
+    return;
+
+  TX_LOCK();
+  *stats = queues[cls].stats;
+  TX_UNLOCK();
+}
+
+void hid_tx_flush(void) {
+  TX_LOCK();
+
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+    queues[i].stats.flushed += queues[i].count + (in_flight == i);
+    queues[i].head = 0;
+    queues[i].count = 0;
+    queues[i].skips = 0;
+  }
+  in_flight = HID_TX_CLASS_COUNT;
+  poll_seen = false;
+
+#if CFG_APP_TX_SOF_SYNC
+  // The next host may poll in a different phase
+  poll_phase = -1;
+#endif
+  TX_UNLOCK();
+}
+
+//--------------------------------------------------------------------+
+// Scheduler
+//--------------------------------------------------------------------+
+
+// Returns true if the class may send a report now
+static bool HID_HOT_FUNC(bucket_has_token)(hid_tx_bucket_t *b) {
+  if (b->rate == 0)
+    return true;
+
+  // Past the time an empty bucket takes to fill it is full, which also
+  // keeps elapsed * rate in range
+  uint64_t const cap = (uint64_t)b->burst * TOKEN;
+  uint64_t const now = time_us_64();
+  uint64_t const elapsed = now - b->last_us;
+  if (elapsed >= cap / b->rate)
+    b->level = cap;
+  else if ((b->level += elapsed * b->rate) > cap)
+    b->level = cap;
+  b->last_us = now;
+
+  return b->level >= TOKEN;
+}
+
+// Earliest deadline first, priority on ties, starved classes first of all.
+// Classes without a token are not eligible, eligible ones are flagged in
+// *eligible.
+static hid_tx_class_t HID_HOT_FUNC(pick_next)(uint32_t now,
+                                              uint8_t *eligible) {
+  hid_tx_class_t best = HID_TX_CLASS_COUNT;
+  *eligible = 0;
+
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+    hid_tx_queue_t *q = &queues[i];
+    if (q->count == 0)
+      continue;
+    hid_tx_entry_t *head = &q->entries[q->head];
+    if (head->hold == HOLD_FRAME && (int32_t)(frame - head->hold_until) < 0)
+      continue;
+    if (!bucket_has_token(&q->bucket)) {
+      // Once per report, however often it is looked at while waiting
+      if (!head->throttled) {
+        head->throttled = true;
+        q->stats.throttled++;
+      }
+      continue;
+    }
+    *eligible |= (uint8_t)(1u << i);
+    if (best == HID_TX_CLASS_COUNT) {
+      best = (hid_tx_class_t)i;
+      continue;
+    }
+
+    hid_tx_queue_t const *b = &queues[best];
+    if (goes_before((hid_tx_class_t)i, head, q->skips, best,
+                    &b->entries[b->head], b->skips, now))
+      best = (hid_tx_class_t)i;
+  }
+
+  return best;
+}
+
+static void HID_HOT_FUNC(submit)(void) {
+  if (in_flight != HID_TX_CLASS_COUNT || !tud_hid_ready())
+    return;
+
+#if CFG_APP_TX_SOF_SYNC
+  // Outside the window the report would idle on the endpoint for a random
+  // part of the interval
+  if (poll_phase >= 0 && !sof_window)
+    return;
+#endif
+
+  uint32_t const now = time_us_32();
+  uint8_t eligible;
+  hid_tx_class_t const cls = pick_next(now, &eligible);
+  if (cls == HID_TX_CLASS_COUNT)
+    return;
+
+  hid_tx_queue_t *q = &queues[cls];
+  hid_tx_entry_t const *e = &q->entries[q->head];
+  if (!tud_hid_report(q->report_id, e->data, e->len))
+    return;
+
+  if (q->bucket.rate)
+    q->bucket.level -= TOKEN;
+
+  uint32_t const latency = now - e->enqueued_us;
+  q->stats.sent++;
+  q->stats.sum_latency_us += latency;
+  if (latency > q->stats.max_latency_us)
+    q->stats.max_latency_us = latency;
+  if ((int32_t)(now - e->deadline_us) > 0)
+    q->stats.missed++;
+
+  in_flight = cls;
+  in_flight_tag = e->tag;
+  in_flight_us = now;
+  q->head = (uint8_t)((q->head + 1) % q->capacity);
+  q->count--;
+
+  // Age everyone who could have gone instead, waiting for a token is not
+  // starvation
+  q->skips = 0;
+  for (int i = 0; i < HID_TX_CLASS_COUNT; i++) {
+    if (i != (int)cls && (eligible & (1u << i)) && queues[i].skips < UINT8_MAX)
+      queues[i].skips++;
+  }
+}
+
+void HID_HOT_FUNC(hid_tx_task)(void) {
+  TX_LOCK();
+  submit();
+#if CFG_APP_TX_SOF_SYNC
+  // The window is only the first attempt after the SOF
+  sof_window = false;
+#endif
+  TX_UNLOCK();
+}
+
+uint32_t HID_HOT_FUNC(hid_tx_complete)(void) {
+  TX_LOCK();
+  if (in_flight == HID_TX_CLASS_COUNT) {
+    TX_UNLOCK();
+    return 0;
+  }
+
+  hid_tx_queue_t *q = &queues[in_flight];
+  uint32_t const now = time_us_32();
+  uint32_t const wire = now - in_flight_us;
+  if (wire < q->stats.min_wire_us)
+    q->stats.min_wire_us = wire;
+  if (wire > q->stats.max_wire_us)
+    q->stats.max_wire_us = wire;
+
+  // Only back-to-back reports show the interval, a report submitted to an
+  // idle endpoint waits a random part of it. Gaps of several intervals
+  // (NAKed polls) are not samples.
+  if (poll_seen && in_flight_us - last_poll_us < BACK_TO_BACK_US) {
+    uint32_t const sample = now - last_poll_us;
+    if (sample < 2 * poll_interval_us)
+      poll_interval_us = poll_interval_us - poll_interval_us / 8 + sample / 8;
+  }
+  last_poll_us = now;
+  poll_seen = true;
+
+#if CFG_APP_TX_SOF_SYNC
+  // The host polled in this frame, submit in the same phase from now on
+  poll_phase = (int8_t)(frame % HID_POLL_INTERVAL);
+#endif
+
+  uint32_t const tag = in_flight_tag;
+  in_flight = HID_TX_CLASS_COUNT;
+  TX_UNLOCK();
+
+  TX_KICK();
+  return tag;
+}
+
+void HID_HOT_FUNC(hid_tx_sof)(uint32_t frame_count) {
+  TX_LOCK();
+  // frame_count is the 11-bit bus frame number
+  frame += (frame_count - last_sof) & 0x7ff;
+  last_sof = frame_count;
+
+#if CFG_APP_TX_SOF_SYNC
+  bool const window =
+      poll_phase >= 0 && (frame % HID_POLL_INTERVAL) == (uint32_t)poll_phase;
+  if (window)
+    sof_window = true;
+#endif
+  TX_UNLOCK();
+
+#if CFG_APP_TX_SOF_SYNC
+  if (window)
+    TX_KICK();
+#endif
+}
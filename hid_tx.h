@@ -0,0 +1,187 @@
+/*
+ * Transmit scheduler for the shared HID IN endpoint.
+ *
+ * Producers queue reports per class instead of calling tud_hid_report()
+ * directly. Whenever the endpoint is free (main loop or report completion)
+ * the scheduler submits the queue head with the earliest deadline, so a long
+ * typing run cannot hold back mouse motion. Ties go to the class with the
+ * higher priority (lower number), and a class that has been passed over
+ * CFG_APP_TX_MAX_SKIPS times in a row is sent next regardless. Heads that
+ * already missed their deadline go last, ordered by priority, so a class
+ * producing faster than the bus cannot make the others late too.
+ *
+ * Each class can also be rate limited by a token bucket: a report needs a
+ * token, tokens refill at `rate` per second up to `burst`. A class without a
+ * token is simply not eligible, so throttled typing never blocks the mouse.
+ *
+ * With CFG_APP_TX_SOF_SYNC the scheduler learns in which frame of the
+ * polling interval the host issues its IN token (from report completions)
+ * and only submits right after that frame's SOF. Every report then waits the
+ * same, minimal time on the endpoint instead of a random part of the
+ * interval. Reports can also be held until a given frame number. The SOF
+ * callback is enabled on every mount (tud_mount_cb), as a bus reset
+ * disables it.
+ *
+ * The host polls the endpoint at a fixed interval, which the scheduler
+ * measures from back-to-back report completions. hid_tx_send_ex() uses it to
+ * tell a producer how long its report will take to leave, and can wait for
+ * queue space up to a deadline instead of failing at once. The estimate
+ * counts what is queued at the time; reports of other classes queued later
+ * with earlier deadlines still go first and delay it.
+ */
+
+#ifndef HID_TX_H_
+#define HID_TX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Functions on the report path are placed in SRAM with CFG_APP_RAM_HOT_PATH,
+// where a cold XIP cache line cannot delay them
+#if CFG_APP_RAM_HOT_PATH
+#include "pico/platform.h"
+#define HID_HOT_FUNC(func) __not_in_flash_func(func)
+#else
+#define HID_HOT_FUNC(func) func
+#endif
+
+typedef enum {
+  HID_TX_KEYBOARD,
+  HID_TX_MOUSE,
+  HID_TX_CONSUMER,
+  HID_TX_GAMEPAD,
+  HID_TX_CLASS_COUNT
+} hid_tx_class_t;
+
+// Largest report payload (gamepad), excluding the report ID
+#define HID_TX_MAX_REPORT 11
+
+typedef struct {
+  uint8_t priority;     // 0 is highest, breaks deadline ties
+  uint32_t deadline_us; // relative to enqueue time
+} hid_tx_class_config_t;
+
+// Backpressure feedback of hid_tx_send_ex()
+typedef struct {
+  uint8_t depth;   // reports queued in the class, including this one
+  uint32_t eta_us; // until the host has fetched it; if it was not queued,
+                   // until the class has room again
+} hid_tx_status_t;
+
+typedef struct {
+  uint32_t sent;
+  uint32_t dropped;        // rejected because the queue was full
+  uint32_t flushed;        // queued or in flight at hid_tx_flush()
+  uint32_t throttled;      // reports that had to wait for a token
+  uint32_t missed;         // submitted after their deadline
+  uint32_t max_latency_us; // enqueue to submit
+  uint64_t sum_latency_us;
+  uint32_t min_wire_us;    // submit to completion, max - min is the jitter
+  uint32_t max_wire_us;
+} hid_tx_stats_t;
+
+/**
+ * @brief Allocates the queues from the arena and applies default class
+ *        priorities and deadlines.
+ *
+ * @return false if the arena is too small.
+ */
+bool hid_tx_init(void);
+
+void hid_tx_set_class_config(hid_tx_class_t cls,
+                             hid_tx_class_config_t const *config);
+
+/**
+ * @brief Limits a class to rate reports per second with bursts of up to
+ *        burst reports. Takes effect immediately; rate 0 removes the limit.
+ *        Note a typed character costs two reports (press and release).
+ */
+void hid_tx_set_rate(hid_tx_class_t cls, uint32_t rate, uint32_t burst);
+
+/**
+ * @brief Maps a report ID to its transmit class.
+ *
+ * @return HID_TX_CLASS_COUNT if the ID is unknown.
+ */
+hid_tx_class_t hid_tx_class_of(uint8_t report_id);
+
+/**
+ * @brief Queues a report for the class.
+ *
+ * @param tag Handed back by hid_tx_complete() once the host has the report,
+ *            0 if the caller does not care.
+ * @return false if the queue is full or len is too large.
+ */
+bool hid_tx_send(hid_tx_class_t cls, void const *report, uint8_t len,
+                 uint32_t tag);
+
+/**
+ * @brief Queues a report and reports the queue state.
+ *
+ * @param timeout_us 0 to fail at once if the queue is full, otherwise how
+ *                   long to wait for room. Waiting keeps the USB stack
+ *                   running (super-loop) or sleeps (FreeRTOS), so never wait
+ *                   from a TinyUSB callback.
+ * @param status     Filled in whether or not the report was queued, may be
+ *                   NULL.
+ * @return false if the queue stayed full or len is too large.
+ */
+bool hid_tx_send_ex(hid_tx_class_t cls, void const *report, uint8_t len,
+                    uint32_t tag, uint32_t timeout_us,
+                    hid_tx_status_t *status);
+
+/**
+ * @brief Returns the measured host polling interval of the IN endpoint.
+ */
+uint32_t hid_tx_poll_interval_us(void);
+
+/**
+ * @brief Queues a report that may not be submitted before the given frame
+ *        (see hid_tx_frame()). Frames only advance with CFG_APP_TX_SOF_SYNC.
+ *        Reports behind it in the class queue wait as well, other classes
+ *        go ahead.
+ */
+bool hid_tx_send_at_frame(hid_tx_class_t cls, void const *report, uint8_t len,
+                          uint32_t tag, uint32_t frame);
+
+/**
+ * @brief Returns the number of SOFs seen since init (wraps at 2^32).
+ */
+uint32_t hid_tx_frame(void);
+
+/**
+ * @brief Submits the next report if the endpoint is free.
+ */
+void hid_tx_task(void);
+
+/**
+ * @brief Counts frames and opens the SOF submit window. Call from tud_sof_cb.
+ */
+void hid_tx_sof(uint32_t frame_count);
+
+/**
+ * @brief Retires the report in flight and submits the next one. Call from
+ *        tud_hid_report_complete_cb.
+ *
+ * @return the tag of the completed report, 0 if none.
+ */
+uint32_t hid_tx_complete(void);
+
+/**
+ * @brief Drops every queued and in-flight report, e.g. on unmount.
+ */
+void hid_tx_flush(void);
+
+uint8_t hid_tx_queued(hid_tx_class_t cls);
+
+/**
+ * @brief Returns true once the host has fetched every report of the class:
+ *        none is queued and none is in flight on the endpoint.
+ */
+bool hid_tx_idle(hid_tx_class_t cls);
+
+void hid_tx_get_stats(hid_tx_class_t cls, hid_tx_stats_t *stats);
+
+#endif /* HID_TX_H_ */
@@ -28,49 +28,114 @@
 #include <string.h>
 
 #include "bsp/board_api.h"
+#include "pico/time.h"
 #include "tusb.h"
 
+#include "app_config.h"
+#include "boot_profile.h"
+#include "clock_sync.h"
+#include "hid_arena.h"
+#include "hid_checkpoint.h"
+#include "hid_ducky.h"
+#include "hid_edit.h"
+#include "hid_lanes.h"
+#include "hid_led.h"
+#include "hid_log.h"
+#include "hid_text.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
 #include "usb_descriptors.h"
 
+#if CFG_APP_WATCHDOG_MS
+#include "hardware/watchdog.h"
+#endif
+
+#if CFG_APP_LOOP_BENCH
+#include "hardware/xip_cache.h"
+#endif
+
+#if CFG_APP_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if CFG_APP_LOOP_BENCH
+#error "CFG_APP_LOOP_BENCH measures the super-loop, not available with FreeRTOS"
+#endif
+#if CFG_APP_KEYBOARD_LANES
+#error "keyboard lanes share state between the completion callback and the main loop, super-loop only"
+#endif
+#endif
+
+#if CFG_APP_EDIT && CFG_APP_KEYBOARD_LANES
+#error "CFG_APP_EDIT and CFG_APP_KEYBOARD_LANES both type the demo text, pick one"
+#endif
+
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
 //--------------------------------------------------------------------+
 
-/* Blink pattern
- * - 250 ms  : device not mounted
- * - 1000 ms : device mounted
- * - 2500 ms : device is suspended
- */
+// Error codes blinked by the status LED (HID_LED_ERROR)
 enum {
-  BLINK_NOT_MOUNTED = 250,
-  BLINK_MOUNTED = 1000,
-  BLINK_SUSPENDED = 2500,
+  LED_ERROR_PAYLOAD_CORRUPT = 1,
+  LED_ERROR_SCRIPT = 2,
 };
 
-static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
+// What the status LED shows once mounted, see led_pattern()
+static uint8_t led_error = 0;
+static bool caps_lock = false;
+
+// Set by the first keyboard LED report after mount, i.e. once the host has
+// bound its keyboard driver
+static bool host_ready = false;
+static uint32_t mount_us = 0;
+static bool first_report_pending = false;
 
-void led_blinking_task(void);
 void hid_task(void);
+#if CFG_APP_LOOP_BENCH
+void loop_bench_task(uint32_t loop_us);
+#endif
+
+#if CFG_APP_REPLAY
+// Recorded session, generated by tools/evdev_to_timeline.py
+extern const uint8_t replay_timeline[];
+extern const size_t replay_timeline_len;
+#if CFG_APP_REPLAY_VERIFY
+extern const uint8_t replay_timeline_digests[][HID_SHA256_LEN];
+extern const size_t replay_timeline_block_size;
+#endif
+
+static hid_timeline_player_t replay_player;
+#endif
+
+#if CFG_APP_DUCKY
+// DuckyScript payload, generated from DUCKY_SCRIPT by CMake
+extern const char ducky_script[];
+extern const size_t ducky_script_len;
+#endif
 
 //--------------------------------------------------------------------+
 // HELPER FUNCTIONS
 //--------------------------------------------------------------------+
 
 /**
- * @brief Sends a keyboard report if the device is ready.
+ * @brief Queues a keyboard report on the transmit scheduler.
  *
- * @param report_id The report ID (e.g., REPORT_ID_KEYBOARD).
  * @param modifier  Modifier keys (e.g., KEYBOARD_MODIFIER_LEFTSHIFT).
- * @param keycode   Array of 6 keycodes.
- * @return true if report sent, false otherwise (not mounted/ready).
+ * @param keycode   Array of 6 keycodes, NULL for none.
+ * @param tag       Handed back once the host has the report, 0 for none.
+ * @param status    Queue depth and ETA of the report, may be NULL.
+ * @return true if report queued, false otherwise (queue full).
  */
-bool send_keyboard_report(uint8_t report_id, uint8_t modifier,
-                          uint8_t keycode[6]) {
-  // Skip if hid is not ready yet
-  if (!tud_hid_ready())
-    return false;
-
-  return tud_hid_keyboard_report(report_id, modifier, keycode);
+bool HID_HOT_FUNC(send_keyboard_report)(uint8_t modifier,
+                                        uint8_t const keycode[6],
+                                        uint32_t tag,
+                                        hid_tx_status_t *status) {
+  hid_keyboard_report_t report = {.modifier = modifier};
+  if (keycode)
+    memcpy(report.keycode, keycode, sizeof(report.keycode));
+
+  return hid_tx_send_ex(HID_TX_KEYBOARD, &report, sizeof(report), tag, 0,
+                        status);
 }
 
 /**
@@ -78,82 +143,218 @@ bool send_keyboard_report(uint8_t report_id, uint8_t modifier,
  *        Note: This sends the state where the key IS pressed.
  *        You must send a key release report afterwards to "release" the key.
  */
-bool send_key_press(uint8_t modifier, uint8_t key_code) {
+bool HID_HOT_FUNC(send_key_press)(uint8_t modifier, uint8_t key_code,
+                                  uint32_t tag) {
   uint8_t keycode[6] = {0};
   keycode[0] = key_code;
-  return send_keyboard_report(REPORT_ID_KEYBOARD, modifier, keycode);
+  return send_keyboard_report(modifier, keycode, tag, NULL);
 }
 
 /**
  * @brief Sends an empty keyboard report to release all keys.
  */
-bool send_key_release(void) {
-  return tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
+bool HID_HOT_FUNC(send_key_release)(uint32_t tag) {
+  return send_keyboard_report(0, NULL, tag, NULL);
 }
 
 /**
- * @brief Sends a mouse report if the device is ready.
+ * @brief Queues a mouse report on the transmit scheduler.
  */
-bool send_mouse_move(int8_t x, int8_t y) {
-  // Skip if hid is not ready yet
-  if (!tud_hid_ready())
-    return false;
-
-  return tud_hid_mouse_report(REPORT_ID_MOUSE, 0x00, x, y, 0, 0);
+static bool HID_HOT_FUNC(send_mouse_report)(uint8_t buttons, int8_t x,
+                                            int8_t y) {
+  hid_mouse_report_t report = {.buttons = buttons, .x = x, .y = y};
+  return hid_tx_send(HID_TX_MOUSE, &report, sizeof(report), 0);
 }
 
-bool send_mouse_click(uint8_t buttons) {
-  if (!tud_hid_ready())
-    return false;
-  return tud_hid_mouse_report(REPORT_ID_MOUSE, buttons, 0, 0, 0, 0);
+bool HID_HOT_FUNC(send_mouse_move)(int8_t x, int8_t y) {
+  return send_mouse_report(0x00, x, y);
 }
 
-bool send_mouse_release(void) {
-  if (!tud_hid_ready())
-    return false;
-  return tud_hid_mouse_report(REPORT_ID_MOUSE, 0x00, 0, 0, 0, 0);
+bool HID_HOT_FUNC(send_mouse_click)(uint8_t buttons) {
+  return send_mouse_report(buttons, 0, 0);
 }
 
-/*------------- MAIN -------------*/
-int main(void) {
-  board_init();
+bool HID_HOT_FUNC(send_mouse_release)(void) {
+  return send_mouse_report(0x00, 0, 0);
+}
 
+static void usb_device_init(void) {
   // init device stack on configured roothub port
   tud_init(BOARD_TUD_RHPORT);
+  boot_profile_mark(BOOT_PHASE_TUD_INIT);
 
   if (board_init_after_tusb) {
     board_init_after_tusb();
   }
+  boot_profile_mark(BOOT_PHASE_INIT_AFTER_TUSB);
+}
+
+// Everything in the main loop besides the USB stack and the transmit
+// scheduler
+static void app_poll(void) {
+  hid_led_task();
+  hid_task();
+
+#if CFG_APP_KEYBOARD_LANES
+  hid_lanes_task();
+#endif
+
+#if CFG_APP_REPLAY
+  // Replay runs outside the 10 ms hid_task tick to keep µs timing
+  hid_timeline_task(&replay_player, time_us_64());
+#endif
+
+  // Reports the host scheduled at its time, likewise
+  clock_sync_task();
+}
+
+#if CFG_APP_FREERTOS
+static void usb_device_task(void *param);
+static void app_task(void *param);
+#endif
+
+/*------------- MAIN -------------*/
+int main(void) {
+  boot_profile_start();
+  board_init();
+  boot_profile_mark(BOOT_PHASE_BOARD_INIT);
+  hid_led_init();
+
+  // Buffers must be handed out before any module init
+  hid_arena_init();
+  hid_log_init();
+  hid_checkpoint_init();
+  hid_tx_init();
+  clock_sync_init();
+#if CFG_APP_EDIT
+  hid_edit_init();
+#endif
+#if CFG_APP_DUCKY
+  // Compiled once, hid_task only runs the bytecode
+  if (!hid_ducky_load(ducky_script, ducky_script_len)) {
+    led_error = LED_ERROR_SCRIPT;
+    hid_led_post(HID_LED_PATTERN(HID_LED_ERROR, led_error));
+  }
+#endif
+  boot_profile_mark(BOOT_PHASE_APP_INIT);
+
+#if CFG_APP_FREERTOS
+  // The stack is brought up by its own task once the scheduler runs, the
+  // transmit scheduler task was created by hid_tx_init()
+  xTaskCreate(usb_device_task, "usbd", CFG_APP_RTOS_USBD_STACK, NULL,
+              CFG_APP_RTOS_USBD_PRIO, NULL);
+  xTaskCreate(app_task, "app", CFG_APP_RTOS_APP_STACK, NULL,
+              CFG_APP_RTOS_APP_PRIO, NULL);
+  vTaskStartScheduler();
+  return 0; // not reached
+#else
+  usb_device_init();
+
+#if CFG_APP_WATCHDOG_MS
+  watchdog_enable(CFG_APP_WATCHDOG_MS, true);
+#endif
 
   while (1) {
+#if CFG_APP_LOOP_BENCH
+    // Every iteration starts from a cold cache, so the maximum is the worst
+    // case a flash-resident path can see
+    xip_cache_invalidate_all();
+    uint32_t const loop_start_us = time_us_32();
+#endif
+#if CFG_APP_WATCHDOG_MS
+    watchdog_update();
+#endif
     tud_task(); // tinyusb device task
-    led_blinking_task();
+    app_poll();
+    hid_tx_task();
 
-    hid_task();
+#if CFG_APP_LOOP_BENCH
+    loop_bench_task(time_us_32() - loop_start_us);
+#endif
   }
+#endif
 }
 
+#if CFG_APP_FREERTOS
+//--------------------------------------------------------------------+
+// FreeRTOS tasks
+//--------------------------------------------------------------------+
+
+// tud_task() blocks on the TinyUSB event queue, so this highest priority
+// task only runs when the controller has work for it
+static void usb_device_task(void *param) {
+  (void)param;
+  usb_device_init();
+
+  while (1) {
+    tud_task();
+  }
+}
+
+// Producers. Their reports go into the hid_tx queues, hid_tx's own task
+// submits them as the endpoint frees up instead of anyone polling
+// tud_hid_ready()
+static void app_task(void *param) {
+  (void)param;
+
+#if CFG_APP_WATCHDOG_MS
+  watchdog_enable(CFG_APP_WATCHDOG_MS, true);
+#endif
+
+  while (1) {
+#if CFG_APP_WATCHDOG_MS
+    watchdog_update();
+#endif
+    app_poll();
+    vTaskDelay(1);
+  }
+}
+#endif
+
 //--------------------------------------------------------------------+
 // Device callbacks
 //--------------------------------------------------------------------+
 
 // Invoked when device is mounted
-void tud_mount_cb(void) { blink_interval_ms = BLINK_MOUNTED; }
+void tud_mount_cb(void) {
+  boot_profile_mark(BOOT_PHASE_MOUNT);
+  boot_profile_report();
+  HID_LOG("usb: mounted");
+  hid_led_post(HID_LED_PATTERN(HID_LED_MOUNTED, 0));
+  caps_lock = false;
+  host_ready = false;
+  mount_us = time_us_32();
+  first_report_pending = true;
+#if CFG_APP_TX_SOF_SYNC
+  // Every bus reset turns the SOF callback off again
+  tud_sof_cb_enable(true);
+#endif
+}
 
 // Invoked when device is unmounted
-void tud_umount_cb(void) { blink_interval_ms = BLINK_NOT_MOUNTED; }
+void tud_umount_cb(void) {
+  HID_LOG("usb: unmounted");
+  hid_led_post(HID_LED_PATTERN(HID_LED_NOT_MOUNTED, 0));
+}
 
 // Invoked when usb bus is suspended
 // remote_wakeup_en : if host allow us  to perform remote wakeup
 // Within 7ms, device must draw an average of current less than 2.5 mA from bus
 void tud_suspend_cb(bool remote_wakeup_en) {
-  (void)remote_wakeup_en;
-  blink_interval_ms = BLINK_SUSPENDED;
+  HID_LOG("usb: suspended, remote wakeup %u", remote_wakeup_en);
+  hid_led_post(HID_LED_PATTERN(HID_LED_SUSPENDED, 0));
 }
 
 // Invoked when usb bus is resumed
 void tud_resume_cb(void) {
-  blink_interval_ms = tud_mounted() ? BLINK_MOUNTED : BLINK_NOT_MOUNTED;
+  HID_LOG("usb: resumed");
+  hid_led_post(HID_LED_PATTERN(
+      tud_mounted() ? HID_LED_MOUNTED : HID_LED_NOT_MOUNTED, 0));
+}
+
+// Invoked on every start of frame, once enabled with tud_sof_cb_enable()
+void HID_HOT_FUNC(tud_sof_cb)(uint32_t frame_count) {
+  hid_tx_sof(frame_count);
 }
 
 //--------------------------------------------------------------------+
@@ -173,16 +374,86 @@ typedef enum {
   STATE_CLICK_RELEASE,
   STATE_WAIT_BEFORE_TYPE,
   STATE_TYPE_CHAR,
-  STATE_RELEASE_CHAR,
+  STATE_TYPE_LANES,
+  STATE_TYPE_EDIT,
+  STATE_REPLAY,
+  STATE_DUCKY,
   STATE_DONE
 } app_state_t;
 
 static app_state_t app_state = STATE_IDLE;
 static uint32_t state_start_ms = 0;
 
-// The text to type
-static const char *text_to_type = "Hello World!";
-static int text_index = 0;
+// Position in demo_text_reports, pre-rendered from demo_text
+static size_t text_index = 0;
+
+// Typing reports are tagged with the checkpoint they reach once acknowledged
+#define CHECKPOINT_TAG(state, position) (((uint32_t)(position) << 4) | (state))
+#define CHECKPOINT_TAG_STATE(tag)       ((uint8_t)((tag) & 0x0f))
+#define CHECKPOINT_TAG_POSITION(tag)    ((tag) >> 4)
+
+// Time to wait after mount before typing, so the host does not miss input
+static bool start_delay_elapsed(void) {
+  uint32_t const waited_ms = board_millis() - state_start_ms;
+#if CFG_APP_FAST_START
+  // Not every host sets the LEDs, fall back to a shorter fixed wait
+  return host_ready || waited_ms >= CFG_APP_FAST_START_TIMEOUT_MS;
+#else
+  return waited_ms > CFG_APP_START_DELAY_MS;
+#endif
+}
+
+// Starts the demo text from the beginning, returns the state to continue in
+static app_state_t start_typing(void) {
+  text_index = 0;
+#if CFG_APP_KEYBOARD_LANES
+  // The whole text at once over the lanes, not checkpointed
+  return hid_lanes_type(demo_text) ? STATE_TYPE_LANES : STATE_WAIT_BEFORE_TYPE;
+#elif CFG_APP_EDIT
+  // Only what changed since the last mount, not checkpointed
+  return hid_edit_type(demo_text) ? STATE_TYPE_EDIT : STATE_DONE;
+#else
+  return STATE_TYPE_CHAR;
+#endif
+}
+
+#if !CFG_APP_REPLAY && !CFG_APP_DUCKY
+// Resume typing from the last checkpoint the host acknowledged
+static bool resume_from_checkpoint(void) {
+  hid_checkpoint_t checkpoint;
+  if (!hid_checkpoint_get(&checkpoint))
+    return false;
+
+  if (checkpoint.state != STATE_TYPE_CHAR)
+    return false;
+  if (checkpoint.position > demo_text_reports.count)
+    return false;
+
+  text_index = checkpoint.position;
+  app_state = (app_state_t)checkpoint.state;
+  return true;
+}
+#endif
+
+// Status LED pattern while mounted and awake. A payload flickers the LED,
+// and once reports back up because the host takes them slower than they
+// are produced, its brightness shows how full the keyboard queue is.
+static uint32_t led_pattern(void) {
+  if (led_error)
+    return HID_LED_PATTERN(HID_LED_ERROR, led_error);
+
+  // From the end of the start delay until the host has the last report
+  if ((app_state > STATE_WAIT_INIT && app_state < STATE_DONE) ||
+      !hid_tx_idle(HID_TX_KEYBOARD)) {
+    uint32_t const depth = hid_tx_queued(HID_TX_KEYBOARD);
+    if (depth > 1)
+      return HID_LED_PATTERN(HID_LED_LEVEL,
+                             depth * 255 / CFG_APP_TX_DEPTH_KEYBOARD);
+    return HID_LED_PATTERN(HID_LED_BUSY, 0);
+  }
+
+  return HID_LED_PATTERN(caps_lock ? HID_LED_ON : HID_LED_MOUNTED, 0);
+}
 
 void hid_task(void) {
   // Poll every 10ms
@@ -194,7 +465,22 @@ void hid_task(void) {
   start_ms += interval_ms;
 
   if (!tud_mounted()) {
+    // Queued reports were lost with the bus, the next mount resumes from
+    // the last acknowledged checkpoint
+    hid_tx_flush();
+#if CFG_APP_KEYBOARD_LANES
+    hid_lanes_flush();
+#endif
     app_state = STATE_IDLE;
+#if CFG_APP_REPLAY
+    replay_player.active = false;
+#endif
+#if CFG_APP_DUCKY
+    hid_ducky_stop();
+#endif
+#if CFG_APP_EDIT
+    hid_edit_abort();
+#endif
     return;
   }
 
@@ -204,9 +490,8 @@ void hid_task(void) {
     return;
   }
 
-  // Skip if hid is not ready yet
-  if (!tud_hid_ready())
-    return;
+  // Posting the pattern shown already does not restart it
+  hid_led_post(led_pattern());
 
   switch (app_state) {
   case STATE_IDLE:
@@ -216,8 +501,26 @@ void hid_task(void) {
     break;
 
   case STATE_WAIT_INIT:
-    if (board_millis() - state_start_ms > 2000) { // Wait 2 seconds
-      app_state = STATE_WAIT_BEFORE_TYPE;
+    if (start_delay_elapsed()) {
+#if CFG_APP_REPLAY
+      app_state = hid_timeline_start(&replay_player, replay_timeline,
+                                     replay_timeline_len, time_us_64())
+                      ? STATE_REPLAY
+                      : STATE_DONE;
+#if CFG_APP_REPLAY_VERIFY
+      hid_timeline_verify(&replay_player, replay_timeline_digests,
+                          replay_timeline_block_size);
+#endif
+#elif CFG_APP_DUCKY
+      // Not checkpointed, a new mount runs the script from the start
+      app_state = hid_ducky_start(board_millis()) ? STATE_DUCKY : STATE_DONE;
+#else
+      // The start delay is wait enough, the pause of STATE_WAIT_BEFORE_TYPE
+      // would cost a fast start 500 ms
+      if (!resume_from_checkpoint()) {
+        app_state = start_typing();
+      }
+#endif
     }
     break;
 
@@ -248,43 +551,64 @@ void hid_task(void) {
 
   case STATE_WAIT_BEFORE_TYPE:
     if (board_millis() - state_start_ms > 500) {
-      text_index = 0;
-      app_state = STATE_TYPE_CHAR;
+      app_state = start_typing();
     }
     break;
 
   case STATE_TYPE_CHAR: {
-    char c = text_to_type[text_index];
-    if (c == 0) {
+    // Presses and releases are already in the stream, just walk it
+    if (text_index >= demo_text_reports.count) {
       app_state = STATE_DONE;
       break;
     }
 
-    uint8_t key = 0;
-    uint8_t modifier = 0;
-
-    if (c >= 'a' && c <= 'z') {
-      key = HID_KEY_A + (c - 'a');
-    } else if (c >= 'A' && c <= 'Z') {
-      key = HID_KEY_A + (c - 'A');
-      modifier = KEYBOARD_MODIFIER_LEFTSHIFT;
-    } else if (c == ' ') {
-      key = HID_KEY_SPACE;
-    } else if (c == '!') {
-      key = HID_KEY_1;
-      modifier = KEYBOARD_MODIFIER_LEFTSHIFT;
+    // Enough to keep the endpoint busy until the next tick, no more: what
+    // is queued is typed again after a reset
+    while (text_index < demo_text_reports.count) {
+      hid_text_report_t const *r = &demo_text_reports.reports[text_index];
+      hid_tx_status_t status;
+      if (!send_keyboard_report(r->modifier, r->keycode,
+                                CHECKPOINT_TAG(STATE_TYPE_CHAR, text_index + 1),
+                                &status))
+        break;
+      text_index++;
+      if (status.eta_us >= interval_ms * 1000)
+        break;
     }
+  } break;
 
-    if (send_key_press(modifier, key)) {
-      app_state = STATE_RELEASE_CHAR;
+  case STATE_TYPE_LANES:
+#if CFG_APP_KEYBOARD_LANES
+    if (!hid_lanes_busy()) {
+      app_state = STATE_DONE;
     }
-  } break;
+#endif
+    break;
 
-  case STATE_RELEASE_CHAR:
-    if (send_key_release()) {
-      text_index++;
-      app_state = STATE_TYPE_CHAR;
+  case STATE_TYPE_EDIT:
+#if CFG_APP_EDIT
+    if (!hid_edit_task()) {
+      app_state = STATE_DONE;
+    }
+#endif
+    break;
+
+  case STATE_REPLAY:
+#if CFG_APP_REPLAY
+    if (!replay_player.active) {
+      if (replay_player.corrupt)
+        led_error = LED_ERROR_PAYLOAD_CORRUPT;
+      app_state = STATE_DONE;
+    }
+#endif
+    break;
+
+  case STATE_DUCKY:
+#if CFG_APP_DUCKY
+    if (!hid_ducky_task(board_millis())) {
+      app_state = STATE_DONE;
     }
+#endif
     break;
 
   case STATE_DONE:
@@ -294,11 +618,36 @@ void hid_task(void) {
 }
 
 // Invoked when sent REPORT successfully to host
-void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report,
-                                uint16_t len) {
-  (void)instance;
+void HID_HOT_FUNC(tud_hid_report_complete_cb)(uint8_t instance,
+                                              uint8_t const *report,
+                                              uint16_t len) {
   (void)len;
   (void)report;
+
+#if CFG_APP_KEYBOARD_LANES
+  if (instance > 0) {
+    hid_lanes_complete(instance - 1);
+    return;
+  }
+#else
+  (void)instance;
+#endif
+
+  if (first_report_pending) {
+    first_report_pending = false;
+    HID_LOG("usb: first report %u us after mount", time_us_32() - mount_us);
+  }
+
+  // The host has the report, execution may now resume past it
+  uint32_t const tag = hid_tx_complete();
+  if (tag) {
+    // Past the last report the text is done, the next run starts over
+    if (CHECKPOINT_TAG_POSITION(tag) >= demo_text_reports.count)
+      hid_checkpoint_clear();
+    else
+      hid_checkpoint_commit(CHECKPOINT_TAG_STATE(tag),
+                            CHECKPOINT_TAG_POSITION(tag));
+  }
 }
 
 // Invoked when received GET_REPORT control request
@@ -306,11 +655,31 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id,
                                hid_report_type_t report_type, uint8_t *buffer,
                                uint16_t reqlen) {
   (void)instance;
-  (void)report_id;
-  (void)report_type;
-  (void)buffer;
-  (void)reqlen;
 
+  if (buffer == NULL)
+    return 0;
+
+  if (report_type == HID_REPORT_TYPE_FEATURE &&
+      report_id == REPORT_ID_CLOCK_SYNC) {
+    return clock_sync_get_report(buffer, reqlen);
+  }
+
+  if (report_type == HID_REPORT_TYPE_FEATURE &&
+      report_id == REPORT_ID_TELEMETRY) {
+    // Word count, then that many little endian log words
+    if (reqlen < 1)
+      return 0;
+    uint32_t words[VENDOR_FEATURE_LEN / 4];
+    uint16_t max = (uint16_t)((reqlen - 1) / 4);
+    if (max > TU_ARRAY_SIZE(words))
+      max = TU_ARRAY_SIZE(words);
+    uint16_t const count = hid_log_read(words, max);
+    buffer[0] = (uint8_t)count;
+    memcpy(&buffer[1], words, count * sizeof(uint32_t));
+    return (uint16_t)(1 + count * sizeof(uint32_t));
+  }
+
+  // Returning 0 makes the stack STALL the request
   return 0;
 }
 
@@ -321,44 +690,53 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
                            uint16_t bufsize) {
   (void)instance;
 
+  // All fields are host controlled, never trust them
+  if (buffer == NULL || bufsize == 0)
+    return;
+
+  if (report_type == HID_REPORT_TYPE_FEATURE &&
+      report_id == REPORT_ID_CLOCK_SYNC) {
+    clock_sync_set_report(buffer, bufsize);
+    return;
+  }
+
   if (report_type == HID_REPORT_TYPE_OUTPUT) {
     // Set keyboard LED e.g Capslock, Numlock etc...
     if (report_id == REPORT_ID_KEYBOARD) {
-      // bufsize should be (at least) 1
-      if (bufsize < 1)
-        return;
 
       uint8_t const kbd_leds = buffer[0];
+      host_ready = true;
 
-      if (kbd_leds & KEYBOARD_LED_CAPSLOCK) {
-        // Capslock On: disable blink, turn led on
-        blink_interval_ms = 0;
-        board_led_write(true);
-      } else {
-        // Caplocks Off: back to normal blink
-        board_led_write(false);
-        blink_interval_ms = BLINK_MOUNTED;
-      }
+      // Capslock On: disable blink, turn led on (unless a payload or an
+      // error has the LED, see led_pattern())
+      caps_lock = kbd_leds & KEYBOARD_LED_CAPSLOCK;
     }
   }
 }
 
+#if CFG_APP_LOOP_BENCH
 //--------------------------------------------------------------------+
-// BLINKING TASK
+// LOOP BENCHMARK
 //--------------------------------------------------------------------+
-void led_blinking_task(void) {
+void loop_bench_task(uint32_t loop_us) {
   static uint32_t start_ms = 0;
-  static bool led_state = false;
+  static uint32_t max_us = 0;
+  static uint32_t sum_us = 0;
+  static uint32_t loops = 0;
 
-  // blink is disabled
-  if (!blink_interval_ms)
-    return;
+  if (loop_us > max_us)
+    max_us = loop_us;
+  sum_us += loop_us;
+  loops++;
 
-  // Blink every interval ms
-  if (board_millis() - start_ms < blink_interval_ms)
-    return; // not enough time
-  start_ms += blink_interval_ms;
+  if (board_millis() - start_ms < 1000)
+    return;
+  start_ms += 1000;
 
-  board_led_write(led_state);
-  led_state = 1 - led_state; // toggle
+  HID_LOG("bench: loop max %u us mean %u us over %u", max_us, sum_us / loops,
+          loops);
+  max_us = 0;
+  sum_us = 0;
+  loops = 0;
 }
+#endif
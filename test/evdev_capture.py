@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Write a synthetic Linux evdev capture for the host tests.
+
+The capture mixes typing, pointer motion at mouse rates (every 1-16 ms), a
+move too large for one report and clicks, with seeded random timing:
+
+    evdev_capture.py session.evdev --seed 1
+"""
+
+import argparse
+import random
+import struct
+
+EV_SYN, EV_KEY, EV_REL = 0x00, 0x01, 0x02
+REL_X, REL_Y = 0x00, 0x01
+BTN_LEFT = 0x110
+KEY_LEFTSHIFT = 42
+# h e l l o
+WORD = [35, 18, 38, 38, 24]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--words", type=int, default=20)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    out = bytearray()
+    t = 1_000_000_000  # µs, arbitrary capture start
+
+    def ev(etype, code, value):
+        out.extend(struct.pack("<qqHHi", t // 1000000, t % 1000000,
+                               etype, code, value))
+
+    def syn():
+        ev(EV_SYN, 0, 0)
+
+    for word in range(args.words):
+        shift = word % 3 == 0
+        if shift:
+            ev(EV_KEY, KEY_LEFTSHIFT, 1)
+            syn()
+            t += rng.randint(20_000, 60_000)
+        for code in WORD:
+            ev(EV_KEY, code, 1)
+            syn()
+            t += rng.randint(30_000, 120_000)
+            ev(EV_KEY, code, 0)
+            syn()
+            t += rng.randint(5_000, 80_000)
+        if shift:
+            ev(EV_KEY, KEY_LEFTSHIFT, 0)
+            syn()
+            t += rng.randint(20_000, 60_000)
+
+        for _ in range(rng.randint(5, 30)):
+            ev(EV_REL, REL_X, rng.randint(-20, 20))
+            ev(EV_REL, REL_Y, rng.randint(-20, 20))
+            syn()
+            t += rng.randint(1_000, 16_000)
+        if word % 5 == 4:
+            ev(EV_REL, REL_X, 300)
+            syn()
+            t += 100_000
+            ev(EV_KEY, BTN_LEFT, 1)
+            syn()
+            t += rng.randint(50_000, 150_000)
+            ev(EV_KEY, BTN_LEFT, 0)
+            syn()
+        t += rng.randint(100_000, 400_000)
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,16 @@
+/*
+ * FreeRTOS configuration of fw_rtos on the kernel's POSIX port (see
+ * test/CMakeLists.txt): the device's, with task stacks big enough to be the
+ * stacks of their threads.
+ */
+
+#ifndef TEST_FREERTOS_CONFIG_H_
+#define TEST_FREERTOS_CONFIG_H_
+
+#include "../../FreeRTOSConfig.h"
+
+// In words of the port's StackType_t, 128 KiB on 64-bit hosts
+#undef configMINIMAL_STACK_SIZE
+#define configMINIMAL_STACK_SIZE ((configSTACK_DEPTH_TYPE)16384)
+
+#endif /* TEST_FREERTOS_CONFIG_H_ */
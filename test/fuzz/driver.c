@@ -0,0 +1,207 @@
+/*
+ * Stand-in for libFuzzer where the compiler has none (GCC): runs
+ * LLVMFuzzerTestOneInput() on every file of the corpus directories, then on
+ * seeded random mutations of them until the time budget is used up. Takes
+ * the libFuzzer options the tests use, so both run the same command line:
+ *
+ *   fuzz_target [-max_total_time=S] [-seed=N] [-max_len=N] corpus_dir...
+ *
+ * No coverage feedback, the sanitizers are the oracle. When one aborts, the
+ * input is written to crash-<target> in the working directory.
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size);
+
+void __sanitizer_set_death_callback(void (*callback)(void))
+    __attribute__((weak));
+
+typedef struct {
+  uint8_t *data;
+  size_t len;
+} input_t;
+
+static input_t *corpus;
+static size_t corpus_count;
+static size_t max_len = 512;
+
+static uint8_t *current;
+static size_t current_len;
+static char const *target = "fuzz";
+
+static uint64_t rng_state;
+
+static uint32_t rnd(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void dump_current(void) {
+  char name[256];
+  snprintf(name, sizeof(name), "crash-%s", target);
+  FILE *f = fopen(name, "wb");
+  if (f) {
+    fwrite(current, 1, current_len, f);
+    fclose(f);
+  }
+  fprintf(stderr, "driver: input of %zu bytes written to %s:", current_len,
+          name);
+  for (size_t i = 0; i < current_len; i++)
+    fprintf(stderr, " %02x", current[i]);
+  fprintf(stderr, "\n");
+}
+
+static void run(uint8_t const *data, size_t len) {
+  // An exact heap copy, so reads past the end are caught
+  free(current);
+  current = malloc(len ? len : 1);
+  memcpy(current, data, len);
+  current_len = len;
+  LLVMFuzzerTestOneInput(current, len);
+}
+
+static void add_input(uint8_t const *data, size_t len) {
+  corpus = realloc(corpus, (corpus_count + 1) * sizeof(input_t));
+  corpus[corpus_count].data = malloc(len ? len : 1);
+  memcpy(corpus[corpus_count].data, data, len);
+  corpus[corpus_count].len = len;
+  corpus_count++;
+}
+
+static void load_dir(char const *path) {
+  DIR *dir = opendir(path);
+  if (!dir)
+    return;
+  struct dirent *e;
+  while ((e = readdir(dir))) {
+    if (e->d_name[0] == '.')
+      continue;
+    char file[4096];
+    snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+    FILE *f = fopen(file, "rb");
+    if (!f)
+      continue;
+    uint8_t *buf = malloc(max_len);
+    size_t const len = fread(buf, 1, max_len, f);
+    fclose(f);
+    add_input(buf, len);
+    free(buf);
+  }
+  closedir(dir);
+}
+
+static size_t mutate(uint8_t *buf, size_t len) {
+  static uint8_t const interesting[] = {0, 1, 2, 0x7f, 0x80, 0xfe, 0xff, 30};
+  int const rounds = 1 + (int)(rnd() % 8);
+  for (int r = 0; r < rounds; r++) {
+    switch (rnd() % 7) {
+    case 0: // flip a bit
+      if (len)
+        buf[rnd() % len] ^= (uint8_t)(1u << (rnd() % 8));
+      break;
+    case 1: // random byte
+      if (len)
+        buf[rnd() % len] = (uint8_t)rnd();
+      break;
+    case 2: // interesting byte
+      if (len)
+        buf[rnd() % len] = interesting[rnd() % sizeof(interesting)];
+      break;
+    case 3: // insert
+      if (len < max_len) {
+        size_t const at = rnd() % (len + 1);
+        memmove(&buf[at + 1], &buf[at], len - at);
+        buf[at] = (uint8_t)rnd();
+        len++;
+      }
+      break;
+    case 4: // erase
+      if (len) {
+        size_t const at = rnd() % len;
+        memmove(&buf[at], &buf[at + 1], len - at - 1);
+        len--;
+      }
+      break;
+    case 5: // truncate
+      if (len)
+        len = rnd() % len;
+      break;
+    case 6: { // splice in part of another input
+      input_t const *o = &corpus[rnd() % corpus_count];
+      if (!o->len)
+        break;
+      size_t const from = rnd() % o->len;
+      size_t n = 1 + rnd() % (o->len - from);
+      size_t const at = len ? rnd() % len : 0;
+      if (at + n > max_len)
+        n = max_len - at;
+      memcpy(&buf[at], &o->data[from], n);
+      if (at + n > len)
+        len = at + n;
+    } break;
+    }
+  }
+  return len;
+}
+
+int main(int argc, char **argv) {
+  double max_time = 10;
+  uint64_t seed = 1;
+
+  target = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+  if (__sanitizer_set_death_callback)
+    __sanitizer_set_death_callback(dump_current);
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-max_total_time=", 16) == 0)
+      max_time = atof(argv[i] + 16);
+    else if (strncmp(argv[i], "-seed=", 6) == 0)
+      seed = strtoull(argv[i] + 6, NULL, 0);
+    else if (strncmp(argv[i], "-max_len=", 9) == 0)
+      max_len = strtoul(argv[i] + 9, NULL, 0);
+  }
+  for (int i = 1; i < argc; i++)
+    if (argv[i][0] != '-')
+      load_dir(argv[i]);
+  if (!corpus_count)
+    add_input(NULL, 0);
+  rng_state = seed ? seed : 1;
+
+  for (size_t i = 0; i < corpus_count; i++)
+    run(corpus[i].data, corpus[i].len);
+
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint8_t *buf = malloc(max_len);
+  uint64_t runs = 0;
+  do {
+    for (int i = 0; i < 256; i++, runs++) {
+      input_t const *in = &corpus[rnd() % corpus_count];
+      size_t len = in->len < max_len ? in->len : max_len;
+      memcpy(buf, in->data, len);
+      len = mutate(buf, len);
+      run(buf, len);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((double)(now.tv_sec - start.tv_sec) +
+               (now.tv_nsec - start.tv_nsec) * 1e-9 <
+           max_time);
+
+  printf("driver: %zu seeds, %llu mutated inputs, no failure\n", corpus_count,
+         (unsigned long long)runs);
+  free(buf);
+  free(current);
+  for (size_t i = 0; i < corpus_count; i++)
+    free(corpus[i].data);
+  free(corpus);
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Common setup of the fuzz targets: the firmware modules as main() brings
+ * them up, on a mounted simulated bus. State carries over between inputs,
+ * as on a device that keeps receiving requests.
+ */
+
+#ifndef TEST_FUZZ_H_
+#define TEST_FUZZ_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock_sync.h"
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "pico/time.h"
+#include "sim.h"
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size);
+
+static inline void fuzz_boot(void) {
+  static int booted;
+  if (booted)
+    return;
+  booted = 1;
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  clock_sync_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+#endif /* TEST_FUZZ_H_ */
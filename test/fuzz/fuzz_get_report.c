@@ -0,0 +1,34 @@
+/*
+ * GET_REPORT requests with any length the host asks for. The first byte
+ * logs that many entries, then each request is
+ *
+ *   instance, report_id, report_type, reqlen (16 bit little endian)
+ *
+ * The answer must fit reqlen and is read in full.
+ */
+
+#include "fuzz.h"
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+  fuzz_boot();
+  if (size < 1)
+    return 0;
+  for (uint8_t i = 0; i < data[0] % 64; i++)
+    HID_LOG("fuzz: entry %u of %u", i, data[0]);
+
+  for (size_t pos = 1; size - pos >= 5; pos += 5) {
+    uint8_t const instance = data[pos] % CFG_TUD_HID;
+    hid_report_type_t const type = (hid_report_type_t)(data[pos + 2] & 3);
+    uint16_t const reqlen = (uint16_t)(data[pos + 3] | data[pos + 4] << 8);
+    uint8_t *buffer = malloc(reqlen ? reqlen : 1);
+    uint16_t const len =
+        sim_get_report(instance, data[pos + 1], type, buffer, reqlen);
+    for (uint16_t i = 0; i < len; i++) {
+      uint8_t volatile b = buffer[i];
+      (void)b;
+    }
+    free(buffer);
+    sim_advance(1000);
+  }
+  return 0;
+}
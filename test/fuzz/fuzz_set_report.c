@@ -0,0 +1,43 @@
+/*
+ * SET_REPORT requests as the host sends them, on any interface, report ID
+ * and type. Each request is
+ *
+ *   instance, report_id, report_type, len, len bytes
+ *
+ * Report type 0 (invalid) stands for a GET_REPORT of len bytes instead, so
+ * clock sync round trips complete. Every request is followed by a few
+ * milliseconds of bus time, so reports scheduled through the clock sync
+ * report go out.
+ */
+
+#include "fuzz.h"
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+  fuzz_boot();
+  size_t pos = 0;
+  while (size - pos >= 4) {
+    uint8_t const instance = data[pos] % CFG_TUD_HID;
+    uint8_t const report_id = data[pos + 1];
+    hid_report_type_t const type = (hid_report_type_t)(data[pos + 2] & 3);
+    size_t len = data[pos + 3];
+    pos += 4;
+    if (type == HID_REPORT_TYPE_INVALID) {
+      uint8_t buffer[255];
+      sim_get_report(instance, report_id, HID_REPORT_TYPE_FEATURE, buffer,
+                     (uint16_t)len);
+      len = 0;
+    }
+    if (len > size - pos)
+      len = size - pos;
+    if (len)
+      sim_set_report(instance, report_id, type, &data[pos], (uint16_t)len);
+    pos += len;
+
+    for (int i = 0; i < 10; i++) {
+      sim_advance(500);
+      clock_sync_task();
+      hid_tx_task();
+    }
+  }
+  return 0;
+}
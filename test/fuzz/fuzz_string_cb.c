@@ -0,0 +1,37 @@
+/*
+ * String descriptor requests for any index and language, with a serial
+ * number of any length from the board:
+ *
+ *   index, langid (16 bit little endian), serial characters...
+ *
+ * A returned descriptor must be well formed and is read in full.
+ */
+
+#include "fuzz.h"
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+  fuzz_boot();
+  if (size < 3)
+    return 0;
+
+  char *serial = malloc(size - 3 + 1);
+  memcpy(serial, &data[3], size - 3);
+  serial[size - 3] = 0;
+  sim.serial = serial;
+
+  uint16_t const *desc =
+      tud_descriptor_string_cb(data[0], (uint16_t)(data[1] | data[2] << 8));
+  if (desc) {
+    uint8_t const bytes = (uint8_t)(desc[0] & 0xff);
+    if ((desc[0] >> 8) != TUSB_DESC_STRING || bytes < 2 || (bytes & 1))
+      abort();
+    for (uint8_t i = 1; i < bytes / 2; i++) {
+      uint16_t volatile c = desc[i];
+      (void)c;
+    }
+  }
+
+  sim.serial = "";
+  free(serial);
+  return 0;
+}
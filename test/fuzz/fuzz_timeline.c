@@ -0,0 +1,20 @@
+/*
+ * Timelines from an untrusted source, decoded and played back.
+ */
+
+#include "fuzz.h"
+#include "hid_timeline.h"
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+  fuzz_boot();
+  hid_tx_flush();
+  hid_timeline_player_t player;
+  if (!hid_timeline_start(&player, data, size, time_us_64()))
+    return 0;
+  // Deltas can be anything, play for a bounded time
+  for (int i = 0; i < 200 && hid_timeline_task(&player, time_us_64()); i++) {
+    sim_advance(1000);
+    hid_tx_task();
+  }
+  return 0;
+}
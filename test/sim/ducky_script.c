@@ -0,0 +1,10 @@
+/*
+ * The DuckyScript payload of CFG_APP_DUCKY=1 builds, which the firmware
+ * build generates from DUCKY_SCRIPT. Tests load their own scripts with
+ * hid_ducky_load().
+ */
+
+#include <stddef.h>
+
+const char ducky_script[] = "STRING sim\n";
+const size_t ducky_script_len = sizeof(ducky_script) - 1;
@@ -0,0 +1,325 @@
+/*
+ * FreeRTOS on the simulated clock (test/stubs/FreeRTOS.h).
+ *
+ * Every task is a thread, but only the one the scheduler picked runs: the
+ * highest priority ready task, until it blocks, yields, or makes a higher
+ * priority task ready. When no task is ready the idle task moves time
+ * forward in steps of sim.loop_us, which runs the bus and its callbacks,
+ * and wakes the tasks whose timeout has come. The callbacks run outside any
+ * task, as interrupts would.
+ *
+ * Left out (SIM_FREERTOS_KERNEL) when fw_rtos runs on the kernel's POSIX
+ * port instead.
+ */
+
+#if !SIM_FREERTOS_KERNEL
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "sim.h"
+#include "task.h"
+
+#define MAX_TASKS   8
+#define MAX_MUTEXES 8
+#define NO_TIMEOUT  UINT64_MAX
+
+struct sim_task {
+  pthread_t thread;
+  TaskFunction_t fn;
+  void *param;
+  char const *name;
+  UBaseType_t priority;
+  bool ready;
+  uint64_t wake_us; // blocked with a timeout until then
+  bool notify_wait;
+  uint32_t notify;
+  struct sim_mutex *mutex_wait;
+};
+
+struct sim_mutex {
+  struct sim_task *owner;
+  bool idle_owned; // taken outside of any task
+  uint32_t count;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static struct sim_task tasks[MAX_TASKS];
+static size_t task_count;
+static struct sim_mutex mutexes[MAX_MUTEXES];
+static size_t mutex_count;
+
+static bool started;
+// The running task, NULL outside of tasks: before the scheduler starts and
+// while the idle task runs the bus
+static struct sim_task *current;
+static unsigned critical;
+static bool yield_pending;
+
+static void fatal(char const *what) {
+  fprintf(stderr, "freertos sim: %s\n", what);
+  abort();
+}
+
+//--------------------------------------------------------------------+
+// Scheduler, all with the lock held
+//--------------------------------------------------------------------+
+
+static void wake(struct sim_task *t) {
+  t->ready = true;
+  t->wake_us = NO_TIMEOUT;
+  t->notify_wait = false;
+  t->mutex_wait = NULL;
+}
+
+static void wake_timed_out(void) {
+  for (size_t i = 0; i < task_count; i++) {
+    if (!tasks[i].ready && tasks[i].wake_us <= sim.now_us)
+      wake(&tasks[i]);
+  }
+}
+
+// Highest priority ready task; among equals the next after the current one
+static struct sim_task *pick(void) {
+  size_t const start = current ? (size_t)(current - tasks) + 1 : 0;
+  struct sim_task *best = NULL;
+  for (size_t n = 0; n < task_count; n++) {
+    struct sim_task *t = &tasks[(start + n) % task_count];
+    if (t->ready && (!best || t->priority > best->priority))
+      best = t;
+  }
+  return best;
+}
+
+// Moves time forward until a task wakes, up to one step
+static void idle(void) {
+  uint64_t next = NO_TIMEOUT;
+  for (size_t i = 0; i < task_count; i++) {
+    if (!tasks[i].ready && tasks[i].wake_us < next)
+      next = tasks[i].wake_us;
+  }
+  uint64_t step = sim.loop_us ? sim.loop_us : 1;
+  if (next > sim.now_us && next - sim.now_us < step)
+    step = next - sim.now_us;
+
+  struct sim_task *const was = current;
+  current = NULL;
+  pthread_mutex_unlock(&lock);
+  sim_advance(step);
+  // The test takes over once time is up, the tasks wait
+  sim_app_yield();
+  pthread_mutex_lock(&lock);
+  current = was;
+  wake_timed_out();
+}
+
+// Hands the CPU to the best ready task and returns once self runs again
+static void reschedule(struct sim_task *self) {
+  wake_timed_out();
+  struct sim_task *next;
+  while ((next = pick()) == NULL)
+    idle();
+  current = next;
+  pthread_cond_broadcast(&cond);
+  while (current != self)
+    pthread_cond_wait(&cond, &lock);
+}
+
+static void block(void) {
+  if (!current)
+    fatal("blocking outside of a task");
+  if (critical)
+    fatal("blocking in a critical section");
+  current->ready = false;
+  reschedule(current);
+}
+
+// t just became ready: a higher priority task runs at once
+static void preempt_for(struct sim_task *t) {
+  if (!current || t->priority <= current->priority)
+    return;
+  if (critical) {
+    yield_pending = true;
+    return;
+  }
+  reschedule(current);
+}
+
+//--------------------------------------------------------------------+
+// Tasks
+//--------------------------------------------------------------------+
+
+static void *task_thread(void *arg) {
+  struct sim_task *const t = arg;
+  pthread_mutex_lock(&lock);
+  while (current != t)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  t->fn(t->param);
+  fatal("a task returned");
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, char const *name,
+                       configSTACK_DEPTH_TYPE stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  (void)stack_depth;
+  pthread_mutex_lock(&lock);
+  if (task_count == MAX_TASKS) {
+    pthread_mutex_unlock(&lock);
+    return pdFAIL;
+  }
+  struct sim_task *const t = &tasks[task_count++];
+  *t = (struct sim_task){.fn = fn, .param = param, .name = name,
+                         .priority = priority};
+  wake(t);
+  if (handle)
+    *handle = t;
+  pthread_create(&t->thread, NULL, task_thread, t);
+  pthread_detach(t->thread);
+  if (started)
+    preempt_for(t);
+  pthread_mutex_unlock(&lock);
+  return pdPASS;
+}
+
+void vTaskStartScheduler(void) {
+  pthread_mutex_lock(&lock);
+  started = true;
+  struct sim_task *const first = pick();
+  if (!first)
+    fatal("no tasks");
+  current = first;
+  pthread_cond_broadcast(&cond);
+  // The thread of main() is done, as on the target
+  while (1)
+    pthread_cond_wait(&cond, &lock);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  pthread_mutex_lock(&lock);
+  if (ticks == 0) {
+    reschedule(current);
+  } else {
+    current->wake_us = (sim.now_us / 1000 + ticks) * 1000;
+    block();
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+TickType_t xTaskGetTickCount(void) { return (TickType_t)(sim.now_us / 1000); }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t) {
+  pthread_mutex_lock(&lock);
+  t->notify++;
+  if (t->notify_wait) {
+    wake(t);
+    preempt_for(t);
+  }
+  pthread_mutex_unlock(&lock);
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+  pthread_mutex_lock(&lock);
+  struct sim_task *const self = current;
+  if (self->notify == 0 && timeout != 0) {
+    self->notify_wait = true;
+    self->wake_us = timeout == portMAX_DELAY
+                        ? NO_TIMEOUT
+                        : (sim.now_us / 1000 + timeout) * 1000;
+    block();
+  }
+  uint32_t const value = self->notify;
+  if (value)
+    self->notify = clear ? 0 : value - 1;
+  pthread_mutex_unlock(&lock);
+  return value;
+}
+
+void sim_task_enter_critical(void) {
+  pthread_mutex_lock(&lock);
+  critical++;
+  pthread_mutex_unlock(&lock);
+}
+
+void sim_task_exit_critical(void) {
+  pthread_mutex_lock(&lock);
+  if (critical == 0)
+    fatal("unbalanced critical section");
+  if (--critical == 0 && yield_pending && current) {
+    yield_pending = false;
+    reschedule(current);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+//--------------------------------------------------------------------+
+// Recursive mutexes
+//--------------------------------------------------------------------+
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+  pthread_mutex_lock(&lock);
+  struct sim_mutex *m = NULL;
+  if (mutex_count < MAX_MUTEXES) {
+    m = &mutexes[mutex_count++];
+    *m = (struct sim_mutex){0};
+  }
+  pthread_mutex_unlock(&lock);
+  return m;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t m, TickType_t timeout) {
+  pthread_mutex_lock(&lock);
+  while (1) {
+    bool const free = m->count == 0;
+    bool const mine = current ? m->owner == current : m->idle_owned;
+    if (free || mine)
+      break;
+    // Tasks never block holding a mutex, so the bus cannot find one taken
+    if (!current)
+      fatal("mutex held by a blocked task");
+    if (timeout == 0) {
+      pthread_mutex_unlock(&lock);
+      return pdFALSE;
+    }
+    current->mutex_wait = m;
+    block();
+  }
+  m->owner = current;
+  m->idle_owned = current == NULL;
+  m->count++;
+  pthread_mutex_unlock(&lock);
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t m) {
+  pthread_mutex_lock(&lock);
+  bool const mine = current ? m->owner == current : m->idle_owned;
+  if (m->count == 0 || !mine)
+    fatal("giving a mutex not held");
+  if (--m->count == 0) {
+    m->owner = NULL;
+    m->idle_owned = false;
+    struct sim_task *best = NULL;
+    for (size_t i = 0; i < task_count; i++) {
+      struct sim_task *t = &tasks[i];
+      if (t->mutex_wait != m)
+        continue;
+      wake(t);
+      if (!best || t->priority > best->priority)
+        best = t;
+    }
+    if (best)
+      preempt_for(best);
+  }
+  pthread_mutex_unlock(&lock);
+  return pdTRUE;
+}
+
+#endif
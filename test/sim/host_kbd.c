@@ -0,0 +1,149 @@
+/*
+ * Host side keyboard model, see host_kbd.h.
+ */
+
+#include <string.h>
+
+#include "host_kbd.h"
+#include "usb_descriptors.h"
+
+#define SHIFT (KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT)
+#define CTRL  (KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_RIGHTCTRL)
+#define ALT   (KEYBOARD_MODIFIER_LEFTALT | KEYBOARD_MODIFIER_RIGHTALT)
+#define GUI   (KEYBOARD_MODIFIER_LEFTGUI | KEYBOARD_MODIFIER_RIGHTGUI)
+
+static uint8_t const ascii_map[128][2] = {HID_ASCII_TO_KEYCODE};
+
+// Character of key with and without Shift
+static char key_char(uint8_t key, bool shift) {
+  if (key == HID_KEY_ENTER)
+    return '\n';
+  if (key == HID_KEY_TAB)
+    return '\t';
+  for (int c = ' '; c < 0x7f; c++)
+    if (ascii_map[c][1] == key && (ascii_map[c][0] != 0) == shift)
+      return (char)c;
+  return 0;
+}
+
+void host_kbd_init(host_kbd_t *kbd) {
+  memset(kbd, 0, sizeof(*kbd));
+  kbd->anchor = -1;
+}
+
+void host_kbd_set_text(host_kbd_t *kbd, char const *text) {
+  size_t len = strlen(text);
+  if (len > HOST_KBD_MAX_TEXT)
+    len = HOST_KBD_MAX_TEXT;
+  memcpy(kbd->text, text, len);
+  kbd->text[len] = 0;
+  kbd->len = (uint16_t)len;
+  kbd->cursor = (uint16_t)len;
+  kbd->anchor = -1;
+}
+
+static void remove_range(host_kbd_t *kbd, uint16_t from, uint16_t to) {
+  memmove(&kbd->text[from], &kbd->text[to], kbd->len - to + 1u);
+  kbd->len = (uint16_t)(kbd->len - (to - from));
+  kbd->cursor = from;
+  kbd->anchor = -1;
+}
+
+static bool delete_selection(host_kbd_t *kbd) {
+  if (kbd->anchor < 0 || kbd->anchor == kbd->cursor) {
+    kbd->anchor = -1;
+    return false;
+  }
+  uint16_t const a = (uint16_t)kbd->anchor;
+  remove_range(kbd, a < kbd->cursor ? a : kbd->cursor,
+               a < kbd->cursor ? kbd->cursor : a);
+  return true;
+}
+
+static void move(host_kbd_t *kbd, uint16_t to, bool select) {
+  if (select && kbd->anchor < 0)
+    kbd->anchor = kbd->cursor;
+  else if (!select)
+    kbd->anchor = -1;
+  kbd->cursor = to;
+}
+
+static void key_down(host_kbd_t *kbd, uint8_t key, uint8_t modifiers) {
+  bool const shift = modifiers & SHIFT;
+  kbd->key_downs++;
+
+  if ((modifiers & CTRL) && key == HID_KEY_A) {
+    kbd->anchor = 0;
+    kbd->cursor = kbd->len;
+    return;
+  }
+
+  switch (key) {
+  case HID_KEY_HOME:
+    move(kbd, 0, shift);
+    return;
+  case HID_KEY_END:
+    move(kbd, kbd->len, shift);
+    return;
+  case HID_KEY_ARROW_LEFT:
+    move(kbd, kbd->cursor ? kbd->cursor - 1 : 0, shift);
+    return;
+  case HID_KEY_ARROW_RIGHT:
+    move(kbd, kbd->cursor < kbd->len ? kbd->cursor + 1 : kbd->len, shift);
+    return;
+  case HID_KEY_BACKSPACE:
+    if (!delete_selection(kbd) && kbd->cursor)
+      remove_range(kbd, kbd->cursor - 1, kbd->cursor);
+    return;
+  case HID_KEY_DELETE:
+    if (!delete_selection(kbd) && kbd->cursor < kbd->len)
+      remove_range(kbd, kbd->cursor, kbd->cursor + 1);
+    return;
+  }
+
+  char const c = key_char(key, shift);
+  // A shortcut goes to the OS, not the field
+  if (!c || (modifiers & (CTRL | ALT | GUI)))
+    return;
+  delete_selection(kbd);
+  if (kbd->len == HOST_KBD_MAX_TEXT)
+    return;
+  memmove(&kbd->text[kbd->cursor + 1], &kbd->text[kbd->cursor],
+          kbd->len - kbd->cursor + 1u);
+  kbd->text[kbd->cursor++] = c;
+  kbd->len++;
+}
+
+void host_kbd_feed(host_kbd_t *kbd, sim_report_t const *report) {
+  uint8_t const *r = report->data;
+  uint8_t const i = report->instance;
+  // The composite interface has report IDs, the lanes have none
+  if (i == 0) {
+    if (report->len != 1 + sizeof(hid_keyboard_report_t) ||
+        r[0] != REPORT_ID_KEYBOARD)
+      return;
+    r++;
+  } else if (report->len != sizeof(hid_keyboard_report_t)) {
+    return;
+  }
+
+  kbd->modifiers[i] = r[0];
+  uint8_t modifiers = 0;
+  for (uint8_t k = 0; k < CFG_TUD_HID; k++)
+    modifiers |= kbd->modifiers[k];
+
+  for (uint8_t k = 0; k < 6; k++) {
+    uint8_t const key = r[2 + k];
+    if (!key || memchr(kbd->keys[i], key, 6))
+      continue;
+    if ((modifiers & SHIFT) != (r[0] & SHIFT))
+      kbd->shift_conflicts++;
+    key_down(kbd, key, modifiers);
+  }
+  memcpy(kbd->keys[i], &r[2], 6);
+}
+
+void host_kbd_feed_all(host_kbd_t *kbd) {
+  for (size_t n = 0; n < sim_report_count; n++)
+    host_kbd_feed(kbd, &sim_reports[n]);
+}
@@ -0,0 +1,53 @@
+/*
+ * Host side keyboard model: turns the logged reports back into text.
+ *
+ * Reports are processed in the order the host received them, endpoint by
+ * endpoint within a frame. Modifiers are merged across all keyboards as an
+ * OS does, a key typed on one keyboard is shifted by a Shift held on another.
+ * A key goes down when it appears in a report without being in the previous
+ * report of the same keyboard. The text goes into a single line edit field
+ * with a cursor and a selection: Home/End, the arrows (with Shift to
+ * select), Backspace, Delete and Ctrl+A work on it. Characters typed with
+ * Ctrl, Alt or GUI held are shortcuts and do not reach the field.
+ */
+
+#ifndef TEST_HOST_KBD_H_
+#define TEST_HOST_KBD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#define HOST_KBD_MAX_TEXT 4096
+
+typedef struct {
+  char text[HOST_KBD_MAX_TEXT + 1];
+  uint16_t len;
+  uint16_t cursor;
+  int32_t anchor; // other end of the selection, -1 for none
+
+  uint8_t keys[CFG_TUD_HID][6];
+  uint8_t modifiers[CFG_TUD_HID];
+  uint32_t key_downs;
+  uint32_t shift_conflicts; // key downs typed under another keyboard's Shift
+} host_kbd_t;
+
+void host_kbd_init(host_kbd_t *kbd);
+
+/**
+ * @brief Feeds one logged report, anything but keyboard reports is ignored.
+ */
+void host_kbd_feed(host_kbd_t *kbd, sim_report_t const *report);
+
+/**
+ * @brief Feeds every logged report, from the first.
+ */
+void host_kbd_feed_all(host_kbd_t *kbd);
+
+/**
+ * @brief Puts text into the field, cursor at its end.
+ */
+void host_kbd_set_text(host_kbd_t *kbd, char const *text);
+
+#endif /* TEST_HOST_KBD_H_ */
@@ -0,0 +1,873 @@
+/*
+ * Host simulation of the device, see sim.h.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "hardware/watchdog.h"
+#include "hardware/xip_cache.h"
+#include "pico/time.h"
+
+#include "sim.h"
+#include "usb_descriptors.h"
+
+#if CFG_APP_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+sim_t sim;
+sim_report_t *sim_reports;
+size_t sim_report_count;
+
+static watchdog_hw_t watchdog_regs;
+watchdog_hw_t *watchdog_hw = &watchdog_regs;
+
+typedef struct {
+  uint64_t time_us;
+  void (*fn)(void *arg);
+  void *arg;
+} event_t;
+
+static event_t events[SIM_MAX_EVENTS];
+static size_t event_count;
+
+static struct {
+  repeating_timer_t *rt;
+  uint64_t next_us;
+  uint32_t period_us;
+} timers[SIM_MAX_TIMERS];
+
+// Enumeration, one control request per step
+enum {
+  ENUM_IDLE,
+  ENUM_DEVICE,
+  ENUM_ADDRESS,
+  ENUM_CONFIG,
+  ENUM_LANGID,
+  ENUM_STRINGS,
+  ENUM_SET_CONFIG,
+  ENUM_REPORT_DESC,
+  ENUM_LEDS,
+};
+
+static struct {
+  uint8_t step;
+  uint8_t item; // within the step
+  uint64_t next_us;
+  uint8_t strings[3];
+  uint16_t report_desc_len[CFG_TUD_HID];
+  uint8_t interval[CFG_TUD_HID];
+} enumeration;
+
+static struct {
+  bool busy;
+  bool held;    // taken by the host, completion delayed by a fault
+  uint64_t submit_us;
+  uint8_t len;
+  uint8_t data[CFG_TUD_HID_EP_BUFSIZE];
+} endpoint[CFG_TUD_HID];
+
+static uint64_t next_frame_us;
+static uint64_t poll_us; // of the current frame, UINT64_MAX once done
+static bool wakeup_pending;
+
+enum {
+  FAULT_NAK_STORM,
+  FAULT_DELAY_COMPLETION,
+  FAULT_BUS_RESET,
+  FAULT_SUSPEND,
+  FAULT_SPURIOUS_SET_REPORT,
+  FAULT_COUNT
+};
+
+static struct {
+  uint32_t rng;
+  uint32_t period_us;
+  bool active;            // one fault at a time
+  uint32_t delay_next_us; // completion delay of the next report taken
+  uint64_t end_us;        // awaiting the first report taken after this
+  bool recovering;
+} faults;
+
+static void fail(char const *what, unsigned arg) {
+  fprintf(stderr, "sim: enumeration: %s (%u)\n", what, arg);
+  sim.enum_errors++;
+}
+
+//--------------------------------------------------------------------+
+// Setup
+//--------------------------------------------------------------------+
+
+void sim_reset(void) {
+  if (!sim_reports)
+    sim_reports = calloc(SIM_MAX_REPORTS, sizeof(sim_report_t));
+  memset(&sim, 0, sizeof(sim));
+  sim.loop_us = 10;
+  sim.poll_offset_us = 100;
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++)
+    sim.poll_phase[i] = i % HID_POLL_INTERVAL;
+  sim.reset_us = 10000;
+  sim.request_us = 1000;
+  sim.bind_us = 20000;
+  sim.host_sets_leds = true;
+  sim.serial = "E6614103E7452D2F";
+
+  sim_report_count = 0;
+  event_count = 0;
+  memset(timers, 0, sizeof(timers));
+  memset(&enumeration, 0, sizeof(enumeration));
+  memset(endpoint, 0, sizeof(endpoint));
+  memset(&watchdog_regs, 0, sizeof(watchdog_regs));
+  memset(&faults, 0, sizeof(faults));
+  next_frame_us = 0;
+  poll_us = UINT64_MAX;
+  wakeup_pending = false;
+}
+
+void sim_clear_reports(void) { sim_report_count = 0; }
+
+void sim_at(uint64_t time_us, void (*fn)(void *arg), void *arg) {
+  if (event_count == SIM_MAX_EVENTS) {
+    fprintf(stderr, "sim: too many events\n");
+    abort();
+  }
+  // Sorted, events at the same time run in the order they were added
+  size_t i = event_count++;
+  while (i > 0 && events[i - 1].time_us > time_us) {
+    events[i] = events[i - 1];
+    i--;
+  }
+  events[i] = (event_t){time_us, fn, arg};
+}
+
+//--------------------------------------------------------------------+
+// Bus
+//--------------------------------------------------------------------+
+
+static bool bus_running(void) {
+  return sim.plugged && sim.stack_up && sim.connected && !sim.suspended;
+}
+
+static void drop_endpoints(void) { memset(endpoint, 0, sizeof(endpoint)); }
+
+// What TinyUSB does on a bus reset or disconnect
+static void stack_reset(void) {
+  bool const was_mounted = sim.mounted;
+  sim.mounted = false;
+  sim.suspended = false;
+  sim.sof_enabled = false;
+  drop_endpoints();
+  if (was_mounted)
+    tud_umount_cb();
+}
+
+static void start_enumeration(void) {
+  stack_reset();
+  memset(&enumeration, 0, sizeof(enumeration));
+  enumeration.step = ENUM_DEVICE;
+  enumeration.next_us = sim.now_us + sim.reset_us;
+}
+
+void sim_plug(void) {
+  sim.plugged = true;
+  if (sim.stack_up && sim.connected)
+    start_enumeration();
+}
+
+void sim_unplug(void) {
+  sim.plugged = false;
+  enumeration.step = ENUM_IDLE;
+  stack_reset();
+}
+
+void sim_bus_reset(void) {
+  if (sim.plugged && sim.stack_up && sim.connected)
+    start_enumeration();
+}
+
+void sim_suspend(void) {
+  if (!sim.mounted || sim.suspended)
+    return;
+  sim.suspended = true;
+  tud_suspend_cb(true);
+}
+
+void sim_resume(void) {
+  if (!sim.suspended)
+    return;
+  sim.suspended = false;
+  tud_resume_cb();
+}
+
+static void wakeup_event(void *arg) {
+  (void)arg;
+  wakeup_pending = false;
+  sim_resume();
+}
+
+//--------------------------------------------------------------------+
+// Faults
+//--------------------------------------------------------------------+
+
+// xorshift32, deterministic for a given seed
+static uint32_t random32(void) {
+  faults.rng ^= faults.rng << 13;
+  faults.rng ^= faults.rng >> 17;
+  faults.rng ^= faults.rng << 5;
+  return faults.rng;
+}
+
+static uint32_t random_range(uint32_t lo, uint32_t hi) {
+  return lo + random32() % (hi - lo + 1);
+}
+
+static void fault_ended(void) {
+  faults.active = false;
+  faults.end_us = sim.now_us;
+  faults.recovering = true;
+}
+
+static void fault_end_event(void *arg) {
+  (void)arg;
+  fault_ended();
+}
+
+static void fault_resume_event(void *arg) {
+  (void)arg;
+  sim_resume();
+  fault_ended();
+}
+
+static void fault_complete_event(void *arg) {
+  uint8_t const i = (uint8_t)(uintptr_t)arg;
+  if (!endpoint[i].held) {
+    // Dropped by a bus reset or unplug in the meantime
+    faults.active = false;
+    return;
+  }
+  endpoint[i].held = false;
+  endpoint[i].busy = false;
+  fault_ended();
+  tud_hid_report_complete_cb(i, endpoint[i].data, endpoint[i].len);
+}
+
+static void inject_fault(void) {
+  switch (random32() % FAULT_COUNT) {
+  case FAULT_NAK_STORM:
+    sim.nak_until_us = sim.now_us + random_range(5, 200) * 1000u;
+    sim.faults.nak_storms++;
+    sim_at(sim.nak_until_us, fault_end_event, NULL);
+    break;
+
+  case FAULT_DELAY_COMPLETION:
+    // Ends with the completion, see poll_endpoints()
+    faults.delay_next_us = random_range(1000, 20000);
+    sim.faults.delayed_completions++;
+    break;
+
+  case FAULT_BUS_RESET:
+    // Recovery includes the enumeration
+    sim.faults.bus_resets++;
+    sim_bus_reset();
+    fault_ended();
+    break;
+
+  case FAULT_SUSPEND:
+    sim.faults.suspends++;
+    sim_suspend();
+    sim_at(sim.now_us + random_range(3, 50) * 1000u, fault_resume_event, NULL);
+    break;
+
+  case FAULT_SPURIOUS_SET_REPORT: {
+    // Output reports only: a random feature report could schedule input
+    uint8_t buf[CFG_TUD_HID_EP_BUFSIZE];
+    for (size_t i = 0; i < sizeof(buf); i++)
+      buf[i] = (uint8_t)random32();
+    uint8_t const report_id = (uint8_t)random_range(0, REPORT_ID_COUNT);
+    uint16_t const len = (uint16_t)random_range(0, sizeof(buf));
+    sim.faults.spurious_set_reports++;
+    sim_set_report(0, report_id, HID_REPORT_TYPE_OUTPUT, buf, len);
+    faults.active = false;
+  } break;
+  }
+}
+
+static void fault_event(void *arg) {
+  (void)arg;
+  if (!faults.period_us)
+    return;
+  // Jittered around the period
+  sim_at(sim.now_us +
+             random_range(faults.period_us / 2, faults.period_us * 3 / 2),
+         fault_event, NULL);
+  if (faults.active || !sim.mounted || sim.suspended)
+    return;
+  faults.active = true;
+  inject_fault();
+}
+
+void sim_inject_faults(uint32_t seed, uint32_t period_us) {
+  bool const running = faults.period_us != 0;
+  faults.rng = seed ? seed : 1;
+  faults.period_us = period_us;
+  if (period_us && !running)
+    sim_at(sim.now_us + period_us, fault_event, NULL);
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+
+static void check_device(void) {
+  uint8_t const *d = tud_descriptor_device_cb();
+  if (!d) {
+    fail("no device descriptor", 0);
+    return;
+  }
+  if (d[0] != sizeof(tusb_desc_device_t) || d[1] != TUSB_DESC_DEVICE)
+    fail("device descriptor header", d[0]);
+  if (d[7] != 8 && d[7] != 16 && d[7] != 32 && d[7] != 64)
+    fail("bMaxPacketSize0", d[7]);
+  if (d[17] < 1)
+    fail("bNumConfigurations", d[17]);
+  enumeration.strings[0] = d[14];
+  enumeration.strings[1] = d[15];
+  enumeration.strings[2] = d[16];
+}
+
+static void check_config(void) {
+  uint8_t const *c = tud_descriptor_configuration_cb(0);
+  if (!c) {
+    fail("no configuration descriptor", 0);
+    return;
+  }
+  if (c[0] != 9 || c[1] != TUSB_DESC_CONFIGURATION)
+    fail("configuration descriptor header", c[0]);
+  uint16_t const total = (uint16_t)(c[2] | c[3] << 8);
+  uint8_t interfaces = 0;
+  int hid = -1;
+  uint16_t off = 0;
+  while (off < total) {
+    uint8_t const len = c[off];
+    if (len < 2 || off + len > total) {
+      fail("descriptor length", off);
+      return;
+    }
+    switch (c[off + 1]) {
+    case TUSB_DESC_INTERFACE:
+      interfaces++;
+      hid = c[off + 5] == TUSB_CLASS_HID ? c[off + 2] : -1;
+      break;
+    case HID_DESC_TYPE_HID:
+      if (hid >= 0 && hid < CFG_TUD_HID)
+        enumeration.report_desc_len[hid] =
+            (uint16_t)(c[off + 7] | c[off + 8] << 8);
+      break;
+    case TUSB_DESC_ENDPOINT:
+      if (hid >= 0 && hid < CFG_TUD_HID) {
+        if ((uint16_t)(c[off + 4] | c[off + 5] << 8) > CFG_TUD_HID_EP_BUFSIZE)
+          fail("wMaxPacketSize", hid);
+        enumeration.interval[hid] = c[off + 6];
+      }
+      break;
+    }
+    off += len;
+  }
+  if (interfaces != c[4] || interfaces != CFG_TUD_HID)
+    fail("interface count", interfaces);
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++)
+    if (!enumeration.report_desc_len[i] || !enumeration.interval[i])
+      fail("HID interface incomplete", i);
+}
+
+static void check_string(uint8_t index) {
+  uint16_t const *s = tud_descriptor_string_cb(index, 0x0409);
+  if (!s) {
+    fail("string missing", index);
+    return;
+  }
+  uint8_t const bytes = (uint8_t)(s[0] & 0xff);
+  if ((s[0] >> 8) != TUSB_DESC_STRING || bytes < 2 || (bytes & 1))
+    fail("string descriptor header", index);
+  // The host reads all of it
+  for (uint8_t i = 1; i < bytes / 2; i++) {
+    uint16_t volatile c = s[i];
+    (void)c;
+  }
+  if (index == 0 && (bytes != 4 || s[1] != 0x0409))
+    fail("language IDs", bytes);
+}
+
+static void check_report_desc(uint8_t instance) {
+  uint8_t const *r = tud_hid_descriptor_report_cb(instance);
+  uint16_t const len = enumeration.report_desc_len[instance];
+  if (!r) {
+    fail("no report descriptor", instance);
+    return;
+  }
+  int depth = 0;
+  uint16_t off = 0;
+  while (off < len) {
+    uint8_t const prefix = r[off];
+    if (prefix == 0xfe) {
+      fail("long item", off);
+      return;
+    }
+    uint8_t const size = (uint8_t)((prefix & 3) == 3 ? 4 : (prefix & 3));
+    if (off + 1 + size > len) {
+      fail("item past the end", off);
+      return;
+    }
+    if ((prefix & 0xfc) == 0xa0)
+      depth++;
+    else if ((prefix & 0xfc) == 0xc0 && --depth < 0) {
+      fail("unbalanced collection", off);
+      return;
+    }
+    off += 1 + size;
+  }
+  if (depth != 0)
+    fail("open collection", instance);
+}
+
+static void enumeration_step(void) {
+  uint64_t next = sim.request_us;
+  switch (enumeration.step) {
+  case ENUM_DEVICE:
+    check_device();
+    enumeration.step = ENUM_ADDRESS;
+    break;
+  case ENUM_ADDRESS:
+    enumeration.step = ENUM_CONFIG;
+    break;
+  case ENUM_CONFIG:
+    check_config();
+    enumeration.step = ENUM_LANGID;
+    break;
+  case ENUM_LANGID:
+    check_string(0);
+    enumeration.step = ENUM_STRINGS;
+    enumeration.item = 0;
+    break;
+  case ENUM_STRINGS:
+    if (enumeration.strings[enumeration.item])
+      check_string(enumeration.strings[enumeration.item]);
+    if (++enumeration.item == 3)
+      enumeration.step = ENUM_SET_CONFIG;
+    break;
+  case ENUM_SET_CONFIG:
+    sim.mounted = true;
+    sim.mount_us = sim.now_us;
+    sim.first_report_us = 0;
+    enumeration.step = ENUM_REPORT_DESC;
+    enumeration.item = 0;
+    tud_mount_cb();
+    break;
+  case ENUM_REPORT_DESC:
+    check_report_desc(enumeration.item);
+    if (++enumeration.item == CFG_TUD_HID) {
+      enumeration.step = sim.host_sets_leds ? ENUM_LEDS : ENUM_IDLE;
+      next = sim.mount_us + sim.bind_us > sim.now_us
+                 ? sim.mount_us + sim.bind_us - sim.now_us
+                 : 0;
+    }
+    break;
+  case ENUM_LEDS: {
+    // Every keyboard driver sets the LEDs once bound
+    uint8_t const leds = 0;
+    sim_set_report(0, REPORT_ID_KEYBOARD, HID_REPORT_TYPE_OUTPUT, &leds, 1);
+    for (uint8_t i = 1; i < CFG_TUD_HID; i++)
+      sim_set_report(i, 0, HID_REPORT_TYPE_OUTPUT, &leds, 1);
+    enumeration.step = ENUM_IDLE;
+  } break;
+  }
+  enumeration.next_us = sim.now_us + next;
+}
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+
+static void poll_endpoints(void) {
+  if (!sim.mounted || sim.now_us < sim.nak_until_us)
+    return;
+  for (uint8_t i = 0; i < CFG_TUD_HID; i++) {
+    uint8_t interval =
+        enumeration.interval[i] ? enumeration.interval[i] : HID_POLL_INTERVAL;
+    if (sim.poll_interval)
+      interval = sim.poll_interval;
+    if (sim.frame % interval != sim.poll_phase[i] % interval ||
+        !endpoint[i].busy || endpoint[i].held)
+      continue;
+    if (sim_report_count < SIM_MAX_REPORTS) {
+      sim_report_t *r = &sim_reports[sim_report_count++];
+      r->time_us = sim.now_us;
+      r->submit_us = endpoint[i].submit_us;
+      r->frame = sim.frame;
+      r->instance = i;
+      r->len = endpoint[i].len;
+      memcpy(r->data, endpoint[i].data, endpoint[i].len);
+    }
+    if (!sim.first_report_us)
+      sim.first_report_us = sim.now_us;
+    if (faults.recovering) {
+      faults.recovering = false;
+      sim.faults.last_recovery_us = (uint32_t)(sim.now_us - faults.end_us);
+      if (sim.faults.last_recovery_us > sim.faults.max_recovery_us)
+        sim.faults.max_recovery_us = sim.faults.last_recovery_us;
+    }
+    if (faults.delay_next_us) {
+      // The host has it, the device hears of it later
+      endpoint[i].held = true;
+      sim_at(sim.now_us + faults.delay_next_us, fault_complete_event,
+             (void *)(uintptr_t)i);
+      faults.delay_next_us = 0;
+      continue;
+    }
+    endpoint[i].busy = false;
+    tud_hid_report_complete_cb(i, endpoint[i].data, endpoint[i].len);
+  }
+}
+
+void sim_run_until(uint64_t time_us) {
+  while (1) {
+    uint64_t t = time_us;
+    int what = 0;
+    if (bus_running()) {
+      if (poll_us < t) {
+        t = poll_us;
+        what = 1;
+      }
+      if (next_frame_us < t) {
+        t = next_frame_us;
+        what = 2;
+      }
+    }
+    if (enumeration.step != ENUM_IDLE && bus_running() &&
+        enumeration.next_us < t) {
+      t = enumeration.next_us;
+      what = 3;
+    }
+    for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+      if (timers[i].rt && timers[i].next_us < t) {
+        t = timers[i].next_us;
+        what = 4;
+      }
+    }
+    if (event_count && events[0].time_us < t) {
+      t = events[0].time_us;
+      what = 5;
+    }
+    if (what == 0) {
+      if (sim.now_us < time_us)
+        sim.now_us = time_us;
+      return;
+    }
+    if (t > sim.now_us)
+      sim.now_us = t;
+
+    switch (what) {
+    case 1:
+      poll_us = UINT64_MAX;
+      poll_endpoints();
+      break;
+    case 2:
+      next_frame_us = (sim.now_us / 1000 + 1) * 1000;
+      poll_us = sim.now_us + sim.poll_offset_us;
+      sim.frame++;
+      if (sim.sof_enabled)
+        tud_sof_cb(sim.frame & 0x7ff);
+      break;
+    case 3:
+      enumeration_step();
+      break;
+    case 4:
+      for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (timers[i].rt && timers[i].next_us == t) {
+          timers[i].next_us += timers[i].period_us;
+          if (!timers[i].rt->callback(timers[i].rt))
+            timers[i].rt = NULL;
+        }
+      }
+      break;
+    case 5: {
+      event_t const e = events[0];
+      memmove(&events[0], &events[1], --event_count * sizeof(event_t));
+      e.fn(e.arg);
+    } break;
+    }
+  }
+}
+
+void sim_advance(uint64_t us) { sim_run_until(sim.now_us + us); }
+
+uint64_t time_us_64(void) { return sim.now_us; }
+
+uint32_t time_us_32(void) { return (uint32_t)sim.now_us; }
+
+bool add_repeating_timer_ms(int32_t delay_ms,
+                            repeating_timer_callback_t callback,
+                            void *user_data, repeating_timer_t *out) {
+  for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+    if (timers[i].rt)
+      continue;
+    uint32_t const period_us =
+        (uint32_t)(delay_ms < 0 ? -delay_ms : delay_ms) * 1000u;
+    *out = (repeating_timer_t){.delay_us = (int64_t)delay_ms * 1000,
+                               .callback = callback,
+                               .user_data = user_data};
+    timers[i].rt = out;
+    timers[i].period_us = period_us;
+    timers[i].next_us = sim.now_us + period_us;
+    return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// Control requests
+//--------------------------------------------------------------------+
+
+// Exactly sized heap copies, so the sanitizers see any overrun
+void sim_set_report(uint8_t instance, uint8_t report_id,
+                    hid_report_type_t type, uint8_t const *buffer,
+                    uint16_t len) {
+  uint8_t *copy = malloc(len ? len : 1);
+  if (len)
+    memcpy(copy, buffer, len);
+  tud_hid_set_report_cb(instance, report_id, type, copy, len);
+  free(copy);
+}
+
+uint16_t sim_get_report(uint8_t instance, uint8_t report_id,
+                        hid_report_type_t type, uint8_t *buffer,
+                        uint16_t reqlen) {
+  uint8_t *copy = malloc(reqlen ? reqlen : 1);
+  uint16_t const len =
+      tud_hid_get_report_cb(instance, report_id, type, copy, reqlen);
+  if (len > reqlen) {
+    fprintf(stderr, "sim: GET_REPORT returned %u of %u bytes\n", len, reqlen);
+    abort();
+  }
+  memcpy(buffer, copy, len);
+  free(copy);
+  return len;
+}
+
+//--------------------------------------------------------------------+
+// Device stack
+//--------------------------------------------------------------------+
+
+bool tud_init(uint8_t rhport) {
+  (void)rhport;
+  sim_advance(sim.tud_init_us);
+  sim.stack_up = true;
+  sim.connected = true;
+  sim.sof_enabled = false;
+  if (sim.plugged)
+    start_enumeration();
+  return true;
+}
+
+bool tud_mounted(void) { return sim.mounted; }
+
+bool tud_suspended(void) { return sim.suspended; }
+
+bool tud_remote_wakeup(void) {
+  if (!sim.suspended)
+    return false;
+  if (!wakeup_pending) {
+    // The host takes over the resume signalling and resumes the bus
+    wakeup_pending = true;
+    sim.wakeups++;
+    sim_at(sim.now_us + 20000, wakeup_event, NULL);
+  }
+  return true;
+}
+
+bool tud_connect(void) {
+  if (sim.connected)
+    return true;
+  sim.connected = true;
+  if (sim.plugged && sim.stack_up)
+    start_enumeration();
+  return true;
+}
+
+bool tud_disconnect(void) {
+  sim.connected = false;
+  enumeration.step = ENUM_IDLE;
+  stack_reset();
+  return true;
+}
+
+void tud_sof_cb_enable(bool en) {
+  sim.sof_enabled = en;
+  if (en)
+    sim.sof_enables++;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+  return instance < CFG_TUD_HID && sim.mounted && !sim.suspended &&
+         !endpoint[instance].busy;
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report,
+                      uint16_t len) {
+  if (!tud_hid_n_ready(instance))
+    return false;
+  uint8_t const id_len = report_id ? 1 : 0;
+  if (len + id_len > CFG_TUD_HID_EP_BUFSIZE)
+    return false;
+  endpoint[instance].data[0] = report_id;
+  if (len)
+    memcpy(&endpoint[instance].data[id_len], report, len);
+  endpoint[instance].len = (uint8_t)(len + id_len);
+  endpoint[instance].busy = true;
+  endpoint[instance].submit_us = sim.now_us;
+  return true;
+}
+
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id,
+                               uint8_t modifier, uint8_t const keycode[6]) {
+  hid_keyboard_report_t report = {.modifier = modifier};
+  if (keycode)
+    memcpy(report.keycode, keycode, sizeof(report.keycode));
+  return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+}
+
+//--------------------------------------------------------------------+
+// Application thread
+//--------------------------------------------------------------------+
+
+int app_main(void);
+
+static pthread_mutex_t app_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t app_cond = PTHREAD_COND_INITIALIZER;
+static bool app_started;
+static bool app_turn; // the application runs, the test waits
+static uint64_t app_until_us;
+
+static void *app_thread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&app_lock);
+  while (!app_turn)
+    pthread_cond_wait(&app_cond, &app_lock);
+  pthread_mutex_unlock(&app_lock);
+  app_main();
+  return NULL;
+}
+
+void sim_run_app(uint64_t until_us) {
+  if (!app_started) {
+    pthread_t thread;
+    app_started = true;
+    pthread_create(&thread, NULL, app_thread, NULL);
+    pthread_detach(thread);
+#if SIM_FREERTOS_KERNEL
+    // The POSIX port's tick is SIGALRM, for the task threads only
+    sigset_t tick;
+    sigemptyset(&tick);
+    sigaddset(&tick, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &tick, NULL);
+#endif
+  }
+  pthread_mutex_lock(&app_lock);
+  app_until_us = until_us;
+  app_turn = true;
+  pthread_cond_broadcast(&app_cond);
+  while (app_turn)
+    pthread_cond_wait(&app_cond, &app_lock);
+  pthread_mutex_unlock(&app_lock);
+}
+
+void sim_app_yield(void) {
+  // Module tests call firmware that runs tud_task() on their own thread
+  if (!app_started || sim.now_us < app_until_us)
+    return;
+  // Hand back to the test until it asks for more time
+  pthread_mutex_lock(&app_lock);
+  app_turn = false;
+  pthread_cond_broadcast(&app_cond);
+  while (!app_turn)
+    pthread_cond_wait(&app_cond, &app_lock);
+  pthread_mutex_unlock(&app_lock);
+}
+
+void tud_task(void) {
+#if CFG_APP_FREERTOS && SIM_FREERTOS_KERNEL
+  // On the kernel's POSIX port the highest priority task runs the bus, a
+  // millisecond of it per call, then blocks for a tick the way TinyUSB
+  // blocks on its event queue. Simulated time does not follow the kernel's
+  // real time tick, so the test may hold the application for as long as it
+  // likes.
+  sim_advance(1000);
+  sim_app_yield();
+  vTaskDelay(1);
+#elif CFG_APP_FREERTOS
+  // TinyUSB blocks on its event queue. Here the bus runs from the idle task
+  // (freertos.c), so the USB task only needs to get out of the way.
+  vTaskDelay(1);
+#else
+  sim_advance(sim.loop_us);
+  sim_app_yield();
+#endif
+}
+
+//--------------------------------------------------------------------+
+// Board
+//--------------------------------------------------------------------+
+
+void board_init(void) { sim_advance(sim.board_init_us); }
+
+uint32_t board_millis(void) { return (uint32_t)(sim.now_us / 1000); }
+
+void board_led_write(bool state) { sim.led_on = state; }
+
+size_t board_usb_get_serial(uint16_t desc_str1[], size_t max_chars) {
+  size_t count = strlen(sim.serial);
+  if (count > max_chars)
+    count = max_chars;
+  for (size_t i = 0; i < count; i++)
+    desc_str1[i] = (uint8_t)sim.serial[i];
+  return count;
+}
+
+void gpio_set_function(unsigned gpio, enum gpio_function fn) {
+  (void)gpio;
+  (void)fn;
+}
+
+pwm_config pwm_get_default_config(void) { return (pwm_config){0}; }
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) { c->top = wrap; }
+
+void pwm_init(unsigned slice_num, pwm_config *c, bool start) {
+  (void)slice_num;
+  (void)c;
+  (void)start;
+}
+
+unsigned pwm_gpio_to_slice_num(unsigned gpio) { return (gpio >> 1) & 7; }
+
+void pwm_set_gpio_level(unsigned gpio, uint16_t level) {
+  if (gpio == PICO_DEFAULT_LED_PIN)
+    sim.led_level = level;
+}
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+  (void)delay_ms;
+  (void)pause_on_debug;
+}
+
+void watchdog_update(void) {}
+
+void xip_cache_invalidate_all(void) {}
@@ -0,0 +1,151 @@
+/*
+ * Host simulation of the device: clock, USB bus, host and board.
+ *
+ * Time is virtual and only moves in sim_advance() (or in tud_task() while
+ * the application runs, see sim_run_app()). The bus has 1 ms frames; the host
+ * polls every HID IN endpoint each HID_POLL_INTERVAL frames in its own phase,
+ * takes the report waiting there and the device gets its completion
+ * callback, as TinyUSB would deliver it. Enumeration runs the standard
+ * request sequence against the descriptor callbacks and checks what they
+ * return. Every report the host takes is logged. On request the host injects
+ * transport faults on a seeded schedule, see sim_inject_faults().
+ */
+
+#ifndef TEST_SIM_H_
+#define TEST_SIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tusb.h"
+
+#define SIM_MAX_REPORTS  65536
+#define SIM_MAX_EVENTS   64
+#define SIM_MAX_TIMERS   4
+
+typedef struct {
+  uint64_t time_us;
+  uint64_t submit_us;  // put on the endpoint by the device
+  uint32_t frame;
+  uint8_t instance;
+  uint8_t len;
+  uint8_t data[CFG_TUD_HID_EP_BUFSIZE]; // report ID first, if any
+} sim_report_t;
+
+// Faults injected by sim_inject_faults(), and how the device recovered
+typedef struct {
+  uint32_t nak_storms;
+  uint32_t delayed_completions;
+  uint32_t bus_resets;
+  uint32_t suspends;
+  uint32_t spurious_set_reports;
+  uint32_t max_recovery_us;  // fault end to the next report taken
+  uint32_t last_recovery_us;
+} sim_faults_t;
+
+typedef struct {
+  // Configuration, defaults from sim_reset()
+  uint32_t loop_us;         // time one tud_task() call takes
+  uint32_t poll_offset_us;  // IN token, after the SOF
+  uint8_t poll_phase[CFG_TUD_HID];
+  uint8_t poll_interval;    // frames between polls, 0 for bInterval
+  uint32_t reset_us;        // bus reset until the first request
+  uint32_t request_us;      // per control request of the enumeration
+  uint32_t bind_us;         // SET_CONFIGURATION until the LED SET_REPORT
+  bool host_sets_leds;
+  uint32_t board_init_us;   // time board_init() takes
+  uint32_t tud_init_us;
+  char const *serial;       // board_usb_get_serial()
+
+  // State, read only for tests
+  uint64_t now_us;
+  uint32_t frame;
+  bool plugged;
+  bool stack_up;            // tud_init() called
+  bool connected;           // D+ pull-up on, tud_disconnect() clears it
+  bool mounted;
+  bool suspended;
+  bool sof_enabled;
+  uint32_t enum_errors;     // descriptor checks that failed
+  uint64_t mount_us;        // last SET_CONFIGURATION
+  uint64_t first_report_us; // first report after the last mount, 0 if none
+  uint32_t sof_enables;     // calls of tud_sof_cb_enable(true)
+  uint16_t led_level;       // PWM level of the LED pin
+  bool led_on;              // board_led_write()
+  uint32_t wakeups;         // remote wakeups signalled
+
+  uint64_t nak_until_us;    // host side NAKs, polls before this take nothing
+  sim_faults_t faults;
+} sim_t;
+
+extern sim_t sim;
+
+extern sim_report_t *sim_reports;
+extern size_t sim_report_count;
+
+/**
+ * @brief Restores the defaults: time 0, cable unplugged, log empty.
+ */
+void sim_reset(void);
+
+/**
+ * @brief Moves time forward, running the bus, timers and scheduled events.
+ */
+void sim_advance(uint64_t us);
+void sim_run_until(uint64_t time_us);
+
+/**
+ * @brief Calls fn(arg) from the simulation once time reaches time_us.
+ */
+void sim_at(uint64_t time_us, void (*fn)(void *arg), void *arg);
+
+/**
+ * @brief Cable and bus events. Plugging in (with the stack up) or a bus
+ *        reset starts an enumeration.
+ */
+void sim_plug(void);
+void sim_unplug(void);
+void sim_bus_reset(void);
+void sim_suspend(void);
+void sim_resume(void);
+
+/**
+ * @brief Injects transport faults, one at a time, every period_us on average,
+ *        on a schedule driven by a seeded PRNG (the same seed replays it): NAK
+ *        storms, a delayed completion of the next report taken, bus resets,
+ *        suspends with the endpoint busy and spurious output SET_REPORTs with
+ *        random IDs and lengths. A period of 0 stops them.
+ */
+void sim_inject_faults(uint32_t seed, uint32_t period_us);
+
+/**
+ * @brief Control requests from the host, the report ID is not part of the
+ *        buffers.
+ */
+void sim_set_report(uint8_t instance, uint8_t report_id,
+                    hid_report_type_t type, uint8_t const *buffer,
+                    uint16_t len);
+uint16_t sim_get_report(uint8_t instance, uint8_t report_id,
+                        hid_report_type_t type, uint8_t *buffer,
+                        uint16_t reqlen);
+
+/**
+ * @brief Runs the firmware's main() (built as app_main) on its own thread in
+ *        lockstep with the caller: it runs until its tud_task() sees time
+ *        reach until_us, then the call returns. Later calls continue it.
+ */
+void sim_run_app(uint64_t until_us);
+
+/**
+ * @brief Hands back to the test once time has reached the sim_run_app()
+ *        limit. tud_task() calls it, with FreeRTOS the idle task does.
+ */
+void sim_app_yield(void);
+
+/**
+ * @brief Forgets the logged reports.
+ */
+void sim_clear_reports(void);
+
+#endif /* TEST_SIM_H_ */
@@ -0,0 +1,36 @@
+/*
+ * FreeRTOS API, for host builds. Tasks are threads that run one at a time
+ * under the scheduler of test/sim/freertos.c, on the simulated clock: the
+ * highest priority ready task runs until it blocks, and once every task is
+ * blocked the idle task moves time (and the bus) forward. Only what the
+ * firmware uses is provided.
+ */
+
+#ifndef TEST_STUBS_FREERTOS_H_
+#define TEST_STUBS_FREERTOS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define configTICK_RATE_HZ    1000
+#define configSTACK_DEPTH_TYPE uint32_t
+
+#define pdFALSE               ((BaseType_t)0)
+#define pdTRUE                ((BaseType_t)1)
+#define pdFAIL                pdFALSE
+#define pdPASS                pdTRUE
+#define portMAX_DELAY         ((TickType_t)UINT32_MAX)
+#define pdMS_TO_TICKS(ms)     ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_FREERTOS_H_ */
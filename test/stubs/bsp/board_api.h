@@ -0,0 +1,26 @@
+/*
+ * TinyUSB board support, for host builds. Implemented by test/sim/sim.c.
+ */
+
+#ifndef TEST_STUBS_BOARD_API_H_
+#define TEST_STUBS_BOARD_API_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void board_init(void);
+void board_init_after_tusb(void) __attribute__((weak));
+uint32_t board_millis(void);
+void board_led_write(bool state);
+size_t board_usb_get_serial(uint16_t desc_str1[], size_t max_chars);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_BOARD_API_H_ */
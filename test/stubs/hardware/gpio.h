@@ -0,0 +1,12 @@
+/*
+ * Pico SDK GPIO API, for host builds.
+ */
+
+#ifndef TEST_STUBS_HARDWARE_GPIO_H_
+#define TEST_STUBS_HARDWARE_GPIO_H_
+
+enum gpio_function { GPIO_FUNC_PWM = 4 };
+
+void gpio_set_function(unsigned gpio, enum gpio_function fn);
+
+#endif /* TEST_STUBS_HARDWARE_GPIO_H_ */
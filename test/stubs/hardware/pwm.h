@@ -0,0 +1,24 @@
+/*
+ * Pico SDK PWM API, for host builds. The level of the LED pin is recorded by
+ * test/sim/sim.c.
+ */
+
+#ifndef TEST_STUBS_HARDWARE_PWM_H_
+#define TEST_STUBS_HARDWARE_PWM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint32_t csr;
+  uint32_t div;
+  uint32_t top;
+} pwm_config;
+
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(unsigned slice_num, pwm_config *c, bool start);
+unsigned pwm_gpio_to_slice_num(unsigned gpio);
+void pwm_set_gpio_level(unsigned gpio, uint16_t level);
+
+#endif /* TEST_STUBS_HARDWARE_PWM_H_ */
@@ -0,0 +1,25 @@
+/*
+ * Pico SDK watchdog API, for host builds. The scratch registers are memory
+ * owned by test/sim/sim.c, so a simulated reboot can keep them.
+ */
+
+#ifndef TEST_STUBS_HARDWARE_WATCHDOG_H_
+#define TEST_STUBS_HARDWARE_WATCHDOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t ctrl;
+  volatile uint32_t load;
+  volatile uint32_t reason;
+  volatile uint32_t scratch[8];
+  volatile uint32_t tick;
+} watchdog_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+
+#endif /* TEST_STUBS_HARDWARE_WATCHDOG_H_ */
@@ -0,0 +1,10 @@
+/*
+ * Pico SDK XIP cache API, for host builds.
+ */
+
+#ifndef TEST_STUBS_HARDWARE_XIP_CACHE_H_
+#define TEST_STUBS_HARDWARE_XIP_CACHE_H_
+
+void xip_cache_invalidate_all(void);
+
+#endif /* TEST_STUBS_HARDWARE_XIP_CACHE_H_ */
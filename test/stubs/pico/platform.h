@@ -0,0 +1,13 @@
+/*
+ * Pico SDK platform macros, for host builds. Placement attributes become
+ * plain sections of the host executable.
+ */
+
+#ifndef TEST_STUBS_PICO_PLATFORM_H_
+#define TEST_STUBS_PICO_PLATFORM_H_
+
+#define __not_in_flash(group)      __attribute__((section(".time_critical." group)))
+#define __not_in_flash_func(func)  __attribute__((section(".time_critical." #func))) func
+#define __uninitialized_ram(var)   __attribute__((section(".uninitialized_data." #var))) var
+
+#endif /* TEST_STUBS_PICO_PLATFORM_H_ */
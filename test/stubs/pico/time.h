@@ -0,0 +1,38 @@
+/*
+ * Pico SDK timer API, for host builds. Time is the simulated clock of
+ * test/sim/sim.c, repeating timers fire from the simulation.
+ */
+
+#ifndef TEST_STUBS_PICO_TIME_H_
+#define TEST_STUBS_PICO_TIME_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/platform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+  int64_t delay_us;
+  repeating_timer_callback_t callback;
+  void *user_data;
+};
+
+bool add_repeating_timer_ms(int32_t delay_ms,
+                            repeating_timer_callback_t callback,
+                            void *user_data, repeating_timer_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_PICO_TIME_H_ */
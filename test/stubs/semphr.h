@@ -0,0 +1,26 @@
+/*
+ * FreeRTOS semaphore API, for host builds (see FreeRTOS.h). Recursive
+ * mutexes only.
+ */
+
+#ifndef TEST_STUBS_SEMPHR_H_
+#define TEST_STUBS_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sim_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex,
+                                   TickType_t timeout);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_SEMPHR_H_ */
@@ -0,0 +1,38 @@
+/*
+ * FreeRTOS task API, for host builds (see FreeRTOS.h).
+ */
+
+#ifndef TEST_STUBS_TASK_H_
+#define TEST_STUBS_TASK_H_
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *param);
+
+BaseType_t xTaskCreate(TaskFunction_t fn, char const *name,
+                       configSTACK_DEPTH_TYPE stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskStartScheduler(void);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+
+// Tasks only switch where they block or wake a higher priority task, so a
+// critical section just must not do either
+void sim_task_enter_critical(void);
+void sim_task_exit_critical(void);
+#define taskENTER_CRITICAL() sim_task_enter_critical()
+#define taskEXIT_CRITICAL()  sim_task_exit_critical()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_TASK_H_ */
@@ -0,0 +1,523 @@
+/*
+ * The parts of TinyUSB the firmware uses, for host builds.
+ *
+ * Types, constants and descriptor macros follow TinyUSB (src/class/hid/hid.h,
+ * src/device/usbd.h, src/common/tusb_types.h), so descriptors come out byte
+ * for byte as on the device. The device stack itself is simulated by
+ * test/sim/sim.c.
+ */
+
+#ifndef TEST_STUBS_TUSB_H_
+#define TEST_STUBS_TUSB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define OPT_MCU_NONE           0
+#define OPT_OS_NONE            1
+#define OPT_OS_FREERTOS        2
+#define OPT_MODE_DEFAULT_SPEED 0
+
+#include "tusb_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Common
+//--------------------------------------------------------------------+
+
+#define TU_ATTR_PACKED       __attribute__((packed))
+#define TU_ATTR_WEAK         __attribute__((weak))
+#define TU_ARRAY_SIZE(a)     (sizeof(a) / sizeof(a[0]))
+#define TU_MIN(a, b)         ((a) < (b) ? (a) : (b))
+#define TU_MAX(a, b)         ((a) > (b) ? (a) : (b))
+#define TU_BIT(n)            (1UL << (n))
+#define TU_U16_LOW(u16)      ((uint8_t)((u16) & 0x00ff))
+#define TU_U16_HIGH(u16)     ((uint8_t)(((u16) >> 8) & 0x00ff))
+#define U16_TO_U8S_LE(u16)   TU_U16_LOW(u16), TU_U16_HIGH(u16)
+
+#define TUD_OPT_HIGH_SPEED   0
+
+enum {
+  TUSB_DESC_DEVICE = 0x01,
+  TUSB_DESC_CONFIGURATION = 0x02,
+  TUSB_DESC_STRING = 0x03,
+  TUSB_DESC_INTERFACE = 0x04,
+  TUSB_DESC_ENDPOINT = 0x05,
+  TUSB_DESC_DEVICE_QUALIFIER = 0x06,
+  TUSB_DESC_OTHER_SPEED_CONFIG = 0x07,
+};
+
+enum { TUSB_CLASS_HID = 3 };
+enum { TUSB_XFER_INTERRUPT = 3 };
+enum { TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP = TU_BIT(5) };
+
+typedef struct TU_ATTR_PACKED {
+  uint8_t bLength;
+  uint8_t bDescriptorType;
+  uint16_t bcdUSB;
+  uint8_t bDeviceClass;
+  uint8_t bDeviceSubClass;
+  uint8_t bDeviceProtocol;
+  uint8_t bMaxPacketSize0;
+  uint16_t idVendor;
+  uint16_t idProduct;
+  uint16_t bcdDevice;
+  uint8_t iManufacturer;
+  uint8_t iProduct;
+  uint8_t iSerialNumber;
+  uint8_t bNumConfigurations;
+} tusb_desc_device_t;
+
+//--------------------------------------------------------------------+
+// HID class
+//--------------------------------------------------------------------+
+
+typedef enum {
+  HID_REPORT_TYPE_INVALID = 0,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+enum {
+  HID_DESC_TYPE_HID = 0x21,
+  HID_DESC_TYPE_REPORT = 0x22,
+};
+
+enum {
+  HID_ITF_PROTOCOL_NONE = 0,
+  HID_ITF_PROTOCOL_KEYBOARD,
+  HID_ITF_PROTOCOL_MOUSE,
+};
+
+enum { HID_SUBCLASS_BOOT = 1 };
+
+typedef struct TU_ATTR_PACKED {
+  uint8_t modifier;
+  uint8_t reserved;
+  uint8_t keycode[6];
+} hid_keyboard_report_t;
+
+typedef struct TU_ATTR_PACKED {
+  uint8_t buttons;
+  int8_t x;
+  int8_t y;
+  int8_t wheel;
+  int8_t pan;
+} hid_mouse_report_t;
+
+typedef struct TU_ATTR_PACKED {
+  int8_t x;
+  int8_t y;
+  int8_t z;
+  int8_t rz;
+  int8_t rx;
+  int8_t ry;
+  uint8_t hat;
+  uint32_t buttons;
+} hid_gamepad_report_t;
+
+typedef enum {
+  KEYBOARD_MODIFIER_LEFTCTRL = TU_BIT(0),
+  KEYBOARD_MODIFIER_LEFTSHIFT = TU_BIT(1),
+  KEYBOARD_MODIFIER_LEFTALT = TU_BIT(2),
+  KEYBOARD_MODIFIER_LEFTGUI = TU_BIT(3),
+  KEYBOARD_MODIFIER_RIGHTCTRL = TU_BIT(4),
+  KEYBOARD_MODIFIER_RIGHTSHIFT = TU_BIT(5),
+  KEYBOARD_MODIFIER_RIGHTALT = TU_BIT(6),
+  KEYBOARD_MODIFIER_RIGHTGUI = TU_BIT(7),
+} hid_keyboard_modifier_bm_t;
+
+typedef enum {
+  KEYBOARD_LED_NUMLOCK = TU_BIT(0),
+  KEYBOARD_LED_CAPSLOCK = TU_BIT(1),
+  KEYBOARD_LED_SCROLLLOCK = TU_BIT(2),
+} hid_keyboard_led_bm_t;
+
+typedef enum {
+  MOUSE_BUTTON_LEFT = TU_BIT(0),
+  MOUSE_BUTTON_RIGHT = TU_BIT(1),
+  MOUSE_BUTTON_MIDDLE = TU_BIT(2),
+} hid_mouse_button_bm_t;
+
+#define HID_KEY_NONE               0x00
+#define HID_KEY_A                  0x04
+#define HID_KEY_B                  0x05
+#define HID_KEY_C                  0x06
+#define HID_KEY_D                  0x07
+#define HID_KEY_E                  0x08
+#define HID_KEY_F                  0x09
+#define HID_KEY_G                  0x0A
+#define HID_KEY_H                  0x0B
+#define HID_KEY_I                  0x0C
+#define HID_KEY_J                  0x0D
+#define HID_KEY_K                  0x0E
+#define HID_KEY_L                  0x0F
+#define HID_KEY_M                  0x10
+#define HID_KEY_N                  0x11
+#define HID_KEY_O                  0x12
+#define HID_KEY_P                  0x13
+#define HID_KEY_Q                  0x14
+#define HID_KEY_R                  0x15
+#define HID_KEY_S                  0x16
+#define HID_KEY_T                  0x17
+#define HID_KEY_U                  0x18
+#define HID_KEY_V                  0x19
+#define HID_KEY_W                  0x1A
+#define HID_KEY_X                  0x1B
+#define HID_KEY_Y                  0x1C
+#define HID_KEY_Z                  0x1D
+#define HID_KEY_1                  0x1E
+#define HID_KEY_2                  0x1F
+#define HID_KEY_3                  0x20
+#define HID_KEY_4                  0x21
+#define HID_KEY_5                  0x22
+#define HID_KEY_6                  0x23
+#define HID_KEY_7                  0x24
+#define HID_KEY_8                  0x25
+#define HID_KEY_9                  0x26
+#define HID_KEY_0                  0x27
+#define HID_KEY_ENTER              0x28
+#define HID_KEY_ESCAPE             0x29
+#define HID_KEY_BACKSPACE          0x2A
+#define HID_KEY_TAB                0x2B
+#define HID_KEY_SPACE              0x2C
+#define HID_KEY_MINUS              0x2D
+#define HID_KEY_EQUAL              0x2E
+#define HID_KEY_BRACKET_LEFT       0x2F
+#define HID_KEY_BRACKET_RIGHT      0x30
+#define HID_KEY_BACKSLASH          0x31
+#define HID_KEY_EUROPE_1           0x32
+#define HID_KEY_SEMICOLON          0x33
+#define HID_KEY_APOSTROPHE         0x34
+#define HID_KEY_GRAVE              0x35
+#define HID_KEY_COMMA              0x36
+#define HID_KEY_PERIOD             0x37
+#define HID_KEY_SLASH              0x38
+#define HID_KEY_CAPS_LOCK          0x39
+#define HID_KEY_F1                 0x3A
+#define HID_KEY_F2                 0x3B
+#define HID_KEY_F3                 0x3C
+#define HID_KEY_F4                 0x3D
+#define HID_KEY_F5                 0x3E
+#define HID_KEY_F6                 0x3F
+#define HID_KEY_F7                 0x40
+#define HID_KEY_F8                 0x41
+#define HID_KEY_F9                 0x42
+#define HID_KEY_F10                0x43
+#define HID_KEY_F11                0x44
+#define HID_KEY_F12                0x45
+#define HID_KEY_PRINT_SCREEN       0x46
+#define HID_KEY_SCROLL_LOCK        0x47
+#define HID_KEY_PAUSE              0x48
+#define HID_KEY_INSERT             0x49
+#define HID_KEY_HOME               0x4A
+#define HID_KEY_PAGE_UP            0x4B
+#define HID_KEY_DELETE             0x4C
+#define HID_KEY_END                0x4D
+#define HID_KEY_PAGE_DOWN          0x4E
+#define HID_KEY_ARROW_RIGHT        0x4F
+#define HID_KEY_ARROW_LEFT         0x50
+#define HID_KEY_ARROW_DOWN         0x51
+#define HID_KEY_ARROW_UP           0x52
+#define HID_KEY_NUM_LOCK           0x53
+#define HID_KEY_APPLICATION        0x65
+
+// { shift, keycode } per ASCII character, US layout
+#define HID_ASCII_TO_KEYCODE \
+    {0, 0                     }, /* 0x00 Null      */ \
+    {0, 0                     }, /* 0x01           */ \
+    {0, 0                     }, /* 0x02           */ \
+    {0, 0                     }, /* 0x03           */ \
+    {0, 0                     }, /* 0x04           */ \
+    {0, 0                     }, /* 0x05           */ \
+    {0, 0                     }, /* 0x06           */ \
+    {0, 0                     }, /* 0x07           */ \
+    {0, HID_KEY_BACKSPACE     }, /* 0x08 Backspace */ \
+    {0, HID_KEY_TAB           }, /* 0x09 Tab       */ \
+    {0, HID_KEY_ENTER         }, /* 0x0A Line Feed */ \
+    {0, 0                     }, /* 0x0B           */ \
+    {0, 0                     }, /* 0x0C           */ \
+    {0, HID_KEY_ENTER         }, /* 0x0D CR        */ \
+    {0, 0                     }, /* 0x0E           */ \
+    {0, 0                     }, /* 0x0F           */ \
+    {0, 0                     }, /* 0x10           */ \
+    {0, 0                     }, /* 0x11           */ \
+    {0, 0                     }, /* 0x12           */ \
+    {0, 0                     }, /* 0x13           */ \
+    {0, 0                     }, /* 0x14           */ \
+    {0, 0                     }, /* 0x15           */ \
+    {0, 0                     }, /* 0x16           */ \
+    {0, 0                     }, /* 0x17           */ \
+    {0, 0                     }, /* 0x18           */ \
+    {0, 0                     }, /* 0x19           */ \
+    {0, 0                     }, /* 0x1A           */ \
+    {0, HID_KEY_ESCAPE        }, /* 0x1B Escape    */ \
+    {0, 0                     }, /* 0x1C           */ \
+    {0, 0                     }, /* 0x1D           */ \
+    {0, 0                     }, /* 0x1E           */ \
+    {0, 0                     }, /* 0x1F           */ \
+                                                      \
+    {0, HID_KEY_SPACE         }, /* 0x20           */ \
+    {1, HID_KEY_1             }, /* 0x21 !         */ \
+    {1, HID_KEY_APOSTROPHE    }, /* 0x22 "         */ \
+    {1, HID_KEY_3             }, /* 0x23 #         */ \
+    {1, HID_KEY_4             }, /* 0x24 $         */ \
+    {1, HID_KEY_5             }, /* 0x25 %         */ \
+    {1, HID_KEY_7             }, /* 0x26 &         */ \
+    {0, HID_KEY_APOSTROPHE    }, /* 0x27 '         */ \
+    {1, HID_KEY_9             }, /* 0x28 (         */ \
+    {1, HID_KEY_0             }, /* 0x29 )         */ \
+    {1, HID_KEY_8             }, /* 0x2A *         */ \
+    {1, HID_KEY_EQUAL         }, /* 0x2B +         */ \
+    {0, HID_KEY_COMMA         }, /* 0x2C ,         */ \
+    {0, HID_KEY_MINUS         }, /* 0x2D -         */ \
+    {0, HID_KEY_PERIOD        }, /* 0x2E .         */ \
+    {0, HID_KEY_SLASH         }, /* 0x2F /         */ \
+    {0, HID_KEY_0             }, /* 0x30 0         */ \
+    {0, HID_KEY_1             }, /* 0x31 1         */ \
+    {0, HID_KEY_2             }, /* 0x32 2         */ \
+    {0, HID_KEY_3             }, /* 0x33 3         */ \
+    {0, HID_KEY_4             }, /* 0x34 4         */ \
+    {0, HID_KEY_5             }, /* 0x35 5         */ \
+    {0, HID_KEY_6             }, /* 0x36 6         */ \
+    {0, HID_KEY_7             }, /* 0x37 7         */ \
+    {0, HID_KEY_8             }, /* 0x38 8         */ \
+    {0, HID_KEY_9             }, /* 0x39 9         */ \
+    {1, HID_KEY_SEMICOLON     }, /* 0x3A :         */ \
+    {0, HID_KEY_SEMICOLON     }, /* 0x3B ;         */ \
+    {1, HID_KEY_COMMA         }, /* 0x3C <         */ \
+    {0, HID_KEY_EQUAL         }, /* 0x3D =         */ \
+    {1, HID_KEY_PERIOD        }, /* 0x3E >         */ \
+    {1, HID_KEY_SLASH         }, /* 0x3F ?         */ \
+                                                      \
+    {1, HID_KEY_2             }, /* 0x40 @         */ \
+    {1, HID_KEY_A             }, /* 0x41 A         */ \
+    {1, HID_KEY_B             }, /* 0x42 B         */ \
+    {1, HID_KEY_C             }, /* 0x43 C         */ \
+    {1, HID_KEY_D             }, /* 0x44 D         */ \
+    {1, HID_KEY_E             }, /* 0x45 E         */ \
+    {1, HID_KEY_F             }, /* 0x46 F         */ \
+    {1, HID_KEY_G             }, /* 0x47 G         */ \
+    {1, HID_KEY_H             }, /* 0x48 H         */ \
+    {1, HID_KEY_I             }, /* 0x49 I         */ \
+    {1, HID_KEY_J             }, /* 0x4A J         */ \
+    {1, HID_KEY_K             }, /* 0x4B K         */ \
+    {1, HID_KEY_L             }, /* 0x4C L         */ \
+    {1, HID_KEY_M             }, /* 0x4D M         */ \
+    {1, HID_KEY_N             }, /* 0x4E N         */ \
+    {1, HID_KEY_O             }, /* 0x4F O         */ \
+    {1, HID_KEY_P             }, /* 0x50 P         */ \
+    {1, HID_KEY_Q             }, /* 0x51 Q         */ \
+    {1, HID_KEY_R             }, /* 0x52 R         */ \
+    {1, HID_KEY_S             }, /* 0x53 S         */ \
+    {1, HID_KEY_T             }, /* 0x54 T         */ \
+    {1, HID_KEY_U             }, /* 0x55 U         */ \
+    {1, HID_KEY_V             }, /* 0x56 V         */ \
+    {1, HID_KEY_W             }, /* 0x57 W         */ \
+    {1, HID_KEY_X             }, /* 0x58 X         */ \
+    {1, HID_KEY_Y             }, /* 0x59 Y         */ \
+    {1, HID_KEY_Z             }, /* 0x5A Z         */ \
+    {0, HID_KEY_BRACKET_LEFT  }, /* 0x5B [         */ \
+    {0, HID_KEY_BACKSLASH     }, /* 0x5C '\'       */ \
+    {0, HID_KEY_BRACKET_RIGHT }, /* 0x5D ]         */ \
+    {1, HID_KEY_6             }, /* 0x5E ^         */ \
+    {1, HID_KEY_MINUS         }, /* 0x5F _         */ \
+                                                      \
+    {0, HID_KEY_GRAVE         }, /* 0x60 `         */ \
+    {0, HID_KEY_A             }, /* 0x61 a         */ \
+    {0, HID_KEY_B             }, /* 0x62 b         */ \
+    {0, HID_KEY_C             }, /* 0x63 c         */ \
+    {0, HID_KEY_D             }, /* 0x64 d         */ \
+    {0, HID_KEY_E             }, /* 0x65 e         */ \
+    {0, HID_KEY_F             }, /* 0x66 f         */ \
+    {0, HID_KEY_G             }, /* 0x67 g         */ \
+    {0, HID_KEY_H             }, /* 0x68 h         */ \
+    {0, HID_KEY_I             }, /* 0x69 i         */ \
+    {0, HID_KEY_J             }, /* 0x6A j         */ \
+    {0, HID_KEY_K             }, /* 0x6B k         */ \
+    {0, HID_KEY_L             }, /* 0x6C l         */ \
+    {0, HID_KEY_M             }, /* 0x6D m         */ \
+    {0, HID_KEY_N             }, /* 0x6E n         */ \
+    {0, HID_KEY_O             }, /* 0x6F o         */ \
+    {0, HID_KEY_P             }, /* 0x70 p         */ \
+    {0, HID_KEY_Q             }, /* 0x71 q         */ \
+    {0, HID_KEY_R             }, /* 0x72 r         */ \
+    {0, HID_KEY_S             }, /* 0x73 s         */ \
+    {0, HID_KEY_T             }, /* 0x74 t         */ \
+    {0, HID_KEY_U             }, /* 0x75 u         */ \
+    {0, HID_KEY_V             }, /* 0x76 v         */ \
+    {0, HID_KEY_W             }, /* 0x77 w         */ \
+    {0, HID_KEY_X             }, /* 0x78 x         */ \
+    {0, HID_KEY_Y             }, /* 0x79 y         */ \
+    {0, HID_KEY_Z             }, /* 0x7A z         */ \
+    {1, HID_KEY_BRACKET_LEFT  }, /* 0x7B {         */ \
+    {1, HID_KEY_BACKSLASH     }, /* 0x7C |         */ \
+    {1, HID_KEY_BRACKET_RIGHT }, /* 0x7D }         */ \
+    {1, HID_KEY_GRAVE         }, /* 0x7E ~         */ \
+    {0, HID_KEY_DELETE        }  /* 0x7F Delete    */ \
+
+//--------------------------------------------------------------------+
+// HID report descriptor items
+//--------------------------------------------------------------------+
+
+#define HID_REPORT_DATA_0(data)
+#define HID_REPORT_DATA_1(data) , (data)
+#define HID_REPORT_DATA_2(data) , U16_TO_U8S_LE(data)
+#define HID_REPORT_ITEM(data, tag, type, size) \
+  (((tag) << 4) | ((type) << 2) | (size)) HID_REPORT_DATA_##size(data)
+
+enum { RI_TYPE_MAIN = 0, RI_TYPE_GLOBAL = 1, RI_TYPE_LOCAL = 2 };
+
+#define HID_INPUT(x)              HID_REPORT_ITEM(x, 8, RI_TYPE_MAIN, 1)
+#define HID_OUTPUT(x)             HID_REPORT_ITEM(x, 9, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION(x)         HID_REPORT_ITEM(x, 10, RI_TYPE_MAIN, 1)
+#define HID_FEATURE(x)            HID_REPORT_ITEM(x, 11, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION_END        HID_REPORT_ITEM(x, 12, RI_TYPE_MAIN, 0)
+
+#define HID_USAGE_PAGE(x)         HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE_PAGE_N(x, n)    HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, n)
+#define HID_LOGICAL_MIN(x)        HID_REPORT_ITEM(x, 1, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX(x)        HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX_N(x, n)   HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, n)
+#define HID_REPORT_SIZE(x)        HID_REPORT_ITEM(x, 7, RI_TYPE_GLOBAL, 1)
+#define HID_REPORT_ID(x)          HID_REPORT_ITEM(x, 8, RI_TYPE_GLOBAL, 1),
+#define HID_REPORT_COUNT(x)       HID_REPORT_ITEM(x, 9, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE(x)              HID_REPORT_ITEM(x, 0, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MIN(x)          HID_REPORT_ITEM(x, 1, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MAX(x)          HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, 1)
+
+#define HID_DATA                  (0 << 0)
+#define HID_CONSTANT              (1 << 0)
+#define HID_ARRAY                 (0 << 1)
+#define HID_VARIABLE              (1 << 1)
+#define HID_ABSOLUTE              (0 << 2)
+#define HID_RELATIVE              (1 << 2)
+
+#define HID_COLLECTION_APPLICATION 1
+#define HID_USAGE_PAGE_DESKTOP    0x01
+#define HID_USAGE_PAGE_KEYBOARD   0x07
+#define HID_USAGE_PAGE_BUTTON     0x09
+#define HID_USAGE_PAGE_CONSUMER   0x0c
+#define HID_USAGE_PAGE_VENDOR     0xFF00
+
+// Shortened but well formed versions of TinyUSB's report descriptor
+// templates, with the same report layouts
+#define TUD_HID_REPORT_DESC_KEYBOARD(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+  HID_USAGE      ( 0x06 ), \
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+    __VA_ARGS__ \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ), \
+    HID_USAGE_MIN  ( 224 ), HID_USAGE_MAX ( 231 ), \
+    HID_LOGICAL_MIN ( 0 ), HID_LOGICAL_MAX ( 1 ), \
+    HID_REPORT_COUNT ( 8 ), HID_REPORT_SIZE ( 1 ), \
+    HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+    HID_REPORT_COUNT ( 1 ), HID_REPORT_SIZE ( 8 ), \
+    HID_INPUT ( HID_CONSTANT ), \
+    HID_REPORT_COUNT ( 6 ), HID_REPORT_SIZE ( 8 ), \
+    HID_USAGE_MIN ( 0 ), HID_USAGE_MAX ( 255 ), \
+    HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ), \
+  HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_MOUSE(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+  HID_USAGE      ( 0x02 ), \
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+    __VA_ARGS__ \
+    HID_REPORT_COUNT ( 5 ), HID_REPORT_SIZE ( 8 ), \
+    HID_INPUT ( HID_DATA | HID_VARIABLE | HID_RELATIVE ), \
+  HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_CONSUMER(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_CONSUMER ), \
+  HID_USAGE      ( 0x01 ), \
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+    __VA_ARGS__ \
+    HID_REPORT_COUNT ( 1 ), HID_REPORT_SIZE ( 16 ), \
+    HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ), \
+  HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_GAMEPAD(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+  HID_USAGE      ( 0x05 ), \
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+    __VA_ARGS__ \
+    HID_REPORT_COUNT ( 11 ), HID_REPORT_SIZE ( 8 ), \
+    HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+  HID_COLLECTION_END
+
+//--------------------------------------------------------------------+
+// Configuration descriptor templates
+//--------------------------------------------------------------------+
+
+#define TUD_CONFIG_DESC_LEN (9)
+
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len, _attribute, _power_ma) \
+  9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount, config_num, _stridx, TU_BIT(7) | _attribute, (_power_ma)/2
+
+#define TUD_HID_DESC_LEN (9 + 9 + 7)
+
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize, _ep_interval) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_HID, (uint8_t)((_boot_protocol) ? (uint8_t)HID_SUBCLASS_BOOT : 0), _boot_protocol, _stridx,\
+  /* HID descriptor */\
+  9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(_report_desc_len),\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
+//--------------------------------------------------------------------+
+// Device stack API (test/sim/sim.c)
+//--------------------------------------------------------------------+
+
+bool tud_init(uint8_t rhport);
+void tud_task(void);
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+bool tud_connect(void);
+bool tud_disconnect(void);
+void tud_sof_cb_enable(bool en);
+
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report,
+                      uint16_t len);
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id,
+                               uint8_t modifier, uint8_t const keycode[6]);
+
+static inline bool tud_hid_ready(void) { return tud_hid_n_ready(0); }
+
+static inline bool tud_hid_report(uint8_t report_id, void const *report,
+                                  uint16_t len) {
+  return tud_hid_n_report(0, report_id, report, len);
+}
+
+// Application callbacks
+uint8_t const *tud_descriptor_device_cb(void);
+uint8_t const *tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance);
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id,
+                               hid_report_type_t report_type, uint8_t *buffer,
+                               uint16_t reqlen);
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
+                           hid_report_type_t report_type, uint8_t const *buffer,
+                           uint16_t bufsize);
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report,
+                                uint16_t len);
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+void tud_sof_cb(uint32_t frame_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_STUBS_TUSB_H_ */
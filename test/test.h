@@ -0,0 +1,58 @@
+/*
+ * Minimal checks for the host tests. A test executable runs its cases from
+ * main() and returns test_result(); benchmarks print "bench:" lines.
+ */
+
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+static int test_failures;
+
+#define CHECK(cond)                                                          \
+  do {                                                                       \
+    if (!(cond)) {                                                           \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,       \
+              #cond);                                                        \
+      test_failures++;                                                       \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                       \
+  do {                                                                       \
+    long long const a_ = (long long)(a);                                     \
+    long long const b_ = (long long)(b);                                     \
+    if (a_ != b_) {                                                          \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",      \
+              __FILE__, __LINE__, #a, #b, a_, b_);                           \
+      test_failures++;                                                       \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_STR(a, b)                                                      \
+  do {                                                                       \
+    char const *a_ = (a);                                                    \
+    char const *b_ = (b);                                                    \
+    if (strcmp(a_, b_) != 0) {                                               \
+      fprintf(stderr, "%s:%d: CHECK_STR(%s, %s) failed: \"%s\" != \"%s\"\n", \
+              __FILE__, __LINE__, #a, #b, a_, b_);                           \
+      test_failures++;                                                       \
+    }                                                                        \
+  } while (0)
+
+#define RUN(test)                                                            \
+  do {                                                                       \
+    int const before_ = test_failures;                                       \
+    test();                                                                  \
+    printf("%s %s\n", test_failures == before_ ? "ok  " : "FAIL", #test);    \
+  } while (0)
+
+static inline int test_result(void) {
+  if (test_failures)
+    fprintf(stderr, "%d check(s) failed\n", test_failures);
+  return test_failures ? 1 : 0;
+}
+
+#endif /* TEST_TEST_H_ */
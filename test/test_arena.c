@@ -0,0 +1,95 @@
+/*
+ * Buffer arena (hid_arena.h), and the arena sizing in app_config.h against
+ * what the modules take at init with every arena user built in.
+ */
+
+#include <stdint.h>
+
+#include "app_config.h"
+#include "clock_sync.h"
+#include "hid_arena.h"
+#include "hid_ducky.h"
+#include "hid_edit.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "test.h"
+
+static bool all_zero(uint8_t const *p, size_t len) {
+  for (size_t i = 0; i < len; i++)
+    if (p[i])
+      return false;
+  return true;
+}
+
+static void test_alloc(void) {
+  hid_arena_init();
+  CHECK_EQ(hid_arena_size() % HID_ARENA_ALIGN, 0);
+  CHECK(hid_arena_size() >= CFG_APP_ARENA_SIZE);
+
+  uint8_t *a = hid_arena_alloc(1);
+  uint8_t *b = hid_arena_alloc(5);
+  uint8_t *c = hid_arena_alloc(HID_ARENA_ALIGN);
+  CHECK(a && b && c);
+  CHECK_EQ((uintptr_t)a % HID_ARENA_ALIGN, 0);
+  CHECK_EQ(b - a, HID_ARENA_ALIGN);
+  CHECK_EQ(c - b, 2 * HID_ARENA_ALIGN);
+  CHECK_EQ(hid_arena_used(), 4 * HID_ARENA_ALIGN);
+  CHECK_EQ(hid_arena_failures(), 0);
+
+  // Reused memory comes back zeroed, padding included
+  memset(a, 0xa5, hid_arena_used());
+  hid_arena_init();
+  CHECK_EQ(hid_arena_used(), 0);
+  uint8_t *again = hid_arena_alloc(4 * HID_ARENA_ALIGN);
+  CHECK(again == a);
+  CHECK(all_zero(again, 4 * HID_ARENA_ALIGN));
+}
+
+static void test_exhaustion(void) {
+  hid_arena_init();
+  size_t const size = hid_arena_size();
+
+  CHECK(hid_arena_alloc(0) == NULL);
+  CHECK(hid_arena_alloc(size + 1) == NULL);
+  CHECK(hid_arena_alloc(SIZE_MAX) == NULL);
+  CHECK(hid_arena_alloc(SIZE_MAX - HID_ARENA_ALIGN + 2) == NULL);
+  CHECK_EQ(hid_arena_failures(), 4);
+  CHECK_EQ(hid_arena_used(), 0);
+
+  // Fills exactly, then nothing fits
+  CHECK(hid_arena_alloc(size - HID_ARENA_ALIGN) != NULL);
+  CHECK(hid_arena_alloc(HID_ARENA_ALIGN + 1) == NULL);
+  CHECK(hid_arena_alloc(HID_ARENA_ALIGN) != NULL);
+  CHECK_EQ(hid_arena_used(), size);
+  CHECK(hid_arena_alloc(1) == NULL);
+  CHECK_EQ(hid_arena_failures(), 6);
+
+  // The high water mark outlives init, the failures do not
+  hid_arena_init();
+  CHECK_EQ(hid_arena_high_water(), size);
+  CHECK_EQ(hid_arena_failures(), 0);
+}
+
+static void test_sizing(void) {
+  // main()'s init order, with every arena user enabled in this build
+  hid_arena_init();
+  CHECK(hid_log_init());
+  CHECK(hid_tx_init());
+  CHECK(clock_sync_init());
+  CHECK(hid_edit_init());
+  static char const script[] = "STRING hello\n";
+  CHECK(hid_ducky_load(script, sizeof(script) - 1));
+
+  CHECK_EQ(hid_arena_failures(), 0);
+  CHECK_EQ(hid_arena_used(), HID_ARENA_ALIGN_UP(CFG_APP_ARENA_SIZE) -
+                                 CFG_APP_ARENA_SPARE);
+  printf("  arena %zu bytes, %zu used, %d spare\n", hid_arena_size(),
+         hid_arena_used(), CFG_APP_ARENA_SPARE);
+}
+
+int main(void) {
+  RUN(test_alloc);
+  RUN(test_exhaustion);
+  RUN(test_sizing);
+  return test_result();
+}
@@ -0,0 +1,138 @@
+/*
+ * Boot profile (boot_profile.h): phase end times of a simulated boot, as the
+ * board and the USB stack take their configured time, reported over the
+ * telemetry feature report; the record of the boot before a reboot.
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "boot_profile.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define BOARD_INIT_US   3000u
+#define TUD_INIT_US     1500u
+#define RUNTIME_INIT_US 300u
+
+typedef struct {
+  uint32_t times_us[BOOT_PHASE_COUNT];
+  bool have_current;
+  bool have_previous;
+  bool reported;      // the log carried the same times
+  uint64_t mount_us;
+} shared_t;
+
+static shared_t *shared;
+
+// Finds the record with the phase times in the drained log words
+static bool log_has_times(uint32_t const *words, size_t count,
+                          uint32_t const times_us[BOOT_PHASE_COUNT]) {
+  for (size_t i = 0; i + 2 <= count;) {
+    uint32_t const nargs = words[i] & 0xff;
+    if (nargs == BOOT_PHASE_COUNT && i + 2 + nargs <= count &&
+        memcmp(&words[i + 2], times_us, sizeof(uint32_t) * nargs) == 0)
+      return true;
+    i += 2 + nargs;
+  }
+  return false;
+}
+
+static void test_phases(void) {
+  fflush(stdout);
+  pid_t const pid = fork();
+  if (pid == 0) {
+    sim_reset();
+    sim.board_init_us = BOARD_INIT_US;
+    sim.tud_init_us = TUD_INIT_US;
+    sim_plug();
+    // The runtime initializes before main()
+    sim_advance(RUNTIME_INIT_US);
+    sim_run_app(200000);
+
+    shared->have_current = boot_profile_get(false, shared->times_us);
+    uint32_t previous[BOOT_PHASE_COUNT];
+    shared->have_previous = boot_profile_get(true, previous);
+    shared->mount_us = sim.mount_us;
+
+    // The host reads the log as tools/hid_log_decode.py --live does
+    static uint32_t words[1024];
+    size_t count = 0;
+    while (1) {
+      uint8_t buffer[VENDOR_FEATURE_LEN];
+      sim_get_report(0, REPORT_ID_TELEMETRY, HID_REPORT_TYPE_FEATURE, buffer,
+                     sizeof(buffer));
+      if (buffer[0] == 0 || count + buffer[0] > TU_ARRAY_SIZE(words))
+        break;
+      memcpy(&words[count], &buffer[1], 4u * buffer[0]);
+      count += buffer[0];
+    }
+    shared->reported = log_has_times(words, count, shared->times_us);
+    _exit(0);
+  }
+  int status;
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // Power on: no earlier boot
+  CHECK(shared->have_current);
+  CHECK(!shared->have_previous);
+
+  uint32_t const *t = shared->times_us;
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    CHECK(t[i] != 0);
+  for (int i = 1; i < BOOT_PHASE_COUNT; i++)
+    CHECK(t[i] >= t[i - 1]);
+  CHECK_EQ(t[BOOT_PHASE_MAIN], RUNTIME_INIT_US);
+  CHECK_EQ(t[BOOT_PHASE_BOARD_INIT] - t[BOOT_PHASE_MAIN], BOARD_INIT_US);
+  CHECK(t[BOOT_PHASE_TUD_INIT] - t[BOOT_PHASE_APP_INIT] >= TUD_INIT_US);
+  CHECK_EQ(t[BOOT_PHASE_MOUNT], shared->mount_us);
+  CHECK(shared->reported);
+
+  printf("  board %u us, app %u us, tud %u us, mount %u us\n",
+         t[BOOT_PHASE_BOARD_INIT] - t[BOOT_PHASE_MAIN],
+         t[BOOT_PHASE_APP_INIT] - t[BOOT_PHASE_BOARD_INIT],
+         t[BOOT_PHASE_TUD_INIT] - t[BOOT_PHASE_APP_INIT],
+         t[BOOT_PHASE_MOUNT]);
+}
+
+static void test_reboot(void) {
+  uint32_t first[BOOT_PHASE_COUNT], t[BOOT_PHASE_COUNT];
+
+  // This process never ran main(), its records are as after power on
+  sim_reset();
+  sim_advance(100);
+  boot_profile_start();
+  CHECK(!boot_profile_get(true, t));
+  sim_advance(2000);
+  boot_profile_mark(BOOT_PHASE_BOARD_INIT);
+  sim_advance(2000);
+  // Only the first time counts
+  boot_profile_mark(BOOT_PHASE_BOARD_INIT);
+  CHECK(boot_profile_get(false, first));
+  CHECK_EQ(first[BOOT_PHASE_MAIN], 100);
+  CHECK_EQ(first[BOOT_PHASE_BOARD_INIT], 2100);
+  CHECK_EQ(first[BOOT_PHASE_MOUNT], 0);
+
+  // A reboot keeps RAM: the record moves to previous
+  sim_reset();
+  boot_profile_start();
+  CHECK(boot_profile_get(true, t));
+  CHECK(memcmp(t, first, sizeof(t)) == 0);
+  CHECK(boot_profile_get(false, t));
+  CHECK_EQ(t[BOOT_PHASE_BOARD_INIT], 0);
+  // Reached right at reset, still not 0
+  CHECK(t[BOOT_PHASE_MAIN] != 0);
+}
+
+int main(void) {
+  shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+    return 1;
+  RUN(test_phases);
+  RUN(test_reboot);
+  return test_result();
+}
@@ -0,0 +1,177 @@
+/*
+ * Exactly-once typing of the demo text across bus resets and watchdog
+ * reboots (hid_checkpoint.h).
+ *
+ * Each boot of the firmware runs main() in a child process, so a reboot is
+ * the next child. The watchdog registers and the host live in shared memory:
+ * they outlast a reboot, and a power-on clears them. The host releases all
+ * keys of the device when the bus resets or the device reboots, as an OS
+ * does on a disconnect.
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hardware/watchdog.h"
+#include "hid_checkpoint.h"
+#include "host_kbd.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+// Long enough for the start delay and the whole text
+#define RUN_US 5000000u
+
+extern char const demo_text[];
+
+typedef struct {
+  watchdog_hw_t watchdog;
+  host_kbd_t kbd;
+  uint64_t first_us; // first and last keyboard report of the last boot
+  uint64_t last_us;
+  bool checkpoint_left;
+  int failures;
+} shared_t;
+
+static shared_t *shared;
+
+static void bus_reset(void *arg) {
+  (void)arg;
+  sim_bus_reset();
+}
+
+static void release_keys(host_kbd_t *kbd) {
+  memset(kbd->keys, 0, sizeof(kbd->keys));
+  memset(kbd->modifiers, 0, sizeof(kbd->modifiers));
+}
+
+static void power_on(void) {
+  memset(&shared->watchdog, 0, sizeof(shared->watchdog));
+  host_kbd_init(&shared->kbd);
+}
+
+// One boot that runs until until_us, with a bus reset at reset_us if not 0
+static void boot(uint64_t reset_us, uint64_t until_us) {
+  fflush(stdout);
+  pid_t const pid = fork();
+  if (pid == 0) {
+    sim_reset();
+    watchdog_hw = &shared->watchdog;
+    sim_plug();
+    if (reset_us)
+      sim_at(reset_us, bus_reset, NULL);
+    sim_run_app(until_us);
+
+    release_keys(&shared->kbd);
+    shared->first_us = shared->last_us = 0;
+    bool reset_seen = false;
+    for (size_t i = 0; i < sim_report_count; i++) {
+      sim_report_t const *r = &sim_reports[i];
+      if (reset_us && !reset_seen && r->time_us >= reset_us) {
+        release_keys(&shared->kbd);
+        reset_seen = true;
+      }
+      if (r->instance != 0 || r->data[0] != REPORT_ID_KEYBOARD)
+        continue;
+      if (!shared->first_us)
+        shared->first_us = r->time_us;
+      shared->last_us = r->time_us;
+      host_kbd_feed(&shared->kbd, r);
+    }
+    hid_checkpoint_t checkpoint;
+    shared->checkpoint_left = hid_checkpoint_get(&checkpoint);
+    shared->failures = test_failures;
+    fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  test_failures += shared->failures;
+}
+
+static uint64_t typing_first_us, typing_last_us;
+
+static void test_uninterrupted(void) {
+  power_on();
+  boot(0, RUN_US);
+  CHECK_STR(shared->kbd.text, demo_text);
+  CHECK(shared->first_us > 0);
+  typing_first_us = shared->first_us;
+  typing_last_us = shared->last_us;
+
+  // The last report cleared the checkpoint, also in the scratch registers
+  CHECK(!shared->checkpoint_left);
+  CHECK_EQ(shared->watchdog.scratch[0], 0);
+  printf("  typing from %.3f s to %.3f s\n", typing_first_us / 1e6,
+         typing_last_us / 1e6);
+}
+
+static void test_finished_runs_again(void) {
+  // A reboot after the text finished starts a new run
+  power_on();
+  boot(0, RUN_US);
+  boot(0, RUN_US);
+  char expected[64];
+  snprintf(expected, sizeof(expected), "%s%s", demo_text, demo_text);
+  CHECK_STR(shared->kbd.text, expected);
+}
+
+// Interruptions from just before the first report to just before the last
+// one, in steps that walk through the phases of the polling interval
+#define SWEEP(t) \
+  for (uint64_t t = typing_first_us - 1000; t < typing_last_us; t += 1700)
+
+static void test_bus_reset(void) {
+  unsigned runs = 0;
+  SWEEP(t) {
+    power_on();
+    boot(t, RUN_US);
+    if (strcmp(shared->kbd.text, demo_text) != 0)
+      printf("  bus reset at %.4f s: \"%s\"\n", t / 1e6, shared->kbd.text);
+    CHECK_STR(shared->kbd.text, demo_text);
+    CHECK(!shared->checkpoint_left);
+    runs++;
+  }
+  printf("  %u bus reset times\n", runs);
+}
+
+static void test_reboot(void) {
+  unsigned runs = 0;
+  SWEEP(t) {
+    power_on();
+    boot(0, t);
+    boot(0, RUN_US);
+    if (strcmp(shared->kbd.text, demo_text) != 0)
+      printf("  reboot at %.4f s: \"%s\"\n", t / 1e6, shared->kbd.text);
+    CHECK_STR(shared->kbd.text, demo_text);
+    CHECK(!shared->checkpoint_left);
+    runs++;
+  }
+  printf("  %u reboot times\n", runs);
+}
+
+static void test_power_on(void) {
+  // Power-on loses the checkpoint, the text starts over
+  power_on();
+  boot(0, (typing_first_us + typing_last_us) / 2);
+  CHECK(shared->checkpoint_left);
+  power_on();
+  boot(0, RUN_US);
+  CHECK_STR(shared->kbd.text, demo_text);
+}
+
+int main(void) {
+  shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+    return 1;
+  RUN(test_uninterrupted);
+  RUN(test_finished_runs_again);
+  RUN(test_bus_reset);
+  RUN(test_reboot);
+  RUN(test_power_on);
+  return test_result();
+}
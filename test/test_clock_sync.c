@@ -0,0 +1,251 @@
+/*
+ * Clock synchronization and scheduled reports (clock_sync.h) against a host
+ * whose clock drifts from the device's, over a link that is slower out than
+ * back. The host side does what tools/clock_sync_host.py does.
+ */
+
+#include <stdlib.h>
+
+#include "clock_sync.h"
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+
+// The host clock runs 50 ppm fast and started long before the device
+#define HOST_EPOCH_US  1700000000000000ull
+#define HOST_DRIFT_PPM 50
+
+// SET_REPORT takes longer to arrive than the GET_REPORT answer, an error
+// no round trip can see: the offset is off by half the difference
+#define OUT_US   600u
+#define BACK_US  200u
+#define BIAS_US  ((OUT_US - BACK_US) / 2)
+// A PING stuck behind other control transfers
+#define QUEUED_US 3000u
+
+#define PING_PERIOD_US 100000u
+
+static uint64_t host_at(uint64_t device_us) {
+  return HOST_EPOCH_US + device_us + device_us * HOST_DRIFT_PPM / 1000000;
+}
+
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  clock_sync_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+  for (int i = 0; i < 8; i++, v >>= 8)
+    p[i] = (uint8_t)v;
+}
+
+static uint64_t get_u64(uint8_t const *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+// The main loop
+static void spin(uint64_t us) {
+  uint64_t const end = sim.now_us + us;
+  while (sim.now_us < end) {
+    sim_advance(sim.loop_us);
+    clock_sync_task();
+    hid_tx_task();
+  }
+}
+
+//--------------------------------------------------------------------+
+// Host
+//--------------------------------------------------------------------+
+
+static struct {
+  uint8_t seq;
+  uint64_t prev_t4;
+  unsigned pings;
+  uint64_t next_ping;
+  // Last answer
+  bool valid;
+  int64_t offset;
+  int32_t drift_ppb;
+  uint64_t t3;
+} host;
+
+static void ping(void) {
+  uint8_t buffer[VENDOR_FEATURE_LEN] = {CLOCK_SYNC_OP_PING, ++host.seq};
+  put_u64(&buffer[2], host_at(sim.now_us));
+  buffer[10] = (uint8_t)(host.seq - 1);
+  put_u64(&buffer[11], host.prev_t4);
+
+  // Every seventh round trip is queued on the way out
+  spin(host.pings++ % 7 == 6 ? OUT_US + QUEUED_US : OUT_US);
+  sim_set_report(0, REPORT_ID_CLOCK_SYNC, HID_REPORT_TYPE_FEATURE, buffer,
+                 sizeof(buffer));
+  spin(1000);
+
+  CHECK_EQ(sim_get_report(0, REPORT_ID_CLOCK_SYNC, HID_REPORT_TYPE_FEATURE,
+                          buffer, sizeof(buffer)),
+           30);
+  CHECK_EQ(buffer[0], host.seq);
+  host.valid = buffer[1];
+  host.t3 = get_u64(&buffer[10]);
+  host.offset = (int64_t)get_u64(&buffer[18]);
+  host.drift_ppb = (int32_t)(buffer[26] | buffer[27] << 8 | buffer[28] << 16 |
+                             (uint32_t)buffer[29] << 24);
+  spin(BACK_US);
+  host.prev_t4 = host_at(sim.now_us);
+}
+
+static void schedule(uint8_t report_id, uint8_t key, uint64_t host_us) {
+  uint8_t buffer[VENDOR_FEATURE_LEN] = {CLOCK_SYNC_OP_SCHEDULE};
+  put_u64(&buffer[1], host_us);
+  buffer[9] = report_id;
+  // Keyboard: first key, mouse: y
+  buffer[10 + 2] = key;
+  sim_set_report(0, REPORT_ID_CLOCK_SYNC, HID_REPORT_TYPE_FEATURE, buffer,
+                 sizeof(buffer));
+}
+
+// The main loop, with the host pinging in the background
+static void run(uint64_t us) {
+  uint64_t const end = sim.now_us + us;
+  while (sim.now_us < end) {
+    if (sim.now_us >= host.next_ping) {
+      ping();
+      host.next_ping += PING_PERIOD_US;
+    }
+    spin(sim.loop_us);
+  }
+}
+
+static void sync(void) {
+  boot();
+  memset(&host, 0, sizeof(host));
+  host.next_ping = sim.now_us;
+  run(5000000);
+  CHECK(clock_sync_valid());
+}
+
+// The host's clock when the report with this report ID and key arrived
+static uint64_t arrival(uint8_t report_id, uint8_t key) {
+  for (size_t i = 0; i < sim_report_count; i++) {
+    sim_report_t const *r = &sim_reports[i];
+    if (r->data[0] == report_id && r->data[3] == key)
+      return host_at(r->time_us);
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_offset_and_drift(void) {
+  sync();
+
+  // The device - host offset at t3, as the model predicts it, against the
+  // true one plus the asymmetry bias
+  CHECK(host.valid);
+  int64_t const truth = (int64_t)(host.t3 - host_at(host.t3));
+  int64_t const error = host.offset - (truth + (int64_t)BIAS_US);
+  CHECK(llabs(error) <= 20);
+
+  // The device clock falls behind by the host's drift
+  CHECK(abs(host.drift_ppb + HOST_DRIFT_PPM * 1000) <= 2000);
+  printf("  offset error %lld us beyond the %u us bias, drift %d ppb\n",
+         (long long)error, BIAS_US, host.drift_ppb);
+}
+
+static void test_schedule(void) {
+  sync();
+  sim_clear_reports();
+
+  // The device thinks the host clock is BIAS_US behind, so it is late by
+  // that, plus the wait for the next poll
+  uint64_t const at = host_at(sim.now_us) + 500000;
+  schedule(REPORT_ID_KEYBOARD, 1, at);
+  run(600000);
+  CHECK_EQ(sim_report_count, 1);
+  uint64_t const got = arrival(REPORT_ID_KEYBOARD, 1);
+  CHECK(got + 50 >= at + BIAS_US);
+  CHECK(got <= at + BIAS_US + INTERVAL_US + sim.loop_us + 1000);
+  printf("  scheduled report arrived %lld us after its time\n",
+         (long long)(got - at));
+}
+
+static void test_schedule_order(void) {
+  sync();
+  sim_clear_reports();
+
+  // Scheduled out of order, sent in time order
+  uint64_t const at = host_at(sim.now_us) + 200000;
+  schedule(REPORT_ID_MOUSE, 3, at + 3 * 20000);
+  schedule(REPORT_ID_MOUSE, 1, at + 1 * 20000);
+  schedule(REPORT_ID_MOUSE, 2, at + 2 * 20000);
+  run(400000);
+  CHECK_EQ(sim_report_count, 3);
+  for (uint8_t i = 0; i < 3; i++)
+    CHECK_EQ(sim_reports[i].data[3], i + 1);
+  for (uint8_t i = 1; i <= 3; i++) {
+    uint64_t const got = arrival(REPORT_ID_MOUSE, i);
+    CHECK(got + 50 >= at + i * 20000u + BIAS_US);
+    CHECK(got <= at + i * 20000u + BIAS_US + INTERVAL_US + sim.loop_us + 1000);
+  }
+}
+
+static void test_schedule_does_not_block(void) {
+  sync();
+  sim_clear_reports();
+
+  // A key scheduled a second ahead does not hold back typing meanwhile
+  uint64_t const at = host_at(sim.now_us) + 1000000;
+  schedule(REPORT_ID_KEYBOARD, 9, at);
+  uint8_t report[8] = {0, 0, 4};
+  uint64_t const sent = sim.now_us;
+  CHECK(hid_tx_send(HID_TX_KEYBOARD, report, sizeof(report), 0));
+  run(3 * INTERVAL_US);
+  CHECK_EQ(sim_report_count, 1);
+  CHECK(sim_reports[0].time_us - sent <= 2 * INTERVAL_US);
+
+  run(1100000);
+  CHECK_EQ(sim_report_count, 2);
+  CHECK(arrival(REPORT_ID_KEYBOARD, 9) >= at);
+}
+
+static void test_schedule_limits(void) {
+  boot();
+  uint8_t const report[8] = {0};
+  // Not before the first round trip
+  CHECK(!clock_sync_send_at(REPORT_ID_KEYBOARD, report, 8, 0));
+
+  sync();
+  uint64_t const now = clock_sync_local_to_host(sim.now_us);
+  CHECK(!clock_sync_send_at(REPORT_ID_KEYBOARD, report, 8,
+                            now + 31ull * 60 * 1000000));
+  CHECK(!clock_sync_send_at(REPORT_ID_CLOCK_SYNC, report, 8, now + 1000));
+  for (unsigned i = 0; i < CFG_APP_CLOCK_SYNC_DEPTH; i++)
+    CHECK(clock_sync_send_at(REPORT_ID_KEYBOARD, report, 8, now + 1000000));
+  CHECK(!clock_sync_send_at(REPORT_ID_KEYBOARD, report, 8, now + 1000000));
+}
+
+int main(void) {
+  RUN(test_offset_and_drift);
+  RUN(test_schedule);
+  RUN(test_schedule_order);
+  RUN(test_schedule_does_not_block);
+  RUN(test_schedule_limits);
+  return test_result();
+}
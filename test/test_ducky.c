@@ -0,0 +1,357 @@
+/*
+ * DuckyScript (hid_ducky.h): compile errors and limits, and what the host
+ * types from a script: REPEAT of commands that take several instructions,
+ * REPEAT of REPEAT, DELAY counted from when the host has the last report,
+ * DEFAULT_DELAY between commands only, and key combinations.
+ *
+ *   test_ducky [corpus dir]
+ *
+ * With the directory of test/data/ducky every NAME.txt script there is run
+ * and the host's field must hold NAME.out afterwards; compile and run time
+ * are benchmarked over the corpus.
+ */
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hid_arena.h"
+#include "hid_ducky.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "host_kbd.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+
+static uint8_t code[CFG_APP_DUCKY_CODE_SIZE];
+
+static bool compile(char const *src, uint32_t *error_line) {
+  size_t code_len;
+  *error_line = 0;
+  return hid_ducky_compile(src, strlen(src), code, sizeof(code), &code_len,
+                           error_line);
+}
+
+static void test_compile_errors(void) {
+  uint32_t line;
+  CHECK(compile("REM only\n\nSTRING a\r\n", &line));
+
+  CHECK(!compile("STRING a\nBOGUS\n", &line));
+  CHECK_EQ(line, 2);
+  // Nothing to repeat
+  CHECK(!compile("REPEAT 2\n", &line));
+  CHECK_EQ(line, 1);
+  CHECK(!compile("DELAY 5x\n", &line));
+  CHECK_EQ(line, 1);
+  // A REPEAT of REPEAT adds to its count, which has 16 bits
+  CHECK(compile("STRING a\nREPEAT 65535\n", &line));
+  CHECK(!compile("STRING a\nREPEAT 65535\nREPEAT 1\n", &line));
+  CHECK_EQ(line, 3);
+
+  // Code buffer full
+  static char big[CFG_APP_DUCKY_CODE_SIZE + 64];
+  memcpy(big, "STRING ", 7);
+  memset(&big[7], 'a', sizeof(big) - 9);
+  big[sizeof(big) - 2] = '\n';
+  CHECK(!compile(big, &line));
+  CHECK_EQ(line, 1);
+}
+
+//--------------------------------------------------------------------+
+// Running scripts
+//--------------------------------------------------------------------+
+
+static host_kbd_t kbd;
+
+// Host time in the hid_ducky_task() calls that queued reports, and those
+// reports, over run()s
+static double task_s;
+static uint32_t task_reports;
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+// Runs a script to the end, the host types into an empty field
+static void run(char const *script) {
+  sim_clear_reports();
+  CHECK(hid_ducky_load(script, strlen(script)));
+  CHECK(hid_ducky_start((uint32_t)(sim.now_us / 1000)));
+  uint64_t const end = sim.now_us + 60000000;
+  while (sim.now_us < end) {
+    sim_advance(sim.loop_us);
+    hid_tx_task();
+    hid_ducky_stats_t stats;
+    hid_ducky_get_stats(&stats);
+    uint32_t const reports = stats.reports;
+    double const t0 = seconds();
+    bool const running = hid_ducky_task((uint32_t)(sim.now_us / 1000));
+    double const dt = seconds() - t0;
+    // Calls that only wait for the queue or a delay do not count
+    hid_ducky_get_stats(&stats);
+    if (stats.reports != reports) {
+      task_s += dt;
+      task_reports += stats.reports - reports;
+    }
+    if (!running && hid_tx_idle(HID_TX_KEYBOARD))
+      break;
+  }
+  CHECK(sim.now_us < end);
+  host_kbd_init(&kbd);
+  host_kbd_feed_all(&kbd);
+}
+
+static void test_repeat_stringln(void) {
+  run("STRINGLN ab\nREPEAT 2\n");
+  CHECK_STR(kbd.text, "ab\nab\nab\n");
+}
+
+static void test_repeat_long_string(void) {
+  // 300 characters take two TEXT instructions
+  static char script[400], text[700];
+  char *p = script + sprintf(script, "STRING ");
+  for (int i = 0; i < 300; i++)
+    *p++ = (char)('a' + i % 26);
+  strcpy(p, "\nREPEAT 1\n");
+  memcpy(text, &script[7], 300);
+  memcpy(&text[300], &script[7], 300);
+  text[600] = 0;
+
+  run(script);
+  CHECK_STR(kbd.text, text);
+}
+
+static void test_repeat_of_repeat(void) {
+  run("STRING x\nREPEAT 2\nREPEAT 3\nSTRING y\n");
+  CHECK_STR(kbd.text, "xxxxxxy");
+}
+
+static void test_repeat_combo(void) {
+  run("STRING hello\nBACKSPACE\nREPEAT 1\nSTRING p\n");
+  CHECK_STR(kbd.text, "help");
+}
+
+// Time the host fetched the n-th keyboard report pressing key
+static uint64_t press_time(uint8_t key, int n) {
+  for (size_t i = 0; i < sim_report_count; i++) {
+    sim_report_t const *r = &sim_reports[i];
+    if (r->instance == 0 && r->data[0] == REPORT_ID_KEYBOARD &&
+        r->data[3] == key && n-- == 0)
+      return r->time_us;
+  }
+  return 0;
+}
+
+// The delay starts once the host has the release of the a, not when it
+// was only queued or on the endpoint
+static void test_delay_after_in_flight(void) {
+  run("STRING a\nDELAY 50\nSTRING b\n");
+  CHECK_STR(kbd.text, "ab");
+  uint64_t const a = press_time(HID_KEY_A, 0);
+  uint64_t const b = press_time(HID_KEY_B, 0);
+  CHECK(a && b);
+  // a, its release one interval later, then the delay
+  CHECK(b - a >= INTERVAL_US + 50000);
+  CHECK(b - a <= 2 * INTERVAL_US + 50000 + 1000);
+  printf("  a to b %.1f ms\n", (b - a) / 1000.0);
+}
+
+static void test_repeat_delay(void) {
+  run("STRING a\nDELAY 20\nREPEAT 2\nSTRING b\n");
+  CHECK_STR(kbd.text, "ab");
+  uint64_t const a = press_time(HID_KEY_A, 0);
+  uint64_t const b = press_time(HID_KEY_B, 0);
+  CHECK(b - a >= INTERVAL_US + 3 * 20000);
+}
+
+// DEFAULT_DELAY follows every command, but not the instructions within
+// one: the ENTER of a STRINGLN, the second piece of a long STRING
+static void test_default_delay(void) {
+  run("DEFAULT_DELAY 30\nSTRINGLN ab\nSTRING c\n");
+  CHECK_STR(kbd.text, "ab\nc");
+  uint64_t const b = press_time(HID_KEY_B, 0);
+  uint64_t const enter = press_time(HID_KEY_ENTER, 0);
+  uint64_t const c = press_time(HID_KEY_C, 0);
+  // b, the release, ENTER
+  CHECK(enter - b <= 2 * INTERVAL_US + 1000);
+  // ENTER, the release, the default delay, c
+  CHECK(c - enter >= INTERVAL_US + 30000);
+
+  // 256 characters take two TEXT instructions, the last is a z
+  static char script[400];
+  char *p = script + sprintf(script, "DEFAULT_DELAY 30\nSTRING ");
+  for (int i = 0; i < 255; i++)
+    *p++ = (char)('a' + i % 25);
+  strcpy(p, "z\n");
+  run(script);
+  uint64_t const y = press_time(HID_KEY_A + 254 % 25, 10);
+  uint64_t const z = press_time(HID_KEY_Z, 0);
+  CHECK(y && z);
+  CHECK(z - y <= 2 * INTERVAL_US + 1000);
+
+  // Off again
+  run("DEFAULT_DELAY 30\nSTRING a\nDEFAULT_DELAY 0\nSTRING b\nSTRING c\n");
+  CHECK_STR(kbd.text, "abc");
+  CHECK(press_time(HID_KEY_C, 0) - press_time(HID_KEY_B, 0) <=
+        2 * INTERVAL_US + 1000);
+}
+
+// A combination goes down in one report and up in the next
+static void check_combo(char const *line, uint8_t modifier, uint8_t key) {
+  char script[64];
+  snprintf(script, sizeof(script), "%s\n", line);
+  run(script);
+  size_t n = 0;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    uint8_t const *r = sim_reports[i].data;
+    if (sim_reports[i].instance != 0 || r[0] != REPORT_ID_KEYBOARD)
+      continue;
+    if (n == 0) {
+      CHECK_EQ(r[1], modifier);
+      CHECK_EQ(r[3], key);
+    } else {
+      CHECK_EQ(r[1], 0);
+      CHECK_EQ(r[3], 0);
+    }
+    n++;
+  }
+  CHECK_EQ(n, 2);
+  if (test_failures)
+    printf("  %s\n", line);
+}
+
+static void test_combos(void) {
+  check_combo("GUI r", KEYBOARD_MODIFIER_LEFTGUI, HID_KEY_R);
+  check_combo("WINDOWS R", KEYBOARD_MODIFIER_LEFTGUI, HID_KEY_R);
+  check_combo("CTRL ALT DELETE",
+              KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTALT,
+              HID_KEY_DELETE);
+  check_combo("CTRL-SHIFT ESC",
+              KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT,
+              HID_KEY_ESCAPE);
+  check_combo("ALT F4", KEYBOARD_MODIFIER_LEFTALT, HID_KEY_F4);
+  check_combo("SHIFT", KEYBOARD_MODIFIER_LEFTSHIFT, 0);
+  check_combo("ENTER", 0, HID_KEY_ENTER);
+
+  // None of them types into the field
+  run("STRING a\nGUI r\nCTRL ALT DELETE\nCTRL-SHIFT ESC\nSTRING b\n");
+  CHECK_STR(kbd.text, "ab");
+
+  uint32_t line;
+  CHECK(!compile("CTRL ALT DELETE ESC\n", &line));
+  CHECK(!compile("GUI FOO\n", &line));
+}
+
+//--------------------------------------------------------------------+
+// Corpus
+//--------------------------------------------------------------------+
+
+static char const *corpus_dir;
+
+static char *read_file(char const *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long const size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *data = malloc((size_t)size + 1);
+  *len = fread(data, 1, (size_t)size, f);
+  data[*len] = 0;
+  fclose(f);
+  return data;
+}
+
+static int by_name(void const *a, void const *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void test_corpus(void) {
+  DIR *dir = opendir(corpus_dir);
+  CHECK(dir);
+  if (!dir)
+    return;
+  char *names[64];
+  size_t count = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) && count < TU_ARRAY_SIZE(names)) {
+    size_t const n = strlen(ent->d_name);
+    if (n > 4 && strcmp(&ent->d_name[n - 4], ".txt") == 0)
+      names[count++] = strndup(ent->d_name, n - 4);
+  }
+  closedir(dir);
+  CHECK(count > 0);
+  qsort(names, count, sizeof(names[0]), by_name);
+
+  size_t script_bytes = 0;
+  double compile_s = 0;
+  task_s = 0;
+  task_reports = 0;
+  for (size_t i = 0; i < count; i++) {
+    char path[512];
+    size_t len, out_len;
+    snprintf(path, sizeof(path), "%s/%s.txt", corpus_dir, names[i]);
+    char *const script = read_file(path, &len);
+    snprintf(path, sizeof(path), "%s/%s.out", corpus_dir, names[i]);
+    char *const expected = read_file(path, &out_len);
+    CHECK(script && expected);
+    if (script && expected) {
+      int const before = test_failures;
+      run(script);
+      CHECK_STR(kbd.text, expected);
+      if (test_failures != before)
+        printf("  %s\n", names[i]);
+
+      // Compiling is quick, many rounds for the time
+      size_t code_len;
+      uint32_t line;
+      double const t0 = seconds();
+      for (int r = 0; r < 1000; r++)
+        CHECK(hid_ducky_compile(script, len, code, sizeof(code), &code_len,
+                                &line));
+      compile_s += (seconds() - t0) / 1000;
+      script_bytes += len;
+    }
+    free(script);
+    free(expected);
+    free(names[i]);
+  }
+  printf("bench: ducky corpus %zu scripts, compile %.1f ns/byte, "
+         "run %.1f ns/report over %u reports\n",
+         count, compile_s / script_bytes * 1e9, task_s / task_reports * 1e9,
+         task_reports);
+}
+
+int main(int argc, char **argv) {
+  RUN(test_compile_errors);
+  boot();
+  RUN(test_repeat_stringln);
+  RUN(test_repeat_long_string);
+  RUN(test_repeat_of_repeat);
+  RUN(test_repeat_combo);
+  RUN(test_delay_after_in_flight);
+  RUN(test_repeat_delay);
+  RUN(test_default_delay);
+  RUN(test_combos);
+  if (argc > 1) {
+    corpus_dir = argv[1];
+    RUN(test_corpus);
+  }
+  return test_result();
+}
@@ -0,0 +1,214 @@
+/*
+ * Incremental text update (hid_edit.h), typed into the host keyboard
+ * model's field: the field ends up holding the target, the diff deletes and
+ * types no more characters than the edit distance, and a field left unknown
+ * by an abandoned update is cleared before the target is typed in full.
+ */
+
+#include <stdlib.h>
+
+#include "hid_arena.h"
+#include "hid_edit.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "host_kbd.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+static host_kbd_t kbd;
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  CHECK(hid_edit_init());
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+  host_kbd_init(&kbd);
+}
+
+static void loop(void) {
+  sim_advance(sim.loop_us);
+  hid_tx_task();
+}
+
+// Key strokes of the last update, by what they did to the field
+typedef struct {
+  uint32_t keys;
+  uint32_t deleted; // Backspace and Delete
+  uint32_t typed;   // characters
+} strokes_t;
+
+static strokes_t strokes(void) {
+  strokes_t s = {0};
+  for (size_t i = 0; i < sim_report_count; i++) {
+    uint8_t const key = sim_reports[i].data[3]; // keycode[0]
+    if (!key)
+      continue;
+    s.keys++;
+    if (key == HID_KEY_BACKSPACE || key == HID_KEY_DELETE)
+      s.deleted++;
+    else if (key != HID_KEY_HOME && key != HID_KEY_END &&
+             key != HID_KEY_ARROW_LEFT && key != HID_KEY_ARROW_RIGHT)
+      s.typed++;
+  }
+  return s;
+}
+
+// Runs an update to the end, the host applies it to its field
+static strokes_t type(char const *target) {
+  sim_clear_reports();
+  CHECK(hid_edit_type(target));
+  uint64_t const end = sim.now_us + 60000000;
+  while (sim.now_us < end) {
+    loop();
+    if (!hid_edit_task() && hid_tx_idle(HID_TX_KEYBOARD))
+      break;
+  }
+  CHECK(sim.now_us < end);
+  for (size_t i = 0; i < sim_report_count; i++)
+    host_kbd_feed(&kbd, &sim_reports[i]);
+  CHECK_STR(kbd.text, target);
+  CHECK_EQ(kbd.cursor, kbd.len);
+  return strokes();
+}
+
+// Characters deleted plus inserted by the shortest edit of a into b
+static uint32_t edit_distance(char const *a, char const *b) {
+  static uint16_t lcs[CFG_APP_EDIT_MAX_TEXT][CFG_APP_EDIT_MAX_TEXT];
+  size_t const n = strlen(a), m = strlen(b);
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= m; j++) {
+      if (!i || !j)
+        lcs[i][j] = 0;
+      else if (a[i - 1] == b[j - 1])
+        lcs[i][j] = lcs[i - 1][j - 1] + 1;
+      else
+        lcs[i][j] = TU_MAX(lcs[i - 1][j], lcs[i][j - 1]);
+    }
+  }
+  return (uint32_t)(n + m - 2u * lcs[n][m]);
+}
+
+static void test_updates(void) {
+  boot();
+  char const *const texts[] = {
+      "hello world", "hello, world", "Hello world!", "help",
+      "", "aaa", "abab", "baba", "The quick brown fox",
+      "The quick red fox jumps", "quick fox"};
+  char const *old = "";
+  for (size_t i = 0; i < TU_ARRAY_SIZE(texts); i++) {
+    strokes_t const s = type(texts[i]);
+    hid_edit_stats_t stats;
+    hid_edit_get_stats(&stats);
+    CHECK_EQ(s.deleted + s.typed, edit_distance(old, texts[i]));
+    CHECK_EQ(s.keys, stats.keys);
+    old = texts[i];
+  }
+}
+
+// Random texts and random edits of them, within CFG_APP_EDIT_MAX_D
+static void test_minimal(void) {
+  boot();
+  static char old[CFG_APP_EDIT_MAX_TEXT], target[CFG_APP_EDIT_MAX_TEXT];
+  uint32_t keys = 0, full_keys = 0;
+  srand(1);
+  size_t len = 0;
+  for (int round = 0; round < 200; round++) {
+    memcpy(old, kbd.text, kbd.len + 1u);
+    len = kbd.len;
+    if (round % 20 == 0) {
+      // A new text now and then
+      len = 20 + rand() % 80;
+      for (size_t i = 0; i < len; i++)
+        target[i] = (char)('a' + rand() % 4);
+    } else {
+      memcpy(target, old, len);
+      for (int e = 1 + rand() % 8; e; e--) {
+        size_t const at = len ? rand() % (len + 1) : 0;
+        if (len && at < len && rand() % 2) {
+          memmove(&target[at], &target[at + 1], len - at - 1);
+          len--;
+        } else if (len < sizeof(target) - 1) {
+          memmove(&target[at + 1], &target[at], len - at);
+          target[at] = (char)('a' + rand() % 4);
+          len++;
+        }
+      }
+    }
+    target[len] = 0;
+
+    strokes_t const s = type(target);
+    uint32_t const d = edit_distance(old, target);
+    if (d <= CFG_APP_EDIT_MAX_D) {
+      CHECK_EQ(s.deleted + s.typed, d);
+    }
+    hid_edit_stats_t stats;
+    hid_edit_get_stats(&stats);
+    keys += stats.keys;
+    full_keys += stats.full_keys;
+    if (test_failures) {
+      printf("  round %d: \"%s\" -> \"%s\"\n", round, old, target);
+      return;
+    }
+  }
+  printf("bench: edit %u keys instead of %u\n", keys, full_keys);
+}
+
+// Beyond CFG_APP_EDIT_MAX_D the changed middle is replaced as one block
+static void test_too_different(void) {
+  boot();
+  static char a[CFG_APP_EDIT_MAX_TEXT], b[CFG_APP_EDIT_MAX_TEXT];
+  size_t const n = 2 * CFG_APP_EDIT_MAX_D + 10;
+  for (size_t i = 0; i < n; i++) {
+    a[i] = (char)('a' + i % 2);
+    b[i] = (char)('c' + i % 2);
+  }
+  a[0] = b[0] = 'x';
+  a[n - 1] = b[n - 1] = 'y';
+  type(a);
+  strokes_t const s = type(b);
+  CHECK_EQ(s.deleted, n - 2);
+  CHECK_EQ(s.typed, n - 2);
+}
+
+static void test_unknown_field(void) {
+  boot();
+  type("some text in the field");
+
+  // Abandoned part way, some of it reached the field
+  sim_clear_reports();
+  CHECK(hid_edit_type("other text"));
+  while (sim_report_count < 6) {
+    loop();
+    hid_edit_task();
+  }
+  hid_edit_abort();
+  while (!hid_tx_idle(HID_TX_KEYBOARD))
+    loop();
+  for (size_t i = 0; i < sim_report_count; i++)
+    host_kbd_feed(&kbd, &sim_reports[i]);
+
+  // Cleared, whatever it holds, then typed in full
+  strokes_t const s = type("new");
+  hid_edit_stats_t stats;
+  hid_edit_get_stats(&stats);
+  CHECK_EQ(s.typed, 3);
+  CHECK_EQ(stats.keys, 3 + 3);
+  CHECK_EQ(stats.full_keys, stats.keys);
+
+  // Known again
+  CHECK_EQ(type("news").keys, 1);
+}
+
+int main(void) {
+  RUN(test_updates);
+  RUN(test_minimal);
+  RUN(test_too_different);
+  RUN(test_unknown_field);
+  return test_result();
+}
@@ -0,0 +1,158 @@
+/*
+ * Transport faults from the simulated host (sim_inject_faults()): a mouse
+ * report stream under NAK storms, delayed completions, bus resets, suspends
+ * and spurious SET_REPORTs, for several seeds. The host must get the stream
+ * in order and without duplicates, lose only what hid_tx_flush() dropped,
+ * and see the stream recover quickly. A suspend with a report on the
+ * endpoint must not lose it.
+ */
+
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+#define RUN_US      40000000u
+#define PERIOD_US   2000000u
+
+// Plug in to mount
+static uint64_t enumeration_us;
+
+static void boot(uint32_t seed) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+  enumeration_us = sim.mount_us;
+  if (seed)
+    sim_inject_faults(seed, PERIOD_US);
+}
+
+static uint16_t seq;
+static bool producing;
+
+// The mouse queue is kept full while mounted
+static void produce(void) {
+  while (producing && tud_mounted()) {
+    uint8_t report[5] = {0, (uint8_t)seq, (uint8_t)(seq >> 8)};
+    if (!hid_tx_send(HID_TX_MOUSE, report, sizeof(report), 0))
+      return;
+    seq++;
+  }
+}
+
+// The main loop, with the flush of tud_umount_cb()
+static void loop(void) {
+  sim_advance(sim.loop_us);
+  if (!tud_mounted())
+    hid_tx_flush();
+  produce();
+  hid_tx_task();
+}
+
+static uint16_t seq_of(sim_report_t const *r) {
+  return (uint16_t)(r->data[2] | r->data[3] << 8);
+}
+
+static void soak(uint32_t seed) {
+  boot(seed);
+  sim_clear_reports();
+  seq = 0;
+  producing = true;
+  uint64_t const start = sim.now_us;
+  while (sim.now_us < start + RUN_US)
+    loop();
+  // Let the last queued reports out
+  producing = false;
+  while (sim.now_us < start + RUN_US + 200000)
+    loop();
+
+  sim_faults_t const stats = sim.faults;
+  hid_tx_stats_t tx;
+  hid_tx_get_stats(HID_TX_MOUSE, &tx);
+
+  // Every kind of fault happened
+  CHECK(stats.nak_storms > 0);
+  CHECK(stats.delayed_completions > 0);
+  CHECK(stats.bus_resets > 0);
+  CHECK(stats.suspends > 0);
+  CHECK(stats.spurious_set_reports > 0);
+
+  // In order, no duplicates
+  size_t received = 0;
+  uint16_t last = 0;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    if (sim_reports[i].data[0] != REPORT_ID_MOUSE)
+      continue;
+    uint16_t const s = seq_of(&sim_reports[i]);
+    if (received)
+      CHECK(s > last);
+    last = s;
+    received++;
+  }
+
+  // Lost are the reports queued or on the endpoint at a bus reset
+  size_t const lost = seq - received;
+  CHECK_EQ(lost, tx.flushed);
+
+  // Recovery is timed from the end of a fault: after a bus reset the host
+  // enumerates again, after the others the next poll or two take a report
+  CHECK(stats.max_recovery_us <= enumeration_us + 2 * INTERVAL_US);
+
+  // Faults take at most a few percent of the polls
+  uint64_t const polls = RUN_US / INTERVAL_US;
+  CHECK(received >= polls * 9 / 10);
+
+  printf("bench: seed %u, %u faults, %zu of %llu polls used, %zu lost, "
+         "recovery max %u us\n",
+         seed,
+         stats.nak_storms + stats.delayed_completions + stats.bus_resets +
+             stats.suspends + stats.spurious_set_reports,
+         received, (unsigned long long)polls, lost, stats.max_recovery_us);
+}
+
+static void test_soak(void) {
+  for (uint32_t seed = 1; seed <= 3; seed++)
+    soak(seed);
+}
+
+static void test_suspend_mid_transfer(void) {
+  // No scheduled faults, the test suspends the bus itself
+  boot(0);
+  sim_clear_reports();
+  seq = 0;
+  producing = true;
+  for (unsigned i = 0; i < 3; i++) {
+    // The host suspends the bus with a report waiting on the endpoint
+    while (sim_report_count < 10 * (i + 1))
+      loop();
+    producing = false;
+    loop();
+    sim_suspend();
+    sim_advance(50000);
+    CHECK(sim.mounted);
+    sim_resume();
+    producing = true;
+  }
+  producing = false;
+  uint64_t const end = sim.now_us + 100000;
+  while (sim.now_us < end)
+    loop();
+
+  // Nothing is lost or sent twice
+  CHECK_EQ(sim_report_count, seq);
+  for (size_t i = 0; i < sim_report_count; i++)
+    CHECK_EQ(seq_of(&sim_reports[i]), i);
+}
+
+int main(void) {
+  RUN(test_soak);
+  RUN(test_suspend_mid_transfer);
+  return test_result();
+}
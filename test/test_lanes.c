@@ -0,0 +1,117 @@
+/*
+ * Keyboard lanes (hid_lanes.h): the text the host types from the waves, with
+ * modifiers merged across keyboards, and characters per poll interval
+ * against the six of a single keyboard.
+ */
+
+#include "hid_arena.h"
+#include "hid_lanes.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "host_kbd.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus.
+// The lanes are polled in the same frame, in endpoint order, unless a test
+// says otherwise.
+static void boot(void) {
+  sim_reset();
+  for (uint8_t lane = 0; lane < CFG_APP_KEYBOARD_LANES; lane++)
+    sim.poll_phase[HID_LANES_INSTANCE(lane)] = 1;
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+  sim_clear_reports();
+}
+
+static void type(char const *text, hid_lanes_stats_t *stats) {
+  CHECK(hid_lanes_type(text));
+  uint64_t const end = sim.now_us + 10000000;
+  while (hid_lanes_busy() && sim.now_us < end) {
+    sim_advance(sim.loop_us);
+    hid_lanes_task();
+  }
+  CHECK(!hid_lanes_busy());
+  hid_lanes_get_stats(stats);
+}
+
+static void test_text(void) {
+  static char const text[] =
+      "Hello World! The QUICK brown fox jumps over the lazy dog, "
+      "1234567890 times: aAbBcC ~!@#$%^&*() Shift-Heavy TEXT.";
+  boot();
+  hid_lanes_stats_t stats;
+  type(text, &stats);
+
+  static host_kbd_t kbd;
+  host_kbd_init(&kbd);
+  host_kbd_feed_all(&kbd);
+  CHECK_STR(kbd.text, text);
+  // No key went down under a Shift another lane held
+  CHECK_EQ(kbd.shift_conflicts, 0);
+  CHECK_EQ(stats.chars, sizeof(text) - 1);
+  CHECK_EQ(stats.reordered, 0);
+
+  // Every wave goes out in one frame
+  uint32_t frames = 0, last_frame = UINT32_MAX;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    if (sim_reports[i].instance == 0)
+      continue;
+    if (sim_reports[i].frame != last_frame)
+      frames++;
+    last_frame = sim_reports[i].frame;
+  }
+  CHECK_EQ(frames, stats.waves);
+  CHECK_EQ(sim_report_count, stats.reports);
+}
+
+static void test_throughput(void) {
+  char text[401];
+  static char const pangram[] = "the quick brown fox jumps over the lazy dog ";
+  for (size_t i = 0; i < sizeof(text) - 1; i++)
+    text[i] = pangram[i % (sizeof(pangram) - 1)];
+  text[sizeof(text) - 1] = 0;
+
+  boot();
+  hid_lanes_stats_t stats;
+  type(text, &stats);
+
+  static host_kbd_t kbd;
+  host_kbd_init(&kbd);
+  host_kbd_feed_all(&kbd);
+  CHECK_STR(kbd.text, text);
+
+  // One wave per poll interval, more than one keyboard can press in one
+  CHECK(stats.waves * INTERVAL_US <= stats.elapsed_us + INTERVAL_US);
+  double const per_interval =
+      (double)stats.chars * INTERVAL_US / stats.elapsed_us;
+  CHECK(per_interval > 6);
+  printf("bench: %d lanes, %u chars in %u waves, %.1f chars per poll "
+         "interval (one keyboard: 6 at most)\n",
+         CFG_APP_KEYBOARD_LANES, stats.chars, stats.waves, per_interval);
+}
+
+// A host that fetches lane 1 before lane 0 types out of order, the device
+// sees it in the completions
+static void test_reordered(void) {
+  boot();
+  sim.poll_phase[HID_LANES_INSTANCE(0)] = 2;
+  sim.poll_phase[HID_LANES_INSTANCE(1)] = 1;
+  hid_lanes_stats_t stats;
+  type("the quick brown fox jumps over the lazy dog", &stats);
+  CHECK(stats.reordered > 0);
+}
+
+int main(void) {
+  RUN(test_text);
+  RUN(test_throughput);
+  RUN(test_reordered);
+  return test_result();
+}
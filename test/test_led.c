@@ -0,0 +1,232 @@
+/*
+ * Status LED (hid_led.h): the steps of every pattern, the engine stepping
+ * through them, and what the LED shows as the firmware runs: a slow blink
+ * once mounted, a fast flicker while the payload types, brightness for the
+ * queue depth while the host NAKs, steady on with Caps Lock, a fast blink
+ * unplugged. Built once with the PWM alarm and once polled from the main
+ * loop.
+ */
+
+#include "hid_led.h"
+#include "hid_text.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define TICK_MS CFG_APP_LED_TICK_MS
+
+static void check_step(uint32_t pattern, uint32_t index, uint8_t level,
+                       uint16_t ms) {
+  hid_led_step_t step;
+  CHECK(hid_led_pattern_step(pattern, index, &step));
+  CHECK_EQ(step.level, level);
+  CHECK_EQ(step.ms, ms);
+}
+
+static bool has_step(uint32_t pattern, uint32_t index) {
+  hid_led_step_t step;
+  return hid_led_pattern_step(pattern, index, &step);
+}
+
+static void test_patterns(void) {
+  uint32_t const not_mounted = HID_LED_PATTERN(HID_LED_NOT_MOUNTED, 0);
+  check_step(not_mounted, 0, 255, 250);
+  check_step(not_mounted, 1, 0, 250);
+  CHECK(!has_step(not_mounted, 2));
+
+  check_step(HID_LED_PATTERN(HID_LED_MOUNTED, 0), 1, 0, 1000);
+  check_step(HID_LED_PATTERN(HID_LED_SUSPENDED, 0), 0, 32, 2500);
+  check_step(HID_LED_PATTERN(HID_LED_BUSY, 0), 0, 255, 50);
+
+  // Held forever
+  check_step(HID_LED_PATTERN(HID_LED_ON, 0), 0, 255, 0);
+  CHECK(!has_step(HID_LED_PATTERN(HID_LED_ON, 0), 1));
+  check_step(HID_LED_PATTERN(HID_LED_OFF, 0), 0, 0, 0);
+  check_step(HID_LED_PATTERN(HID_LED_LEVEL, 100), 0, 100, 0);
+  check_step(HID_LED_PATTERN(HID_LED_LEVEL, 1000), 0, 255, 0);
+
+  // Three pulses, then the pause
+  uint32_t const error = HID_LED_PATTERN(HID_LED_ERROR, 3);
+  for (uint32_t i = 0; i < 6; i++)
+    check_step(error, i, i % 2 ? 0 : 255, 150);
+  check_step(error, 6, 0, 1000);
+  CHECK(!has_step(error, 7));
+}
+
+static void test_engine(void) {
+  // A new pattern starts from its first step at once
+  hid_led_post(HID_LED_PATTERN(HID_LED_BUSY, 0));
+  CHECK_EQ(hid_led_tick(TICK_MS), 255);
+  for (uint32_t ms = TICK_MS; ms < 50; ms += TICK_MS)
+    CHECK_EQ(hid_led_tick(TICK_MS), 255);
+  CHECK_EQ(hid_led_tick(TICK_MS), 0);
+
+  // Posting it again does not restart it
+  hid_led_post(HID_LED_PATTERN(HID_LED_BUSY, 0));
+  for (uint32_t ms = TICK_MS; ms < 50; ms += TICK_MS)
+    CHECK_EQ(hid_led_tick(TICK_MS), 0);
+  CHECK_EQ(hid_led_tick(TICK_MS), 255);
+
+  // Steps shorter than a tick are passed over: 400 ms into the error
+  // pattern is the second pulse, the end wraps to the first
+  hid_led_post(HID_LED_PATTERN(HID_LED_ERROR, 2));
+  CHECK_EQ(hid_led_tick(TICK_MS), 255);
+  CHECK_EQ(hid_led_tick(400), 255);
+  CHECK_EQ(hid_led_tick(100), 0);
+  CHECK_EQ(hid_led_tick(1100), 255);
+
+  hid_led_post(HID_LED_PATTERN(HID_LED_LEVEL, 64));
+  CHECK_EQ(hid_led_tick(TICK_MS), 64);
+  CHECK_EQ(hid_led_tick(60000), 64);
+
+  hid_led_post(HID_LED_PATTERN(HID_LED_NOT_MOUNTED, 0));
+}
+
+//--------------------------------------------------------------------+
+// The firmware
+//--------------------------------------------------------------------+
+
+#define SAMPLE_US   5000u
+#define MAX_SAMPLES 4096
+
+// Brightness of the LED, 0 - 255
+static uint8_t led(void) {
+#if CFG_APP_LED_PWM
+  // The level is squared
+  uint32_t l = 0;
+  while ((l + 1) * (l + 1) <= sim.led_level)
+    l++;
+  return (uint8_t)l;
+#else
+  return sim.led_on ? 255 : 0;
+#endif
+}
+
+static struct {
+  uint64_t time_us;
+  uint8_t level;
+} samples[MAX_SAMPLES];
+static size_t sample_count;
+
+static void run_to(uint64_t until_us) {
+  while (sim.now_us < until_us && sample_count < MAX_SAMPLES) {
+    sim_run_app(sim.now_us + SAMPLE_US);
+    samples[sample_count].time_us = sim.now_us;
+    samples[sample_count].level = led();
+    sample_count++;
+  }
+  CHECK(sample_count < MAX_SAMPLES);
+}
+
+// Times the LED turned on or off in [from_us, to_us)
+static size_t changes(uint64_t from_us, uint64_t to_us, uint64_t *out,
+                      size_t max) {
+  size_t n = 0;
+  for (size_t i = 1; i < sample_count; i++) {
+    if (samples[i].time_us < from_us || samples[i].time_us >= to_us)
+      continue;
+    if (!samples[i].level != !samples[i - 1].level && n < max)
+      out[n++] = samples[i].time_us;
+  }
+  return n;
+}
+
+// The LED blinks on and off every period_us in [from_us, to_us)
+static void check_blink(uint64_t from_us, uint64_t to_us, uint32_t period_us) {
+  uint64_t t[64];
+  size_t const n = changes(from_us, to_us, t, TU_ARRAY_SIZE(t));
+  CHECK(n >= 1 && n + 1 >= (to_us - from_us) / period_us);
+  for (size_t i = 1; i < n; i++) {
+    uint64_t const d = t[i] - t[i - 1];
+    CHECK(d + TICK_MS * 1000 >= period_us && d <= period_us + TICK_MS * 1000);
+  }
+}
+
+static void caps_lock(void *arg) {
+  uint8_t const leds = arg ? KEYBOARD_LED_CAPSLOCK : 0;
+  sim_set_report(0, REPORT_ID_KEYBOARD, HID_REPORT_TYPE_OUTPUT, &leds, 1);
+}
+
+static uint64_t mount(void) {
+  sim_plug();
+  while (!sim.mounted && sim.now_us < 60000000)
+    run_to(sim.now_us + SAMPLE_US);
+  CHECK(sim.mounted);
+  return sim.mount_us;
+}
+
+static uint64_t last_report_us(void) {
+  return sim_report_count ? sim_reports[sim_report_count - 1].time_us : 0;
+}
+
+static void test_firmware(void) {
+  sim_reset();
+
+  // Waiting out the start delay
+  uint64_t const mount_us = mount();
+  run_to(mount_us + 1900000);
+  check_blink(mount_us + 100000, mount_us + 1900000, 1000000);
+
+  // Blinking fast while the demo text is typed, a report per poll
+  while (!sim.first_report_us && sim.now_us < mount_us + 10000000)
+    run_to(sim.now_us + SAMPLE_US);
+  uint64_t const typing_us = sim.first_report_us;
+  CHECK(typing_us);
+  run_to(typing_us + 200000);
+  uint64_t const done_us = last_report_us();
+  CHECK(done_us > typing_us + 50000);
+  check_blink(typing_us, done_us, 50000);
+
+  run_to(done_us + 2500000);
+  check_blink(done_us + 100000, done_us + 2500000, 1000000);
+
+  // Caps Lock holds it on
+  sim_at(sim.now_us, caps_lock, (void *)1);
+  uint64_t const caps_us = sim.now_us;
+  run_to(caps_us + 1500000);
+  uint64_t t[4];
+  CHECK_EQ(changes(caps_us + 50000, caps_us + 1500000, t, 4), 0);
+  CHECK_EQ(samples[sample_count - 1].level, 255);
+
+  sim_at(sim.now_us, caps_lock, NULL);
+  uint64_t const caps_off_us = sim.now_us;
+  run_to(caps_off_us + 2500000);
+  check_blink(caps_off_us + 50000, caps_off_us + 2500000, 1000000);
+
+  sim_unplug();
+  uint64_t const unplug_us = sim.now_us;
+  run_to(unplug_us + 1000000);
+  check_blink(unplug_us + 50000, unplug_us + 1000000, 250000);
+
+  // The host NAKs while the text is typed again, every report queues up
+  uint64_t const remount_us = mount();
+  sim_clear_reports();
+  sim.nak_until_us = remount_us + 2400000;
+  run_to(sim.nak_until_us);
+  bool dark = false, dimmed = false;
+  for (size_t i = 0; i < sample_count; i++) {
+    if (samples[i].time_us < sim.nak_until_us - 150000)
+      continue;
+    dark |= samples[i].level == 0;
+    dimmed |= samples[i].level > 0 && samples[i].level < 255;
+  }
+  CHECK(!dark);
+#if CFG_APP_LED_PWM
+  CHECK(dimmed);
+#endif
+  CHECK(sim.first_report_us >= sim.nak_until_us);
+
+  // Until the host has them all
+  run_to(sim.now_us + 200000);
+  CHECK_EQ(sim_report_count, demo_text_reports.count);
+  uint64_t const drained_us = last_report_us();
+  run_to(drained_us + 2500000);
+  check_blink(drained_us + 50000, drained_us + 2500000, 1000000);
+}
+
+int main(void) {
+  RUN(test_patterns);
+  RUN(test_engine);
+  RUN(test_firmware);
+  return test_result();
+}
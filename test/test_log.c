@@ -0,0 +1,191 @@
+/*
+ * Binary log (hid_log.h): records as the host drains them over the
+ * telemetry feature report, and the cost of a HID_LOG() call against
+ * formatting on the spot.
+ *
+ * With an argument, the drained words are written to <prefix>.bin and the
+ * text printf makes of the same calls to <prefix>.txt, for
+ * test/tools/test_hid_log_decode.py to decode with this executable's format
+ * strings and compare.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "pico/time.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+//--------------------------------------------------------------------+
+// Host side
+//--------------------------------------------------------------------+
+
+static uint32_t drained[4096];
+static size_t drained_count;
+
+// Reads the telemetry report until the ring is empty
+static void drain(void) {
+  while (1) {
+    uint8_t buffer[VENDOR_FEATURE_LEN];
+    uint16_t const len = sim_get_report(0, REPORT_ID_TELEMETRY,
+                                        HID_REPORT_TYPE_FEATURE, buffer,
+                                        sizeof(buffer));
+    CHECK(len >= 1);
+    uint8_t const count = buffer[0];
+    CHECK_EQ(len, 1 + 4 * count);
+    if (count == 0 || drained_count + count > TU_ARRAY_SIZE(drained))
+      return;
+    memcpy(&drained[drained_count], &buffer[1], 4 * count);
+    drained_count += count;
+  }
+}
+
+// The same call, once to the log and once formatted right away
+static FILE *expected;
+
+#define LOG(fmt, ...)                                                          \
+  do {                                                                         \
+    HID_LOG(fmt, ##__VA_ARGS__);                                               \
+    if (expected)                                                              \
+      fprintf(expected, "%10.6f " fmt "\n", time_us_32() / 1e6,              \
+              ##__VA_ARGS__);                                                  \
+    sim_advance(1000);                                                         \
+  } while (0)
+
+//--------------------------------------------------------------------+
+// Records
+//--------------------------------------------------------------------+
+
+static void test_records(void) {
+  boot();
+  drain();
+  drained_count = 0;
+
+  uint32_t const before = time_us_32();
+  LOG("no arguments");
+  LOG("signed %d %i", -5, 7);
+  LOG("unsigned %u", 4000000000u);
+  LOG("hex %x %X %08x", 0xbeef, 0xBEEF, 0x12);
+  LOG("char %c%c", 'o', 'k');
+  LOG("100%% |%5d|%-5d|%+d|% d|", 42, 42, 3, 3);
+  LOG("eight %u %u %u %u %u %u %u %u", 1, 2, 3, 4, 5, 6, 7, 8);
+  drain();
+
+  // [format offset << 8 | nargs] [time] [args]
+  CHECK_EQ(drained[0] & 0xff, 0);
+  CHECK_EQ(drained[1], before);
+  CHECK_EQ(drained[2] & 0xff, 2);
+  CHECK_EQ(drained[3], before + 1000);
+  CHECK_EQ(drained[4], (uint32_t)-5);
+  CHECK_EQ(drained[5], 7);
+  CHECK(drained[0] >> 8 != drained[2] >> 8);
+}
+
+static void test_overflow(void) {
+  // A full ring drops records and says how many before the next one
+  unsigned const fit = CFG_APP_LOG_RING_WORDS / 3;
+  for (unsigned i = 0; i < fit; i++)
+    LOG("record %u", i);
+  for (unsigned i = 0; i < 15; i++)
+    HID_LOG("record %u", fit + i);
+  drain();
+  if (expected)
+    fprintf(expected, "%10.6f log: %u records dropped\n", time_us_32() / 1e6,
+            15u);
+  LOG("after the gap");
+  drain();
+}
+
+static void test_wrap(void) {
+  // Small reads, so records straddle both the ring end and the reports
+  for (unsigned i = 0; i < 3 * CFG_APP_LOG_RING_WORDS / 4; i++) {
+    LOG("wrap %u of %u", i, 3 * CFG_APP_LOG_RING_WORDS / 4);
+    uint32_t words[6];
+    uint16_t const n = hid_log_read(words, i % 4 + 3);
+    memcpy(&drained[drained_count], words, 4 * n);
+    drained_count += n;
+  }
+  drain();
+  CHECK(drained_count < TU_ARRAY_SIZE(drained));
+}
+
+//--------------------------------------------------------------------+
+// Benchmark
+//--------------------------------------------------------------------+
+
+#define BENCH_CALLS 1000000
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(void) {
+  boot();
+  uint32_t words[CFG_APP_LOG_RING_WORDS];
+
+  // Drained now and then like the host would, so every call takes the full
+  // path instead of counting a drop
+  double start = now_ns();
+  for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+    HID_LOG("bench %u %u %u", i, i * 3, i ^ 0x55);
+    if ((i & 63) == 63)
+      hid_log_read(words, CFG_APP_LOG_RING_WORDS);
+  }
+  double const log_ns = (now_ns() - start) / BENCH_CALLS;
+
+  char text[64];
+  volatile size_t total = 0;
+  start = now_ns();
+  for (uint32_t i = 0; i < BENCH_CALLS; i++)
+    total += (size_t)snprintf(text, sizeof(text), "bench %u %u %u", i, i * 3,
+                              i ^ 0x55);
+  double const printf_ns = (now_ns() - start) / BENCH_CALLS;
+
+  CHECK(log_ns < printf_ns);
+  printf("bench: HID_LOG %.1f ns per call, snprintf %.1f ns per call\n",
+         log_ns, printf_ns);
+}
+
+int main(int argc, char **argv) {
+  char path[512];
+  if (argc > 1) {
+    snprintf(path, sizeof(path), "%s.txt", argv[1]);
+    expected = fopen(path, "w");
+    CHECK(expected != NULL);
+  }
+
+  RUN(test_records);
+  RUN(test_overflow);
+  RUN(test_wrap);
+
+  if (expected) {
+    fclose(expected);
+    expected = NULL;
+    snprintf(path, sizeof(path), "%s.bin", argv[1]);
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL);
+    if (f) {
+      fwrite(drained, 4, drained_count, f);
+      fclose(f);
+    }
+  }
+
+  RUN(bench);
+  return test_result();
+}
@@ -0,0 +1,65 @@
+/*
+ * The FreeRTOS build (CFG_APP_FREERTOS) on the FreeRTOS shim of
+ * sim/freertos.c, or on the kernel's POSIX port: the USB, transmit and
+ * application tasks bring up the device and type the demo text, with the
+ * transmit task submitting each report as the previous one completes and
+ * the producer queueing no further ahead than its next tick.
+ */
+
+#include "host_kbd.h"
+#include "hid_tx.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+#define RUN_US      3000000u
+
+extern char const demo_text[];
+
+static void test_demo_text(void) {
+  sim_reset();
+  sim_plug();
+  sim_run_app(RUN_US);
+  CHECK(sim.mounted);
+  CHECK_EQ(sim.enum_errors, 0);
+
+  static host_kbd_t kbd;
+  host_kbd_init(&kbd);
+  size_t keyboard = 0;
+  uint64_t first = 0, last = 0, max_gap = 0;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    sim_report_t const *r = &sim_reports[i];
+    if (r->instance != 0 || r->data[0] != REPORT_ID_KEYBOARD)
+      continue;
+    if (keyboard && r->time_us - last > max_gap)
+      max_gap = r->time_us - last;
+    if (!keyboard)
+      first = r->time_us;
+    last = r->time_us;
+    keyboard++;
+    host_kbd_feed(&kbd, r);
+  }
+  CHECK_STR(kbd.text, demo_text);
+
+  // The producer keeps a hid_task() tick's worth queued and the transmit
+  // task submits each report as the one before completes: one per poll
+  CHECK(keyboard > 1);
+  CHECK(max_gap <= INTERVAL_US + 1000);
+
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_KEYBOARD, &stats);
+  CHECK_EQ(stats.sent, keyboard);
+  CHECK_EQ(stats.dropped, 0);
+  // No deeper than the tick
+  CHECK(stats.max_latency_us < 10000 + INTERVAL_US);
+  printf("  %zu reports from %.3f s to %.3f s, queued to submitted max %u us, "
+         "on the endpoint max %u us\n",
+         keyboard, first / 1e6, last / 1e6, stats.max_latency_us,
+         stats.max_wire_us);
+}
+
+int main(void) {
+  RUN(test_demo_text);
+  return test_result();
+}
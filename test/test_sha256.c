@@ -0,0 +1,248 @@
+/*
+ * SHA-256 (hid_sha256.h) against the FIPS 180-4 test vectors, fed in every
+ * split, and block verification of a replayed timeline (hid_timeline.h):
+ * a corrupt block stops playback before any of its records reach the host.
+ * Benchmarks the hash in MB/s.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_sha256.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+static void hex(uint8_t const digest[HID_SHA256_LEN], char out[65]) {
+  for (int i = 0; i < HID_SHA256_LEN; i++)
+    sprintf(&out[2 * i], "%02x", digest[i]);
+}
+
+static void hash(void const *data, size_t len, uint8_t digest[HID_SHA256_LEN]) {
+  hid_sha256_t ctx;
+  hid_sha256_start(&ctx);
+  hid_sha256_update(&ctx, data, len);
+  hid_sha256_finish(&ctx, digest);
+}
+
+#define CHECK_DIGEST(digest, expected)                                       \
+  do {                                                                       \
+    char hex_[65];                                                           \
+    hex(digest, hex_);                                                       \
+    CHECK_STR(hex_, expected);                                               \
+  } while (0)
+
+static void test_vectors(void) {
+  uint8_t d[HID_SHA256_LEN];
+  hash("", 0, d);
+  CHECK_DIGEST(d, "e3b0c44298fc1c149afbf4c8996fb924"
+                  "27ae41e4649b934ca495991b7852b855");
+  hash("abc", 3, d);
+  CHECK_DIGEST(d, "ba7816bf8f01cfea414140de5dae2223"
+                  "b00361a396177a9cb410ff61f20015ad");
+  static char const two_blocks[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  hash(two_blocks, sizeof(two_blocks) - 1, d);
+  CHECK_DIGEST(d, "248d6a61d20638b8e5c026930c3e6039"
+                  "a33ce45964ff2167f6ecedd419db06c1");
+
+  // A million a, in pieces of odd sizes
+  static uint8_t a[1000];
+  memset(a, 'a', sizeof(a));
+  hid_sha256_t ctx;
+  hid_sha256_start(&ctx);
+  for (size_t done = 0, n = 1; done < 1000000; done += n, n = n % 991 + 7) {
+    if (n > 1000000 - done)
+      n = 1000000 - done;
+    hid_sha256_update(&ctx, a, n);
+  }
+  hid_sha256_finish(&ctx, d);
+  CHECK_DIGEST(d, "cdc76e5c9914fb9281a1c7e284d73e67"
+                  "f1809a48a497200e046d39ccc7112cd0");
+}
+
+// Any split into two updates gives the one-shot digest, around the padding
+// boundaries of one and two blocks
+static void test_splits(void) {
+  uint8_t data[200];
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)(i * 31 + 7);
+
+  for (size_t len = 0; len <= 140; len++) {
+    uint8_t whole[HID_SHA256_LEN];
+    hash(data, len, whole);
+    for (size_t split = 0; split <= len; split++) {
+      hid_sha256_t ctx;
+      uint8_t d[HID_SHA256_LEN];
+      hid_sha256_start(&ctx);
+      hid_sha256_update(&ctx, data, split);
+      hid_sha256_update(&ctx, &data[split], len - split);
+      hid_sha256_finish(&ctx, d);
+      if (memcmp(d, whole, sizeof(d)) != 0) {
+        CHECK(!"split digest differs");
+        printf("  len %zu split %zu\n", len, split);
+        return;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Verified replay
+//--------------------------------------------------------------------+
+
+#define BLOCK_SIZE   256
+#define RECORDS      300
+#define RECORD_LEN   10 // delta, report ID, 8 byte keyboard report
+#define IMAGE_LEN    (HID_TIMELINE_HEADER_LEN + RECORDS * RECORD_LEN)
+#define BLOCKS       ((IMAGE_LEN + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+static uint8_t image[IMAGE_LEN];
+static uint8_t digests[BLOCKS][HID_SHA256_LEN];
+
+static void build_image(void) {
+  memcpy(image, "HTL", 3);
+  image[3] = HID_TIMELINE_VERSION;
+  uint8_t *p = &image[HID_TIMELINE_HEADER_LEN];
+  for (int i = 0; i < RECORDS; i++) {
+    *p++ = 100; // delta_us, one byte varint
+    *p++ = REPORT_ID_KEYBOARD;
+    memset(p, 0, 8);
+    p[2] = (uint8_t)(HID_KEY_A + i % 26); // keycode[0]
+    p += 8;
+  }
+  for (size_t b = 0; b < BLOCKS; b++) {
+    size_t const off = b * BLOCK_SIZE;
+    hash(&image[off], IMAGE_LEN - off < BLOCK_SIZE ? IMAGE_LEN - off
+                                                   : BLOCK_SIZE,
+         digests[b]);
+  }
+}
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+  sim_clear_reports();
+}
+
+// Plays data to the end or the first corrupt block, returns the number of
+// keyboard reports the host got
+static size_t replay(uint8_t const *data, hid_timeline_player_t *player) {
+  boot();
+  CHECK(hid_timeline_start(player, data, IMAGE_LEN, sim.now_us));
+  hid_timeline_verify(player, (uint8_t const(*)[HID_SHA256_LEN])digests,
+                      BLOCK_SIZE);
+  uint64_t const end = sim.now_us + 10000000;
+  while (sim.now_us < end) {
+    bool const playing = hid_timeline_task(player, sim.now_us);
+    hid_tx_task();
+    if (!playing && hid_tx_idle(HID_TX_KEYBOARD))
+      break;
+    sim_advance(sim.loop_us);
+  }
+  CHECK(sim.now_us < end);
+  return sim_report_count;
+}
+
+// Records that end before offset
+static size_t records_before(size_t offset) {
+  return offset <= HID_TIMELINE_HEADER_LEN
+             ? 0
+             : (offset - HID_TIMELINE_HEADER_LEN) / RECORD_LEN;
+}
+
+// The hash runs a block ahead of playback, so a corrupt block stops it
+// while the one before is playing: none of its records reach the host,
+// all of those two blocks back did
+#define CHECK_STOPPED_AT(got, offset)                                        \
+  do {                                                                       \
+    CHECK((got) <= records_before(offset));                                  \
+    CHECK((got) >= records_before((offset) < BLOCK_SIZE                      \
+                                      ? 0                                    \
+                                      : (offset) - BLOCK_SIZE));             \
+  } while (0)
+
+static void test_intact(void) {
+  hid_timeline_player_t player;
+  CHECK_EQ(replay(image, &player), RECORDS);
+  CHECK(!player.corrupt);
+  CHECK_EQ(player.verified, IMAGE_LEN);
+  CHECK_EQ(player.sent, RECORDS);
+}
+
+static void test_corrupt_blocks(void) {
+  static uint8_t bad[IMAGE_LEN];
+  // A byte in the header block, in a middle one and in the last, short
+  // one; the flipped bit still decodes, only the hash notices
+  size_t const blocks[] = {0, BLOCKS / 2, BLOCKS - 1};
+  for (size_t i = 0; i < TU_ARRAY_SIZE(blocks); i++) {
+    size_t const offset = blocks[i] * BLOCK_SIZE;
+    memcpy(bad, image, IMAGE_LEN);
+    size_t at = offset + BLOCK_SIZE / 2;
+    if (at >= IMAGE_LEN)
+      at = IMAGE_LEN - 1;
+    bad[at] ^= 0x10;
+
+    hid_timeline_player_t player;
+    size_t const got = replay(bad, &player);
+    CHECK(player.corrupt);
+    CHECK_EQ(player.verified, offset);
+    CHECK_STOPPED_AT(got, offset);
+    CHECK_EQ(player.sent, got);
+    printf("  block %zu corrupt: %zu of %d records sent\n", blocks[i], got,
+           RECORDS);
+  }
+}
+
+static void test_wrong_digest(void) {
+  digests[1][0] ^= 1;
+  hid_timeline_player_t player;
+  size_t const got = replay(image, &player);
+  digests[1][0] ^= 1;
+  CHECK(player.corrupt);
+  CHECK_EQ(player.verified, BLOCK_SIZE);
+  CHECK_STOPPED_AT(got, BLOCK_SIZE);
+}
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_sha256(void) {
+  size_t const len = 4u << 20;
+  uint8_t *data = malloc(len);
+  for (size_t i = 0; i < len; i++)
+    data[i] = (uint8_t)i;
+  uint8_t d[HID_SHA256_LEN];
+  double const t0 = seconds();
+  hash(data, len, d);
+  double const dt = seconds() - t0;
+  free(data);
+  printf("bench: sha256 (%s) %.1f MB/s\n",
+         HID_SHA256_HW ? "accelerator" : "software", len / dt / 1e6);
+}
+
+int main(void) {
+  RUN(test_vectors);
+  RUN(test_splits);
+  build_image();
+  RUN(test_intact);
+  RUN(test_corrupt_blocks);
+  RUN(test_wrong_digest);
+  RUN(bench_sha256);
+  return test_result();
+}
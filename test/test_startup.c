@@ -0,0 +1,102 @@
+/*
+ * Startup: the simulated host enumerates the device with the standard
+ * request sequence, the firmware starts typing after its start delay
+ * (CFG_APP_START_DELAY_MS) or, with CFG_APP_FAST_START, once the host sets
+ * the keyboard LEDs. Built once per mode; reports the time from plug-in to
+ * the first report.
+ *
+ * main() runs once per process, so every boot is a child process.
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+#define RUN_US      3000000u
+
+// hid_task() runs every 10 ms: a tick to see the mount, one to see the end
+// of the wait and one to send, then the report waits for a poll
+#define START_SLACK_US (3 * 10000u + INTERVAL_US)
+
+typedef struct {
+  uint64_t mount_us;
+  uint64_t first_report_us;
+  uint32_t enum_errors;
+  uint32_t bind_us;
+  bool mounted;
+} shared_t;
+
+static shared_t *shared;
+
+static void boot(bool host_sets_leds) {
+  fflush(stdout);
+  pid_t const pid = fork();
+  if (pid == 0) {
+    sim_reset();
+    sim.host_sets_leds = host_sets_leds;
+    sim_plug();
+    sim_run_app(RUN_US);
+    shared->mount_us = sim.mount_us;
+    shared->first_report_us = sim.first_report_us;
+    shared->enum_errors = sim.enum_errors;
+    shared->bind_us = sim.bind_us;
+    shared->mounted = sim.mounted;
+    _exit(0);
+  }
+  int status;
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // Every descriptor the host asked for was well formed
+  CHECK(shared->mounted);
+  CHECK_EQ(shared->enum_errors, 0);
+  CHECK(shared->first_report_us > shared->mount_us);
+}
+
+static void report(char const *host) {
+  printf("bench: %s, mounted %.1f ms after plug-in, first report %.1f ms "
+         "after plug-in\n",
+         host, shared->mount_us / 1e3, shared->first_report_us / 1e3);
+}
+
+static void test_host_sets_leds(void) {
+  boot(true);
+#if CFG_APP_FAST_START
+  uint64_t const start = shared->mount_us + shared->bind_us;
+#else
+  uint64_t const start = shared->mount_us + CFG_APP_START_DELAY_MS * 1000u;
+#endif
+  CHECK(shared->first_report_us >= start);
+  CHECK(shared->first_report_us <= start + START_SLACK_US);
+  report("host sets the LEDs");
+}
+
+static void test_host_ignores_leds(void) {
+  boot(false);
+#if CFG_APP_FAST_START
+  uint64_t const start =
+      shared->mount_us + CFG_APP_FAST_START_TIMEOUT_MS * 1000u;
+#else
+  uint64_t const start = shared->mount_us + CFG_APP_START_DELAY_MS * 1000u;
+#endif
+  CHECK(shared->first_report_us >= start);
+  CHECK(shared->first_report_us <= start + START_SLACK_US);
+  report("host leaves the LEDs");
+}
+
+int main(void) {
+  shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+    return 1;
+
+  printf("CFG_APP_FAST_START=%d\n", CFG_APP_FAST_START);
+  RUN(test_host_sets_leds);
+  RUN(test_host_ignores_leds);
+  return test_result();
+}
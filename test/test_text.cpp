@@ -0,0 +1,150 @@
+/*
+ * Compile-time text rendering (hid_text.hpp): the reports of HID_TEXT() and
+ * "..."_hid, decoded by the host keyboard model, give back the text; each
+ * key matches the runtime keymap (hid_keymap.h).
+ */
+
+#include <string>
+
+#include "hid_text.hpp"
+
+extern "C" {
+#include "hid_keymap.h"
+#include "host_kbd.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+}
+
+// Also checked by the compiler, next to the header's own checks
+namespace {
+
+constexpr bool same(hid_text_report_t const &a, hid_text_report_t const &b) {
+  if (a.modifier != b.modifier || a.reserved != b.reserved)
+    return false;
+  for (int i = 0; i < 6; i++) {
+    if (a.keycode[i] != b.keycode[i])
+      return false;
+  }
+  return true;
+}
+
+template <std::size_t N>
+constexpr bool same(std::array<hid_text_report_t, N> const &a,
+                    std::array<hid_text_report_t, N> const &b) {
+  for (std::size_t i = 0; i < N; i++) {
+    if (!same(a[i], b[i]))
+      return false;
+  }
+  return true;
+}
+
+constexpr auto hello = HID_TEXT("Hello World!");
+static_assert(hello.size() == 14, "12 keys, released between the l's and at "
+                                  "the end");
+static_assert(same(hello, "Hello World!"_hid), "the literal renders the same");
+static_assert(HID_TEXT("a\x01" "b").size() == 3, "characters without a key "
+                                                 "are skipped");
+static_assert(HID_TEXT("\n")[0].keycode[0] == HID_KEY_ENTER, "line feed");
+
+} // namespace
+
+// What a host types from reports
+static std::string decode(hid_text_report_t const *reports, std::size_t count,
+                          uint32_t *key_downs = nullptr) {
+  static host_kbd_t kbd;
+  host_kbd_init(&kbd);
+  for (std::size_t i = 0; i < count; i++) {
+    sim_report_t r = {};
+    r.data[0] = REPORT_ID_KEYBOARD;
+    memcpy(&r.data[1], &reports[i], sizeof(reports[i]));
+    r.len = 1 + sizeof(reports[i]);
+    host_kbd_feed(&kbd, &r);
+  }
+  if (key_downs)
+    *key_downs = kbd.key_downs;
+  return std::string(kbd.text, kbd.len);
+}
+
+template <std::size_t N>
+static std::string decode(std::array<hid_text_report_t, N> const &reports,
+                          uint32_t *key_downs = nullptr) {
+  return decode(reports.data(), N, key_downs);
+}
+
+#define CHECK_ROUND_TRIP(str)                                                \
+  do {                                                                       \
+    constexpr auto reports_ = HID_TEXT(str);                                 \
+    uint32_t key_downs_;                                                     \
+    std::string const text_ = decode(reports_, &key_downs_);                 \
+    CHECK_STR(text_.c_str(), str);                                           \
+    /* every key went down, none was lost to a missing release */            \
+    CHECK_EQ(key_downs_, sizeof(str) - 1);                                   \
+    CHECK_EQ(reports_.back().keycode[0], 0);                                 \
+  } while (0)
+
+static void test_round_trip(void) {
+  CHECK_ROUND_TRIP("Hello World!");
+  CHECK_ROUND_TRIP("aaa");
+  CHECK_ROUND_TRIP("aAaA");
+  CHECK_ROUND_TRIP("Mississippi    balloon");
+  CHECK_ROUND_TRIP("Tab\tand\nline feed");
+  CHECK_ROUND_TRIP(" !\"#$%&'()*+,-./0123456789:;<=>?@"
+                   "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
+                   "abcdefghijklmnopqrstuvwxyz{|}~");
+  CHECK(decode(HID_TEXT("")).empty());
+}
+
+static void test_skipped(void) {
+  // Characters without a key, UTF-8 included, leave no report
+  constexpr auto r = HID_TEXT("a\x01" "b\xc3\xa9" "c");
+  CHECK_EQ(r.size(), 4);
+  std::string const text = decode(r);
+  CHECK_STR(text.c_str(), "abc");
+}
+
+// Every key report as the runtime keymap maps the character
+static void test_runtime_keymap(void) {
+  static char const text[] = " !\"#$%&'()*+,-./0123456789:;<=>?@"
+                             "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
+                             "abcdefghijklmnopqrstuvwxyz{|}~\t\n";
+  constexpr auto reports = HID_TEXT(" !\"#$%&'()*+,-./0123456789:;<=>?@"
+                                    "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
+                                    "abcdefghijklmnopqrstuvwxyz{|}~\t\n");
+  std::size_t n = 0;
+  uint8_t prev = 0;
+  for (char const *c = text; *c; c++) {
+    uint8_t modifier, key;
+    CHECK(hid_keymap_ascii(*c, &modifier, &key));
+    if (key == prev) {
+      CHECK(n < reports.size() && reports[n].keycode[0] == 0);
+      n++;
+    }
+    CHECK(n < reports.size());
+    if (n >= reports.size())
+      return;
+    CHECK_EQ(reports[n].modifier, modifier);
+    CHECK_EQ(reports[n].keycode[0], key);
+    for (int i = 1; i < 6; i++)
+      CHECK_EQ(reports[n].keycode[i], 0);
+    n++;
+    prev = key;
+  }
+  CHECK_EQ(n + 1, reports.size());
+}
+
+// The demo text main() types
+static void test_demo_text(void) {
+  CHECK(demo_text_reports.count > 0);
+  std::string const text =
+      decode(demo_text_reports.reports, demo_text_reports.count);
+  CHECK_STR(text.c_str(), demo_text);
+}
+
+int main(void) {
+  RUN(test_round_trip);
+  RUN(test_skipped);
+  RUN(test_runtime_keymap);
+  RUN(test_demo_text);
+  return test_result();
+}
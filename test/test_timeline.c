@@ -0,0 +1,370 @@
+/*
+ * Timeline decoder and replay engine (hid_timeline.h).
+ *
+ * Replay tolerance: a report reaches the host no earlier than its recorded
+ * time and at most one polling interval plus one millisecond after it, plus
+ * one interval per report still ahead of it on the endpoint (records closer
+ * together than the polling interval queue up).
+ *
+ *   test_timeline [session.htl]
+ *
+ * With a timeline from tools/evdev_to_timeline.py the replay is also checked
+ * against the converted capture.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "hid_arena.h"
+#include "hid_keymap.h"
+#include "hid_log.h"
+#include "hid_text.h"
+#include "hid_timeline.h"
+#include "hid_tx.h"
+#include "pico/time.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+#define TOLERANCE_US (INTERVAL_US + 1000u)
+
+static uint8_t *buf;
+static size_t buf_len;
+
+static void put_varint(uint32_t v) {
+  do {
+    uint8_t b = v & 0x7f;
+    v >>= 7;
+    buf[buf_len++] = (uint8_t)(b | (v ? 0x80 : 0));
+  } while (v);
+}
+
+static void put_header(void) {
+  buf_len = 0;
+  buf[buf_len++] = 'H';
+  buf[buf_len++] = 'T';
+  buf[buf_len++] = 'L';
+  buf[buf_len++] = HID_TIMELINE_VERSION;
+}
+
+static void put_record(uint32_t delta_us, uint8_t report_id, uint8_t seq) {
+  put_varint(delta_us);
+  buf[buf_len++] = report_id;
+  uint8_t const len = hid_timeline_report_len(report_id);
+  for (uint8_t i = 0; i < len; i++)
+    buf[buf_len++] = (uint8_t)(seq + i);
+}
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+static void play(hid_timeline_player_t *player, uint64_t until_us) {
+  while (sim.now_us < until_us) {
+    sim_advance(sim.loop_us);
+    hid_timeline_task(player, time_us_64());
+    hid_tx_task();
+  }
+}
+
+// Compares what the host received with the timeline played from start_us
+static void check_replay(uint8_t const *data, size_t len, uint64_t start_us) {
+  size_t pos = HID_TIMELINE_HEADER_LEN;
+  hid_timeline_record_t rec;
+  uint64_t due = start_us;
+  size_t n = 0;
+  uint32_t max_late = 0;
+  while (hid_timeline_next(data, len, &pos, &rec)) {
+    due += rec.delta_us;
+    if (n >= sim_report_count) {
+      CHECK(n < sim_report_count);
+      return;
+    }
+    sim_report_t const *r = &sim_reports[n];
+    CHECK_EQ(r->len, 1 + rec.len);
+    CHECK_EQ(r->data[0], rec.report_id);
+    CHECK(memcmp(&r->data[1], rec.payload, rec.len) == 0);
+
+    // Reports ahead of this one still waiting at its due time
+    uint32_t backlog = 0;
+    for (size_t i = 0; i < n; i++)
+      if (sim_reports[i].time_us > due)
+        backlog++;
+    CHECK(r->time_us >= due);
+    uint64_t const late = r->time_us - due;
+    CHECK(late <= TOLERANCE_US + (uint64_t)backlog * INTERVAL_US);
+    if (!backlog && late > max_late)
+      max_late = (uint32_t)late;
+    n++;
+  }
+  CHECK_EQ(n, sim_report_count);
+  printf("  %zu reports, worst lateness %u us without backlog (tolerance %u)\n",
+         n, max_late, TOLERANCE_US);
+}
+
+//--------------------------------------------------------------------+
+// Decoder
+//--------------------------------------------------------------------+
+
+static void test_decode(void) {
+  put_header();
+  put_record(0, REPORT_ID_KEYBOARD, 1);
+  put_record(127, REPORT_ID_MOUSE, 2);
+  put_record(128, REPORT_ID_CONSUMER_CONTROL, 3);
+  put_record(UINT32_MAX, REPORT_ID_GAMEPAD, 4);
+
+  size_t pos = HID_TIMELINE_HEADER_LEN;
+  hid_timeline_record_t rec;
+  uint32_t const deltas[] = {0, 127, 128, UINT32_MAX};
+  uint8_t const ids[] = {REPORT_ID_KEYBOARD, REPORT_ID_MOUSE,
+                         REPORT_ID_CONSUMER_CONTROL, REPORT_ID_GAMEPAD};
+  for (int i = 0; i < 4; i++) {
+    CHECK(hid_timeline_next(buf, buf_len, &pos, &rec));
+    CHECK_EQ(rec.delta_us, deltas[i]);
+    CHECK_EQ(rec.report_id, ids[i]);
+    CHECK_EQ(rec.len, hid_timeline_report_len(ids[i]));
+    CHECK_EQ(rec.payload[0], i + 1);
+  }
+  CHECK_EQ(pos, buf_len);
+  CHECK(!hid_timeline_next(buf, buf_len, &pos, &rec));
+}
+
+static void test_decode_rejects(void) {
+  hid_timeline_record_t rec;
+  size_t pos;
+
+  // Varint longer than 32 bits
+  uint8_t const overflow[] = {0xff, 0xff, 0xff, 0xff, 0x1f, REPORT_ID_MOUSE};
+  pos = 0;
+  CHECK(!hid_timeline_next(overflow, sizeof(overflow), &pos, &rec));
+  CHECK_EQ(pos, 0);
+
+  uint8_t const endless[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
+  pos = 0;
+  CHECK(!hid_timeline_next(endless, sizeof(endless), &pos, &rec));
+
+  uint8_t const unknown_id[] = {0x00, 0x7f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  pos = 0;
+  CHECK(!hid_timeline_next(unknown_id, sizeof(unknown_id), &pos, &rec));
+
+  // Every truncation of a valid record fails without reading past the end
+  put_header();
+  put_record(300, REPORT_ID_GAMEPAD, 9);
+  for (size_t len = HID_TIMELINE_HEADER_LEN; len < buf_len; len++) {
+    uint8_t *copy = malloc(len);
+    memcpy(copy, buf, len);
+    pos = HID_TIMELINE_HEADER_LEN;
+    CHECK(!hid_timeline_next(copy, len, &pos, &rec));
+    free(copy);
+  }
+
+  hid_timeline_player_t player;
+  uint8_t const bad_version[] = {'H', 'T', 'L', HID_TIMELINE_VERSION + 1};
+  CHECK(!hid_timeline_start(&player, bad_version, sizeof(bad_version), 0));
+  CHECK(!hid_timeline_start(&player, bad_version, 3, 0));
+}
+
+//--------------------------------------------------------------------+
+// Replay
+//--------------------------------------------------------------------+
+
+static void test_replay_spaced(void) {
+  boot();
+  // Irregular gaps, all longer than the polling interval
+  put_header();
+  uint32_t seed = 1;
+  for (uint8_t i = 0; i < 100; i++) {
+    seed = seed * 1103515245u + 12345u;
+    uint32_t const gap = INTERVAL_US + 1 + (seed >> 16) % 40000;
+    put_record(gap, i & 1 ? REPORT_ID_MOUSE : REPORT_ID_KEYBOARD, i);
+  }
+
+  hid_timeline_player_t player;
+  sim_clear_reports();
+  uint64_t const start = time_us_64();
+  CHECK(hid_timeline_start(&player, buf, buf_len, start));
+  play(&player, start + 100 * 50000);
+  CHECK(!player.active);
+  CHECK_EQ(player.sent, 100);
+  check_replay(buf, buf_len, start);
+}
+
+static void test_replay_burst(void) {
+  boot();
+  // Bursts at the same time stamp queue on the endpoint
+  put_header();
+  for (uint8_t i = 0; i < 60; i++)
+    put_record(i % 6 ? 0 : 60000, REPORT_ID_MOUSE, i);
+
+  hid_timeline_player_t player;
+  sim_clear_reports();
+  uint64_t const start = time_us_64();
+  CHECK(hid_timeline_start(&player, buf, buf_len, start));
+  play(&player, start + 10 * 60000 + 100000);
+  CHECK_EQ(player.sent, 60);
+  check_replay(buf, buf_len, start);
+}
+
+static char const *capture_path;
+
+static void test_replay_capture(void) {
+  FILE *f = fopen(capture_path, "rb");
+  CHECK(f != NULL);
+  if (!f)
+    return;
+  static uint8_t capture[1 << 20];
+  size_t const len = fread(capture, 1, sizeof(capture), f);
+  fclose(f);
+
+  boot();
+  hid_timeline_player_t player;
+  sim_clear_reports();
+  uint64_t const start = time_us_64();
+  CHECK(hid_timeline_start(&player, capture, len, start));
+  uint64_t until = start;
+  while (player.active) {
+    until += 1000000;
+    play(&player, until);
+  }
+  play(&player, until + 100000);
+  check_replay(capture, len, start);
+}
+
+//--------------------------------------------------------------------+
+// Benchmarks
+//--------------------------------------------------------------------+
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_decode(void) {
+  size_t const records = 200000;
+  uint8_t *const saved = buf;
+  buf = malloc(HID_TIMELINE_HEADER_LEN + records * 16);
+  put_header();
+  for (size_t i = 0; i < records; i++)
+    put_record((uint32_t)(i * 977 % 70000), i % 3 ? REPORT_ID_MOUSE
+                                                   : REPORT_ID_KEYBOARD,
+               (uint8_t)i);
+
+  double const t0 = seconds();
+  size_t pos = HID_TIMELINE_HEADER_LEN, n = 0;
+  hid_timeline_record_t rec;
+  while (hid_timeline_next(buf, buf_len, &pos, &rec))
+    n++;
+  double const dt = seconds() - t0;
+  CHECK_EQ(n, records);
+  printf("bench: timeline decode %.1f Mrecords/s, %.1f MB/s\n",
+         n / dt / 1e6, buf_len / dt / 1e6);
+  free(buf);
+  buf = saved;
+}
+
+static void bench_replay(void) {
+  boot();
+  // Back to back, the bus is the limit
+  put_header();
+  for (uint16_t i = 0; i < 1000; i++)
+    put_record(0, REPORT_ID_KEYBOARD, (uint8_t)i);
+
+  hid_timeline_player_t player;
+  sim_clear_reports();
+  uint64_t const start = time_us_64();
+  double const t0 = seconds();
+  CHECK(hid_timeline_start(&player, buf, buf_len, start));
+  while (player.active || sim_report_count < 1000) {
+    play(&player, sim.now_us + 1000);
+    if (sim.now_us > start + 10000000)
+      break;
+  }
+  double const dt = seconds() - t0;
+  CHECK_EQ(sim_report_count, 1000);
+  double const sim_s = (sim.now_us - start) / 1e6;
+  printf("bench: timeline replay %.0f reports/s on the bus (%u us interval), "
+         "simulated %.1fx real time\n",
+         1000 / sim_s, INTERVAL_US, sim_s / dt);
+}
+
+// The demo text typed live, a keymap lookup per character, the way the
+// firmware did before it was pre-rendered: the same reports as
+// demo_text_reports, into out
+static size_t type_live(char const *text, hid_text_report_t *out) {
+  size_t n = 0;
+  uint8_t prev = 0;
+  for (char const *c = text; *c; c++) {
+    uint8_t modifier, keycode;
+    if (!hid_keymap_ascii(*c, &modifier, &keycode))
+      continue;
+    if (keycode == prev)
+      out[n++] = (hid_text_report_t){0};
+    out[n++] = (hid_text_report_t){.modifier = modifier, .keycode = {keycode}};
+    prev = keycode;
+  }
+  if (n)
+    out[n++] = (hid_text_report_t){0};
+  return n;
+}
+
+// Walks the pre-rendered reports as the firmware's STATE_TYPE_CHAR does
+static size_t type_rendered(hid_text_report_t *out) {
+  for (size_t i = 0; i < demo_text_reports.count; i++)
+    out[i] = demo_text_reports.reports[i];
+  return demo_text_reports.count;
+}
+
+static void bench_text(void) {
+  size_t const count = demo_text_reports.count;
+  hid_text_report_t *const live = calloc(count + 1, sizeof(*live));
+  hid_text_report_t *const rendered = calloc(count + 1, sizeof(*rendered));
+  CHECK_EQ(type_live(demo_text, live), count);
+  CHECK_EQ(type_rendered(rendered), count);
+  CHECK(memcmp(live, rendered, count * sizeof(*live)) == 0);
+
+  unsigned const rounds = 20000;
+  size_t n = 0;
+  double t0 = seconds();
+  for (unsigned r = 0; r < rounds; r++)
+    n += type_rendered(rendered);
+  double const rendered_ns = (seconds() - t0) / n * 1e9;
+  n = 0;
+  t0 = seconds();
+  for (unsigned r = 0; r < rounds; r++)
+    n += type_live(demo_text, live);
+  double const live_ns = (seconds() - t0) / n * 1e9;
+  // Keeps the rounds from being optimized away
+  CHECK(memcmp(live, rendered, count * sizeof(*live)) == 0);
+
+  printf("bench: demo text %zu reports, pre-rendered %.2f ns/report, "
+         "typed live %.2f ns/report\n",
+         count, rendered_ns, live_ns);
+  free(live);
+  free(rendered);
+}
+
+int main(int argc, char **argv) {
+  buf = malloc(64 * 1024);
+  RUN(test_decode);
+  RUN(test_decode_rejects);
+  RUN(test_replay_spaced);
+  RUN(test_replay_burst);
+  if (argc > 1) {
+    capture_path = argv[1];
+    RUN(test_replay_capture);
+  }
+  RUN(bench_decode);
+  RUN(bench_replay);
+  RUN(bench_text);
+  free(buf);
+  return test_result();
+}
@@ -0,0 +1,391 @@
+/*
+ * Transmit scheduler (hid_tx.h): latency of each class under load and rate
+ * limits, as the host sees them. Latency is from hid_tx_send() until the host
+ * has the report. The ETA hid_tx_send_ex() gives is checked against the same
+ * host, at bInterval and at a faster polling rate it has to learn.
+ */
+
+#include <stdlib.h>
+
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "pico/time.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+
+// Firmware modules as main() brings them up, then a plugged in, mounted bus
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+static void loop(void) {
+  sim_advance(sim.loop_us);
+  hid_tx_task();
+}
+
+// Reports carry a sequence number at data[2] (keyboard: first key, mouse:
+// y), so the host side can be matched to the enqueue time
+static bool send_seq(hid_tx_class_t cls, uint16_t seq) {
+  uint8_t report[8] = {0};
+  report[2] = (uint8_t)seq;
+  return hid_tx_send(cls, report, cls == HID_TX_KEYBOARD ? 8 : 5, 0);
+}
+
+static int cmp_u32(void const *a, void const *b) {
+  uint32_t const x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(uint32_t *v, size_t n, unsigned p) {
+  qsort(v, n, sizeof(*v), cmp_u32);
+  return v[(n - 1) * p / 100];
+}
+
+//--------------------------------------------------------------------+
+// Earliest deadline first
+//--------------------------------------------------------------------+
+
+#define MOUSE_PERIOD_US 8000
+#define MOUSE_REPORTS   250
+
+static void test_edf_latency(void) {
+  boot();
+  sim_clear_reports();
+
+  // Typing keeps the keyboard queue full, the mouse moves every 8 ms. The
+  // mouse starts once the typing is behind its deadlines: before, a key
+  // queued well before a mouse report can rightly go first.
+  static uint64_t enqueued[MOUSE_REPORTS];
+  uint16_t mouse = 0, keys = 0;
+  uint64_t const start = sim.now_us;
+  uint64_t next_mouse = start + 100000;
+  while (mouse < MOUSE_REPORTS || sim.now_us < next_mouse + 50000) {
+    while (send_seq(HID_TX_KEYBOARD, keys))
+      keys++;
+    if (mouse < MOUSE_REPORTS && sim.now_us >= next_mouse) {
+      enqueued[mouse] = sim.now_us;
+      CHECK(send_seq(HID_TX_MOUSE, mouse));
+      mouse++;
+      next_mouse += MOUSE_PERIOD_US;
+    }
+    loop();
+  }
+
+  static uint32_t latency[MOUSE_REPORTS];
+  size_t n = 0, keyboard = 0;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    sim_report_t const *r = &sim_reports[i];
+    if (r->data[0] == REPORT_ID_KEYBOARD)
+      keyboard++;
+    if (r->data[0] != REPORT_ID_MOUSE)
+      continue;
+    // In order, so the sequence number only needs its low byte
+    CHECK_EQ(r->data[3], (uint8_t)n);
+    if (n < MOUSE_REPORTS) {
+      latency[n] = (uint32_t)(r->time_us - enqueued[n]);
+      n++;
+    }
+  }
+  CHECK_EQ(n, MOUSE_REPORTS);
+
+  // A mouse report waits for the report on the wire, then for the poll
+  // after its own submit: two intervals and the loop at most
+  uint32_t const p50 = percentile(latency, n, 50);
+  uint32_t const p95 = percentile(latency, n, 95);
+  uint32_t const p99 = percentile(latency, n, 99);
+  uint32_t const max = latency[n - 1];
+  CHECK(max <= 2 * INTERVAL_US + sim.loop_us);
+
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_MOUSE, &stats);
+  CHECK_EQ(stats.missed, 0);
+  CHECK_EQ(stats.dropped, 0);
+
+  // Typing gets every poll the mouse does not need
+  uint64_t const polls = (sim.now_us - start) / INTERVAL_US;
+  CHECK(keyboard + n >= polls - 2);
+  printf("bench: mouse latency under typing p50 %u us, p95 %u us, p99 %u us, "
+         "max %u us; %zu keyboard reports in %llu polls\n",
+         p50, p95, p99, max, keyboard, (unsigned long long)polls);
+}
+
+static void test_starvation(void) {
+  boot();
+  sim_clear_reports();
+
+  // Both queues always full: the mouse wins every deadline, the keyboard is
+  // sent after CFG_APP_TX_MAX_SKIPS passes
+  uint16_t keys = 0, mouse = 0;
+  while (sim_report_count < 200) {
+    while (send_seq(HID_TX_KEYBOARD, keys))
+      keys++;
+    while (send_seq(HID_TX_MOUSE, mouse))
+      mouse++;
+    loop();
+  }
+
+  size_t run = 0, max_run = 0, keyboard = 0;
+  for (size_t i = 0; i < sim_report_count; i++) {
+    if (sim_reports[i].data[0] == REPORT_ID_KEYBOARD) {
+      keyboard++;
+      run = 0;
+    } else if (++run > max_run) {
+      max_run = run;
+    }
+  }
+  CHECK(keyboard > 0);
+  CHECK(max_run <= CFG_APP_TX_MAX_SKIPS + 1);
+}
+
+//--------------------------------------------------------------------+
+// Rate limit
+//--------------------------------------------------------------------+
+
+static void test_rate_limit(void) {
+  boot();
+  sim_clear_reports();
+  hid_tx_set_rate(HID_TX_KEYBOARD, 50, 2);
+
+  // A burst of two, then one every 20 ms
+  for (uint16_t i = 0; i < 10; i++)
+    CHECK(send_seq(HID_TX_KEYBOARD, i));
+  uint64_t const end = sim.now_us + 1000000;
+  while (sim.now_us < end)
+    loop();
+
+  CHECK_EQ(sim_report_count, 10);
+  CHECK(sim_reports[1].time_us - sim_reports[0].time_us <= INTERVAL_US);
+  // The third token is partly refilled while the burst goes out
+  CHECK(sim_reports[2].time_us - sim_reports[1].time_us < 20000);
+  for (size_t i = 3; i < sim_report_count; i++)
+    CHECK_EQ(sim_reports[i].time_us - sim_reports[i - 1].time_us, 20000);
+
+  // Each report that waited counts once, not once per look at it
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_KEYBOARD, &stats);
+  CHECK_EQ(stats.sent, 10);
+  CHECK_EQ(stats.throttled, 8);
+}
+
+static void test_rate_limit_idle(void) {
+  boot();
+  hid_tx_set_rate(HID_TX_KEYBOARD, 50, 2);
+
+  // Empty the bucket, then stay idle for just over the 2^32 us it takes
+  // time_us_32() to wrap: the bucket is full again
+  for (uint16_t i = 0; i < 2; i++)
+    CHECK(send_seq(HID_TX_KEYBOARD, i));
+  while (hid_tx_queued(HID_TX_KEYBOARD))
+    loop();
+  sim_advance((1ull << 32) + 1000);
+
+  sim_clear_reports();
+  for (uint16_t i = 0; i < 2; i++)
+    CHECK(send_seq(HID_TX_KEYBOARD, i));
+  uint64_t const end = sim.now_us + 3 * INTERVAL_US;
+  while (sim.now_us < end)
+    loop();
+  CHECK_EQ(sim_report_count, 2);
+
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_KEYBOARD, &stats);
+  CHECK_EQ(stats.throttled, 0);
+}
+
+//--------------------------------------------------------------------+
+// Backpressure
+//--------------------------------------------------------------------+
+
+#define ETA_REPORTS 240
+
+static uint64_t predicted[ETA_REPORTS];
+
+// Until the host has fetched a report the ETA can only guess its phase
+static void learn_phase(void) {
+  CHECK(send_seq(HID_TX_KEYBOARD, 0));
+  while (!hid_tx_idle(HID_TX_KEYBOARD))
+    loop();
+}
+
+// Queues ETA_REPORTS keyboard reports with hid_tx_send_ex() in bursts of 1
+// to burst reports, a random pause between bursts, and notes when each
+// should reach the host
+static void send_bursts(unsigned burst) {
+  sim_clear_reports();
+  srand(burst);
+  uint16_t seq = 0;
+  while (seq < ETA_REPORTS) {
+    for (unsigned n = 1 + rand() % burst; n && seq < ETA_REPORTS; n--) {
+      uint8_t report[8] = {0};
+      report[2] = (uint8_t)seq;
+      hid_tx_status_t status;
+      if (!hid_tx_send_ex(HID_TX_KEYBOARD, report, 8, 0, 0, &status))
+        break;
+      predicted[seq++] = sim.now_us + status.eta_us;
+    }
+    uint64_t const until = sim.now_us + rand() % (4 * INTERVAL_US);
+    while (sim.now_us < until)
+      loop();
+  }
+  while (!hid_tx_idle(HID_TX_KEYBOARD))
+    loop();
+}
+
+// Largest difference between the ETA and when the host had the report
+static uint32_t eta_error(uint32_t *p50) {
+  static uint32_t error[ETA_REPORTS];
+  CHECK_EQ(sim_report_count, ETA_REPORTS);
+  size_t const n = TU_MIN(sim_report_count, ETA_REPORTS);
+  for (size_t i = 0; i < n; i++) {
+    sim_report_t const *r = &sim_reports[i];
+    CHECK_EQ(r->data[3], (uint8_t)i);
+    error[i] = (uint32_t)(r->time_us > predicted[i]
+                              ? r->time_us - predicted[i]
+                              : predicted[i] - r->time_us);
+  }
+  *p50 = percentile(error, n, 50);
+  return error[n - 1];
+}
+
+static void test_eta(void) {
+  boot();
+  learn_phase();
+  uint32_t p50, max;
+  // From an idle endpoint: the next poll
+  send_bursts(1);
+  max = eta_error(&p50);
+  CHECK(max <= sim.loop_us);
+  // Deep queues: one poll per report ahead
+  send_bursts(12);
+  max = eta_error(&p50);
+  CHECK(max <= sim.loop_us);
+  printf("bench: ETA error p50 %u us, max %u us\n", p50, max);
+}
+
+static void test_eta_other_classes(void) {
+  boot();
+  learn_phase();
+  sim_clear_reports();
+  // Mouse reports due earlier go first, but the third is late by its turn
+  // and goes after the keyboard report, which can still make its deadline
+  for (uint16_t i = 0; i < 3; i++)
+    CHECK(send_seq(HID_TX_MOUSE, i));
+  hid_tx_status_t status;
+  uint8_t const report[8] = {0};
+  uint64_t const now = sim.now_us;
+  CHECK(hid_tx_send_ex(HID_TX_KEYBOARD, report, 8, 0, 0, &status));
+  CHECK_EQ(status.depth, 1);
+  while (!hid_tx_idle(HID_TX_MOUSE))
+    loop();
+
+  CHECK_EQ(sim_report_count, 4);
+  CHECK_EQ(sim_reports[2].data[0], REPORT_ID_KEYBOARD);
+  CHECK_EQ(sim_reports[2].time_us, now + status.eta_us);
+}
+
+static void test_eta_learns_interval(void) {
+  boot();
+  // The host polls every 2 ms, not at bInterval
+  sim.poll_interval = 2;
+  CHECK_EQ(hid_tx_poll_interval_us(), INTERVAL_US);
+  send_bursts(12);
+  uint32_t const learned = hid_tx_poll_interval_us();
+  CHECK(learned >= 1950 && learned <= 2050);
+
+  uint32_t p50;
+  send_bursts(12);
+  uint32_t const max = eta_error(&p50);
+  // The average moves in steps of 1/8 and settles a few us off, which adds
+  // up over the reports ahead
+  CHECK(max <= sim.loop_us + CFG_APP_TX_DEPTH_KEYBOARD *
+                                 (learned > 2000 ? learned - 2000
+                                                 : 2000 - learned));
+  printf("bench: ETA error at a learned %u us interval p50 %u us, max %u us\n",
+         learned, p50, max);
+}
+
+static void test_eta_rate_limited(void) {
+  boot();
+  hid_tx_set_rate(HID_TX_KEYBOARD, 100, 1);
+  // The token is there between two polls, the report leaves at the next
+  uint32_t p50;
+  send_bursts(4);
+  uint32_t const max = eta_error(&p50);
+  CHECK(max <= INTERVAL_US + sim.loop_us);
+}
+
+static void test_send_ex_full(void) {
+  boot();
+  learn_phase();
+  sim_clear_reports();
+  uint16_t seq = 0;
+  while (send_seq(HID_TX_KEYBOARD, seq))
+    seq++;
+
+  // Full: not queued, the ETA is when there is room
+  hid_tx_status_t status;
+  uint8_t const report[8] = {0};
+  uint64_t const full_us = sim.now_us;
+  CHECK(!hid_tx_send_ex(HID_TX_KEYBOARD, report, 8, 0, 0, &status));
+  CHECK_EQ(status.depth, CFG_APP_TX_DEPTH_KEYBOARD);
+  while (hid_tx_queued(HID_TX_KEYBOARD) == CFG_APP_TX_DEPTH_KEYBOARD)
+    loop();
+  uint64_t const room_us = sim.now_us;
+  CHECK(room_us + sim.loop_us >= full_us + status.eta_us);
+  CHECK(room_us <= full_us + status.eta_us + sim.loop_us);
+
+  // Waiting: queued once there is room, before the timeout
+  while (send_seq(HID_TX_KEYBOARD, seq))
+    seq++;
+  uint64_t const wait_us = sim.now_us;
+  CHECK(hid_tx_send_ex(HID_TX_KEYBOARD, report, 8, 0, 3 * INTERVAL_US,
+                       &status));
+  CHECK_EQ(status.depth, CFG_APP_TX_DEPTH_KEYBOARD);
+  CHECK(sim.now_us - wait_us <= INTERVAL_US + sim.loop_us);
+
+}
+
+static void test_send_ex_timeout(void) {
+  boot();
+  // Nothing leaves the queue within the wait
+  hid_tx_set_rate(HID_TX_KEYBOARD, 1, 1);
+  uint16_t seq = 0;
+  while (send_seq(HID_TX_KEYBOARD, seq))
+    seq++;
+
+  hid_tx_stats_t before, after;
+  hid_tx_status_t status;
+  uint8_t const report[8] = {0};
+  hid_tx_get_stats(HID_TX_KEYBOARD, &before);
+  uint64_t const wait_us = sim.now_us;
+  CHECK(!hid_tx_send_ex(HID_TX_KEYBOARD, report, 8, 0, 2 * INTERVAL_US,
+                        &status));
+  CHECK(sim.now_us - wait_us >= 2 * INTERVAL_US);
+  // The wait that ran out is one drop, not one per try
+  hid_tx_get_stats(HID_TX_KEYBOARD, &after);
+  CHECK_EQ(after.dropped - before.dropped, 1);
+}
+
+int main(void) {
+  RUN(test_edf_latency);
+  RUN(test_starvation);
+  RUN(test_rate_limit);
+  RUN(test_rate_limit_idle);
+  RUN(test_eta);
+  RUN(test_eta_other_classes);
+  RUN(test_eta_learns_interval);
+  RUN(test_eta_rate_limited);
+  RUN(test_send_ex_full);
+  RUN(test_send_ex_timeout);
+  return test_result();
+}
@@ -0,0 +1,207 @@
+/*
+ * SOF synchronized submission (CFG_APP_TX_SOF_SYNC in hid_tx.h), across bus
+ * resets. Reports are submitted right after the SOF of the frame the host
+ * polls in, so each one waits the same short time on the endpoint, and
+ * hid_tx_send_at_frame() reports leave in the frame asked for. Also built
+ * without the sync, where the time on the endpoint spreads over the poll
+ * interval: the two builds bound the spread from either side.
+ */
+
+#include "hid_arena.h"
+#include "hid_log.h"
+#include "hid_tx.h"
+#include "sim.h"
+#include "test.h"
+#include "usb_descriptors.h"
+
+#define INTERVAL_US (HID_POLL_INTERVAL * 1000u)
+
+static void boot(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+}
+
+// The main loop: queued reports are dropped while unmounted (hid_task())
+static void loop(void) {
+  sim_advance(sim.loop_us);
+  if (!tud_mounted())
+    hid_tx_flush();
+  hid_tx_task();
+}
+
+static void run(uint64_t us) {
+  uint64_t const end = sim.now_us + us;
+  while (sim.now_us < end)
+    loop();
+}
+
+// Reports at irregular times, none back to back
+static void send_spaced(unsigned count) {
+  uint32_t seed = 7;
+  for (unsigned i = 0; i < count; i++) {
+    uint8_t report[5] = {0, (uint8_t)i};
+    CHECK(hid_tx_send(HID_TX_MOUSE, report, sizeof(report), 0));
+    seed = seed * 1103515245u + 12345u;
+    run(2 * INTERVAL_US + (seed >> 16) % INTERVAL_US);
+  }
+}
+
+// Largest minus smallest time a report sat on the endpoint, from the first
+// logged report on
+static uint32_t wire_spread(size_t first) {
+  uint64_t min = UINT64_MAX, max = 0;
+  for (size_t i = first; i < sim_report_count; i++) {
+    uint64_t const wire = sim_reports[i].time_us - sim_reports[i].submit_us;
+    min = TU_MIN(min, wire);
+    max = TU_MAX(max, wire);
+  }
+  return min <= max ? (uint32_t)(max - min) : 0;
+}
+
+static void test_jitter(void) {
+  boot();
+  sim_clear_reports();
+  send_spaced(40);
+  CHECK_EQ(sim_report_count, 40);
+  // The first report learns the phase
+  uint32_t const spread = wire_spread(1);
+#if CFG_APP_TX_SOF_SYNC
+  CHECK(spread <= sim.loop_us);
+#else
+  // Submitted whenever it was sent, it waits a random part of the interval
+  CHECK(spread >= INTERVAL_US / 2);
+#endif
+  printf("bench: time on the endpoint spreads %u us (%s)\n", spread,
+         CFG_APP_TX_SOF_SYNC ? "SOF synced" : "unsynced");
+}
+
+#if CFG_APP_TX_SOF_SYNC
+
+static void check_wire(unsigned count) {
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_MOUSE, &stats);
+  CHECK_EQ(sim_report_count, count);
+  // The first report learns the phase and may wait up to an interval
+  CHECK(stats.max_wire_us <= INTERVAL_US);
+  printf("  %u reports, on the endpoint %u..%u us\n", stats.sent,
+         stats.min_wire_us, stats.max_wire_us);
+}
+
+static void test_sof_enabled_on_mount(void) {
+  sim_reset();
+  hid_arena_init();
+  hid_log_init();
+  hid_tx_init();
+  // Not before the device is configured
+  CHECK_EQ(sim.sof_enables, 0);
+  sim_plug();
+  tud_init(0);
+  sim_advance(100000);
+  CHECK(sim.mounted);
+  CHECK(sim.sof_enabled);
+  CHECK_EQ(sim.sof_enables, 1);
+}
+
+static void test_sync(void) {
+  boot();
+  sim_clear_reports();
+  send_spaced(20);
+  check_wire(20);
+
+  // Once in phase every report sits on the endpoint for the time from the
+  // SOF to the poll only
+  hid_tx_stats_t stats;
+  hid_tx_get_stats(HID_TX_MOUSE, &stats);
+  CHECK(stats.min_wire_us <= sim.poll_offset_us + sim.loop_us);
+}
+
+static void test_sync_after_bus_reset(void) {
+  boot();
+  send_spaced(5);
+
+  // The reset disables the SOF callback, the next mount enables it again.
+  // Without SOFs the learned phase would never open a submit window.
+  sim_bus_reset();
+  CHECK(!sim.sof_enabled);
+  run(100000);
+  CHECK(sim.mounted);
+  CHECK(sim.sof_enabled);
+  CHECK_EQ(sim.sof_enables, 2);
+
+  sim_clear_reports();
+  send_spaced(20);
+  CHECK_EQ(sim_report_count, 20);
+}
+
+// Queues a report for the given bus frame, returns the frame the host took
+// it in
+static uint32_t send_at_bus_frame(uint32_t bus_frame, uint8_t seq) {
+  // hid_tx_frame() counts the SOFs the bus numbers
+  uint32_t const offset = sim.frame - hid_tx_frame();
+  uint8_t report[5] = {0, seq};
+  CHECK(hid_tx_send_at_frame(HID_TX_MOUSE, report, sizeof(report), 0,
+                             bus_frame - offset));
+  size_t const before = sim_report_count;
+  while (sim_report_count == before && sim.frame < bus_frame + 100)
+    loop();
+  CHECK_EQ(sim_report_count, before + 1);
+  return sim_reports[sim_report_count - 1].frame;
+}
+
+static void test_send_at_frame(void) {
+  boot();
+  sim_clear_reports();
+  send_spaced(2);
+  uint32_t const poll = sim_reports[sim_report_count - 1].frame;
+
+  // In a polled frame: submitted at its SOF, taken in it
+  uint32_t const polled = poll + 4 * HID_POLL_INTERVAL;
+  CHECK_EQ(send_at_bus_frame(polled, 1), polled);
+  sim_report_t const *r = &sim_reports[sim_report_count - 1];
+  CHECK(r->submit_us >= r->time_us - sim.poll_offset_us);
+
+  // Between polls: not before it, at the next poll
+  uint32_t const between = poll + 6 * HID_POLL_INTERVAL + 2;
+  CHECK_EQ(send_at_bus_frame(between, 2),
+           poll + 7 * HID_POLL_INTERVAL);
+
+  // Other classes go ahead of a held report, its own class waits behind
+  // it in order
+  uint32_t const later = sim.frame + 20 * HID_POLL_INTERVAL;
+  uint32_t const offset = sim.frame - hid_tx_frame();
+  uint8_t report[5] = {0, 3};
+  CHECK(hid_tx_send_at_frame(HID_TX_MOUSE, report, sizeof(report), 0,
+                             later - offset));
+  report[1] = 4;
+  CHECK(hid_tx_send(HID_TX_MOUSE, report, sizeof(report), 0));
+  uint8_t const key[8] = {0};
+  CHECK(hid_tx_send(HID_TX_KEYBOARD, key, sizeof(key), 0));
+  size_t const before = sim_report_count;
+  run(2 * INTERVAL_US);
+  CHECK_EQ(sim_report_count, before + 1);
+  CHECK_EQ(sim_reports[before].data[0], REPORT_ID_KEYBOARD);
+  while (sim_report_count < before + 3 && sim.frame < later + 100)
+    loop();
+  CHECK_EQ(sim_report_count, before + 3);
+  CHECK_EQ(sim_reports[before + 1].frame, later);
+  CHECK_EQ(sim_reports[before + 1].data[2], 3);
+  CHECK_EQ(sim_reports[before + 2].data[2], 4);
+}
+
+#endif
+
+int main(void) {
+  RUN(test_jitter);
+#if CFG_APP_TX_SOF_SYNC
+  RUN(test_sof_enabled_on_mount);
+  RUN(test_sync);
+  RUN(test_sync_after_bus_reset);
+  RUN(test_send_at_frame);
+#endif
+  return test_result();
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Tests of the pointer path simplification of tools/evdev_to_timeline.py.
+
+The replayed path must stay within the tolerance of every recorded point,
+moves may not be further apart than the time bound unless the recording
+was, and clicks happen where they were recorded.
+"""
+
+import os
+import random
+import struct
+import sys
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+
+import evdev_to_timeline as e2t  # noqa: E402
+from evdev_to_timeline import REPORT_ID_KEYBOARD, REPORT_ID_MOUSE  # noqa: E402
+
+
+def mouse(t, dx, dy, buttons=0):
+    return (t, REPORT_ID_MOUSE, struct.pack("<Bbbbb", buttons, dx, dy, 0, 0))
+
+
+def moves(points):
+    """Mouse reports that visit the absolute points (time_us, x, y)."""
+    out, x, y = [], 0, 0
+    for t, px, py in points:
+        for dx, dy in e2t.split_motion(px - x, py - y):
+            out.append(mouse(t, dx, dy))
+        x, y = px, py
+    return out
+
+
+def positions(records):
+    """Absolute position after the last mouse report of each time."""
+    out, x, y = [], 0, 0
+    for t, report_id, payload in records:
+        if report_id != REPORT_ID_MOUSE:
+            continue
+        _, dx, dy, _, _ = struct.unpack("<Bbbbb", payload)
+        x, y = x + dx, y + dy
+        if out and out[-1][0] == t:
+            out[-1] = (t, x, y)
+        else:
+            out.append((t, x, y))
+    return out
+
+
+def simplify(points, tolerance, window=64, max_gap_us=50000):
+    simplifier = e2t.PathSimplifier(tolerance, window, max_gap_us)
+    out = e2t.simplify_motion(moves(points), simplifier)
+    return out, simplifier
+
+
+def deviation(p, a, b):
+    num, den = e2t.dist_sq(p[1:], a[1:], b[1:])
+    return (num / den) ** 0.5
+
+
+class SplitMotion(unittest.TestCase):
+    def test_steps(self):
+        for dx, dy in [(0, 0), (127, -127), (128, 0), (-1000, 3), (300, 299)]:
+            steps = list(e2t.split_motion(dx, dy))
+            self.assertEqual((sum(s[0] for s in steps), sum(s[1] for s in steps)),
+                             (dx, dy))
+            self.assertTrue(all(abs(s[0]) <= 127 and abs(s[1]) <= 127 for s in steps))
+
+
+class Simplify(unittest.TestCase):
+    def check_within(self, points, tolerance, window, max_gap_us):
+        out, simplifier = simplify(points, tolerance, window, max_gap_us)
+        kept = positions(out)
+        # The replay ends where the recording does, through kept points
+        self.assertEqual(kept[-1], points[-1])
+        self.assertTrue(set(kept) <= set(points))
+
+        # Every recorded point is within the tolerance of the replayed
+        # segment over its time, which the tool reports as its maximum
+        bound = round(tolerance * 16) / 16
+        worst = 0.0
+        start = (points[0][0], 0, 0)
+        prev, k = start, 0
+        for p in points:
+            while kept[k][0] < p[0]:
+                prev, k = kept[k], k + 1
+            worst = max(worst, deviation(p, prev, kept[k]))
+        self.assertLessEqual(worst, bound + 1e-9)
+        self.assertLessEqual(simplifier.max_dev_sq ** 0.5, bound + 1e-9)
+
+        # Moves no further apart than the bound, unless recorded that way
+        times = [start[0]] + [p[0] for p in points]
+        for (t0, _, _), (t1, _, _) in zip([start] + kept, kept):
+            if t1 - t0 > max_gap_us:
+                self.assertEqual(times[times.index(t1) - 1], t0)
+        return out
+
+    def test_random_walks(self):
+        total_in = total_out = 0
+        for seed in range(100):
+            rng = random.Random(seed)
+            points, t, x, y = [], 0, 0, 0
+            vx, vy = rng.randint(-20, 20), rng.randint(-20, 20)
+            # One report per point
+            for _ in range(rng.randint(2, 400)):
+                t += rng.choice([1000, 4000, 8000, 8000, 30000, 200000])
+                vx = max(-127, min(127, vx + rng.randint(-4, 4)))
+                vy = max(-127, min(127, vy + rng.randint(-4, 4)))
+                x, y = x + vx, y + vy
+                points.append((t, x, y))
+            tolerance = rng.choice([0.5, 1, 1.5, 4, 20])
+            window = rng.choice([2, 8, 64, 1000])
+            with self.subTest(seed=seed, tolerance=tolerance, window=window):
+                out = self.check_within(points, tolerance, window, 50000)
+            total_in += len(moves(points))
+            total_out += len(out)
+        print("\nrandom paths: %d -> %d reports" % (total_in, total_out),
+              file=sys.stderr)
+
+    def test_fast_line_is_one_move(self):
+        # Recorded from boot or with evdev's wall clock time stamps
+        for base in [0, 1700000000 * 1000000]:
+            points = [(base + 1000 * i, 3 * i, i) for i in range(1, 41)]
+            out, _ = simplify(points, 1.5)
+            self.assertEqual(positions(out), [points[-1]])
+
+    def test_slow_drag_keeps_its_pace(self):
+        # 2 s along a line, a count every 8 ms
+        points = [(8000 * i, i, 0) for i in range(1, 251)]
+        out = self.check_within(points, 1.5, 64, 50000)
+        kept = positions(out)
+        self.assertGreaterEqual(len(kept), 2000000 // 50000)
+        self.assertLess(len(kept), len(points) // 2)
+        for (t0, _, _), (t1, _, _) in zip(kept, kept[1:]):
+            self.assertLessEqual(t1 - t0, 50000)
+
+    def test_click_where_recorded(self):
+        records = moves([(1000 * i, 2 * i, 0) for i in range(1, 21)])
+        records.append(mouse(21000, 0, 0, 1))
+        records += [(t + 21000, rid, p) for t, rid, p in
+                    moves([(1000 * i, i, i) for i in range(1, 11)])]
+        records.append((40000, REPORT_ID_KEYBOARD, bytes(8)))
+        out = e2t.simplify_motion(records, e2t.PathSimplifier(2))
+        self.assertLess(len(out), len(records))
+        x = 0
+        for t, report_id, payload in out:
+            if report_id != REPORT_ID_MOUSE:
+                continue
+            buttons, dx, _, _, _ = struct.unpack("<Bbbbb", payload)
+            if buttons and t == 21000:
+                self.assertEqual(x, 40)
+            x += dx
+        self.assertEqual(out[-1][1], REPORT_ID_KEYBOARD)
+
+
+if __name__ == "__main__":
+    unittest.main()
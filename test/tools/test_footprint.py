@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Tests of tools/footprint.py against test/data/footprint_sample.map."""
+
+import io
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+from contextlib import redirect_stdout
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+
+import footprint  # noqa: E402
+
+MAP = os.path.join(HERE, "..", "data", "footprint_sample.map")
+BUDGETS = os.path.join(ROOT, "tools", "footprint_budgets.ini")
+OBJ = "CMakeFiles/pico_hid_device.dir/%s.obj"
+USBD = "/home/dev/pico-sdk/build/libtinyusb_device.a(usbd.c.obj)"
+
+
+def run(*args):
+    return subprocess.run([sys.executable, os.path.join(ROOT, "tools", "footprint.py"),
+                           MAP] + list(args), capture_output=True, text=True)
+
+
+class ParseMap(unittest.TestCase):
+    def setUp(self):
+        self.per_object, self.per_section = footprint.parse_map(MAP)
+
+    def sizes(self, obj):
+        return self.per_object[obj]
+
+    def test_wrapped_and_single_line_sections(self):
+        self.assertEqual(self.sizes(OBJ % "main.c"),
+                         {"text": 0x9c + 0x64, "rodata": 4, "data": 0x30, "bss": 0})
+
+    def test_section_kinds(self):
+        self.assertEqual(self.sizes(OBJ % "hid_tx.c"),
+                         {"text": 0, "rodata": 0, "data": 0x90, "bss": 0x200})
+        self.assertEqual(self.sizes(OBJ % "hid_log.c")["bss"], 0x20)
+        self.assertEqual(self.sizes(OBJ % "boot_profile.c")["bss"], 0x40)
+        self.assertEqual(self.sizes(USBD), {"text": 0x400, "rodata": 0, "data": 0, "bss": 0x60})
+
+    def test_discarded_input_ignored(self):
+        # Before the memory map, and zero sized within it
+        self.assertNotIn((OBJ % "main.c", ".text.unused_helper"), self.per_section)
+        self.assertEqual(self.sizes(OBJ % "hid_log.c")["text"], 0)
+
+    def test_short_name(self):
+        self.assertEqual(footprint.short_name(USBD), "usbd.c")
+        self.assertEqual(footprint.short_name(OBJ % "main.c"), "main.c")
+
+
+class Report(unittest.TestCase):
+    def test_groups_and_ram_functions(self):
+        groups, budgets = footprint.load_config(BUDGETS, "rp2350")
+        per_object, per_section = footprint.parse_map(MAP)
+        self.assertEqual(footprint.group_of(OBJ % "hid_tx.c", groups), "hid_engine")
+        self.assertEqual(footprint.group_of(USBD, groups), "tinyusb")
+        self.assertEqual(footprint.group_of(OBJ % "boot_profile.c", groups), "other")
+
+        out = io.StringIO()
+        with redirect_stdout(out):
+            footprint.print_ram_functions(per_section)
+        lines = out.getvalue().splitlines()
+        self.assertEqual(lines[1].split(), ["hid_tx_task", "hid_tx.c", "128"])
+        self.assertEqual(lines[3].split(), ["total", "176"])
+
+    def test_within_budgets(self):
+        r = run("--budgets", BUDGETS, "--platform", "rp2040", "--files")
+        self.assertEqual(r.returncode, 0, r.stderr)
+        self.assertIn("Per source file", r.stdout)
+
+    def test_budget_exceeded(self):
+        with tempfile.NamedTemporaryFile("w", suffix=".ini", delete=False) as f:
+            f.write("[groups]\nhid_engine = */main.c.obj */hid_*.c.obj\n"
+                    "[budget]\nhid_engine.ram = 600\n"
+                    "[budget.rp2350]\nhid_engine.ram = 1024\n")
+        try:
+            # data 0x30 + 0x90, bss 0x200 + 0x20
+            r = run("--budgets", f.name)
+            self.assertEqual(r.returncode, 1)
+            self.assertIn("hid_engine.ram is 736 bytes, budget 600 (+136)", r.stderr)
+            r = run("--budgets", f.name, "--platform", "rp2350")
+            self.assertEqual(r.returncode, 0, r.stderr)
+        finally:
+            os.unlink(f.name)
+
+
+if __name__ == "__main__":
+    unittest.main()
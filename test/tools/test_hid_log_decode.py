@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Tests of tools/hid_log_decode.py.
+
+    test_hid_log_decode.py [ELF PREFIX]
+
+With arguments, also decodes PREFIX.bin, the log test_log drained from the
+firmware, with the format strings of its executable ELF, and compares the
+result with PREFIX.txt, what printf made of the same calls.
+"""
+
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+
+import hid_log_decode  # noqa: E402
+
+ELF = PREFIX = None
+
+
+def run(*args):
+    return subprocess.run([sys.executable, os.path.join(ROOT, "tools", "hid_log_decode.py")]
+                          + list(args), capture_output=True, text=True)
+
+
+class FormatRecord(unittest.TestCase):
+    def check(self, fmt, args, text):
+        self.assertEqual(hid_log_decode.format_record(fmt, args), text)
+
+    def test_signed(self):
+        self.check("%d %i", [0xFFFFFFFB, 7], "-5 7")
+        self.check("%ld", [0x80000000], "-2147483648")
+
+    def test_unsigned_and_hex(self):
+        self.check("%u", [4000000000], "4000000000")
+        self.check("%x %X %08x", [0xBEEF, 0xBEEF, 0x12], "beef BEEF 00000012")
+
+    def test_flags_and_percent(self):
+        self.check("100%% |%5d|%-5d|%+d|% d|", [42, 42, 3, 3], "100% |   42|42   |+3| 3|")
+        self.check("%c%c", [ord("o"), ord("k")], "ok")
+
+    def test_missing_arguments_are_zero(self):
+        self.check("%u %u", [1], "1 0")
+
+
+class Decoder(unittest.TestCase):
+    FORMATS = {0: "a %u", 8: "b"}
+
+    def test_records_split_across_chunks(self):
+        decoder = hid_log_decode.Decoder(self.FORMATS)
+        words = [0 << 8 | 1, 10, 5, 8 << 8 | 0, 20]
+        out = []
+        for w in words:
+            out.extend(decoder.feed([w]))
+        self.assertEqual(out, [(10, "a 5"), (20, "b")])
+        self.assertEqual(decoder.words, [])
+
+    def test_unknown_format(self):
+        decoder = hid_log_decode.Decoder(self.FORMATS)
+        out = list(decoder.feed([0x123 << 8 | 1, 30, 9]))
+        self.assertEqual(out, [(30, "<unknown format 0x000123> [9]")])
+
+
+@unittest.skipIf(len(sys.argv) < 3, "no firmware log given")
+class Firmware(unittest.TestCase):
+    def expected(self):
+        with open(PREFIX + ".txt") as f:
+            return f.read().splitlines()
+
+    def test_dictionary(self):
+        formats = hid_log_decode.dictionary_from_elf(ELF)
+        self.assertIn("log: %u records dropped", formats.values())
+        self.assertIn("signed %d %i", formats.values())
+
+    def test_decode_matches_printf(self):
+        r = run(ELF, PREFIX + ".bin")
+        self.assertEqual(r.returncode, 0, r.stderr)
+        self.assertEqual(r.stdout.splitlines(), self.expected())
+
+    def test_decode_with_extracted_dictionary(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            dictionary = os.path.join(tmp, "formats.json")
+            r = run(ELF, "--extract", "-o", dictionary)
+            self.assertEqual(r.returncode, 0, r.stderr)
+            with open(dictionary) as f:
+                self.assertTrue(json.load(f))
+            r = run(dictionary, PREFIX + ".bin")
+            self.assertEqual(r.returncode, 0, r.stderr)
+            self.assertEqual(r.stdout.splitlines(), self.expected())
+
+    def test_truncated_dump(self):
+        # A record cut off at the end of the dump is not printed
+        with open(PREFIX + ".bin", "rb") as f:
+            data = f.read()
+        header, = struct.unpack_from("<I", data)
+        with tempfile.NamedTemporaryFile(suffix=".bin", delete=False) as f:
+            f.write(data[:4 * (2 + (header & 0xFF)) - 4])
+        try:
+            r = run(ELF, f.name)
+            self.assertEqual(r.returncode, 0, r.stderr)
+            self.assertEqual(r.stdout, "")
+        finally:
+            os.unlink(f.name)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 3:
+        ELF, PREFIX = sys.argv[1], sys.argv[2]
+    unittest.main(argv=sys.argv[:1])
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Tests of tools/text_to_timeline.py.
+
+    test_text_to_timeline.py HID_H
+
+HID_H is the hid.h to take the keymap from, test/stubs/tusb.h for the host
+build. Its table is checked against a US layout written out by hand.
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+
+import text_to_timeline  # noqa: E402
+from evdev_to_timeline import REPORT_ID_KEYBOARD, TIMELINE_HEADER  # noqa: E402
+
+HID_H = None
+
+SHIFT = 0x02
+
+# HID keyboard usages of the unshifted and shifted characters of each key
+US_KEYS = [
+    (0x1E, "1!"), (0x1F, "2@"), (0x20, "3#"), (0x21, "4$"), (0x22, "5%"),
+    (0x23, "6^"), (0x24, "7&"), (0x25, "8*"), (0x26, "9("), (0x27, "0)"),
+    (0x28, "\n"), (0x2B, "\t"), (0x2C, " "), (0x2D, "-_"), (0x2E, "=+"),
+    (0x2F, "[{"), (0x30, "]}"), (0x31, "\\|"), (0x33, ";:"), (0x34, "'\""),
+    (0x35, "`~"), (0x36, ",<"), (0x37, ".>"), (0x38, "/?"),
+]
+
+
+def us_layout():
+    table = {}
+    for i in range(26):
+        table[chr(ord("a") + i)] = (0, 0x04 + i)
+        table[chr(ord("A") + i)] = (SHIFT, 0x04 + i)
+    for usage, chars in US_KEYS:
+        table[chars[0]] = (0, usage)
+        if len(chars) > 1:
+            table[chars[1]] = (SHIFT, usage)
+    return table
+
+
+def header(entries, extra=""):
+    lines = ["#define HID_KEY_A 0x04", "#define HID_KEY_B 0x05", extra,
+             "#define HID_ASCII_TO_KEYCODE \\"]
+    lines += ["    {%s, %s}, /* %d */ \\" % (s, k, i) for i, (s, k) in enumerate(entries)]
+    return "\n".join(lines) + "\n"
+
+
+def table_with(chars):
+    """128 entries, chars maps characters to (shift, key name)."""
+    return [chars.get(chr(i), (0, 0)) for i in range(128)]
+
+
+@unittest.skipIf(len(sys.argv) < 2, "no hid.h given")
+class Keymap(unittest.TestCase):
+    def setUp(self):
+        with open(HID_H) as f:
+            self.table = text_to_timeline.keymap(f.read())
+
+    def test_printable_ascii_is_us_layout(self):
+        us = us_layout()
+        for code in range(0x20, 0x7F):
+            ch = chr(code)
+            self.assertEqual(self.table.get(ch), us.get(ch), repr(ch))
+
+    def test_line_feed_and_tab(self):
+        self.assertEqual(self.table["\n"], (0, 0x28))
+        self.assertEqual(self.table["\t"], (0, 0x2B))
+
+    def test_unmapped(self):
+        self.assertNotIn("\x00", self.table)
+        self.assertNotIn("\x01", self.table)
+
+
+class Parse(unittest.TestCase):
+    def test_names_and_numbers(self):
+        table = text_to_timeline.keymap(
+            header(table_with({"a": ("0", "HID_KEY_A"), "B": ("1", "HID_KEY_B"),
+                               "c": ("0", "0x06")})))
+        self.assertEqual(table, {"a": (0, 4), "B": (SHIFT, 5), "c": (0, 6)})
+
+    def test_no_table(self):
+        with self.assertRaisesRegex(ValueError, "no HID_ASCII_TO_KEYCODE"):
+            text_to_timeline.keymap("#define HID_KEY_A 0x04\n")
+
+    def test_short_table(self):
+        with self.assertRaisesRegex(ValueError, "127 entries"):
+            text_to_timeline.keymap(header(table_with({})[:127]))
+
+    def test_undefined_key(self):
+        with self.assertRaisesRegex(ValueError, "HID_KEY_Z"):
+            text_to_timeline.keymap(header(table_with({"z": ("0", "HID_KEY_Z")})))
+
+
+class Render(unittest.TestCase):
+    TABLE = {"a": (0, 4), "A": (SHIFT, 4), "b": (0, 5), "\n": (0, 0x28)}
+
+    def reports(self, text, interval_us=0):
+        data, count = text_to_timeline.render(text, self.TABLE, interval_us)
+        self.assertTrue(data.startswith(TIMELINE_HEADER))
+        body = data[len(TIMELINE_HEADER):]
+        out = []
+        while body:
+            # One byte varint delta in these tests
+            self.assertLess(body[0], 0x80)
+            self.assertEqual(body[1], REPORT_ID_KEYBOARD)
+            out.append((body[0], body[2:10]))
+            body = body[10:]
+        self.assertEqual(len(out), count)
+        return out
+
+    def test_release_between_same_key(self):
+        r = [payload for _, payload in self.reports("aAb")]
+        self.assertEqual(r, [bytes([0, 0, 4, 0, 0, 0, 0, 0]), bytes(8),
+                             bytes([SHIFT, 0, 4, 0, 0, 0, 0, 0]),
+                             bytes([0, 0, 5, 0, 0, 0, 0, 0]), bytes(8)])
+
+    def test_carriage_return_skipped(self):
+        r = [payload[2] for _, payload in self.reports("a\r\nb")]
+        self.assertEqual(r, [4, 0x28, 5, 0])
+
+    def test_interval(self):
+        self.assertEqual([d for d, _ in self.reports("ab", 100)], [0, 100, 100])
+
+    def test_unknown_character(self):
+        with self.assertRaisesRegex(ValueError, "offset 1"):
+            text_to_timeline.render("aé", self.TABLE, 0)
+
+
+@unittest.skipIf(len(sys.argv) < 2, "no hid.h given")
+class Command(unittest.TestCase):
+    def run_tool(self, *args):
+        return subprocess.run([sys.executable, os.path.join(ROOT, "tools", "text_to_timeline.py")]
+                              + list(args), capture_output=True, text=True)
+
+    def test_c_array(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            text = os.path.join(tmp, "payload.txt")
+            out = os.path.join(tmp, "payload_timeline.c")
+            with open(text, "w") as f:
+                f.write("Hello World!\n")
+            result = self.run_tool(text, "--keymap", HID_H, "--c-array", "-o", out)
+            self.assertEqual(result.returncode, 0, result.stderr)
+            self.assertIn("15 reports", result.stderr)
+            with open(out) as f:
+                self.assertIn("replay_timeline", f.read())
+
+    def test_keymap_required(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            text = os.path.join(tmp, "payload.txt")
+            with open(text, "w") as f:
+                f.write("a")
+            result = self.run_tool(text, "-o", os.path.join(tmp, "out.bin"))
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn("--keymap", result.stderr)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 2:
+        HID_H = sys.argv[1]
+    unittest.main(argv=sys.argv[:1])
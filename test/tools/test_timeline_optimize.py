@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Tests of tools/timeline_optimize.py.
+
+    test_timeline_optimize.py [TIMELINE]
+
+The packing rules are checked case by case, then on random timelines: the
+optimized timeline must give the host the same events with no more reports.
+With an argument, also optimizes TIMELINE, e.g. the capture the
+timeline_convert test writes.
+"""
+
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+
+import timeline_optimize as opt  # noqa: E402
+from evdev_to_timeline import REPORT_ID_KEYBOARD, REPORT_ID_MOUSE  # noqa: E402
+
+TIMELINE = None
+
+REPORT_ID_CONSUMER = 3
+SHIFT = 0x02
+A, B, C = 0x04, 0x05, 0x06
+
+
+def kbd(t, mod=0, *keys):
+    return (t, REPORT_ID_KEYBOARD, bytes([mod, 0] + (list(keys) + [0] * 6)[:6]))
+
+
+def mouse(t, buttons=0, x=0, y=0, wheel=0, pan=0):
+    return (t, REPORT_ID_MOUSE, struct.pack("<Bbbbb", buttons, x, y, wheel, pan))
+
+
+class Timeline(unittest.TestCase):
+    def test_round_trip(self):
+        records = [kbd(0, 0, A), kbd(300, 0), mouse(1000000, 1, -5, 7),
+                   (1000001, REPORT_ID_CONSUMER, b"\xe9\x00")]
+        self.assertEqual(opt.read_timeline(opt.write_timeline(records)), records)
+
+    def test_rejects(self):
+        with self.assertRaisesRegex(ValueError, "version"):
+            opt.read_timeline(b"XXXX")
+        data = opt.write_timeline([kbd(0, 0, A)])
+        with self.assertRaisesRegex(ValueError, "bad record"):
+            opt.read_timeline(data[:-1])
+
+
+class Packing(unittest.TestCase):
+    def optimized(self, records, window_us=5000):
+        out = opt.optimize(records, window_us)
+        self.assertEqual(opt.normalized(opt.host_events(out)),
+                         opt.normalized(opt.host_events(records)))
+        return out
+
+    def test_presses_share_a_report(self):
+        out = self.optimized([kbd(0, 0, A), kbd(100, 0, A, B), kbd(200, 0, A, B, C)])
+        self.assertEqual(out, [kbd(0, 0, A, B, C)])
+
+    def test_releases_join_the_next_presses(self):
+        out = self.optimized([kbd(0, 0, A), kbd(100, 0), kbd(200, 0, B), kbd(300, 0)])
+        self.assertEqual(out, [kbd(0, 0, A), kbd(100, 0, B), kbd(300, 0)])
+
+    def test_same_key_again_is_not_merged(self):
+        out = self.optimized([kbd(0, 0, A), kbd(100, 0), kbd(200, 0, A), kbd(300, 0)])
+        self.assertEqual(len(out), 4)
+
+    def test_seven_keys_need_two_reports(self):
+        keys = list(range(A, A + 7))
+        records = [kbd(10 * i, 0, *keys[:i + 1][-6:]) for i in range(7)]
+        self.assertEqual(len(self.optimized(records)), 2)
+
+    def test_shift_folds_into_the_key(self):
+        out = self.optimized([kbd(0, SHIFT), kbd(100, SHIFT, A), kbd(200, 0)])
+        self.assertEqual(out, [kbd(0, SHIFT, A), kbd(200, 0)])
+
+    def test_shift_after_a_press_does_not_fold(self):
+        # The host applies modifiers before keys, folded A would be shifted
+        out = self.optimized([kbd(0, 0, A), kbd(100, SHIFT, A)])
+        self.assertEqual(len(out), 2)
+
+    def test_window(self):
+        out = self.optimized([kbd(0, 0, A), kbd(100, 0, A, B)], window_us=50)
+        self.assertEqual(len(out), 2)
+
+    def test_motion_is_summed_and_split(self):
+        out = self.optimized([mouse(10 * i, 0, 100, -1) for i in range(3)])
+        self.assertEqual(out, [mouse(0, 0, 127, -3), mouse(0, 0, 127), mouse(0, 0, 46)])
+
+    def test_motion_joins_a_button_change(self):
+        out = self.optimized([mouse(0, 1), mouse(100, 1, 5), mouse(200, 0, 0, 3)])
+        self.assertEqual(out, [mouse(0, 1, 5), mouse(200, 0, 0, 3)])
+
+    def test_motion_before_a_button_change_does_not(self):
+        out = self.optimized([mouse(0, 0, 5), mouse(100, 1)])
+        self.assertEqual(out, [mouse(0, 0, 5), mouse(100, 1)])
+
+    def test_no_change_is_dropped(self):
+        out = self.optimized([kbd(0, 0, A), kbd(100, 0, A), mouse(200), kbd(20000, 0)])
+        self.assertEqual(out, [kbd(0, 0, A), kbd(20000, 0)])
+
+    def test_other_reports_pass_in_order(self):
+        consumer = (100, REPORT_ID_CONSUMER, b"\xe9\x00")
+        out = self.optimized([kbd(0, 0, A), consumer, kbd(200, 0, A, B)])
+        self.assertEqual(out, [kbd(0, 0, A), consumer, kbd(200, 0, A, B)])
+
+
+class Random(unittest.TestCase):
+    """Random timelines, as a recorder could produce them."""
+
+    @staticmethod
+    def timeline(rng, n):
+        records, t, keys = [], 0, []
+        for _ in range(n):
+            t += rng.choice([0, 10, 1000, 4000, 8000, 30000])
+            kind = rng.random()
+            if kind < 0.6:
+                # Release or press a key, sometimes change the modifiers
+                if keys and rng.random() < 0.5:
+                    keys.remove(rng.choice(keys))
+                elif len(keys) < 6:
+                    key = rng.choice([k for k in range(A, A + 8) if k not in keys])
+                    keys.append(key)
+                mod = rng.choice([0, 0, 0, SHIFT, 0x01, 0x03])
+                records.append(kbd(t, mod, *keys))
+            elif kind < 0.95:
+                records.append(mouse(t, rng.choice([0, 0, 1, 2, 3]),
+                                     rng.randint(-127, 127), rng.randint(-3, 3),
+                                     rng.choice([0, 0, 1, -1]), 0))
+            else:
+                records.append((t, REPORT_ID_CONSUMER, bytes([rng.randint(0, 255), 0])))
+        return records
+
+    def test_host_sees_the_same(self):
+        total_in = total_out = 0
+        for seed in range(300):
+            rng = random.Random(seed)
+            records = self.timeline(rng, rng.randint(1, 60))
+            window = rng.choice([0, 1000, 5000, 50000])
+            out = opt.optimize(records, window)
+            with self.subTest(seed=seed, window=window):
+                self.assertEqual(opt.normalized(opt.host_events(out)),
+                                 opt.normalized(opt.host_events(records)))
+                self.assertLessEqual(len(out), len(records) + sum(
+                    1 for r in records if r[1] == REPORT_ID_MOUSE))
+                times = [r[0] for r in out]
+                self.assertEqual(times, sorted(times))
+                # Round trip through the file format, which starts at 0
+                t0 = out[0][0] if out else 0
+                self.assertEqual(opt.read_timeline(opt.write_timeline(out)),
+                                 [(t - t0, rid, payload) for t, rid, payload in out])
+            total_in += len(records)
+            total_out += len(out)
+        print("\nrandom timelines: %d -> %d reports" % (total_in, total_out),
+              file=sys.stderr)
+
+
+@unittest.skipIf(len(sys.argv) < 2, "no timeline given")
+class Capture(unittest.TestCase):
+    def test_check(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            out = os.path.join(tmp, "opt.bin")
+            result = subprocess.run(
+                [sys.executable, os.path.join(ROOT, "tools", "timeline_optimize.py"),
+                 TIMELINE, "-o", out, "--check"], capture_output=True, text=True)
+            self.assertEqual(result.returncode, 0, result.stderr)
+            with open(TIMELINE, "rb") as f:
+                before = opt.read_timeline(f.read())
+            with open(out, "rb") as f:
+                after = opt.read_timeline(f.read())
+            self.assertLess(len(after), len(before))
+            print("\n" + result.stderr.strip(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 2:
+        TIMELINE = sys.argv[1]
+    unittest.main(argv=sys.argv[:1])
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Host side of the clock_sync.h protocol (needs the `hidapi` package).
+
+    clock_sync_host.py                      # sync and print offset/drift
+    clock_sync_host.py --type-at 1700000000.250 a
+
+Timestamps are the host's CLOCK_REALTIME in µs, so several rigs whose hosts
+are NTP/PTP synchronized can be told to act at the same instant.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import hid
+
+VID, PID = 0xCAFE, 0x4004
+REPORT_ID_CLOCK_SYNC = 5
+REPORT_ID_KEYBOARD = 1
+FEATURE_LEN = 31
+
+OP_PING, OP_SCHEDULE = 1, 2
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def set_feature(dev, payload):
+    payload = payload.ljust(FEATURE_LEN, b"\0")
+    dev.send_feature_report([REPORT_ID_CLOCK_SYNC] + list(payload))
+
+
+def sync(dev, rounds, interval):
+    seq, prev_seq, prev_t4 = 0, 0xFF, 0
+    reply = None
+    for _ in range(rounds):
+        seq = (seq + 1) & 0xFF
+        t1 = now_us()
+        set_feature(dev, struct.pack("<BBQBQ", OP_PING, seq, t1, prev_seq, prev_t4))
+        data = bytes(dev.get_feature_report(REPORT_ID_CLOCK_SYNC, FEATURE_LEN + 1))
+        t4 = now_us()
+        reply = struct.unpack_from("<BBQQqi", data, 1)
+        prev_seq, prev_t4 = seq, t4
+        time.sleep(interval)
+    _, valid, _, _, offset, drift = reply
+    return bool(valid), offset, drift
+
+
+def key_usage(ch):
+    if "a" <= ch <= "z":
+        return 0, 0x04 + ord(ch) - ord("a")
+    if "A" <= ch <= "Z":
+        return 0x02, 0x04 + ord(ch) - ord("A")
+    if ch == " ":
+        return 0, 0x2C
+    raise ValueError("unsupported character %r" % ch)
+
+
+def schedule_key(dev, at_us, ch):
+    modifier, usage = key_usage(ch)
+    press = bytes([modifier, 0, usage, 0, 0, 0, 0, 0])
+    release = bytes(8)
+    for t, report in ((at_us, press), (at_us + 20000, release)):
+        set_feature(dev, struct.pack("<BQB", OP_SCHEDULE, t, REPORT_ID_KEYBOARD) + report)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rounds", type=int, default=20)
+    parser.add_argument("--interval", type=float, default=0.05, help="seconds between pings")
+    parser.add_argument("--type-at", nargs=2, metavar=("UNIX_TIME", "CHAR"),
+                        help="press CHAR when the host clock reaches UNIX_TIME")
+    args = parser.parse_args()
+
+    dev = hid.device()
+    dev.open(VID, PID)
+
+    valid, offset, drift = sync(dev, args.rounds, args.interval)
+    if not valid:
+        print("no round trip accepted", file=sys.stderr)
+        return 1
+    print("offset %d us, drift %.3f ppm" % (offset, drift / 1000.0))
+
+    if args.type_at:
+        schedule_key(dev, int(float(args.type_at[0]) * 1000000), args.type_at[1])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
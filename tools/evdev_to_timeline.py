@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+"""Convert a Linux evdev capture into a HID report timeline (hid_timeline.h).
+
+Capture the raw events of one or more devices, e.g.
+
+    sudo cat /dev/input/event3 > kbd.evdev
+
+then convert them:
+
+    evdev_to_timeline.py kbd.evdev -o session.bin
+    evdev_to_timeline.py kbd.evdev mouse.evdev --c-array -o replay_timeline.c
+
+Multiple captures are merged by timestamp. A report is emitted at every
+SYN_REPORT that changed the keyboard or mouse state.
+
+Pointer recordings consist of many tiny moves, one report each. With
+--simplify PX the path is reduced (Ramer-Douglas-Peucker) to the points
+needed to stay within PX pixels of it; clicks, wheel and key reports break
+the path, so they happen exactly where they were recorded. Points no more
+than --simplify-gap MS apart are kept as well, so a slow drag still moves
+at its recorded pace instead of jumping to its end:
+
+    evdev_to_timeline.py mouse.evdev --simplify 1.5 -o session.bin
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+REPORT_ID_KEYBOARD = 1
+REPORT_ID_MOUSE = 2
+
+TIMELINE_HEADER = b"HTL\x01"
+
+# The player verifies a C array timeline block by block against these
+# SHA-256 digests (hid_timeline_verify())
+DIGEST_BLOCK_SIZE = 4096
+
+EV_SYN, EV_KEY, EV_REL = 0x00, 0x01, 0x02
+SYN_REPORT = 0
+REL_X, REL_Y, REL_HWHEEL, REL_WHEEL = 0x00, 0x01, 0x06, 0x08
+BTN_LEFT, BTN_RIGHT, BTN_MIDDLE, BTN_SIDE, BTN_EXTRA = 0x110, 0x111, 0x112, 0x113, 0x114
+
+# linux/input-event-codes.h KEY_* -> HID keyboard usage
+MODIFIERS = {
+    29: 0x01,   # KEY_LEFTCTRL
+    42: 0x02,   # KEY_LEFTSHIFT
+    56: 0x04,   # KEY_LEFTALT
+    125: 0x08,  # KEY_LEFTMETA
+    97: 0x10,   # KEY_RIGHTCTRL
+    54: 0x20,   # KEY_RIGHTSHIFT
+    100: 0x40,  # KEY_RIGHTALT
+    126: 0x80,  # KEY_RIGHTMETA
+}
+
+KEYS = {
+    1: 0x29, 2: 0x1E, 3: 0x1F, 4: 0x20, 5: 0x21, 6: 0x22, 7: 0x23, 8: 0x24,
+    9: 0x25, 10: 0x26, 11: 0x27, 12: 0x2D, 13: 0x2E, 14: 0x2A, 15: 0x2B,
+    16: 0x14, 17: 0x1A, 18: 0x08, 19: 0x15, 20: 0x17, 21: 0x1C, 22: 0x18,
+    23: 0x0C, 24: 0x12, 25: 0x13, 26: 0x2F, 27: 0x30, 28: 0x28,
+    30: 0x04, 31: 0x16, 32: 0x07, 33: 0x09, 34: 0x0A, 35: 0x0B, 36: 0x0D,
+    37: 0x0E, 38: 0x0F, 39: 0x33, 40: 0x34, 41: 0x35, 43: 0x31,
+    44: 0x1D, 45: 0x1B, 46: 0x06, 47: 0x19, 48: 0x05, 49: 0x11, 50: 0x10,
+    51: 0x36, 52: 0x37, 53: 0x38, 55: 0x55, 57: 0x2C, 58: 0x39,
+    59: 0x3A, 60: 0x3B, 61: 0x3C, 62: 0x3D, 63: 0x3E, 64: 0x3F, 65: 0x40,
+    66: 0x41, 67: 0x42, 68: 0x43, 87: 0x44, 88: 0x45,
+    69: 0x53, 70: 0x47, 71: 0x5F, 72: 0x60, 73: 0x61, 74: 0x56, 75: 0x5C,
+    76: 0x5D, 77: 0x5E, 78: 0x57, 79: 0x59, 80: 0x5A, 81: 0x5B, 82: 0x62,
+    83: 0x63, 86: 0x64, 96: 0x58, 98: 0x54, 99: 0x46, 102: 0x4A, 103: 0x52,
+    104: 0x4B, 105: 0x50, 106: 0x4F, 107: 0x4D, 108: 0x51, 109: 0x4E,
+    110: 0x49, 111: 0x4C, 119: 0x48, 127: 0x65,
+}
+
+MOUSE_BUTTONS = {BTN_LEFT: 0x01, BTN_RIGHT: 0x02, BTN_MIDDLE: 0x04,
+                 BTN_SIDE: 0x08, BTN_EXTRA: 0x10}
+
+
+def read_events(path, event_size):
+    """Yield (time_us, type, code, value) from a raw struct input_event dump."""
+    if event_size == 24:
+        fmt = "<qqHHi"
+    else:
+        fmt = "<iiHHi"
+    with open(path, "rb") as f:
+        data = f.read()
+    for off in range(0, len(data) - event_size + 1, event_size):
+        sec, usec, etype, code, value = struct.unpack_from(fmt, data, off)
+        yield sec * 1000000 + usec, etype, code, value
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def clamp8(v):
+    return max(-127, min(127, v))
+
+
+class Converter:
+    def __init__(self):
+        self.modifier = 0
+        self.keys = []
+        self.buttons = 0
+        self.rel = [0, 0, 0, 0]  # x, y, wheel, pan
+        self.kbd_dirty = False
+        self.mouse_dirty = False
+        self.records = []  # (time_us, report_id, payload)
+
+    def event(self, t, etype, code, value):
+        if etype == EV_KEY:
+            if value == 2:  # autorepeat, the host generates its own
+                return
+            if code in MODIFIERS:
+                bit = MODIFIERS[code]
+                self.modifier = (self.modifier | bit) if value else (self.modifier & ~bit)
+                self.kbd_dirty = True
+            elif code in KEYS:
+                usage = KEYS[code]
+                if value and usage not in self.keys:
+                    self.keys.append(usage)
+                elif not value and usage in self.keys:
+                    self.keys.remove(usage)
+                self.kbd_dirty = True
+            elif code in MOUSE_BUTTONS:
+                bit = MOUSE_BUTTONS[code]
+                self.buttons = (self.buttons | bit) if value else (self.buttons & ~bit)
+                self.mouse_dirty = True
+        elif etype == EV_REL:
+            idx = {REL_X: 0, REL_Y: 1, REL_WHEEL: 2, REL_HWHEEL: 3}.get(code)
+            if idx is not None:
+                self.rel[idx] += value
+                self.mouse_dirty = True
+        elif etype == EV_SYN and code == SYN_REPORT:
+            self.flush(t)
+
+    def flush(self, t):
+        if self.kbd_dirty:
+            keys = (self.keys[:6] + [0] * 6)[:6]
+            payload = bytes([self.modifier, 0] + keys)
+            self.records.append((t, REPORT_ID_KEYBOARD, payload))
+            self.kbd_dirty = False
+
+        # Motion larger than one report can carry is split over several
+        while self.mouse_dirty:
+            step = [clamp8(v) for v in self.rel]
+            self.rel = [v - s for v, s in zip(self.rel, step)]
+            payload = struct.pack("<Bbbbb", self.buttons, *step)
+            self.records.append((t, REPORT_ID_MOUSE, payload))
+            self.mouse_dirty = any(self.rel)
+
+    def timeline(self):
+        out = bytearray(TIMELINE_HEADER)
+        if not self.records:
+            return bytes(out)
+        prev = self.records[0][0]
+        for t, report_id, payload in self.records:
+            delta = max(0, t - prev)
+            if delta > 0xFFFFFFFF:
+                raise ValueError("gap between events does not fit in 32 bits")
+            out += varint(delta) + bytes([report_id]) + payload
+            prev = t
+        return bytes(out)
+
+
+def split_motion(dx, dy):
+    """Yield steps of at most 127 that stay within half a count of the line."""
+    n = max(1, -(-max(abs(dx), abs(dy)) // 127))
+    px = py = 0
+    for i in range(1, n + 1):
+        nx = (2 * dx * i + n) // (2 * n)
+        ny = (2 * dy * i + n) // (2 * n)
+        yield nx - px, ny - py
+        px, py = nx, ny
+
+
+def dist_sq(p, a, b):
+    """Squared distance of point p to segment ab as a fraction (num, den)."""
+    dx, dy = b[0] - a[0], b[1] - a[1]
+    vx, vy = p[0] - a[0], p[1] - a[1]
+    dot = vx * dx + vy * dy
+    length_sq = dx * dx + dy * dy
+    if length_sq == 0 or dot <= 0:
+        return vx * vx + vy * vy, 1
+    if dot >= length_sq:
+        wx, wy = p[0] - b[0], p[1] - b[1]
+        return wx * wx + wy * wy, 1
+    cross = vx * dy - vy * dx
+    return cross * cross, length_sq
+
+
+class PathSimplifier:
+    """Streaming Ramer-Douglas-Peucker over absolute pointer positions.
+
+    Points are buffered until `window` of them are pending or the path is
+    broken, then reduced so that every dropped point lies within the
+    tolerance of the segment between the kept points around it, and kept
+    points are at most `max_gap_us` apart unless no point lies between
+    them. Positions are integer counts and the tolerance has 4 fractional
+    bits, so every decision is exact integer arithmetic.
+    """
+
+    def __init__(self, tolerance, window=64, max_gap_us=50000):
+        self.tol_sq_q8 = int(round(tolerance * 16)) ** 2
+        self.window = max(2, window)
+        self.max_gap_us = max_gap_us
+        self.points = []  # (time_us, x, y), the first one is emitted
+        self.max_dev_sq = 0.0
+
+    def restart(self, t, x, y):
+        """Continue the path from (x, y), which the caller already emitted."""
+        self.points = [(t, x, y)]
+
+    def feed(self, t, x, y):
+        """Add a point, return the points to emit now."""
+        if not self.points:
+            # The path leaves the origin with its first move, not at time 0
+            self.points.append((t, 0, 0))
+        self.points.append((t, x, y))
+        if len(self.points) <= self.window:
+            return []
+        return self.flush()
+
+    def flush(self):
+        """Reduce the pending points, return those kept (last one included)."""
+        pts = self.points
+        if len(pts) < 2:
+            return []
+        keep = [False] * len(pts)
+        keep[0] = keep[-1] = True
+        stack = [(0, len(pts) - 1)]
+        while stack:
+            i, j = stack.pop()
+            a, b = pts[i][1:], pts[j][1:]
+            worst, worst_k = (0, 1), None
+            for k in range(i + 1, j):
+                num, den = dist_sq(pts[k][1:], a, b)
+                if num * worst[1] > worst[0] * den:
+                    worst, worst_k = (num, den), k
+            if worst_k is not None and worst[0] * 256 > self.tol_sq_q8 * worst[1]:
+                keep[worst_k] = True
+                stack += [(i, worst_k), (worst_k, j)]
+            elif j - i > 1 and pts[j][0] - pts[i][0] > self.max_gap_us:
+                # Close enough in space but not in time: split halfway
+                mid = (pts[i][0] + pts[j][0]) // 2
+                k = min(range(i + 1, j), key=lambda k: abs(pts[k][0] - mid))
+                keep[k] = True
+                stack += [(i, k), (k, j)]
+
+        # Deviation of every dropped point from the segment replacing it
+        prev = 0
+        for k in range(1, len(pts)):
+            if keep[k]:
+                for m in range(prev + 1, k):
+                    num, den = dist_sq(pts[m][1:], pts[prev][1:], pts[k][1:])
+                    self.max_dev_sq = max(self.max_dev_sq, num / den)
+                prev = k
+
+        kept = [p for p, k in zip(pts[1:], keep[1:]) if k]
+        self.points = [pts[-1]]
+        return kept
+
+
+def simplify_motion(records, simplifier):
+    """Replace runs of plain mouse moves by the simplified path.
+
+    A mouse report that changes buttons, wheel or pan, and any other report,
+    ends the run: the path up to it is emitted first, so order and the
+    position of every click are kept.
+    """
+    out = []
+    x = y = 0          # recorded position
+    ex = ey = 0        # position the emitted reports reach
+    buttons = 0
+
+    def emit(points):
+        nonlocal ex, ey
+        for t, px, py in points:
+            for dx, dy in split_motion(px - ex, py - ey):
+                out.append((t, REPORT_ID_MOUSE,
+                            struct.pack("<Bbbbb", buttons, dx, dy, 0, 0)))
+            ex, ey = px, py
+
+    for t, report_id, payload in records:
+        if report_id == REPORT_ID_MOUSE:
+            b, dx, dy, wheel, pan = struct.unpack("<Bbbbb", payload)
+            x += dx
+            y += dy
+            if b == buttons and not wheel and not pan:
+                emit(simplifier.feed(t, x, y))
+                continue
+            # The path ends where the report starts
+            emit(simplifier.flush())
+            buttons = b
+            ex, ey = x, y
+            simplifier.restart(t, x, y)
+        else:
+            emit(simplifier.flush())
+        out.append((t, report_id, payload))
+    emit(simplifier.flush())
+    return out
+
+
+def c_array(data, name, tool="evdev_to_timeline.py"):
+    lines = ["// Generated by tools/%s, do not edit" % tool,
+             "",
+             "#include <stddef.h>",
+             "#include <stdint.h>",
+             "",
+             "const uint8_t %s[] = {" % name]
+    for i in range(0, len(data), 12):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 12]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("const size_t %s_len = sizeof(%s);" % (name, name))
+    lines.append("")
+    lines.append("// SHA-256 of every %d byte block" % DIGEST_BLOCK_SIZE)
+    lines.append("const size_t %s_block_size = %d;" % (name, DIGEST_BLOCK_SIZE))
+    lines.append("const uint8_t %s_digests[][32] = {" % name)
+    for off in range(0, len(data), DIGEST_BLOCK_SIZE):
+        digest = hashlib.sha256(data[off:off + DIGEST_BLOCK_SIZE]).digest()
+        lines.append("  {" + ", ".join("0x%02x" % b for b in digest[:16]) + ",")
+        lines.append("   " + ", ".join("0x%02x" % b for b in digest[16:]) + "},")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("captures", nargs="+", help="raw evdev dumps")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--c-array", action="store_true",
+                        help="emit a C source file instead of a binary")
+    parser.add_argument("--name", default="replay_timeline",
+                        help="C symbol name (with --c-array)")
+    parser.add_argument("--event-size", type=int, choices=(16, 24), default=24,
+                        help="sizeof(struct input_event) of the capturing host")
+    parser.add_argument("--simplify", type=float, metavar="PX", default=0,
+                        help="simplify the pointer path to within PX pixels")
+    parser.add_argument("--simplify-window", type=int, metavar="N", default=64,
+                        help="points reduced at a time, bounds memory and delay")
+    parser.add_argument("--simplify-gap", type=float, metavar="MS", default=50,
+                        help="keep points so that moves are at most MS apart")
+    args = parser.parse_args()
+
+    events = []
+    for path in args.captures:
+        events.extend(read_events(path, args.event_size))
+    events.sort(key=lambda e: e[0])
+
+    conv = Converter()
+    for ev in events:
+        conv.event(*ev)
+
+    if args.simplify > 0:
+        before = sum(1 for r in conv.records if r[1] == REPORT_ID_MOUSE)
+        simplifier = PathSimplifier(args.simplify, args.simplify_window,
+                                    int(args.simplify_gap * 1000))
+        conv.records = simplify_motion(conv.records, simplifier)
+        after = sum(1 for r in conv.records if r[1] == REPORT_ID_MOUSE)
+        print("mouse: %d -> %d reports, max deviation %.2f px"
+              % (before, after, simplifier.max_dev_sq ** 0.5), file=sys.stderr)
+
+    data = conv.timeline()
+
+    if args.c_array:
+        with open(args.output, "w") as f:
+            f.write(c_array(data, args.name))
+    else:
+        with open(args.output, "wb") as f:
+            f.write(data)
+
+    print("%d reports, %d bytes" % (len(conv.records), len(data)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Report flash/RAM usage per source file and per module from a GNU ld map.
+
+    footprint.py pico_hid_device.elf.map --budgets tools/footprint_budgets.ini \
+                 --platform rp2350
+
+Sizes are taken from the input sections of the map file:
+
+    text    .text*                       (flash)
+    rodata  .rodata* .flashdata* .binary_info*      (flash)
+    data    .data* .time_critical* .sdata*          (flash load image + RAM)
+    bss     .bss* .sbss* COMMON .uninitialized_data* (RAM)
+
+Functions placed in SRAM (__not_in_flash_func, CFG_APP_RAM_HOT_PATH) are
+listed with their RAM cost from their .time_critical.<name> sections.
+
+Exits with status 1 if a budget is exceeded.
+"""
+
+import argparse
+import configparser
+import fnmatch
+import os
+import re
+import sys
+from collections import defaultdict
+
+KINDS = ("text", "rodata", "data", "bss")
+
+KIND_PREFIXES = (
+    (".text", "text"),
+    (".rodata", "rodata"),
+    (".flashdata", "rodata"),
+    (".binary_info", "rodata"),
+    (".time_critical", "data"),
+    (".data", "data"),
+    (".sdata", "data"),
+    (".bss", "bss"),
+    (".sbss", "bss"),
+    (".uninitialized_data", "bss"),
+    ("COMMON", "bss"),
+)
+
+# " .text.hid_task  0x10000200  0x9c  path/main.c.obj" (may wrap after the name)
+SECTION_RE = re.compile(r"^ (\S+)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+))?$")
+WRAPPED_RE = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+)$")
+
+
+def section_kind(name):
+    for prefix, kind in KIND_PREFIXES:
+        if name.startswith(prefix):
+            return kind
+    return None
+
+
+def parse_map(path):
+    """Return {object path: {kind: bytes}} and {(object, section): bytes}."""
+    per_object = defaultdict(lambda: dict.fromkeys(KINDS, 0))
+    per_section = {}
+
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    # Only the memory map part lists the final placement
+    try:
+        start = lines.index("Linker script and memory map")
+    except ValueError:
+        start = 0
+
+    pending = None
+    for line in lines[start:]:
+        if pending is not None:
+            m = WRAPPED_RE.match(line)
+            if m:
+                add(per_object, per_section, pending, int(m.group(2), 16), m.group(3))
+            pending = None
+            continue
+
+        m = SECTION_RE.match(line)
+        if not m:
+            continue
+        name = m.group(1)
+        if section_kind(name) is None:
+            continue
+        if m.group(2) is None:
+            pending = name
+            continue
+        add(per_object, per_section, name, int(m.group(3), 16), m.group(4))
+
+    return per_object, per_section
+
+
+def add(per_object, per_section, name, size, obj):
+    # Addresses of discarded (--gc-sections) input are reported as 0
+    if size == 0:
+        return
+    obj = obj.strip()
+    per_object[obj][section_kind(name)] += size
+    per_section[(obj, name)] = per_section.get((obj, name), 0) + size
+
+
+def flash(sizes):
+    return sizes["text"] + sizes["rodata"] + sizes["data"]
+
+
+def ram(sizes):
+    return sizes["data"] + sizes["bss"]
+
+
+def short_name(obj):
+    # libfoo.a(bar.c.obj) -> bar.c, path/CMakeFiles/x.dir/main.c.obj -> main.c
+    m = re.search(r"\(([^)]+)\)$", obj)
+    base = m.group(1) if m else os.path.basename(obj)
+    for suffix in (".obj", ".o"):
+        if base.endswith(suffix):
+            base = base[: -len(suffix)]
+    return base
+
+
+def load_config(path, platform):
+    cfg = configparser.ConfigParser()
+    cfg.optionxform = str
+    cfg.read(path)
+
+    groups = []
+    if cfg.has_section("groups"):
+        for name, patterns in cfg.items("groups"):
+            groups.append((name, patterns.split()))
+
+    budgets = {}
+    for section in ("budget", "budget." + platform if platform else None):
+        if section and cfg.has_section(section):
+            for key, value in cfg.items(section):
+                budgets[key] = int(value, 0)
+    return groups, budgets
+
+
+def group_of(obj, groups):
+    for name, patterns in groups:
+        if any(fnmatch.fnmatch(obj, p) for p in patterns):
+            return name
+    return "other"
+
+
+def print_table(title, rows):
+    print(title)
+    print("  %-32s %8s %8s %8s %8s %8s %8s" % ("", "text", "rodata", "data", "bss", "flash", "ram"))
+    for name, sizes in rows:
+        print("  %-32s %8d %8d %8d %8d %8d %8d" % (
+            name[:32], sizes["text"], sizes["rodata"], sizes["data"], sizes["bss"],
+            flash(sizes), ram(sizes)))
+    print()
+
+
+def print_ram_functions(per_section):
+    prefix = ".time_critical."
+    funcs = sorted(((size, name[len(prefix):], short_name(obj))
+                    for (obj, name), size in per_section.items() if name.startswith(prefix)),
+                   reverse=True)
+    if not funcs:
+        return
+    print("RAM-resident functions")
+    for size, name, obj in funcs:
+        print("  %-32s %-20s %8d" % (name[:32], obj[:20], size))
+    print("  %-32s %-20s %8d" % ("total", "", sum(f[0] for f in funcs)))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", help="linker map file (<target>.elf.map)")
+    parser.add_argument("--budgets", help="group and budget definitions (ini)")
+    parser.add_argument("--platform", default="", help="selects [budget.<platform>] overrides")
+    parser.add_argument("--files", action="store_true", help="also list every source file")
+    args = parser.parse_args()
+
+    per_object, per_section = parse_map(args.map)
+    groups, budgets = load_config(args.budgets, args.platform) if args.budgets else ([], {})
+
+    per_group = defaultdict(lambda: dict.fromkeys(KINDS, 0))
+    total = dict.fromkeys(KINDS, 0)
+    for obj, sizes in per_object.items():
+        g = group_of(obj, groups)
+        for k in KINDS:
+            per_group[g][k] += sizes[k]
+            total[k] += sizes[k]
+
+    if args.files:
+        rows = sorted(per_object.items(), key=lambda kv: -flash(kv[1]) - ram(kv[1]))
+        print_table("Per source file", [(short_name(o), s) for o, s in rows])
+
+    order = [name for name, _ in groups] + ["other"]
+    print_table("Per module", [(g, per_group[g]) for g in order if g in per_group] + [("total", total)])
+
+    print_ram_functions(per_section)
+
+    failed = False
+    for key, limit in sorted(budgets.items()):
+        group, _, kind = key.rpartition(".")
+        sizes = total if group == "total" else per_group.get(group, dict.fromkeys(KINDS, 0))
+        used = flash(sizes) if kind == "flash" else ram(sizes) if kind == "ram" else sizes.get(kind, 0)
+        if used > limit:
+            print("footprint: %s is %d bytes, budget %d (+%d)" % (key, used, limit, used - limit),
+                  file=sys.stderr)
+            failed = True
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
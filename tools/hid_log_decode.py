@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Decode the binary log written by HID_LOG() (see hid_log.h).
+
+    hid_log_decode.py pico_hid_device.elf --extract -o pico_hid_device.hidlog.json
+    hid_log_decode.py pico_hid_device.hidlog.json log.bin
+    hid_log_decode.py pico_hid_device.elf --live          # needs `hidapi`
+
+The format strings are read from the `hid_log_fmt` section of the ELF, or
+from a dictionary previously extracted from it. A log dump is the raw
+little endian word stream as read from the REPORT_ID_TELEMETRY feature
+report; --live polls the device for it.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+import time
+
+SECTION = "hid_log_fmt"
+VID, PID = 0xCAFE, 0x4004
+REPORT_ID_TELEMETRY = 6
+FEATURE_LEN = 31
+
+
+def elf_section(path, name):
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("%s is not an ELF file" % path)
+    is64 = elf[4] == 2
+    endian = "<" if elf[5] == 1 else ">"
+    if is64:
+        shoff, = struct.unpack_from(endian + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x3A)
+        fmt = endian + "IIQQQQ"
+    else:
+        shoff, = struct.unpack_from(endian + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x2E)
+        fmt = endian + "IIIIII"
+
+    headers = []
+    for i in range(shnum):
+        sh_name, _, _, _, offset, size = struct.unpack_from(fmt, elf, shoff + i * shentsize)
+        headers.append((sh_name, offset, size))
+
+    _, str_off, str_size = headers[shstrndx]
+    strtab = elf[str_off:str_off + str_size]
+    for sh_name, offset, size in headers:
+        end = strtab.index(b"\0", sh_name)
+        if strtab[sh_name:end].decode() == name:
+            return elf[offset:offset + size]
+    raise ValueError("%s has no %s section" % (path, name))
+
+
+def dictionary_from_elf(path):
+    """Map section offset -> format string. Padding between strings is NUL."""
+    data = elf_section(path, SECTION)
+    formats = {}
+    start = None
+    for i, b in enumerate(data):
+        if b and start is None:
+            start = i
+        elif not b and start is not None:
+            formats[start] = data[start:i].decode("utf-8", "replace")
+            start = None
+    return formats
+
+
+def load_dictionary(path):
+    if path.endswith(".json"):
+        with open(path) as f:
+            return {int(k): v for k, v in json.load(f).items()}
+    return dictionary_from_elf(path)
+
+
+CONVERSION_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z)?([diuxXc%])")
+
+
+def format_record(fmt, args):
+    it = iter(args)
+
+    def conv(m):
+        flags, kind = m.group(1), m.group(2)
+        if kind == "%":
+            return "%"
+        value = next(it, 0)
+        if kind in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            kind = "d"
+        elif kind == "u":
+            kind = "d"
+        return ("%" + flags + kind) % value
+
+    return CONVERSION_RE.sub(conv, fmt)
+
+
+class Decoder:
+    def __init__(self, formats):
+        self.formats = formats
+        self.words = []
+
+    def feed(self, words):
+        """Consume words, yield (timestamp_us, text) for complete records."""
+        self.words.extend(words)
+        while len(self.words) >= 2:
+            header = self.words[0]
+            nargs = header & 0xFF
+            if len(self.words) < 2 + nargs:
+                break
+            timestamp = self.words[1]
+            args = self.words[2:2 + nargs]
+            del self.words[:2 + nargs]
+            fmt = self.formats.get(header >> 8)
+            if fmt is None:
+                text = "<unknown format 0x%06x> %s" % (header >> 8, args)
+            else:
+                text = format_record(fmt, args)
+            yield timestamp, text
+
+
+def words_from_file(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    return list(struct.unpack("<%dI" % (len(data) // 4), data[: len(data) // 4 * 4]))
+
+
+def live_words(poll_interval):
+    import hid
+
+    dev = hid.device()
+    dev.open(VID, PID)
+    while True:
+        data = bytes(dev.get_feature_report(REPORT_ID_TELEMETRY, FEATURE_LEN + 1))
+        count = data[1] if len(data) > 1 else 0
+        if count:
+            yield list(struct.unpack_from("<%dI" % count, data, 2))
+        else:
+            time.sleep(poll_interval)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("formats", help="firmware ELF or extracted .json dictionary")
+    parser.add_argument("dump", nargs="?", help="binary log dump")
+    parser.add_argument("--extract", action="store_true", help="write the format dictionary")
+    parser.add_argument("-o", "--output", help="output file for --extract")
+    parser.add_argument("--live", action="store_true", help="read from the device")
+    parser.add_argument("--poll", type=float, default=0.05, help="seconds between empty polls")
+    args = parser.parse_args()
+
+    formats = load_dictionary(args.formats)
+
+    if args.extract:
+        out = open(args.output, "w") if args.output else sys.stdout
+        json.dump({str(k): v for k, v in sorted(formats.items())}, out, indent=1)
+        out.write("\n")
+        return 0
+
+    decoder = Decoder(formats)
+    if args.live:
+        chunks = live_words(args.poll)
+    elif args.dump:
+        chunks = [words_from_file(args.dump)]
+    else:
+        parser.error("need a dump file or --live")
+
+    for chunk in chunks:
+        for timestamp, text in decoder.feed(chunk):
+            print("%10.6f %s" % (timestamp / 1e6, text), flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Render text into a HID report timeline (hid_timeline.h) at build time.
+
+    text_to_timeline.py payload.txt --keymap <tinyusb>/src/class/hid/hid.h \
+        --c-array -o payload_timeline.c
+
+The firmware then plays the reports straight from flash with the replay
+player; no character is looked up on the device. Every character is one
+keyboard report. A release report is only inserted where the next character
+uses the same key (the host would not see it go down again), and once at
+the end. Reports are spaced --interval-us apart, 0 leaves the pace to the
+transmit scheduler.
+
+Characters are mapped for a US layout host with HID_ASCII_TO_KEYCODE from
+TinyUSB's hid.h (--keymap), the table the firmware types with, so the
+pre-rendered text cannot drift from it. A character the table has no key
+for is an error.
+"""
+
+import argparse
+import re
+import sys
+
+from evdev_to_timeline import REPORT_ID_KEYBOARD, TIMELINE_HEADER, c_array, varint
+
+SHIFT = 0x02  # KEYBOARD_MODIFIER_LEFTSHIFT, as hid_keymap_ascii() sets it
+
+
+def keymap(header):
+    """Character -> (modifier, key) from HID_ASCII_TO_KEYCODE in hid.h."""
+    # Comments out first, the table has one per entry
+    source = re.sub(r"/\*.*?\*/", "", header, flags=re.S)
+    usages = {m.group(1): int(m.group(2), 0) for m in re.finditer(
+        r"^\s*#\s*define\s+(HID_KEY_\w+)\s+(0x[0-9A-Fa-f]+|\d+)\b", source, re.M)}
+
+    m = re.search(r"^\s*#\s*define\s+HID_ASCII_TO_KEYCODE\b((?:.*\\\n)*.*)", source, re.M)
+    if not m:
+        raise ValueError("no HID_ASCII_TO_KEYCODE")
+    entries = re.findall(r"\{\s*(\w+)\s*,\s*(\w+)\s*\}", m.group(1))
+    if len(entries) != 128:
+        raise ValueError("HID_ASCII_TO_KEYCODE has %d entries, not 128" % len(entries))
+
+    table = {}
+    for code, (shift, key) in enumerate(entries):
+        if key not in usages:
+            try:
+                usages[key] = int(key, 0)
+            except ValueError:
+                raise ValueError("HID_ASCII_TO_KEYCODE uses undefined %s" % key)
+        if usages[key]:
+            table[chr(code)] = (SHIFT if int(shift, 0) else 0, usages[key])
+    return table
+
+
+def render(text, table, interval_us):
+    reports = []
+    prev_key = None
+    for i, ch in enumerate(text):
+        if ch == "\r":
+            continue
+        if ch not in table:
+            raise ValueError("character %r at offset %d has no key" % (ch, i))
+        modifier, key = table[ch]
+        if key == prev_key:
+            reports.append(bytes(8))
+        reports.append(bytes([modifier, 0, key, 0, 0, 0, 0, 0]))
+        prev_key = key
+    if reports:
+        reports.append(bytes(8))
+
+    out = bytearray(TIMELINE_HEADER)
+    for n, payload in enumerate(reports):
+        out += varint(interval_us if n else 0) + bytes([REPORT_ID_KEYBOARD]) + payload
+    return bytes(out), len(reports)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("text", help="text file to type")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--keymap", required=True, metavar="HID_H",
+                        help="TinyUSB's src/class/hid/hid.h")
+    parser.add_argument("--c-array", action="store_true",
+                        help="emit a C source file instead of a binary")
+    parser.add_argument("--name", default="replay_timeline",
+                        help="C symbol name (with --c-array)")
+    parser.add_argument("--interval-us", type=int, default=0,
+                        help="time between reports")
+    args = parser.parse_args()
+
+    with open(args.keymap, encoding="utf-8") as f:
+        header = f.read()
+    try:
+        table = keymap(header)
+    except ValueError as e:
+        print("%s: %s" % (args.keymap, e), file=sys.stderr)
+        return 1
+
+    with open(args.text, encoding="utf-8") as f:
+        text = f.read()
+
+    try:
+        data, count = render(text, table, args.interval_us)
+    except ValueError as e:
+        print("%s: %s" % (args.text, e), file=sys.stderr)
+        return 1
+
+    if args.c_array:
+        with open(args.output, "w") as f:
+            f.write(c_array(data, args.name, "text_to_timeline.py"))
+    else:
+        with open(args.output, "wb") as f:
+            f.write(data)
+
+    print("%d reports, %d bytes" % (count, len(data)), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
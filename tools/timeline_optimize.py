@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+"""Rewrite a HID report timeline (hid_timeline.h) with as few reports as
+possible without changing what the host sees.
+
+    evdev_to_timeline.py kbd.evdev mouse.evdev -o session.bin
+    timeline_optimize.py session.bin -o session.opt.bin
+    timeline_optimize.py session.bin -o replay_timeline.c --c-array --check
+
+The input reports are decoded into the events a host derives from them (key
+and modifier up/down, button up/down, relative motion). The events are then
+packed into reports again:
+
+  * key presses share a report while the modifiers stay the same and there
+    is a free slot of the six; keys that go down in one report are seen in
+    array order
+  * releases share the report of the presses that follow them, unless the
+    same key goes down again (the press would not be seen)
+  * modifier changes fold into the report of the keys they affect; the host
+    applies them first and in bit order, so only changes in that order fold
+  * consecutive mouse moves are summed, motion after a button change joins
+    its report (buttons are applied first), motion before one does not
+  * reports that change nothing are dropped
+
+Only events less than --window-us apart are packed together, and a packed
+report goes out at the time of its first event. Consumer and gamepad reports
+are passed through unchanged and are never reordered against the rest.
+
+--check decodes both timelines with the reference host model and fails if
+the event sequences differ (consecutive motion compared as its sum).
+"""
+
+import argparse
+import struct
+import sys
+
+from evdev_to_timeline import (REPORT_ID_KEYBOARD, REPORT_ID_MOUSE,
+                               TIMELINE_HEADER, c_array, clamp8, varint)
+
+REPORT_LEN = {1: 8, 2: 5, 3: 2, 4: 11}
+
+
+#--------------------------------------------------------------------+
+# Timeline I/O
+#--------------------------------------------------------------------+
+
+def read_timeline(data):
+    """Return [(time_us, report_id, payload)]."""
+    if data[:4] != TIMELINE_HEADER:
+        raise ValueError("not a version 1 timeline")
+    records = []
+    pos, t = 4, 0
+    while pos < len(data):
+        delta, shift = 0, 0
+        while True:
+            b = data[pos]
+            pos += 1
+            delta |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        t += delta
+        report_id = data[pos]
+        n = REPORT_LEN.get(report_id)
+        if n is None or pos + 1 + n > len(data):
+            raise ValueError("bad record at offset %d" % pos)
+        records.append((t, report_id, bytes(data[pos + 1:pos + 1 + n])))
+        pos += 1 + n
+    return records
+
+
+def write_timeline(records):
+    out = bytearray(TIMELINE_HEADER)
+    prev = records[0][0] if records else 0
+    for t, report_id, payload in records:
+        out += varint(t - prev) + bytes([report_id]) + payload
+        prev = t
+    return bytes(out)
+
+
+#--------------------------------------------------------------------+
+# Reference host model
+#--------------------------------------------------------------------+
+
+def host_events(records):
+    """Events a host derives from the reports, in the order it emits them:
+    modifiers, then released keys, then pressed keys in array order for a
+    keyboard report; buttons, then motion for a mouse report."""
+    events = []
+    mod, keys, buttons = 0, [], 0
+    for t, report_id, payload in records:
+        if report_id == REPORT_ID_KEYBOARD:
+            new_mod = payload[0]
+            new_keys = [k for k in payload[2:8] if k]
+            for bit in range(8):
+                m = 1 << bit
+                if (mod ^ new_mod) & m:
+                    events.append((t, "mod", m, 1 if new_mod & m else 0))
+            for k in keys:
+                if k not in new_keys:
+                    events.append((t, "key", k, 0))
+            for k in new_keys:
+                if k not in keys:
+                    events.append((t, "key", k, 1))
+            mod, keys = new_mod, new_keys
+        elif report_id == REPORT_ID_MOUSE:
+            new_buttons, x, y, wheel, pan = struct.unpack("<Bbbbb", payload)
+            for bit in range(8):
+                m = 1 << bit
+                if (buttons ^ new_buttons) & m:
+                    events.append((t, "btn", m, 1 if new_buttons & m else 0))
+            if x or y or wheel or pan:
+                events.append((t, "rel", (x, y, wheel, pan), None))
+            buttons = new_buttons
+        else:
+            events.append((t, "raw", report_id, payload))
+    return events
+
+
+def normalized(events):
+    """Drop timing and sum consecutive motion."""
+    out = []
+    for _, kind, code, value in events:
+        if kind == "rel" and out and out[-1][0] == "rel":
+            out[-1] = ("rel", tuple(a + b for a, b in zip(out[-1][1], code)), None)
+        else:
+            out.append((kind, code, value))
+    return out
+
+
+#--------------------------------------------------------------------+
+# Optimizer
+#--------------------------------------------------------------------+
+
+class Optimizer:
+    def __init__(self, window_us):
+        self.window = window_us
+        self.records = []
+        # State the host has
+        self.mod, self.keys, self.buttons = 0, [], 0
+        self.pending = None
+
+    # Keyboard report under construction
+    def _kbd(self, t):
+        p = self.pending
+        if p and (p["kind"] != "kbd" or t - p["t"] > self.window):
+            self.flush()
+        if not self.pending:
+            self.pending = {"kind": "kbd", "t": t, "mod": self.mod,
+                            "keys": list(self.keys), "pressed": [],
+                            "released": set(), "mod_changed": 0}
+        return self.pending
+
+    # Mouse report under construction
+    def _mouse(self, t):
+        p = self.pending
+        if p and (p["kind"] != "mouse" or t - p["t"] > self.window):
+            self.flush()
+        if not self.pending:
+            self.pending = {"kind": "mouse", "t": t, "buttons": self.buttons,
+                            "rel": [0, 0, 0, 0], "btn_changed": 0}
+        return self.pending
+
+    def event(self, t, kind, code, value):
+        if kind == "key":
+            p = self._kbd(t)
+            if value:
+                # A key released in this report cannot go down again in it
+                if code in p["keys"] or code in p["released"] or len(p["keys"]) == 6:
+                    self.flush()
+                    p = self._kbd(t)
+                if len(p["keys"]) < 6:
+                    p["keys"].append(code)
+                    p["pressed"].append(code)
+            elif code in self.keys or code in p["pressed"]:
+                # The host reports releases before presses, in the order the
+                # keys sit in the previous report
+                if p["pressed"] or any(self.keys.index(k) > self.keys.index(code)
+                                       for k in p["released"]):
+                    self.flush()
+                    p = self._kbd(t)
+                p["keys"].remove(code)
+                p["released"].add(code)
+        elif kind == "mod":
+            p = self._kbd(t)
+            # Modifiers are applied first and in bit order, and a tap must
+            # not cancel out
+            if p["pressed"] or p["released"] or p["mod_changed"] >= code:
+                self.flush()
+                p = self._kbd(t)
+            p["mod"] = (p["mod"] | code) if value else (p["mod"] & ~code)
+            p["mod_changed"] |= code
+        elif kind == "btn":
+            p = self._mouse(t)
+            if any(p["rel"]) or p["btn_changed"] >= code:
+                self.flush()
+                p = self._mouse(t)
+            p["buttons"] = (p["buttons"] | code) if value else (p["buttons"] & ~code)
+            p["btn_changed"] |= code
+        elif kind == "rel":
+            p = self._mouse(t)
+            p["rel"] = [a + b for a, b in zip(p["rel"], code)]
+        else:
+            self.flush()
+            self.records.append((t, code, value))
+
+    def flush(self):
+        p, self.pending = self.pending, None
+        if not p:
+            return
+        if p["kind"] == "kbd":
+            # Keys kept from before first, then the new ones in press order
+            kept = [k for k in p["keys"] if k not in p["pressed"]]
+            keys = kept + p["pressed"]
+            if p["mod"] == self.mod and sorted(keys) == sorted(self.keys):
+                return
+            payload = bytes([p["mod"], 0] + (keys + [0] * 6)[:6])
+            self.records.append((p["t"], REPORT_ID_KEYBOARD, payload))
+            self.mod, self.keys = p["mod"], keys
+        else:
+            rel = p["rel"]
+            if p["buttons"] == self.buttons and not any(rel):
+                return
+            # Motion beyond one report is split, buttons ride on the first
+            while True:
+                step = [clamp8(v) for v in rel]
+                rel = [v - s for v, s in zip(rel, step)]
+                payload = struct.pack("<Bbbbb", p["buttons"], *step)
+                self.records.append((p["t"], REPORT_ID_MOUSE, payload))
+                if not any(rel):
+                    break
+            self.buttons = p["buttons"]
+
+
+def optimize(records, window_us):
+    opt = Optimizer(window_us)
+    for ev in host_events(records):
+        opt.event(*ev)
+    opt.flush()
+    return opt.records
+
+
+#--------------------------------------------------------------------+
+# Main
+#--------------------------------------------------------------------+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("timeline", help="input timeline (binary)")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--c-array", action="store_true",
+                        help="emit a C source file instead of a binary")
+    parser.add_argument("--name", default="replay_timeline",
+                        help="C symbol name (with --c-array)")
+    parser.add_argument("--window-us", type=int, default=5000,
+                        help="pack only events closer than this (default: one poll interval)")
+    parser.add_argument("--check", action="store_true",
+                        help="verify the host sees the same events")
+    args = parser.parse_args()
+
+    with open(args.timeline, "rb") as f:
+        records = read_timeline(f.read())
+    optimized = optimize(records, args.window_us)
+
+    if args.check and normalized(host_events(records)) != normalized(host_events(optimized)):
+        print("%s: host visible events differ" % args.timeline, file=sys.stderr)
+        return 1
+
+    data = write_timeline(optimized)
+    if args.c_array:
+        with open(args.output, "w") as f:
+            f.write(c_array(data, args.name, "timeline_optimize.py"))
+    else:
+        with open(args.output, "wb") as f:
+            f.write(data)
+
+    saved = 100.0 * (len(records) - len(optimized)) / len(records) if records else 0.0
+    print("%d -> %d reports (-%.1f%%), %d bytes" % (len(records), len(optimized), saved, len(data)),
+          file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
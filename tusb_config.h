@@ -30,6 +30,8 @@
  extern "C" {
 #endif
 
+#include "app_config.h"
+
 //--------------------------------------------------------------------+
 // Board Specific Configuration
 //--------------------------------------------------------------------+
@@ -91,14 +93,16 @@
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_HID               1
+// The composite interface plus one per keyboard lane (hid_lanes.h)
+#define CFG_TUD_HID               (1 + CFG_APP_KEYBOARD_LANES)
 #define CFG_TUD_CDC               0
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    16
+// This is also the control buffer, so it sizes the vendor feature reports
+#define CFG_TUD_HID_EP_BUFSIZE    32
 
 #ifdef __cplusplus
  }
@@ -33,9 +33,13 @@
  * Auto ProductID layout's Bitmap:
  *   [MSB]         HID | MSC | CDC          [LSB]
  */
-#define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
+#define _PID_MAP(itf, n)  ( (CFG_TUD_##itf ? 1 : 0) << (n) )
 #define USB_PID           (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
-                           _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4) )
+                           _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4) | (CFG_APP_KEYBOARD_LANES << 5) )
+
+#if CFG_APP_KEYBOARD_LANES > 4
+#error "CFG_APP_KEYBOARD_LANES must be 0 to 4"
+#endif
 
 #define USB_VID   0xCafe
 #define USB_BCD   0x0200
@@ -80,15 +84,29 @@ uint8_t const desc_hid_report[] =
   TUD_HID_REPORT_DESC_KEYBOARD( HID_REPORT_ID(REPORT_ID_KEYBOARD         )),
   TUD_HID_REPORT_DESC_MOUSE   ( HID_REPORT_ID(REPORT_ID_MOUSE            )),
   TUD_HID_REPORT_DESC_CONSUMER( HID_REPORT_ID(REPORT_ID_CONSUMER_CONTROL )),
-  TUD_HID_REPORT_DESC_GAMEPAD ( HID_REPORT_ID(REPORT_ID_GAMEPAD          ))
+  TUD_HID_REPORT_DESC_GAMEPAD ( HID_REPORT_ID(REPORT_ID_GAMEPAD          )),
+  TUD_HID_REPORT_DESC_VENDOR_FEATURE( 0x01, HID_REPORT_ID(REPORT_ID_CLOCK_SYNC) ),
+  TUD_HID_REPORT_DESC_VENDOR_FEATURE( 0x02, HID_REPORT_ID(REPORT_ID_TELEMETRY ) )
 };
 
+#if CFG_APP_KEYBOARD_LANES
+// Keyboard lanes, without report ID
+uint8_t const desc_hid_lane_report[] =
+{
+  TUD_HID_REPORT_DESC_KEYBOARD()
+};
+#endif
+
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
 {
+#if CFG_APP_KEYBOARD_LANES
+  if (instance > 0) return desc_hid_lane_report;
+#else
   (void) instance;
+#endif
   return desc_hid_report;
 }
 
@@ -99,20 +117,38 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
 enum
 {
   ITF_NUM_HID,
-  ITF_NUM_TOTAL
+  ITF_NUM_LANE,
+  ITF_NUM_TOTAL = ITF_NUM_LANE + CFG_APP_KEYBOARD_LANES
 };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + (1 + CFG_APP_KEYBOARD_LANES) * TUD_HID_DESC_LEN)
 
 #define EPNUM_HID   0x81
 
+// Lane n is HID instance n + 1 on the next IN endpoint
+#define TUD_HID_LANE_DESCRIPTOR(n) \
+  TUD_HID_DESCRIPTOR(ITF_NUM_LANE + (n), 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_lane_report), EPNUM_HID + 1 + (n), CFG_TUD_HID_EP_BUFSIZE, HID_POLL_INTERVAL)
+
 uint8_t const desc_configuration[] =
 {
   // Config number, interface count, string index, total length, attribute, power in mA
   TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
   // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 5)
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, HID_POLL_INTERVAL),
+
+#if CFG_APP_KEYBOARD_LANES > 0
+  TUD_HID_LANE_DESCRIPTOR(0),
+#endif
+#if CFG_APP_KEYBOARD_LANES > 1
+  TUD_HID_LANE_DESCRIPTOR(1),
+#endif
+#if CFG_APP_KEYBOARD_LANES > 2
+  TUD_HID_LANE_DESCRIPTOR(2),
+#endif
+#if CFG_APP_KEYBOARD_LANES > 3
+  TUD_HID_LANE_DESCRIPTOR(3),
+#endif
 };
 
 #if TUD_OPT_HIGH_SPEED
@@ -211,6 +247,7 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 
     case STRID_SERIAL:
       chr_count = board_usb_get_serial(_desc_str + 1, 32);
+      if ( chr_count > 32 ) chr_count = 32;
       break;
 
     default:
@@ -31,7 +31,30 @@ enum
   REPORT_ID_MOUSE,
   REPORT_ID_CONSUMER_CONTROL,
   REPORT_ID_GAMEPAD,
+  REPORT_ID_CLOCK_SYNC,
+  REPORT_ID_TELEMETRY,
   REPORT_ID_COUNT
 };
 
+// bInterval of the HID IN endpoint, in frames (ms at full speed)
+#define HID_POLL_INTERVAL   5
+
+// Vendor feature reports fill the control buffer, minus the report ID
+#define VENDOR_FEATURE_LEN  (CFG_TUD_HID_EP_BUFSIZE - 1)
+
+// Vendor defined feature report of VENDOR_FEATURE_LEN opaque bytes
+#define TUD_HID_REPORT_DESC_VENDOR_FEATURE(usage, ...) \
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2   ),\
+  HID_USAGE        ( usage                       ),\
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION  ),\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE        ( usage                     ),\
+    HID_LOGICAL_MIN  ( 0x00                      ),\
+    HID_LOGICAL_MAX_N( 0xff, 2                   ),\
+    HID_REPORT_SIZE  ( 8                         ),\
+    HID_REPORT_COUNT ( VENDOR_FEATURE_LEN        ),\
+    HID_FEATURE      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),\
+  HID_COLLECTION_END
+
 #endif /* USB_DESCRIPTORS_H_ */